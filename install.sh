@@ -19,7 +19,7 @@ DISTRO_CODENAME="unknown"
 
 # Defaults
 BUILD_MODE="release"  # release | debug_all | debug_nd
-CPU_TARGET=""         # avx2 | avx512 | neon | sve2 (empty by default)
+CPU_TARGET=""         # avx2 | avx512 | x86_64 | neon | sve2 (empty by default)
 SKIP_DEPS=false       # if true, skip dependency installation step
 
 script_dir="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
@@ -259,6 +259,7 @@ build_project() {
         case "$CPU_TARGET" in
             avx2)   cmake_args+=("-DUSE_AVX2=ON") ;;
             avx512) cmake_args+=("-DUSE_AVX512=ON") ;;
+            x86_64) cmake_args+=("-DUSE_RUNTIME_DISPATCH=ON") ;;
             neon)   cmake_args+=("-DUSE_NEON=ON") ;;
             sve2)   cmake_args+=("-DUSE_SVE2=ON") ;;
             *) 
@@ -304,6 +305,7 @@ Build Mode Options (Select one):
 CPU Optimization Options (Select one):
   --avx2          Add -DUSE_AVX2=ON
   --avx512        Add -DUSE_AVX512=ON
+  --x86_64        Add -DUSE_RUNTIME_DISPATCH=ON (AVX2 and AVX512 in one binary)
   --neon          Add -DUSE_NEON=ON
   --sve2          Add -DUSE_SVE2=ON
 
@@ -351,6 +353,10 @@ parse_args() {
                 CPU_TARGET="avx512"
                 shift
                 ;;
+            --x86_64)
+                CPU_TARGET="x86_64"
+                shift
+                ;;
             --neon)
                 CPU_TARGET="neon"
                 shift
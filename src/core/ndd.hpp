@@ -11,9 +11,11 @@
 #include "index_meta.hpp"
 #include "msgpack_ndd.hpp"
 #include "quant_vector.hpp"
+#include "search_planner.hpp"
 #include "wal.hpp"
 #include "../quant/dispatch.hpp"
 #include "../utils/archive_utils.hpp"
+#include "../utils/worker_pool.hpp"
 #include <memory>
 #include <deque>
 #include <unordered_map>
@@ -41,6 +43,13 @@ struct IndexConfig {
     ndd::quant::QuantizationLevel quant_level =
             ndd::quant::QuantizationLevel::INT8;  // Default to INT8 quantization
     const int32_t checksum;
+    // Precision of an extra copy used to rerank graph candidates. UNKNOWN disables reranking
+    ndd::quant::QuantizationLevel rerank_quant_level = ndd::quant::QuantizationLevel::UNKNOWN;
+    // Leading dimensions the graph is built on (Matryoshka embeddings), 0 for all of them. The
+    // rerank copy keeps every dimension
+    size_t prefix_dim = 0;
+
+    size_t graphDim() const { return prefix_dim ? prefix_dim : dim; }
 };
 
 struct IndexInfo {
@@ -53,6 +62,22 @@ struct IndexInfo {
     int32_t checksum;
     size_t M;
     size_t ef_con;
+    ndd::quant::QuantizationLevel rerank_quant_level;
+    size_t prefix_dim;
+    size_t deleted_elements;  // Still linked into the graph until the next vacuum
+    double deleted_ratio;
+};
+
+// Exposes a pinned vector store read view to HNSW for zero-copy level 0 access
+class StorageVectorView : public hnswlib::VectorView {
+public:
+    explicit StorageVectorView(VectorStore::ReadView&& view) :
+        view_(std::move(view)) {}
+
+    const uint8_t* getVector(ndd::idInt label) const override { return view_.get(label); }
+
+private:
+    VectorStore::ReadView view_;
 };
 
 struct CacheEntry {
@@ -71,6 +96,9 @@ struct CacheEntry {
     size_t searchCount{0};
     // Per-index operation mutex for coordinating addVectors, saveIndex, deleteVectors
     std::mutex operation_mutex;
+    // Checkpoint being written in the background, see checkpointInternal(). It yields
+    // whether the checkpoint reached the disk, waitForCheckpoint() applies a failure
+    std::future<bool> checkpoint;
 
     // Default constructor required for map
     CacheEntry() :
@@ -156,6 +184,8 @@ private:
     std::atomic<bool> running_{true};
     // Write-ahead log for each index
     std::unordered_map<std::string, std::unique_ptr<WriteAheadLog>> wal_logs_;
+    // Threads for exact searches over large filter results, the calling thread is the last one
+    ndd::WorkerPool search_pool_{settings::NUM_SEARCH_THREADS - 1};
 
     // New methods to handle WAL
     WriteAheadLog* getOrCreateWAL(const std::string& index_id) {
@@ -258,11 +288,32 @@ private:
                 break;
             }
             LOG_INFO("Autosave check running");
+            vacuumIndices();
             checkAndSaveIndices();
         }
         LOG_INFO("Autosave thread stopped");
     }
 
+    // Vacuum indices whose deleted elements crossed the threshold
+    void vacuumIndices() {
+        std::vector<std::string> indices_to_vacuum;
+        for(auto& [index_id, entry] : indices_) {
+            if(entry.alg->getDeletedCount() >= settings::VACUUM_MIN_DELETED
+               && entry.alg->getDeletedRatio() >= settings::VACUUM_DELETED_RATIO) {
+                indices_to_vacuum.push_back(index_id);
+            }
+        }
+
+        for(const auto& index_id : indices_to_vacuum) {
+            try {
+                LOG_INFO("Vacuuming index " << index_id);
+                vacuumIndex(index_id);
+            } catch(const std::exception& e) {
+                LOG_ERROR("Failed to vacuum " << index_id << ": " << e.what());
+            }
+        }
+    }
+
     // Check and save indices based on update time
     void checkAndSaveIndices() {
         std::vector<std::string> indices_to_save;
@@ -336,11 +387,107 @@ private:
     // Internal saveIndex implementation that doesn't call getIndexEntry
     // Used by functions that already have the entry and mutex
     void saveIndexInternal(CacheEntry& entry) {
+        // A checkpoint still being written would race with this save for the file and WAL
+        waitForCheckpoint(entry);
         // Double check if the index is still updated
         if(!entry.updated) {
             return;
         }
         LOG_DEBUG("Saving index " << entry.index_id);
+        growIfNeeded(entry);
+
+        std::string index_path = data_dir_ + "/" + entry.index_id + "/main.idx";
+        std::string temp_path = index_path + ".tmp";
+
+        entry.alg->saveIndex(temp_path);
+        std::filesystem::rename(temp_path, index_path);
+        // The deltas of the previous file no longer apply
+        std::filesystem::remove(hnswlib::deltaPath(index_path));
+
+        // Clear the WAL
+        clearWAL(entry.index_id);
+
+        // Update element count in metadata
+        if(!metadata_manager_->updateElementCount(entry.index_id, entry.alg->getElementsCount())) {
+            std::cerr << "Warning: Failed to update element count in metadata for "
+                      << entry.index_id << std::endl;
+        }
+        entry.updated = false;
+    }
+
+    // Save triggered by the WAL size on the write path. The index is copied in memory while
+    // the caller holds operation_mutex, and the copy is written to disk by a background thread
+    // once the lock is released. The WAL entries the copy covers are rotated aside and dropped
+    // once the file is in place, so a crash before that replays them over the previous file.
+    // Mostly only the regions changed since the last checkpoint are copied, and appended to
+    // the delta file next to the index file
+    void checkpointInternal(CacheEntry& entry) {
+        if(!entry.updated) {
+            return;
+        }
+        // The previous checkpoint is still writing, the WAL can grow until the next trigger
+        if(entry.checkpoint.valid()
+           && entry.checkpoint.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        waitForCheckpoint(entry);
+        LOG_DEBUG("Checkpointing index " << entry.index_id);
+        growIfNeeded(entry);
+
+        // The WAL moves aside first: a failure there leaves the index untouched. Taking the
+        // snapshot consumes the dirty regions, so from there on a failure makes the next
+        // checkpoint a full one
+        WriteAheadLog* wal = getOrCreateWAL(entry.index_id);
+        wal->rotate();
+        try {
+            std::shared_ptr<hnswlib::IndexSnapshot> snapshot = entry.alg->snapshot(true);
+            if(!metadata_manager_->updateElementCount(entry.index_id,
+                                                      entry.alg->getElementsCount())) {
+                std::cerr << "Warning: Failed to update element count in metadata for "
+                          << entry.index_id << std::endl;
+            }
+
+            // The writer thread leaves the entry alone, the entry is only changed by threads
+            // holding operation_mutex
+            std::string index_id = entry.index_id;
+            std::string index_path = data_dir_ + "/" + index_id + "/main.idx";
+            entry.checkpoint = std::async(
+                    std::launch::async, [index_id, snapshot, wal, index_path]() {
+                        std::string temp_path = index_path + ".tmp";
+                        try {
+                            if(snapshot->delta) {
+                                snapshot->write(index_path);
+                            } else {
+                                snapshot->write(temp_path);
+                                std::filesystem::rename(temp_path, index_path);
+                                std::filesystem::remove(hnswlib::deltaPath(index_path));
+                            }
+                            wal->dropRotated();
+                            return true;
+                        } catch(const std::exception& e) {
+                            LOG_ERROR("Checkpoint of " << index_id << " failed: " << e.what());
+                            return false;
+                        }
+                    });
+        } catch(...) {
+            entry.alg->requireFullCheckpoint();
+            throw;
+        }
+        entry.updated = false;
+    }
+
+    // Waits for the background checkpoint of the entry, if any. Called with operation_mutex
+    // held, or once nothing else uses the entry
+    void waitForCheckpoint(CacheEntry& entry) {
+        if(entry.checkpoint.valid() && !entry.checkpoint.get()) {
+            // The rotated WAL entries stay, the next save covers them again in full
+            entry.alg->requireFullCheckpoint();
+            entry.markUpdated();
+        }
+    }
+
+    // Grows an index that is about to run out of slots before it is saved
+    void growIfNeeded(CacheEntry& entry) {
         // Auto-resize check
         size_t remainingCapacity = entry.alg->getRemainingCapacity();
         LOG_DEBUG("Remaining capacity for index " << entry.index_id << ": " << remainingCapacity);
@@ -360,22 +507,192 @@ private:
                 // Continue with saving even if resize fails
             }
         }
+    }
 
-        std::string index_path = data_dir_ + "/" + entry.index_id + "/main.idx";
-        std::string temp_path = index_path + ".tmp";
+private:
+    // Exact search over the ids of a filter bitmap. Used when so few vectors match that a
+    // brute force scan beats a filtered graph traversal. Blocks of ids are scored on the
+    // search pool, every thread reads through its own view.
+    std::vector<std::pair<float, ndd::idInt>>
+    searchPrefiltered(CacheEntry& entry,
+                      const std::vector<uint8_t>& query_bytes,
+                      const ndd::RoaringBitmap& filter_bitmap,
+                      size_t k) {
+        auto results = hnswlib::searchKnnBitmap(
+                query_bytes.data(),
+                filter_bitmap,
+                k,
+                entry.alg->getSpace(),
+                search_pool_,
+                settings::BRUTE_FORCE_BLOCK_SIZE,
+                [&]() { return entry.vector_storage->get_read_view(); });
+
+        LOG_DEBUG("Pre-filter: bruteforce search over " << filter_bitmap.cardinality()
+                                                        << " ids returned " << results.size()
+                                                        << " results");
+        return results;
+    }
 
-        entry.alg->saveIndex(temp_path);
-        std::filesystem::rename(temp_path, index_path);
+    // Rescores dense candidates against the higher precision rerank copies and keeps the best
+    // k, most similar first. Candidates without a rerank copy are dropped.
+    void rerankCandidates(CacheEntry& entry,
+                          const std::vector<float>& query,
+                          std::vector<std::pair<float, ndd::idInt>>& candidates,
+                          size_t k) {
+        ndd::quant::QuantizationLevel rerank_level = entry.vector_storage->getRerankQuantLevel();
+        hnswlib::UnifiedSpace space(entry.alg->getSpaceType(),
+                                    entry.vector_storage->getRerankDimension(),
+                                    rerank_level);
+        std::vector<uint8_t> query_bytes =
+                ndd::quant::quantize_query(ndd::quant::get_quantizer_dispatch(rerank_level),
+                                           query,
+                                           space.get_dist_func_param());
+
+        auto rerank_view = entry.vector_storage->get_rerank_view();
+        std::vector<ndd::idInt> labels;
+        std::vector<const void*> vectors;
+        labels.reserve(candidates.size());
+        vectors.reserve(candidates.size());
+        for(const auto& [similarity, label] : candidates) {
+            if(const uint8_t* vec = rerank_view.get(label)) {
+                labels.push_back(label);
+                vectors.push_back(vec);
+            }
+        }
 
-        // Clear the WAL
-        clearWAL(entry.index_id);
+        std::vector<float> sims(labels.size());
+        space.get_query_sim_batch_func()(query_bytes.data(),
+                                         vectors.data(),
+                                         vectors.size(),
+                                         space.get_dist_func_param(),
+                                         sims.data());
 
-        // Update element count in metadata
-        if(!metadata_manager_->updateElementCount(entry.index_id, entry.alg->getElementsCount())) {
-            std::cerr << "Warning: Failed to update element count in metadata for "
-                      << entry.index_id << std::endl;
+        candidates.clear();
+        for(size_t i = 0; i < labels.size(); i++) {
+            candidates.emplace_back(sims[i], labels[i]);
         }
-        entry.updated = false;
+        size_t keep = std::min(k, candidates.size());
+        std::partial_sort(candidates.begin(),
+                          candidates.begin() + keep,
+                          candidates.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+        candidates.resize(keep);
+    }
+
+    // Leading dimensions the graph of a prefix index is built on, 0 when it has all of them
+    size_t prefixDim(const CacheEntry& entry) const {
+        size_t graph_dim = entry.alg->getDimension();
+        return entry.vector_storage->getRerankDimension() > graph_dim ? graph_dim : 0;
+    }
+
+    // Float values of a stored vector for responses. The graph of a prefix index holds only
+    // the leading dimensions, so its vectors are read from the rerank copy
+    std::vector<float> decodeStoredVector(CacheEntry& entry, const uint8_t* vec_bytes) {
+        if(prefixDim(entry)) {
+            return ndd::quant::get_quantizer_dispatch(entry.vector_storage->getRerankQuantLevel())
+                    .dequantize(vec_bytes, entry.vector_storage->getRerankDimension());
+        }
+        return ndd::quant::dequantize_vector(
+                ndd::quant::get_quantizer_dispatch(entry.alg->getQuantLevel()),
+                vec_bytes,
+                entry.alg->getDimension(),
+                entry.alg->getSpace()->get_dist_func_param());
+    }
+
+    std::string codebookPath(const std::string& index_id,
+                             ndd::quant::QuantizationLevel quant_level) const {
+        const char* file = quant_level == ndd::quant::QuantizationLevel::PQ ? "pq_codebook.bin"
+                                                                            : "int8s_scales.bin";
+        return data_dir_ + "/" + index_id + "/" + file;
+    }
+
+    // Trained levels learn their state (PQ codebook, INT8S scales) from a sample of the first
+    // inserted batch. It is on disk before any code is stored, since WAL recovery re-inserts
+    // stored codes.
+    template <typename VectorType>
+    void trainCodebook(CacheEntry& entry, const std::vector<VectorType>& vectors) {
+        ndd::quant::QuantizationLevel quant_level = entry.alg->getQuantLevel();
+        bool is_pq = quant_level == ndd::quant::QuantizationLevel::PQ;
+        size_t min_vectors =
+                is_pq ? settings::PQ_MIN_TRAINING_VECTORS : settings::INT8S_MIN_TRAINING_VECTORS;
+        size_t max_vectors =
+                is_pq ? settings::PQ_MAX_TRAINING_VECTORS : settings::INT8S_MAX_TRAINING_VECTORS;
+        std::string level_name = ndd::quant::quantLevelToString(quant_level);
+        if(vectors.size() < min_vectors) {
+            throw std::runtime_error("The first batch of a " + level_name
+                                     + " index trains its quantizer and needs at least "
+                                     + std::to_string(min_vectors) + " vectors");
+        }
+
+        size_t dim = entry.alg->getDimension();
+        bool prefix = prefixDim(entry) != 0;
+        size_t num_samples = std::min(vectors.size(), max_vectors);
+        std::vector<float> samples(num_samples * dim);
+        for(size_t i = 0; i < num_samples; i++) {
+            const auto& vec = vectors[i * vectors.size() / num_samples].vector;
+            if(prefix) {
+                auto sample = vector_prefix(vec, dim, entry.alg->getSpaceType());
+                std::copy(sample.begin(), sample.end(), samples.begin() + i * dim);
+                continue;
+            }
+            if(vec.size() != dim) {
+                throw std::runtime_error("Vector dimension mismatch");
+            }
+            std::copy(vec.begin(), vec.end(), samples.begin() + i * dim);
+        }
+
+        std::string path = codebookPath(entry.index_id, quant_level);
+        std::shared_ptr<const void> codebook;
+        if(is_pq) {
+            auto trained = ndd::quant::pq::Codebook::train(samples.data(),
+                                                           num_samples,
+                                                           dim,
+                                                           settings::PQ_TRAINING_ITERATIONS,
+                                                           settings::RANDOM_SEED);
+            trained->save(path + ".tmp");
+            codebook = trained;
+        } else {
+            auto trained = ndd::quant::int8s::DimScales::train(samples.data(), num_samples, dim);
+            trained->save(path + ".tmp");
+            codebook = trained;
+        }
+        std::filesystem::rename(path + ".tmp", path);
+        entry.alg->setCodebook(codebook);
+        LOG_INFO("Trained " << level_name << " quantizer for " << entry.index_id << " on "
+                            << num_samples << " vectors");
+    }
+
+    void loadCodebook(const std::string& index_id, hnswlib::HierarchicalNSW<float>& alg) {
+        ndd::quant::QuantizationLevel quant_level = alg.getQuantLevel();
+        if(!ndd::quant::is_trained_level(quant_level)) {
+            return;
+        }
+        std::string path = codebookPath(index_id, quant_level);
+        if(!std::filesystem::exists(path)) {
+            return;
+        }
+        if(quant_level == ndd::quant::QuantizationLevel::PQ) {
+            alg.setCodebook(ndd::quant::pq::Codebook::load(path));
+        } else {
+            alg.setCodebook(ndd::quant::int8s::DimScales::load(path));
+        }
+    }
+
+    // Whether the entry has a checkpoint still writing. The result of a finished one is applied
+    // when operation_mutex is free, a failure makes the entry dirty again
+    bool checkpointPending(CacheEntry& entry) {
+        if(!entry.checkpoint.valid()) {
+            return false;
+        }
+        if(entry.checkpoint.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return true;
+        }
+        std::unique_lock<std::mutex> operation_lock(entry.operation_mutex, std::try_to_lock);
+        if(!operation_lock.owns_lock()) {
+            return true;
+        }
+        waitForCheckpoint(entry);
+        return false;
     }
 
 public:
@@ -399,8 +716,10 @@ public:
                 if(it != indices_.end()) {
                     total_size -= it->second.alg->getApproxSizeGB();
 
-                    // Only evict if the index is not dirty (hasn't been updated)
-                    if(it->second.updated) {
+                    // Only evict if the index is not dirty (hasn't been updated). A checkpoint
+                    // leaves it dirty until it is on disk, the one still writing is not waited
+                    // for here as indices_mutex_ is held
+                    if(checkpointPending(it->second) || it->second.updated) {
                         LOG_WARN("Cannot evict dirty index " << to_evict
                                                              << " - needs saving first");
                         // Put it back at the front to try other indices
@@ -503,6 +822,14 @@ public:
             }
             LOG_DEBUG("Shutdown complete");
         }
+        // Background checkpoints still use the WAL
+        for(auto& [index_id, entry] : indices_) {
+            try {
+                waitForCheckpoint(entry);
+            } catch(const std::exception& e) {
+                std::cerr << "Checkpoint of " << index_id << " failed: " << e.what() << std::endl;
+            }
+        }
         // Clear WAL logs
         wal_logs_.clear();
     }
@@ -534,7 +861,7 @@ public:
 
         hnswlib::HierarchicalNSW<float> hnsw(config.max_elements,
                                              space_type,
-                                             config.dim,
+                                             config.graphDim(),
                                              config.M,
                                              config.ef_construction,
                                              settings::RANDOM_SEED,
@@ -636,6 +963,8 @@ public:
                            {"sparse_dim", meta->sparse_dim},
                            {"space_type", meta->space_type_str},
                            {"quant_level", static_cast<int>(meta->quant_level)},
+                           {"rerank_quant_level", static_cast<int>(meta->rerank_quant_level)},
+                           {"prefix_dim", meta->prefix_dim},
                            {"total_elements", meta->total_elements},
                            {"checksum", meta->checksum}};
 
@@ -755,6 +1084,9 @@ public:
             new_meta.space_type_str = meta_json["params"]["space_type"];
             new_meta.quant_level = static_cast<ndd::quant::QuantizationLevel>(
                     meta_json["params"]["quant_level"].get<int>());
+            new_meta.rerank_quant_level = static_cast<ndd::quant::QuantizationLevel>(
+                    meta_json["params"].value("rerank_quant_level", 0));
+            new_meta.prefix_dim = meta_json["params"].value("prefix_dim", 0ul);
             new_meta.created_at = std::chrono::system_clock::now();
             new_meta.total_elements = meta_json["params"].value("total_elements", 0ul);
             new_meta.checksum = meta_json["params"].value("checksum", -1);
@@ -850,8 +1182,11 @@ public:
 
         // Create HNSW directly with all necessary parameters
         ndd::quant::QuantizationLevel quant_level = config.quant_level;
-        auto vector_storage =
-                std::make_shared<VectorStorage>(vector_storage_dir, config.dim, config.quant_level);
+        auto vector_storage = std::make_shared<VectorStorage>(vector_storage_dir,
+                                                              config.graphDim(),
+                                                              config.quant_level,
+                                                              config.rerank_quant_level,
+                                                              config.dim);
 
         // Initialize Sparse Storage if needed
         std::unique_ptr<ndd::SparseVectorStorage> sparse_storage = nullptr;
@@ -865,7 +1200,7 @@ public:
 
         auto alg = std::make_unique<hnswlib::HierarchicalNSW<float>>(config.max_elements,
                                                                      space_type,
-                                                                     config.dim,
+                                                                     config.graphDim(),
                                                                      config.M,
                                                                      config.ef_construction,
                                                                      settings::RANDOM_SEED,
@@ -875,6 +1210,12 @@ public:
         alg->setVectorFetcher([vs = vector_storage](ndd::idInt label, uint8_t* buffer) {
             return vs->get_vector(label, buffer);
         });
+        alg->setVectorViewFactory([vs = vector_storage]() {
+            return std::make_unique<StorageVectorView>(vs->get_read_view());
+        });
+        if(settings::ENABLE_VECTOR_ARENA) {
+            alg->enableVectorArena();
+        }
 
         // Create WAL during index creation
         getOrCreateWAL(index_id);
@@ -904,6 +1245,8 @@ public:
         metadata_entry.sparse_dim = config.sparse_dim;
         metadata_entry.space_type_str = config.space_type_str;
         metadata_entry.quant_level = config.quant_level;
+        metadata_entry.rerank_quant_level = config.rerank_quant_level;
+        metadata_entry.prefix_dim = config.prefix_dim;
         metadata_entry.checksum = config.checksum;
         metadata_entry.total_elements = 0;
         metadata_entry.M = config.M;
@@ -939,11 +1282,15 @@ public:
             throw std::runtime_error("Required files missing for index: " + index_id);
         }
 
-        // Load metadata to get sparse_dim
+        // Load metadata to get sparse_dim, the rerank precision and the full dimension
         auto metadata = metadata_manager_->getMetadata(index_id);
         size_t sparse_dim = 0;
+        ndd::quant::QuantizationLevel rerank_quant_level = ndd::quant::QuantizationLevel::UNKNOWN;
+        size_t rerank_dim = 0;
         if(metadata) {
             sparse_dim = metadata->sparse_dim;
+            rerank_quant_level = metadata->rerank_quant_level;
+            rerank_dim = metadata->dimension;
         }
 
         // Step 1: Load HNSW index (automatically adjusts cache based on element count and cache
@@ -956,10 +1303,15 @@ public:
             throw std::runtime_error("Cannot load index '" + index_id + "': " + e.what());
         }
 
+        loadCodebook(index_id, *alg);
+
         // Step 2: Create IDMapper and VectorStorage - IDMapper handles bloom filter initialization
         auto id_mapper = std::make_shared<IDMapper>(lmdb_dir, false);
-        auto vector_storage = std::make_shared<VectorStorage>(
-                vector_storage_dir, alg->getDimension(), alg->getQuantLevel());
+        auto vector_storage = std::make_shared<VectorStorage>(vector_storage_dir,
+                                                              alg->getDimension(),
+                                                              alg->getQuantLevel(),
+                                                              rerank_quant_level,
+                                                              rerank_dim);
 
         // Initialize Sparse Storage if sparse_dim > 0
         std::unique_ptr<ndd::SparseVectorStorage> sparse_storage;
@@ -976,6 +1328,12 @@ public:
         alg->setVectorFetcher([vs = vector_storage](ndd::idInt label, uint8_t* buffer) {
             return vs->get_vector(label, buffer);
         });
+        alg->setVectorViewFactory([vs = vector_storage]() {
+            return std::make_unique<StorageVectorView>(vs->get_read_view());
+        });
+        if(settings::ENABLE_VECTOR_ARENA) {
+            alg->enableVectorArena();
+        }
 
         LOG_DEBUG("Loaded index: " << index_id);
         LOG_DEBUG("Created space for index: " << index_id);
@@ -1004,12 +1362,13 @@ public:
         LOG_INFO("Starting reload for " << index_id);
 
         try {
-            // Phase 1: Save index if it was updated
+            // Phase 1: Save index if it was updated. saveIndex() also waits for a checkpoint
+            // still writing, which Phase 2 would otherwise wait for under the write lock
             {
                 std::shared_lock<std::shared_mutex> lock(indices_mutex_);
                 auto it = indices_.find(index_id);
-                if(it != indices_.end() && it->second.updated) {
-                    LOG_DEBUG("Saving updated index before reload: " << index_id);
+                if(it != indices_.end()) {
+                    LOG_DEBUG("Saving index before reload if updated: " << index_id);
                     saveIndex(index_id);
                 }
             }
@@ -1064,11 +1423,18 @@ public:
 
         // Create a new HNSW algorithm object from the saved file
         auto new_alg = std::make_unique<hnswlib::HierarchicalNSW<float>>(index_path, 0);
+        new_alg->setCodebook(entry.alg->getCodebook());
 
         // Set the vector fetcher to use our storage
         new_alg->setVectorFetcher([vs = entry.vector_storage](ndd::idInt label, uint8_t* buffer) {
             return vs->get_vector(label, buffer);
         });
+        new_alg->setVectorViewFactory([vs = entry.vector_storage]() {
+            return std::make_unique<StorageVectorView>(vs->get_read_view());
+        });
+        if(settings::ENABLE_VECTOR_ARENA) {
+            new_alg->enableVectorArena();
+        }
 
         // Replace the algorithm in the existing entry
         entry.alg = std::move(new_alg);
@@ -1090,6 +1456,11 @@ public:
                 return false;
             }
 
+            if(ndd::quant::is_trained_level(entry.alg->getQuantLevel())
+               && !entry.alg->hasCodebook()) {
+                trainCodebook(entry, vectors);
+            }
+
             // CRITICAL FIX: Pass WAL to create_ids_batch for atomic logging
             WriteAheadLog* wal = getOrCreateWAL(index_id);
 
@@ -1102,8 +1473,10 @@ public:
             std::vector<std::pair<idInt, bool>> numeric_ids;
             // Get or create numeric IDs in batch - this returns ids.
             // If str_id already exists, it will return the old numeric ID
-            if(entry.alg->getDeletedCount() > 0) {
-                // There are deleted IDs, we need to reuse them
+            if(entry.alg->getDeletedCount() > 0 || entry.alg->getFreeSlotCount() > 0) {
+                // There are deleted IDs, we need to reuse them. Once vacuum() reclaimed their
+                // slots they are only counted as free slots, and fresh IDs would outgrow the
+                // label lookup of the index
                 numeric_ids = entry.id_mapper->create_ids_batch<true>(str_ids, wal);
             } else {
                 // No deleted IDs, just create new ones
@@ -1152,6 +1525,9 @@ public:
             std::vector<QuantVectorObject> quantized_vectors;
             quantized_vectors.reserve(vectors.size());
             ndd::quant::QuantizationLevel quant_level = entry.alg->getQuantLevel();
+            ndd::quant::QuantizationLevel rerank_level =
+                    entry.vector_storage->getRerankQuantLevel();
+            size_t prefix_dim = prefixDim(entry);
             auto space = entry.alg->getSpace();
             const void* dist_params = space ? space->get_dist_func_param() : nullptr;
 
@@ -1163,7 +1539,8 @@ public:
 
             for(auto& vec_obj : mutable_vectors) {
                 // Use efficient move constructor with internal quantization
-                quantized_vectors.emplace_back(std::move(vec_obj), quant_level, dist_params);
+                quantized_vectors.emplace_back(
+                        std::move(vec_obj), quant_level, dist_params, rerank_level, prefix_dim);
             }
             LOG_DEBUG("QuantVectorObject conversion completed with move semantics");
 
@@ -1228,9 +1605,9 @@ public:
 
             // Check if we need to save based on WAL entry count after logging
             if(wal->getEntryCount() >= persistence_config_.save_every_n_updates) {
-                LOG_DEBUG("Saving index " << index_id << " after " << wal->getEntryCount()
-                                          << " updates");
-                saveIndexInternal(entry);
+                LOG_DEBUG("Checkpointing index " << index_id << " after "
+                                    << wal->getEntryCount() << " updates");
+                checkpointInternal(entry);
             }
 
             PRINT_LOG_TIME();
@@ -1349,7 +1726,6 @@ public:
                 return std::nullopt;
             }
 
-            std::vector<uint8_t> vec_bytes = entry.vector_storage->get_vector(numeric_id);
             ndd::VectorMeta meta = entry.vector_storage->get_meta(numeric_id);
 
             ndd::VectorObject obj;
@@ -1359,10 +1735,16 @@ public:
             obj.norm = meta.norm;
 
             // Convert raw bytes to float vector using unified dequantization function
-            ndd::quant::QuantizationLevel quant_level = entry.alg->getQuantLevel();
-            std::vector<float> float_data =
-                    ndd::quant::get_quantizer_dispatch(quant_level)
-                            .dequantize(vec_bytes.data(), entry.alg->getDimension());
+            std::vector<float> float_data;
+            if(prefixDim(entry)) {
+                auto rerank_view = entry.vector_storage->get_rerank_view();
+                if(const uint8_t* vec_bytes = rerank_view.get(numeric_id)) {
+                    float_data = decodeStoredVector(entry, vec_bytes);
+                }
+            } else {
+                std::vector<uint8_t> vec_bytes = entry.vector_storage->get_vector(numeric_id);
+                float_data = decodeStoredVector(entry, vec_bytes.data());
+            }
 
             // Add the float data to the msgpack
             obj.vector = {float_data.begin(), float_data.end()};
@@ -1374,10 +1756,13 @@ public:
         }
     }
 
-    // Delete vectors from id mapper, delete filter and mark as deleted in HNSW. Does not delete
-    // meta, vector data Meta and vector data will be overwritten when the id is reused
+    // Delete vectors from id mapper, delete filter and rerank copy and mark as deleted in HNSW.
+    // Does not delete meta, vector data Meta and vector data will be overwritten when the id is
+    // reused
     bool deleteVectorsByIds(CacheEntry& entry, const std::vector<ndd::idInt>& numeric_ids) {
         try {
+            std::vector<ndd::idInt> deleted_ids;
+            deleted_ids.reserve(numeric_ids.size());
             for(ndd::idInt numeric_id : numeric_ids) {
                 auto meta = entry.vector_storage->get_meta(numeric_id);
                 // Remove ID mapping by getting the string id from metadata
@@ -1391,7 +1776,9 @@ public:
                 entry.vector_storage->deleteFilter(numeric_id, meta.filter);
                 // Mark as deleted in HNSW index
                 entry.alg->markDelete(numeric_id);
+                deleted_ids.push_back(numeric_id);
             }
+            entry.vector_storage->deleteRerankVectors(deleted_ids);
             // Add the list to write ahead log using IndexManager's method
             logDeletions(entry.index_id, numeric_ids);
 
@@ -1420,9 +1807,9 @@ public:
                 // Check if we need to save based on WAL entry count after logging
                 WriteAheadLog* wal = getOrCreateWAL(index_id);
                 if(wal->getEntryCount() >= persistence_config_.save_every_n_updates) {
-                    LOG_DEBUG("Saving index " << index_id << " after " << wal->getEntryCount()
-                                              << " updates");
-                    saveIndexInternal(entry);
+                    LOG_DEBUG("Checkpointing index " << index_id << " after "
+                                    << wal->getEntryCount() << " updates");
+                    checkpointInternal(entry);
                 }
                 return numeric_ids.size();
             } else {
@@ -1484,9 +1871,9 @@ public:
             if(result) {
                 WriteAheadLog* wal = getOrCreateWAL(index_id);
                 if(wal->getEntryCount() >= persistence_config_.save_every_n_updates) {
-                    LOG_DEBUG("Saving index " << index_id << " after " << wal->getEntryCount()
-                                              << " updates");
-                    saveIndexInternal(entry);
+                    LOG_DEBUG("Checkpointing index " << index_id << " after "
+                                    << wal->getEntryCount() << " updates");
+                    checkpointInternal(entry);
                 }
             }
 
@@ -1514,11 +1901,18 @@ public:
               size_t k,
               const nlohmann::json& filter_array,
               bool include_vectors = false,
-              size_t ef = 0) {
+              size_t ef = 0,
+              size_t rerank_factor = 0,
+              ndd::SearchPlan* plan_out = nullptr) {
         try {
             auto& entry = getIndexEntry(index_id);
             entry.searchCount += k;
 
+            // Lookups made on this thread reuse one read transaction per store instead of
+            // renewing one per lookup. The search pool workers and the sparse task open their
+            // own, and the stores are separate environments, so this is no consistent snapshot
+            auto snapshot = entry.vector_storage->pin_snapshot();
+
             // 1. Sparse Search (Async)
             std::future<std::vector<std::pair<ndd::idInt, float>>> sparse_future;
             if(entry.sparse_storage && !sparse_indices.empty()) {
@@ -1548,17 +1942,97 @@ public:
             // 2. Dense Search (Main Thread)
             std::vector<std::pair<float, ndd::idInt>> dense_results;
 
-            if(!query.empty()) {
+            // Indexes with a rerank copy collect rerank_factor * k graph candidates, which are
+            // rescored at the higher precision before the top k are kept
+            bool rerank = !query.empty() && entry.vector_storage->has_rerank_store();
+            size_t dense_k = k;
+            if(rerank) {
+                dense_k = k * (rerank_factor ? rerank_factor : settings::DEFAULT_RERANK_FACTOR);
+            }
+
+            // Filtered dense searches are planned from the filter statistics before any bitmap
+            // is built: brute force over few matches, a filtered traversal in between, or an
+            // unfiltered over-fetch when most vectors match.
+            ndd::SearchPlan local_plan;
+            ndd::SearchPlan& plan = plan_out ? *plan_out : local_plan;
+            plan = ndd::SearchPlan();
+            auto& filter_store = entry.vector_storage->filter_store_;
+            ndd::RoaringBitmap filter_bitmap;
+            bool dense_filtered = !query.empty() && !filter_array.empty();
+            if(dense_filtered) {
+                size_t total = entry.alg->getElementsCount();
+                size_t estimated = filter_store->estimateFilterCardinality(filter_array, total);
+                if(sparse_indices.empty()) {
+                    plan = ndd::planFilteredSearch(total,
+                                                   estimated,
+                                                   entry.alg->getDimension(),
+                                                   entry.alg->getM(),
+                                                   dense_k,
+                                                   ef,
+                                                   search_pool_.concurrency(),
+                                                   entry.alg->hasVectorArena());
+                } else {
+                    // Hybrid results are fused by rank, keep the dense side exact
+                    plan.strategy = ndd::FilterStrategy::FilteredGraph;
+                    plan.estimated_matches = estimated;
+                }
+                LOG_DEBUG("Search plan: " << plan.describe());
+
+                if(plan.strategy != ndd::FilterStrategy::OverFetch) {
+                    filter_bitmap = filter_store->computeFilterBitmap(filter_array);
+                    LOG_DEBUG("Filter cardinality: " << filter_bitmap.cardinality());
+                }
+            }
+
+            // A trained level index has neither its quantizer nor vectors before its first
+            // insert
+            bool dense_ready = !ndd::quant::is_trained_level(entry.alg->getQuantLevel())
+                               || entry.alg->hasCodebook();
+            if(!query.empty() && dense_ready) {
                 // Convert query to bytes using the wrapper method
                 ndd::quant::QuantizationLevel quant_level = entry.alg->getQuantLevel();
-                auto space = entry.alg->getSpace();
-                std::vector<uint8_t> query_bytes =
-                        ndd::quant::get_quantizer_dispatch(quant_level).quantize(query);
-                // Always try post-filtering first (or direct search if no filter)
-                // When there are filters, we need to search for more candidates to account for
-                // filtering
-                size_t search_k = filter_array.empty() ? k : std::max(ef, k * 2);
-                dense_results = entry.alg->searchKnn(query_bytes.data(), search_k, ef);
+                // A prefix index walks its graph with the query prefix, the rerank below
+                // scores the full query
+                size_t prefix_dim = prefixDim(entry);
+                std::vector<uint8_t> query_bytes = ndd::quant::quantize_query(
+                        ndd::quant::get_quantizer_dispatch(quant_level),
+                        prefix_dim ? vector_prefix(query, prefix_dim, entry.alg->getSpaceType())
+                                   : query,
+                        entry.alg->getSpace()->get_dist_func_param());
+
+                if(plan.strategy == ndd::FilterStrategy::BruteForce) {
+                    dense_results = searchPrefiltered(entry, query_bytes, filter_bitmap, dense_k);
+                }
+
+                if(plan.strategy == ndd::FilterStrategy::OverFetch) {
+                    dense_results = entry.alg->searchKnn(query_bytes.data(), plan.fetch_k, ef);
+                    bool exhausted = dense_results.size() < plan.fetch_k;
+                    std::erase_if(dense_results, [&](const auto& p) {
+                        ndd::VectorMeta meta = entry.vector_storage->get_meta(p.second);
+                        return !entry.vector_storage->matches_filter(p.second, meta, filter_array);
+                    });
+
+                    // The estimate was too optimistic, fall back to the filtered traversal
+                    if(dense_results.size() < dense_k && !exhausted) {
+                        plan.strategy = ndd::FilterStrategy::FilteredGraph;
+                        plan.fell_back = true;
+                        filter_bitmap = filter_store->computeFilterBitmap(filter_array);
+                    } else if(dense_results.size() > dense_k) {
+                        dense_results.resize(dense_k);
+                    }
+                }
+
+                if(plan.strategy == ndd::FilterStrategy::FilteredGraph) {
+                    hnswlib::BitmapFilterFunctor filter_functor(filter_bitmap);
+                    dense_results =
+                            entry.alg->searchKnn(query_bytes.data(), dense_k, ef, &filter_functor);
+                } else if(!dense_filtered) {
+                    dense_results = entry.alg->searchKnn(query_bytes.data(), dense_k, ef);
+                }
+
+                if(rerank) {
+                    rerankCandidates(entry, query, dense_results, k);
+                }
             }
 
             // 3. Get Sparse Results (Join)
@@ -1611,14 +2085,22 @@ public:
             results.reserve(final_candidates.size());
             LOG_DEBUG("Search results size: " << final_candidates.size());
 
+            // Vectors are dequantized straight from the store pages, the full dimension copy
+            // for prefix indexes
+            std::optional<VectorStore::ReadView> vector_view;
+            if(include_vectors) {
+                vector_view.emplace(prefixDim(entry) ? entry.vector_storage->get_rerank_view()
+                                                     : entry.vector_storage->get_read_view());
+            }
+
             // Process and filter results
             size_t filtered_count = 0;
             for(const auto& p : final_candidates) {
                 // Get metadata
                 ndd::VectorMeta meta = entry.vector_storage->get_meta(p.second);
 
-                // Apply filter
-                if(!filter_array.empty()
+                // Apply filter. Dense-only results were already filtered by the plan.
+                if(!filter_array.empty() && !(dense_filtered && sparse_results.empty())
                    && !entry.vector_storage->matches_filter(p.second, meta, filter_array)) {
                     continue;
                 }
@@ -1632,12 +2114,9 @@ public:
                 result.norm = meta.norm;
 
                 if(include_vectors) {
-                    std::vector<uint8_t> vec_bytes = entry.vector_storage->get_vector(p.second);
-                    if(!vec_bytes.empty()) {
-                        ndd::quant::QuantizationLevel quant_level = entry.alg->getQuantLevel();
-                        std::vector<float> float_data =
-                                ndd::quant::get_quantizer_dispatch(quant_level)
-                                        .dequantize(vec_bytes.data(), entry.alg->getDimension());
+                    const uint8_t* vec_bytes = vector_view->get(p.second);
+                    if(vec_bytes) {
+                        std::vector<float> float_data = decodeStoredVector(entry, vec_bytes);
                         result.vector = {float_data.begin(), float_data.end()};
                     }
                 }
@@ -1651,109 +2130,6 @@ public:
                 }
             }
 
-            // Check if post-filtering gave poor results and pre-filtering might help
-            // Only for dense search for now as sparse pre-filtering is not implemented
-            if(!filter_array.empty()
-               && filtered_count < k * settings::PREFILTER_RESULT_RATIO_THRESHOLD && !query.empty()
-               && sparse_results.empty()) {
-                size_t filter_cardinality =
-                        entry.vector_storage->filter_store_->countIdsMatchingFilter(filter_array);
-                LOG_DEBUG("Post-filter gave poor results ("
-                          << filtered_count << "/" << k
-                          << "), checking pre-filter option. Cardinality: " << filter_cardinality);
-
-                if(filter_cardinality < settings::PREFILTER_CARDINALITY_THRESHOLD) {
-                    LOG_DEBUG("Using pre-filter approach due to poor post-filter results");
-
-                    // Pre-filter: Get filtered IDs and do bruteforce search
-                    auto filtered_ids =
-                            entry.vector_storage->filter_store_->getIdsMatchingFilter(filter_array);
-                    LOG_DEBUG("Pre-filter: got " << filtered_ids.size() << " filtered IDs");
-
-                    if(!filtered_ids.empty()) {
-                        // Convert size_t to size_t for batch retrieval
-                        std::vector<ndd::idInt> numeric_ids(filtered_ids.begin(),
-                                                            filtered_ids.end());
-
-                        // Get vectors for filtered IDs
-                        auto vector_batch = entry.vector_storage->get_vectors_batch(numeric_ids);
-                        LOG_DEBUG("Pre-filter: retrieved " << vector_batch.size() << " vectors");
-
-                        // Prepare subset for bruteforce search
-                        std::vector<std::pair<idInt, std::vector<uint8_t>>> vector_subset;
-                        vector_subset.reserve(vector_batch.size());
-
-                        for(const auto& [numeric_id, vec_bytes] : vector_batch) {
-                            vector_subset.emplace_back(static_cast<idInt>(numeric_id), vec_bytes);
-                        }
-
-                        // Perform bruteforce search on subset using HNSW's space interface
-                        ndd::quant::QuantizationLevel quant_level = entry.alg->getQuantLevel();
-                        auto space = entry.alg->getSpace();
-                        std::vector<uint8_t> query_bytes =
-                                ndd::quant::get_quantizer_dispatch(quant_level).quantize(query);
-                        auto prefilter_results = hnswlib::searchKnnSubset<float>(
-                                query_bytes.data(), vector_subset, k, space);
-
-                        LOG_DEBUG("Pre-filter: bruteforce search returned "
-                                  << prefilter_results.size() << " results");
-
-                        // Convert results to VectorResult format
-                        std::vector<ndd::VectorResult> prefilter_final_results;
-                        prefilter_final_results.reserve(prefilter_results.size());
-
-                        for(const auto& [distance, label] : prefilter_results) {
-                            ndd::idInt numeric_id = static_cast<ndd::idInt>(label);
-                            ndd::VectorMeta meta = entry.vector_storage->get_meta(numeric_id);
-
-                            ndd::VectorResult result;
-                            result.id = meta.id;
-                            result.filter = meta.filter;
-                            result.meta = meta.meta;
-
-                            if(entry.alg->getSpaceType() == hnswlib::COSINE_SPACE
-                               || entry.alg->getSpaceType() == hnswlib::IP_SPACE) {
-                                result.similarity = 1.0f - distance;
-                            } else {
-                                result.similarity = distance;
-                            }
-
-                            result.norm = meta.norm;
-
-                            if(include_vectors) {
-                                // Find the vector bytes from our batch
-                                auto it = std::find_if(vector_batch.begin(),
-                                                       vector_batch.end(),
-                                                       [numeric_id](const auto& pair) {
-                                                           return pair.first == numeric_id;
-                                                       });
-
-                                if(it != vector_batch.end()) {
-                                    const auto& vec_bytes = it->second;
-
-                                    ndd::quant::QuantizationLevel quant_level =
-                                            entry.alg->getQuantLevel();
-                                    std::vector<float> float_data =
-                                            ndd::quant::get_quantizer_dispatch(quant_level)
-                                                    .dequantize(vec_bytes.data(),
-                                                                entry.alg->getDimension());
-                                    result.vector = {float_data.begin(), float_data.end()};
-                                }
-                            }
-
-                            prefilter_final_results.push_back(std::move(result));
-                        }
-
-                        return prefilter_final_results;
-                    }
-                } else {
-                    LOG_DEBUG("Filter cardinality too high for pre-filtering ("
-                              << filter_cardinality
-                              << " >= " << settings::PREFILTER_CARDINALITY_THRESHOLD
-                              << "), returning post-filter results");
-                }
-            }
-
             // Ensure we don't return more than k results
             if(results.size() > k) {
                 results.resize(k);
@@ -1812,16 +2188,48 @@ public:
         return false;
     }
 
+    // Lays the graph out in traversal order and saves it, so the order survives restarts.
+    // Returns the number of reordered elements
+    size_t reorderIndex(const std::string& index_id) {
+        auto& entry = getIndexEntry(index_id);
+        std::lock_guard<std::mutex> operation_lock(entry.operation_mutex);
+
+        size_t reordered = entry.alg->reorderGraph();
+        entry.markUpdated();
+        saveIndexInternal(entry);
+        return reordered;
+    }
+
+    // Unlinks deleted elements from the graph and frees their slots for new inserts, then
+    // saves the index. Returns the number of freed slots
+    size_t vacuumIndex(const std::string& index_id) {
+        auto& entry = getIndexEntry(index_id);
+        std::lock_guard<std::mutex> operation_lock(entry.operation_mutex);
+
+        size_t freed = entry.alg->vacuum();
+        if(freed) {
+            entry.markUpdated();
+            saveIndexInternal(entry);
+        }
+        return freed;
+    }
+
     std::optional<IndexInfo> getIndexInfo(const std::string& index_id) {
         auto& entry = getIndexEntry(index_id);
+        size_t prefix_dim = prefixDim(entry);
         IndexInfo indx = {entry.alg->getElementsCount(),
-                          entry.alg->getDimension(),
+                          prefix_dim ? entry.vector_storage->getRerankDimension()
+                                     : entry.alg->getDimension(),
                           entry.sparse_dim,
                           entry.alg->getSpaceTypeStr(),
                           entry.alg->getQuantLevel(),
                           entry.alg->getChecksum(),
                           entry.alg->getM(),
-                          entry.alg->getEfConstruction()};
+                          entry.alg->getEfConstruction(),
+                          entry.vector_storage->getRerankQuantLevel(),
+                          prefix_dim,
+                          entry.alg->getDeletedCount(),
+                          entry.alg->getDeletedRatio()};
         return indx;
     }
 
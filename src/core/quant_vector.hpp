@@ -5,15 +5,41 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <cmath>
+#include <stdexcept>
+
+// Leading dim values of a vector, for indexes whose graph is built on a prefix of every
+// vector. Cosine prefixes are renormalized, the cosine kernels expect unit vectors
+inline std::vector<float>
+vector_prefix(const std::vector<float>& input, size_t dim, hnswlib::SpaceType space_type) {
+    if(input.size() < dim) {
+        throw std::runtime_error("Vector dimension mismatch");
+    }
+    std::vector<float> prefix(input.begin(), input.begin() + dim);
+    if(space_type == hnswlib::COSINE_SPACE) {
+        float norm = 0.0f;
+        for(float v : prefix) {
+            norm += v * v;
+        }
+        if(norm > 0.0f) {
+            float inv = 1.0f / std::sqrt(norm);
+            for(float& v : prefix) {
+                v *= inv;
+            }
+        }
+    }
+    return prefix;
+}
 
 // Lightweight quantized vector object for internal processing
 // Does not include msgpack serialization to keep it lean and efficient
 struct QuantVectorObject {
-    std::string id;                     // String identifier
-    std::vector<uint8_t> meta;          // Binary metadata (zipped)
-    std::string filter;                 // Filter as JSON string
-    float norm;                         // Vector norm (only for cosine distance)
-    std::vector<uint8_t> quant_vector;  // Quantized vector data as uint8_t buffer
+    std::string id;                      // String identifier
+    std::vector<uint8_t> meta;           // Binary metadata (zipped)
+    std::string filter;                  // Filter as JSON string
+    float norm;                          // Vector norm (only for cosine distance)
+    std::vector<uint8_t> quant_vector;   // Quantized vector data as uint8_t buffer
+    std::vector<uint8_t> rerank_vector;  // Higher precision copy for reranking (optional)
 
     // Default constructor
     QuantVectorObject() = default;
@@ -21,12 +47,18 @@ struct QuantVectorObject {
     // Efficient move constructor with quantization
     QuantVectorObject(ndd::VectorObject&& vec_obj,
                       ndd::quant::QuantizationLevel quant_level,
-                      const void* params = nullptr) :
+                      const void* params = nullptr,
+                      ndd::quant::QuantizationLevel rerank_level =
+                              ndd::quant::QuantizationLevel::UNKNOWN,
+                      size_t prefix_dim = 0) :
         id(std::move(vec_obj.id)),
         meta(std::move(vec_obj.meta)),
         filter(std::move(vec_obj.filter)),
         norm(vec_obj.norm),
-        quant_vector(quant_vector_buffer(vec_obj.vector, quant_level, params)) {
+        quant_vector(quant_vector_buffer(vec_obj.vector, quant_level, params, prefix_dim)),
+        rerank_vector(rerank_level == ndd::quant::QuantizationLevel::UNKNOWN
+                              ? std::vector<uint8_t>()
+                              : quant_vector_buffer(vec_obj.vector, rerank_level, params)) {
         // vec_obj.vector will be destroyed automatically after this constructor
         // All quantization logic handled by our internal quant_vector_buffer function
     }
@@ -34,21 +66,35 @@ struct QuantVectorObject {
     // Efficient move constructor for HybridVectorObject (ignores sparse data)
     QuantVectorObject(ndd::HybridVectorObject&& vec_obj,
                       ndd::quant::QuantizationLevel quant_level,
-                      const void* params = nullptr) :
+                      const void* params = nullptr,
+                      ndd::quant::QuantizationLevel rerank_level =
+                              ndd::quant::QuantizationLevel::UNKNOWN,
+                      size_t prefix_dim = 0) :
         id(std::move(vec_obj.id)),
         meta(std::move(vec_obj.meta)),
         filter(std::move(vec_obj.filter)),
         norm(vec_obj.norm),
-        quant_vector(quant_vector_buffer(vec_obj.vector, quant_level, params)) {
+        quant_vector(quant_vector_buffer(vec_obj.vector, quant_level, params, prefix_dim)),
+        rerank_vector(rerank_level == ndd::quant::QuantizationLevel::UNKNOWN
+                              ? std::vector<uint8_t>()
+                              : quant_vector_buffer(vec_obj.vector, rerank_level, params)) {
         // vec_obj.vector will be destroyed automatically after this constructor
     }
 
 private:
     // Self-contained quantization function that uses optimized implementations
-    // Convert vector<float> to quantized uint8_t buffer based on quantization level
+    // Convert vector<float> to quantized uint8_t buffer based on quantization level. A
+    // prefix_dim keeps only the leading dimensions the graph is built on
     static std::vector<uint8_t> quant_vector_buffer(const std::vector<float>& input,
                                                     ndd::quant::QuantizationLevel quant_level,
-                                                    const void* params = nullptr) {
-        return ndd::quant::get_quantizer_dispatch(quant_level).quantize(input);
+                                                    const void* params = nullptr,
+                                                    size_t prefix_dim = 0) {
+        auto dispatch = ndd::quant::get_quantizer_dispatch(quant_level);
+        if(prefix_dim) {
+            auto space_type = static_cast<const hnswlib::DistParams*>(params)->space_type;
+            return ndd::quant::quantize_vector(
+                    dispatch, vector_prefix(input, prefix_dim, space_type), params);
+        }
+        return ndd::quant::quantize_vector(dispatch, input, params);
     }
 };
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include "../utils/settings.hpp"
+
+namespace ndd {
+
+    enum class FilterStrategy : uint8_t {
+        None = 0,           // No filter
+        BruteForce = 1,     // Exact scan over the matching ids
+        FilteredGraph = 2,  // HNSW traversal that only collects matching ids
+        OverFetch = 3       // Unfiltered HNSW search for k / selectivity, then post-filter
+    };
+
+    inline const char* filterStrategyName(FilterStrategy strategy) {
+        switch(strategy) {
+            case FilterStrategy::BruteForce:
+                return "brute_force";
+            case FilterStrategy::FilteredGraph:
+                return "filtered_graph";
+            case FilterStrategy::OverFetch:
+                return "over_fetch";
+            default:
+                return "none";
+        }
+    }
+
+    // How a filtered dense search was executed, reported back with the results
+    struct SearchPlan {
+        FilterStrategy strategy = FilterStrategy::None;
+        size_t estimated_matches = 0;  // Filter cardinality estimated from index statistics
+        size_t fetch_k = 0;            // Candidates requested by an over-fetch search
+        bool fell_back = false;        // Over-fetch found fewer than k matches
+
+        std::string describe() const {
+            std::string plan = filterStrategyName(strategy);
+            if(strategy != FilterStrategy::None) {
+                plan += ";estimated=" + std::to_string(estimated_matches);
+            }
+            if(fetch_k) {
+                plan += ";fetch_k=" + std::to_string(fetch_k);
+            }
+            if(fell_back) {
+                plan += ";fallback";
+            }
+            return plan;
+        }
+    };
+
+    // Picks the cheapest way to run a filtered dense search over total_elements vectors of
+    // dimension dim in a graph of degree M, given the estimated number of matching ids.
+    // Brute force scans are split across brute_force_threads threads and read their vectors
+    // from the vector store, graph searches read them from the vector arena if there is one.
+    inline SearchPlan planFilteredSearch(size_t total_elements,
+                                         size_t estimated_matches,
+                                         size_t dim,
+                                         size_t M,
+                                         size_t k,
+                                         size_t ef,
+                                         size_t brute_force_threads = 1,
+                                         bool vector_arena = false) {
+        SearchPlan plan;
+        plan.estimated_matches = estimated_matches;
+
+        const double n = static_cast<double>(std::max<size_t>(total_elements, 1));
+        const double matches = std::min(static_cast<double>(estimated_matches), n);
+        const double selectivity = std::max(matches / n, 1.0 / n);
+        const size_t search_ef = std::max(ef, k);
+
+        // Nanoseconds to score one vector, with and without the vector store lookup
+        const double score_ns = settings::PLANNER_NS_PER_DIMENSION * dim;
+        const double stored_score_ns = score_ns + settings::PLANNER_VECTOR_FETCH_NS;
+        const double graph_score_ns = vector_arena ? score_ns : stored_score_ns;
+
+        // Base layer expansion plus the greedy descent through the upper layers
+        auto graph_cost = [&](double e) {
+            double visits = e * 2.0 * M * settings::PLANNER_GRAPH_VISIT_RATIO + M * std::log2(n);
+            return visits * graph_score_ns;
+        };
+
+        const double bitmap_cost = matches * settings::PLANNER_BITMAP_NS_PER_ID;
+        // Every block of ids is one task, small scans do not spread over all threads
+        const double blocks = std::ceil(matches / settings::BRUTE_FORCE_BLOCK_SIZE);
+        const double brute_threads =
+                std::clamp(blocks, 1.0, std::max(static_cast<double>(brute_force_threads), 1.0));
+        const double brute_cost = matches * stored_score_ns / brute_threads + bitmap_cost;
+        const double filtered_cost = graph_cost(search_ef)
+                                             * (1.0
+                                                + settings::PLANNER_FILTER_PENALTY
+                                                          * (1.0 - selectivity) / selectivity)
+                                     + bitmap_cost;
+
+        plan.strategy = brute_cost <= filtered_cost ? FilterStrategy::BruteForce
+                                                    : FilterStrategy::FilteredGraph;
+        double best_cost = std::min(brute_cost, filtered_cost);
+
+        double fetch = std::ceil(k / selectivity * settings::PLANNER_OVERFETCH_MARGIN);
+        if(fetch <= settings::MAX_K) {
+            size_t fetch_k = static_cast<size_t>(fetch);
+            double overfetch_cost = graph_cost(std::max(search_ef, fetch_k))
+                                    + fetch_k * settings::PLANNER_POSTFILTER_NS;
+            if(overfetch_cost < best_cost) {
+                plan.strategy = FilterStrategy::OverFetch;
+                plan.fetch_k = fetch_k;
+            }
+        }
+        return plan;
+    }
+
+}  // namespace ndd
@@ -10,6 +10,10 @@ namespace hnswlib {
         ndd::quant::QuantizerDispatch dispatch_;
         DISTFUNC<float> selected_dist_func_{nullptr};
         SIMFUNC<float> selected_sim_func_{nullptr};
+        SIMBATCHFUNC<float> selected_sim_batch_func_{nullptr};
+        SIMFUNC<float> selected_query_sim_func_{nullptr};
+        SIMBATCHFUNC<float> selected_query_sim_batch_func_{nullptr};
+        SIMBOUNDEDBATCHFUNC<float> selected_query_sim_bounded_batch_func_{nullptr};
         size_t dim_;
         size_t data_size_;
         DistParams dist_params_;
@@ -20,31 +24,50 @@ namespace hnswlib {
             dim_(dim),
             space_type_(space_type) {
 
-            // 1. Get the capabilities for this quantization level
-            dispatch_ = ndd::quant::get_quantizer_dispatch(quant_level);
+            // 1. Get the capabilities for this quantization level and dimension
+            dispatch_ = ndd::quant::get_quantizer_dispatch(quant_level, dim);
 
             // 2. Set up parameters
             data_size_ = dispatch_.get_storage_size(dim);
             dist_params_.dim = dim;
             dist_params_.quant_level = static_cast<uint8_t>(quant_level);
+            dist_params_.space_type = space_type;
 
             // 3. Pick the right distance and similarity functions based on the metric
             switch(space_type_) {
                 case L2_SPACE:
                     selected_dist_func_ = dispatch_.dist_l2;
                     selected_sim_func_ = dispatch_.sim_l2;
+                    selected_sim_batch_func_ = dispatch_.sim_l2_batch;
+                    selected_query_sim_func_ = dispatch_.query_sim_l2;
+                    selected_query_sim_batch_func_ = dispatch_.query_sim_l2_batch;
+                    selected_query_sim_bounded_batch_func_ = dispatch_.query_sim_l2_batch_bounded;
                     break;
                 case IP_SPACE:
                     selected_dist_func_ = dispatch_.dist_ip;
                     selected_sim_func_ = dispatch_.sim_ip;
+                    selected_sim_batch_func_ = dispatch_.sim_ip_batch;
+                    selected_query_sim_func_ = dispatch_.query_sim_ip;
+                    selected_query_sim_batch_func_ = dispatch_.query_sim_ip_batch;
+                    selected_query_sim_bounded_batch_func_ = dispatch_.query_sim_ip_batch_bounded;
                     break;
                 case COSINE_SPACE:
                     selected_dist_func_ = dispatch_.dist_cosine;
                     selected_sim_func_ = dispatch_.sim_cosine;
+                    selected_sim_batch_func_ = dispatch_.sim_cosine_batch;
+                    selected_query_sim_func_ = dispatch_.query_sim_cosine;
+                    selected_query_sim_batch_func_ = dispatch_.query_sim_cosine_batch;
+                    selected_query_sim_bounded_batch_func_ =
+                            dispatch_.query_sim_cosine_batch_bounded;
                     break;
                 default:
                     throw std::runtime_error("Unknown space type");
             }
+
+            // Early abandoning needs a block to skip after the first check to pay off
+            if(dim < 2 * ndd::quant::ABANDON_BLOCK) {
+                selected_query_sim_bounded_batch_func_ = nullptr;
+            }
         }
 
         size_t get_data_size() override { return data_size_; }
@@ -53,6 +76,26 @@ namespace hnswlib {
 
         SIMFUNC<float> get_sim_func() override { return selected_sim_func_; }
 
+        SIMBATCHFUNC<float> get_sim_batch_func() override { return selected_sim_batch_func_; }
+
+        // Levels without asymmetric kernels score queries like stored vectors
+        SIMFUNC<float> get_query_sim_func() override {
+            return selected_query_sim_func_ ? selected_query_sim_func_ : selected_sim_func_;
+        }
+
+        SIMBATCHFUNC<float> get_query_sim_batch_func() override {
+            return selected_query_sim_batch_func_ ? selected_query_sim_batch_func_
+                                                  : selected_sim_batch_func_;
+        }
+
+        SIMBOUNDEDBATCHFUNC<float> get_query_sim_bounded_batch_func() override {
+            return selected_query_sim_bounded_batch_func_;
+        }
+
+        SIMBATCHFUNC<float> get_sim_error_batch_func() override {
+            return dispatch_.sim_error_batch;
+        }
+
         void* get_dist_func_param() override { return &dist_params_; }
     };
 
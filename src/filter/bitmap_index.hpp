@@ -1,12 +1,14 @@
 #pragma once
 
 #include <string>
+#include <cstring>
 #include <vector>
 #include <stdexcept>
 #include <iostream>
 #include "mdbx/mdbx.h"
 #include "../utils/log.hpp"
 #include "../core/types.hpp"
+#include "../storage/read_txn_pool.hpp"
 
 namespace ndd {
     namespace filter {
@@ -15,6 +17,8 @@ namespace ndd {
         private:
             MDBX_env* env_;
             MDBX_dbi dbi_;
+            MDBX_dbi stats_dbi_;  // FilterKey -> uint64 cardinality, read by the search planner
+            ndd::ReadTxnPool* read_txns_;
 
             static std::string format_filter_key(const std::string& field,
                                                  const std::string& value) {
@@ -23,43 +27,27 @@ namespace ndd {
 
             // Load bitmap from LMDB
             ndd::RoaringBitmap get_bitmap_internal(const std::string& filter_key) const {
-                MDBX_txn* txn;
-                int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
+                auto read_txn = read_txns_->acquire();
+
+                MDBX_val key{const_cast<char*>(filter_key.c_str()), filter_key.size()};
+                MDBX_val data;
+
+                int rc = mdbx_get(read_txn.txn(), dbi_, &key, &data);
+                if(rc == MDBX_NOTFOUND) {
+                    // LOG_DEBUG("Filter key not found: " << filter_key);
+                    return ndd::RoaringBitmap();  // Return empty bitmap
+                }
                 if(rc != MDBX_SUCCESS) {
-                    throw std::runtime_error("Failed to begin read transaction: "
-                                             + std::string(mdbx_strerror(rc)));
+                    throw std::runtime_error("Failed to read filter key '" + filter_key
+                                             + "': " + std::string(mdbx_strerror(rc)));
                 }
 
-                try {
-                    MDBX_val key{const_cast<char*>(filter_key.c_str()), filter_key.size()};
-                    MDBX_val data;
-
-                    rc = mdbx_get(txn, dbi_, &key, &data);
-                    if(rc == MDBX_NOTFOUND) {
-                        mdbx_txn_abort(txn);
-                        // LOG_DEBUG("Filter key not found: " << filter_key);
-                        return ndd::RoaringBitmap();  // Return empty bitmap
-                    }
-                    if(rc != MDBX_SUCCESS) {
-                        mdbx_txn_abort(txn);
-                        throw std::runtime_error("Failed to read filter key '" + filter_key
-                                                 + "': " + std::string(mdbx_strerror(rc)));
-                    }
-
-                    if(data.iov_len == 0) {
-                        mdbx_txn_abort(txn);
-                        // LOG_DEBUG("Empty data for filter key: " << filter_key);
-                        return ndd::RoaringBitmap();
-                    }
-
-                    ndd::RoaringBitmap bitmap =
-                            ndd::RoaringBitmap::read(static_cast<const char*>(data.iov_base));
-                    mdbx_txn_abort(txn);
-                    return bitmap;
-                } catch(...) {
-                    mdbx_txn_abort(txn);
-                    throw;
+                if(data.iov_len == 0) {
+                    // LOG_DEBUG("Empty data for filter key: " << filter_key);
+                    return ndd::RoaringBitmap();
                 }
+
+                return ndd::RoaringBitmap::read(static_cast<const char*>(data.iov_base));
             }
 
             void store_bitmap_internal(const std::string& filter_key,
@@ -93,6 +81,16 @@ namespace ndd {
                                              + std::string(mdbx_strerror(rc)));
                 }
 
+                // Keep the cardinality next to the bitmap so estimates never deserialize it
+                uint64_t cardinality = bitmap.cardinality();
+                MDBX_val stat{&cardinality, sizeof(cardinality)};
+                rc = mdbx_put(txn, stats_dbi_, &key, &stat, MDBX_UPSERT);
+                if(rc != MDBX_SUCCESS) {
+                    mdbx_txn_abort(txn);
+                    throw std::runtime_error("Failed to store bitmap stats: "
+                                             + std::string(mdbx_strerror(rc)));
+                }
+
                 rc = mdbx_txn_commit(txn);
                 if(rc != MDBX_SUCCESS) {
                     throw std::runtime_error("Failed to commit transaction: "
@@ -101,8 +99,9 @@ namespace ndd {
             }
 
         public:
-            BitmapIndex(MDBX_env* env) :
-                env_(env) {
+            BitmapIndex(MDBX_env* env, ndd::ReadTxnPool* read_txns) :
+                env_(env),
+                read_txns_(read_txns) {
                 MDBX_txn* txn;
                 int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_READWRITE, &txn);
                 if(rc != MDBX_SUCCESS) {
@@ -116,6 +115,12 @@ namespace ndd {
                     throw std::runtime_error("Failed to open BitmapIndex dbi");
                 }
 
+                rc = mdbx_dbi_open(txn, "bitmap_stats", MDBX_CREATE, &stats_dbi_);
+                if(rc != MDBX_SUCCESS) {
+                    mdbx_txn_abort(txn);
+                    throw std::runtime_error("Failed to open bitmap_stats dbi");
+                }
+
                 mdbx_txn_commit(txn);
             }
 
@@ -129,6 +134,22 @@ namespace ndd {
                 return get_bitmap_internal(key);
             }
 
+            // Number of ids stored under a key, read from the persisted stats. Bitmaps written
+            // before the stats existed are counted directly until their next update.
+            uint64_t cardinality_by_key(const std::string& filter_key) const {
+                auto read_txn = read_txns_->acquire();
+                MDBX_val key{const_cast<char*>(filter_key.c_str()), filter_key.size()};
+                MDBX_val data;
+
+                int rc = mdbx_get(read_txn.txn(), stats_dbi_, &key, &data);
+                if(rc == MDBX_SUCCESS && data.iov_len == sizeof(uint64_t)) {
+                    uint64_t cardinality;
+                    std::memcpy(&cardinality, data.iov_base, sizeof(cardinality));
+                    return cardinality;
+                }
+                return get_bitmap_internal(filter_key).cardinality();
+            }
+
             void add(const std::string& field, const std::string& value, ndd::idInt id) {
                 std::string filter_key = format_filter_key(field, value);
                 ndd::RoaringBitmap bitmap = get_bitmap_internal(filter_key);
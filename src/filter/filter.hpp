@@ -10,12 +10,15 @@
 #include <iostream>
 #include <unordered_map>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include "json/nlohmann_json.hpp"
 #include "../utils/settings.hpp"
 #include "mdbx/mdbx.h"
 #include "../utils/log.hpp"
 #include "../core/types.hpp"
+#include "../storage/read_txn_pool.hpp"
 
 #include "numeric_index.hpp"
 #include "bitmap_index.hpp"
@@ -32,6 +35,8 @@ private:
     MDBX_env* env_;
     MDBX_dbi dbi_;  // Used for schema storage
     std::string path_;
+    // Shared by the numeric and bitmap indices, they live in the same environment
+    std::unique_ptr<ndd::ReadTxnPool> read_txns_;
     std::unique_ptr<ndd::numeric::NumericIndex> numeric_index_;
     std::unique_ptr<ndd::filter::BitmapIndex> bitmap_index_;
 
@@ -109,6 +114,11 @@ private:
         // max DBs to allow multiple databases (main + schema + numeric_forward + numeric_inverted)
         mdbx_env_set_maxdbs(env_, 10);
 
+        rc = mdbx_env_set_maxreaders(env_, settings::MDBX_MAX_READERS);
+        if(rc != MDBX_SUCCESS) {
+            throw std::runtime_error("Failed to set max readers for filters");
+        }
+
         // Set
         // Set geometry for auto-grow: initial per settings, growth=256MB, max=32GB
         rc = mdbx_env_set_geometry(
@@ -146,8 +156,9 @@ private:
         }
 
         // Initialize Indices
-        numeric_index_ = std::make_unique<ndd::numeric::NumericIndex>(env_);
-        bitmap_index_ = std::make_unique<ndd::filter::BitmapIndex>(env_);
+        read_txns_ = std::make_unique<ndd::ReadTxnPool>(env_);
+        numeric_index_ = std::make_unique<ndd::numeric::NumericIndex>(env_, read_txns_.get());
+        bitmap_index_ = std::make_unique<ndd::filter::BitmapIndex>(env_, read_txns_.get());
 
         load_schema();
     }
@@ -156,6 +167,123 @@ private:
         return field + ":" + value;
     }
 
+    // Maps a JSON number onto the sortable encoding used by the numeric index
+    static bool to_sortable(const nlohmann::json& v, uint32_t& out) {
+        if(v.is_number_integer()) {
+            out = ndd::numeric::int_to_sortable(v.get<int>());
+        } else if(v.is_number()) {
+            out = ndd::numeric::float_to_sortable(v.get<float>());
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Bitmap key of a string, integer or boolean filter value
+    static bool to_filter_value(const nlohmann::json& v, std::string& out) {
+        if(v.is_string()) {
+            out = v.get<std::string>();
+        } else if(v.is_boolean()) {
+            out = v.get<bool>() ? "true" : "false";
+        } else if(v.is_number_integer()) {
+            out = std::to_string(v.get<int>());
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // One filter condition, checked against the schema and turned into index lookups whose
+    // results are ORed: sortable ranges of the numeric index or keys of the bitmap index
+    struct ParsedCondition {
+        std::string field;
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        std::vector<std::string> keys;
+    };
+
+    ParsedCondition parseCondition(const nlohmann::json& condition) const {
+        if(!condition.is_object() || condition.size() != 1) {
+            throw std::runtime_error("Each condition must be a single-field object");
+        }
+
+        ParsedCondition parsed;
+        parsed.field = condition.begin().key();
+        const auto& field = parsed.field;
+        const auto& expr = condition.begin().value();
+
+        if(field.empty()) {
+            throw std::runtime_error("Filter field name cannot be empty");
+        }
+
+        // Check schema for field type
+        FieldType type = FieldType::Unknown;
+        {
+            std::lock_guard<std::mutex> lock(schema_mutex_);
+            auto it = schema_cache_.find(field);
+            if(it != schema_cache_.end()) {
+                type = it->second;
+            }
+        }
+
+        if(!expr.is_object() || expr.size() != 1) {
+            throw std::runtime_error("Operator must be a single-field object");
+        }
+
+        const std::string op = expr.begin().key();
+        const auto& val = expr.begin().value();
+
+        if(op == "$eq" || op == "$in") {
+            if(op == "$in" && !val.is_array()) {
+                throw std::runtime_error("$in must be array");
+            }
+            if(op == "$in" && val.empty()) {
+                LOG_DEBUG("Empty $in array for field: " << field);
+            }
+            const nlohmann::json values = op == "$in" ? val : nlohmann::json::array({val});
+            for(const auto& v : values) {
+                if(type == FieldType::Number) {
+                    uint32_t sortable_val;
+                    if(!to_sortable(v, sortable_val)) {
+                        throw std::runtime_error(op + " value for numeric field must be a number");
+                    }
+                    parsed.ranges.emplace_back(sortable_val, sortable_val);
+                    continue;
+                }
+                std::string str_val;
+                if(!to_filter_value(v, str_val)) {
+                    throw std::runtime_error(op + (op == "$in" ? " values" : " value")
+                                             + " must be string, integer or boolean");
+                }
+                // Empty strings in $in match nothing
+                if(op == "$eq" || !str_val.empty()) {
+                    parsed.keys.push_back(format_filter_key(field, str_val));
+                }
+            }
+        } else if(op == "$range") {
+            if(!val.is_array() || val.size() != 2) {
+                throw std::runtime_error(
+                        "$range must be [start, end] array with exactly 2 elements");
+            }
+            if(type != FieldType::Number) {
+                throw std::runtime_error("$range operator is only supported for numeric fields");
+            }
+            uint32_t start_val, end_val;
+            if(!to_sortable(val[0], start_val)) {
+                throw std::runtime_error("Range start must be a number");
+            }
+            if(!to_sortable(val[1], end_val)) {
+                throw std::runtime_error("Range end must be a number");
+            }
+            if(start_val > end_val) {
+                throw std::runtime_error("Invalid range: start > end");
+            }
+            parsed.ranges.emplace_back(start_val, end_val);
+        } else {
+            throw std::runtime_error("Unsupported operator: " + op);
+        }
+        return parsed;
+    }
+
 public:
     Filter(const std::string& path) :
         path_(path) {
@@ -164,10 +292,14 @@ public:
     }
 
     ~Filter() {
+        read_txns_.reset();
         mdbx_dbi_close(env_, dbi_);
         mdbx_env_close(env_);
     }
 
+    // Pins the current snapshot for this thread until the handle is released
+    ndd::ReadTxnPool::Handle pin_snapshot() const { return read_txns_->acquire(); }
+
     // Compute the filter bitmap based on the provided JSON filter array
     ndd::RoaringBitmap computeFilterBitmap(const nlohmann::json& filter_array) const {
         if(!filter_array.is_array()) {
@@ -183,138 +315,13 @@ public:
         bool first = true;
 
         for(const auto& condition : filter_array) {
-            if(!condition.is_object() || condition.size() != 1) {
-                throw std::runtime_error("Each condition must be a single-field object");
-            }
-
-            const auto& field = condition.begin().key();
-            const auto& expr = condition.begin().value();
-
-            if(field.empty()) {
-                throw std::runtime_error("Filter field name cannot be empty");
-            }
-
-            // Check schema for field type
-            FieldType type = FieldType::Unknown;
-            {
-                std::lock_guard<std::mutex> lock(schema_mutex_);
-                auto it = schema_cache_.find(field);
-                if(it != schema_cache_.end()) {
-                    type = it->second;
-                }
-            }
-
+            ParsedCondition parsed = parseCondition(condition);
             ndd::RoaringBitmap or_result;
-
-            if(!expr.is_object() || expr.size() != 1) {
-                throw std::runtime_error("Operator must be a single-field object");
+            for(const auto& [start_val, end_val] : parsed.ranges) {
+                or_result |= numeric_index_->range(parsed.field, start_val, end_val);
             }
-
-            const std::string op = expr.begin().key();
-            const auto& val = expr.begin().value();
-
-            if(op == "$eq") {
-                if(type == FieldType::Number) {
-                    uint32_t sortable_val;
-                    if(val.is_number_integer()) {
-                        sortable_val = ndd::numeric::int_to_sortable(val.get<int>());
-                    } else if(val.is_number()) {
-                        sortable_val = ndd::numeric::float_to_sortable(val.get<float>());
-                    } else {
-                        throw std::runtime_error("$eq value for numeric field must be a number");
-                    }
-                    or_result = numeric_index_->range(field, sortable_val, sortable_val);
-                } else {
-                    if(!val.is_string() && !val.is_number_integer() && !val.is_boolean()) {
-                        throw std::runtime_error("$eq value must be string, integer or boolean");
-                    }
-                    std::string str_val;
-                    if(val.is_string()) {
-                        str_val = val.get<std::string>();
-                    } else if(val.is_boolean()) {
-                        str_val = val.get<bool>() ? "true" : "false";
-                    } else {
-                        // Integers for non-numeric fields are treated as strings without padding
-                        str_val = std::to_string(val.get<int>());
-                    }
-                    std::string key = format_filter_key(field, str_val);
-                    or_result = bitmap_index_->get_bitmap_by_key(key);
-                }
-            } else if(op == "$in") {
-                if(!val.is_array()) {
-                    throw std::runtime_error("$in must be array");
-                }
-                if(val.empty()) {
-                    LOG_DEBUG("Empty $in array for field: " << field);
-                } else {
-                    for(const auto& v : val) {
-                        if(type == FieldType::Number) {
-                            uint32_t sortable_val;
-                            if(v.is_number_integer()) {
-                                sortable_val = ndd::numeric::int_to_sortable(v.get<int>());
-                            } else if(v.is_number()) {
-                                sortable_val = ndd::numeric::float_to_sortable(v.get<float>());
-                            } else {
-                                throw std::runtime_error(
-                                        "$in value for numeric field must be a number");
-                            }
-                            or_result |= numeric_index_->range(field, sortable_val, sortable_val);
-                        } else {
-                            if(!v.is_string() && !v.is_number_integer() && !v.is_boolean()) {
-                                throw std::runtime_error(
-                                        "$in values must be string, integer or boolean");
-                            }
-                            std::string str_val;
-                            if(v.is_string()) {
-                                str_val = v.get<std::string>();
-                            } else if(v.is_boolean()) {
-                                str_val = v.get<bool>() ? "true" : "false";
-                            } else {
-                                str_val = std::to_string(v.get<int>());
-                            }
-                            if(!str_val.empty()) {
-                                std::string key = format_filter_key(field, str_val);
-                                or_result |= bitmap_index_->get_bitmap_by_key(key);
-                            }
-                        }
-                    }
-                }
-            } else if(op == "$range") {
-                if(!val.is_array() || val.size() != 2) {
-                    throw std::runtime_error(
-                            "$range must be [start, end] array with exactly 2 elements");
-                }
-
-                if(type == FieldType::Number) {
-                    uint32_t start_val, end_val;
-
-                    if(val[0].is_number_integer()) {
-                        start_val = ndd::numeric::int_to_sortable(val[0].get<int>());
-                    } else if(val[0].is_number()) {
-                        start_val = ndd::numeric::float_to_sortable(val[0].get<float>());
-                    } else {
-                        throw std::runtime_error("Range start must be a number");
-                    }
-
-                    if(val[1].is_number_integer()) {
-                        end_val = ndd::numeric::int_to_sortable(val[1].get<int>());
-                    } else if(val[1].is_number()) {
-                        end_val = ndd::numeric::float_to_sortable(val[1].get<float>());
-                    } else {
-                        throw std::runtime_error("Range end must be a number");
-                    }
-
-                    if(start_val > end_val) {
-                        throw std::runtime_error("Invalid range: start > end");
-                    }
-
-                    or_result = numeric_index_->range(field, start_val, end_val);
-                } else {
-                    throw std::runtime_error(
-                            "$range operator is only supported for numeric fields");
-                }
-            } else {
-                throw std::runtime_error("Unsupported operator: " + op);
+            for(const auto& key : parsed.keys) {
+                or_result |= bitmap_index_->get_bitmap_by_key(key);
             }
 
             // Combine with final result
@@ -348,6 +355,35 @@ public:
         return computeFilterBitmap(filter_array).cardinality();
     }
 
+    // Estimate how many of total_elements ids match the filter without building any bitmap.
+    // Single conditions are counted from the persisted bitmap cardinalities and numeric bucket
+    // counts, conditions are assumed independent when combined with AND.
+    size_t estimateFilterCardinality(const nlohmann::json& filter_array,
+                                     size_t total_elements) const {
+        if(!filter_array.is_array()) {
+            throw std::runtime_error("Filter must be an array");
+        }
+        if(filter_array.empty() || total_elements == 0) {
+            return 0;
+        }
+
+        double selectivity = 1.0;
+        for(const auto& condition : filter_array) {
+            ParsedCondition parsed = parseCondition(condition);
+            size_t matches = 0;
+            for(const auto& [start_val, end_val] : parsed.ranges) {
+                matches += numeric_index_->estimate_range(parsed.field, start_val, end_val);
+            }
+            for(const auto& key : parsed.keys) {
+                matches += bitmap_index_->cardinality_by_key(key);
+            }
+
+            selectivity *= std::min(1.0, static_cast<double>(matches) / total_elements);
+        }
+
+        return static_cast<size_t>(std::ceil(selectivity * total_elements));
+    }
+
     void add_to_filter(const std::string& field, const std::string& value, ndd::idInt numeric_id) {
         bitmap_index_->add(field, value, numeric_id);
     }
@@ -10,6 +10,7 @@
 #include "mdbx/mdbx.h"
 #include "../utils/log.hpp"
 #include "../core/types.hpp"
+#include "../storage/read_txn_pool.hpp"
 
 namespace ndd {
     namespace numeric {
@@ -129,9 +130,28 @@ namespace ndd {
             uint32_t max_val() const { return entries.empty() ? 0 : entries.back().first; }
         };
 
+        // Closes an MDBX cursor when it goes out of scope, also when a bucket fails to decode
+        struct CursorGuard {
+            MDBX_cursor* cursor = nullptr;
+
+            CursorGuard(MDBX_txn* txn, MDBX_dbi dbi) {
+                int rc = mdbx_cursor_open(txn, dbi, &cursor);
+                if(rc != MDBX_SUCCESS) {
+                    throw std::runtime_error(std::string("Failed to open cursor: ")
+                                             + mdbx_strerror(rc));
+                }
+            }
+
+            ~CursorGuard() { mdbx_cursor_close(cursor); }
+
+            CursorGuard(const CursorGuard&) = delete;
+            CursorGuard& operator=(const CursorGuard&) = delete;
+        };
+
         class NumericIndex {
         private:
             MDBX_env* env_;
+            ndd::ReadTxnPool* read_txns_;
             MDBX_dbi forward_dbi_;   // ID -> Value (Field:ID -> Value)
             MDBX_dbi inverted_dbi_;  // BucketKey -> Bucket (Field:StartVal -> BucketBlob)
 
@@ -172,8 +192,9 @@ namespace ndd {
             }
 
         public:
-            NumericIndex(MDBX_env* env) :
-                env_(env) {
+            NumericIndex(MDBX_env* env, ndd::ReadTxnPool* read_txns) :
+                env_(env),
+                read_txns_(read_txns) {
                 MDBX_txn* txn;
                 int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_READWRITE, &txn);
                 if(rc != MDBX_SUCCESS) {
@@ -260,117 +281,44 @@ namespace ndd {
 
             ndd::RoaringBitmap range(const std::string& field, uint32_t min_val, uint32_t max_val) {
                 ndd::RoaringBitmap result;
-                MDBX_txn* txn;
-                int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-                if(rc != MDBX_SUCCESS) {
-                    return result;
-                }
-
-                try {
-                    MDBX_cursor* cursor;
-                    mdbx_cursor_open(txn, inverted_dbi_, &cursor);
-
-                    // 1. Find start bucket (bucket with start_val <= min_val)
-                    std::string start_key_str = make_bucket_key(field, min_val);
-                    MDBX_val key{const_cast<char*>(start_key_str.data()), start_key_str.size()};
-                    MDBX_val data;
-
-                    rc = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
+                auto read_txn = read_txns_->acquire();
+                MDBX_txn* txn = read_txn.txn();
 
-                    bool valid_start = false;
+                CursorGuard guard(txn, inverted_dbi_);
+                MDBX_cursor* cursor = guard.cursor;
 
-                    if(rc == MDBX_SUCCESS) {
-                        std::string found_key((char*)key.iov_base, key.iov_len);
-                        if(found_key.rfind(field + ":", 0) == 0) {
-                            // Found a bucket in the same field
-                            if(found_key > start_key_str) {
-                                // We landed on a bucket starting AFTER min_val.
-                                // Check previous bucket to see if it covers min_val.
-                                MDBX_val p_key = key;
-                                MDBX_val p_data;
-                                int p_rc = mdbx_cursor_get(cursor, &p_key, &p_data, MDBX_PREV);
-
-                                if(p_rc == MDBX_SUCCESS) {
-                                    std::string prev_key((char*)p_key.iov_base, p_key.iov_len);
-                                    if(prev_key.rfind(field + ":", 0) == 0) {
-                                        // Previous bucket is in same field, start there
-                                        valid_start = true;
-                                        // cursor is already at prev
-                                        key = p_key;
-                                        data = p_data;
-                                    } else {
-                                        // Previous bucket is different field.
-                                        // This means min_val is before the first bucket of this
-                                        // field. So we start at the found_key (first bucket). Reset
-                                        // cursor to found_key
-                                        mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
-                                        valid_start = true;
-                                    }
-                                } else {
-                                    // No prev, start at found_key
-                                    mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
-                                    valid_start = true;
-                                }
-                            } else {
-                                // Exact match on start key
-                                valid_start = true;
-                            }
-                        } else {
-                            // Found key is next field. Go back to see if we have buckets for this
-                            // field.
-                            rc = mdbx_cursor_get(cursor, &key, &data, MDBX_PREV);
-                            if(rc == MDBX_SUCCESS) {
-                                std::string prev_key((char*)key.iov_base, key.iov_len);
-                                if(prev_key.rfind(field + ":", 0) == 0) {
-                                    valid_start = true;
-                                }
-                            }
-                        }
-                    } else if(rc == MDBX_NOTFOUND) {
-                        // Try last bucket
-                        rc = mdbx_cursor_get(cursor, &key, &data, MDBX_LAST);
-                        if(rc == MDBX_SUCCESS) {
-                            std::string last_key((char*)key.iov_base, key.iov_len);
-                            if(last_key.rfind(field + ":", 0) == 0) {
-                                valid_start = true;
-                            }
+                MDBX_val key;
+                MDBX_val data;
+                bool valid_start = seek_range_start(cursor, field, min_val, key, data);
+
+                if(valid_start) {
+                    // Iterate buckets
+                    while(true) {
+                        std::string curr_key((char*)key.iov_base, key.iov_len);
+                        if(curr_key.rfind(field + ":", 0) != 0) {
+                            break;  // End of field
                         }
-                    }
 
-                    if(valid_start) {
-                        // Iterate buckets
-                        while(true) {
-                            std::string curr_key((char*)key.iov_base, key.iov_len);
-                            if(curr_key.rfind(field + ":", 0) != 0) {
-                                break;  // End of field
-                            }
-
-                            uint32_t bucket_start = parse_bucket_key_val(curr_key);
-                            if(bucket_start > max_val) {
-                                break;  // Bucket starts after range
-                            }
+                        uint32_t bucket_start = parse_bucket_key_val(curr_key);
+                        if(bucket_start > max_val) {
+                            break;  // Bucket starts after range
+                        }
 
-                            // Deserialize and scan
-                            Bucket bucket = Bucket::deserialize(data.iov_base, data.iov_len);
-                            for(const auto& entry : bucket.entries) {
-                                if(entry.first >= min_val && entry.first <= max_val) {
-                                    result.add(entry.second);
-                                }
+                        // Deserialize and scan
+                        Bucket bucket = Bucket::deserialize(data.iov_base, data.iov_len);
+                        for(const auto& entry : bucket.entries) {
+                            if(entry.first >= min_val && entry.first <= max_val) {
+                                result.add(entry.second);
                             }
+                        }
 
-                            rc = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT);
-                            if(rc != MDBX_SUCCESS) {
-                                break;
-                            }
+                        int rc = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT);
+                        if(rc != MDBX_SUCCESS) {
+                            break;
                         }
                     }
-
-                    mdbx_cursor_close(cursor);
-                    mdbx_txn_abort(txn);  // Read-only
-                } catch(...) {
-                    mdbx_txn_abort(txn);
-                    throw;
                 }
+
                 return result;
             }
 
@@ -379,35 +327,155 @@ namespace ndd {
                              ndd::idInt id,
                              uint32_t min_val,
                              uint32_t max_val) {
-                MDBX_txn* txn;
-                int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-                if(rc != MDBX_SUCCESS) {
-                    return false;
+                auto read_txn = read_txns_->acquire();
+
+                std::string fwd_key_str = make_forward_key(field, id);
+                MDBX_val fwd_key{const_cast<char*>(fwd_key_str.data()), fwd_key_str.size()};
+                MDBX_val fwd_val;
+
+                int rc = mdbx_get(read_txn.txn(), forward_dbi_, &fwd_key, &fwd_val);
+                bool match = false;
+                if(rc == MDBX_SUCCESS) {
+                    uint32_t val;
+                    std::memcpy(&val, fwd_val.iov_base, 4);
+                    if(val >= min_val && val <= max_val) {
+                        match = true;
+                    }
+                }
+                return match;
+            }
+
+            // Counts the ids with a value in [min_val, max_val] from the bucket headers alone.
+            // Buckets that lie entirely inside the range contribute their stored count, only
+            // the (at most two) buckets straddling a range edge are scanned.
+            size_t estimate_range(const std::string& field, uint32_t min_val, uint32_t max_val) {
+                size_t count = 0;
+                auto read_txn = read_txns_->acquire();
+                MDBX_txn* txn = read_txn.txn();
+
+                CursorGuard guard(txn, inverted_dbi_);
+                MDBX_cursor* cursor = guard.cursor;
+
+                const std::string prefix = field + ":";
+                MDBX_val key;
+                MDBX_val data;
+                bool more = seek_range_start(cursor, field, min_val, key, data);
+
+                while(more) {
+                    std::string curr_key((char*)key.iov_base, key.iov_len);
+                    if(curr_key.rfind(prefix, 0) != 0) {
+                        break;
+                    }
+
+                    uint32_t bucket_start = parse_bucket_key_val(curr_key);
+                    if(bucket_start > max_val) {
+                        break;
+                    }
+                    MDBX_val bucket_data = data;
+
+                    // A bucket holds values from its start up to the next bucket's start
+                    more = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT) == MDBX_SUCCESS;
+                    bool inside = false;
+                    if(more && bucket_start >= min_val) {
+                        std::string next_key((char*)key.iov_base, key.iov_len);
+                        inside = next_key.rfind(prefix, 0) == 0
+                                 && parse_bucket_key_val(next_key) <= max_val;
+                    }
+
+                    if(inside && bucket_data.iov_len >= 4) {
+                        uint32_t bucket_count;
+                        std::memcpy(&bucket_count, bucket_data.iov_base, 4);
+                        count += bucket_count;
+                    } else {
+                        Bucket bucket =
+                                Bucket::deserialize(bucket_data.iov_base, bucket_data.iov_len);
+                        for(const auto& entry : bucket.entries) {
+                            if(entry.first >= min_val && entry.first <= max_val) {
+                                count++;
+                            }
+                        }
+                    }
                 }
 
-                try {
-                    std::string fwd_key_str = make_forward_key(field, id);
-                    MDBX_val fwd_key{const_cast<char*>(fwd_key_str.data()), fwd_key_str.size()};
-                    MDBX_val fwd_val;
+                return count;
+            }
+
+        private:
+            // Positions the cursor on the first bucket of field that can hold values >= min_val
+            bool seek_range_start(MDBX_cursor* cursor,
+                                  const std::string& field,
+                                  uint32_t min_val,
+                                  MDBX_val& key,
+                                  MDBX_val& data) {
+                // 1. Find start bucket (bucket with start_val <= min_val)
+                std::string start_key_str = make_bucket_key(field, min_val);
+                key = {const_cast<char*>(start_key_str.data()), start_key_str.size()};
 
-                    rc = mdbx_get(txn, forward_dbi_, &fwd_key, &fwd_val);
-                    bool match = false;
+                int rc = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
+
+                bool valid_start = false;
+
+                if(rc == MDBX_SUCCESS) {
+                    std::string found_key((char*)key.iov_base, key.iov_len);
+                    if(found_key.rfind(field + ":", 0) == 0) {
+                        // Found a bucket in the same field
+                        if(found_key > start_key_str) {
+                            // We landed on a bucket starting AFTER min_val.
+                            // Check previous bucket to see if it covers min_val.
+                            MDBX_val p_key = key;
+                            MDBX_val p_data;
+                            int p_rc = mdbx_cursor_get(cursor, &p_key, &p_data, MDBX_PREV);
+
+                            if(p_rc == MDBX_SUCCESS) {
+                                std::string prev_key((char*)p_key.iov_base, p_key.iov_len);
+                                if(prev_key.rfind(field + ":", 0) == 0) {
+                                    // Previous bucket is in same field, start there
+                                    valid_start = true;
+                                    // cursor is already at prev
+                                    key = p_key;
+                                    data = p_data;
+                                } else {
+                                    // Previous bucket is different field.
+                                    // This means min_val is before the first bucket of this
+                                    // field. So we start at the found_key (first bucket). Reset
+                                    // cursor to found_key
+                                    mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
+                                    valid_start = true;
+                                }
+                            } else {
+                                // No prev, start at found_key
+                                mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
+                                valid_start = true;
+                            }
+                        } else {
+                            // Exact match on start key
+                            valid_start = true;
+                        }
+                    } else {
+                        // Found key is next field. Go back to see if we have buckets for this
+                        // field.
+                        rc = mdbx_cursor_get(cursor, &key, &data, MDBX_PREV);
+                        if(rc == MDBX_SUCCESS) {
+                            std::string prev_key((char*)key.iov_base, key.iov_len);
+                            if(prev_key.rfind(field + ":", 0) == 0) {
+                                valid_start = true;
+                            }
+                        }
+                    }
+                } else if(rc == MDBX_NOTFOUND) {
+                    // Try last bucket
+                    rc = mdbx_cursor_get(cursor, &key, &data, MDBX_LAST);
                     if(rc == MDBX_SUCCESS) {
-                        uint32_t val;
-                        std::memcpy(&val, fwd_val.iov_base, 4);
-                        if(val >= min_val && val <= max_val) {
-                            match = true;
+                        std::string last_key((char*)key.iov_base, key.iov_len);
+                        if(last_key.rfind(field + ":", 0) == 0) {
+                            valid_start = true;
                         }
                     }
-                    mdbx_txn_abort(txn);
-                    return match;
-                } catch(...) {
-                    mdbx_txn_abort(txn);
-                    throw;
                 }
+
+                return valid_start;
             }
 
-        private:
             void
             add_to_bucket(MDBX_txn* txn, const std::string& field, uint32_t value, ndd::idInt id) {
                 // Find the bucket that starts <= value
@@ -418,8 +486,8 @@ namespace ndd {
                 std::string target_key = make_bucket_key(field, value);
                 MDBX_val key{const_cast<char*>(target_key.data()), target_key.size()};
                 MDBX_val data;
-                MDBX_cursor* cursor;
-                mdbx_cursor_open(txn, inverted_dbi_, &cursor);
+                CursorGuard guard(txn, inverted_dbi_);
+                MDBX_cursor* cursor = guard.cursor;
 
                 int rc = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
 
@@ -518,8 +586,6 @@ namespace ndd {
                     MDBX_val b_val{bytes.data(), bytes.size()};
                     mdbx_put(txn, inverted_dbi_, &b_key, &b_val, MDBX_put_flags_t(0));
                 }
-
-                mdbx_cursor_close(cursor);
             }
 
             void remove_from_bucket(MDBX_txn* txn,
@@ -530,8 +596,8 @@ namespace ndd {
                 std::string target_key = make_bucket_key(field, value);
                 MDBX_val key{const_cast<char*>(target_key.data()), target_key.size()};
                 MDBX_val data;
-                MDBX_cursor* cursor;
-                mdbx_cursor_open(txn, inverted_dbi_, &cursor);
+                CursorGuard guard(txn, inverted_dbi_);
+                MDBX_cursor* cursor = guard.cursor;
 
                 int rc = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
 
@@ -594,8 +660,6 @@ namespace ndd {
                         }
                     }
                 }
-
-                mdbx_cursor_close(cursor);
             }
         };
 
@@ -4,6 +4,7 @@
 #include <mutex>
 #include <algorithm>
 #include <assert.h>
+#include "../utils/worker_pool.hpp"
 
 namespace hnswlib {
     template <typename dist_t> class BruteforceSearch : public AlgorithmInterface<dist_t> {
@@ -169,49 +170,116 @@ namespace hnswlib {
         }
     };
 
-    // Standalone function for bruteforce search on a subset of vectors
-    // Uses the same SpaceInterface as the HNSW index for consistency
-    template <typename dist_t>
-    std::vector<std::pair<dist_t, idInt>>
-    searchKnnSubset(const void* query_data,
-                    const std::vector<std::pair<idInt, std::vector<uint8_t>>>& vector_subset,
-                    size_t k,
-                    hnswlib::SpaceInterface<dist_t>* space) {
-
-        if(vector_subset.empty() || k == 0) {
-            return {};
+    // Keeps the k most similar (similarity, label) pairs pushed so far
+    class TopSimilar {
+    public:
+        explicit TopSimilar(size_t k) :
+            k_(k) {
+            heap_.reserve(k);
         }
 
-        // Get distance function from space interface (same as HNSW uses)
-        hnswlib::DISTFUNC<dist_t> distance_func = space->get_dist_func();
-        void* dist_func_param = space->get_dist_func_param();
+        void push(float similarity, idInt label) {
+            if(heap_.size() < k_) {
+                heap_.emplace_back(similarity, label);
+                std::push_heap(heap_.begin(), heap_.end(), worse);
+            } else if(k_ && similarity > heap_.front().first) {
+                std::pop_heap(heap_.begin(), heap_.end(), worse);
+                heap_.back() = {similarity, label};
+                std::push_heap(heap_.begin(), heap_.end(), worse);
+            }
+        }
 
-        // Use priority queue to maintain top k results (max heap for smallest distances)
-        std::priority_queue<std::pair<dist_t, idInt>> top_results;
+        void merge(const TopSimilar& other) {
+            for(const auto& [similarity, label] : other.heap_) {
+                push(similarity, label);
+            }
+        }
 
-        // Compute distances for all vectors in subset
-        for(const auto& [label, vec_bytes] : vector_subset) {
-            dist_t distance = distance_func(query_data, vec_bytes.data(), dist_func_param);
+        // Most similar first
+        std::vector<std::pair<float, idInt>> sorted() const {
+            std::vector<std::pair<float, idInt>> results(heap_);
+            std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+                return a.first > b.first;
+            });
+            return results;
+        }
 
-            if(top_results.size() < k) {
-                top_results.emplace(distance, label);
-            } else if(distance < top_results.top().first) {
-                top_results.pop();
-                top_results.emplace(distance, label);
-            }
+    private:
+        // Min-heap on similarity, the weakest kept result sits at the front
+        static bool worse(const std::pair<float, idInt>& a, const std::pair<float, idInt>& b) {
+            return a.first > b.first;
         }
 
-        // Convert to vector and reverse to get ascending order (best first)
-        std::vector<std::pair<dist_t, idInt>> results;
-        results.reserve(top_results.size());
+        size_t k_;
+        std::vector<std::pair<float, idInt>> heap_;
+    };
 
-        while(!top_results.empty()) {
-            results.push_back(top_results.top());
-            top_results.pop();
+    // Exact top-k by similarity over the ids of a bitmap, using the same space (and query
+    // batch kernels) as the HNSW index. query_data is prepared by quantize_query. The ids are
+    // split into blocks of block_size that are scored on the worker pool, each thread keeps its
+    // own top-k and the heaps are merged at the end.
+    // make_view() is called once per block on the executing thread and must return an object
+    // whose get(id) returns the stored vector, or nullptr when it is missing.
+    template <typename MakeView>
+    std::vector<std::pair<float, idInt>> searchKnnBitmap(const void* query_data,
+                                                         const ndd::RoaringBitmap& ids,
+                                                         size_t k,
+                                                         SpaceInterface<float>* space,
+                                                         ndd::WorkerPool& pool,
+                                                         size_t block_size,
+                                                         MakeView&& make_view) {
+        const size_t count = ids.cardinality();
+        if(count == 0 || k == 0) {
+            return {};
         }
 
-        std::reverse(results.begin(), results.end());
-        return results;
+        SIMBATCHFUNC<float> sim_batch_func = space->get_query_sim_batch_func();
+        const void* dist_func_param = space->get_dist_func_param();
+        const size_t num_blocks = (count + block_size - 1) / block_size;
+        std::vector<TopSimilar> tops(pool.concurrency(), TopSimilar(k));
+
+        pool.parallel_for(num_blocks, [&](size_t block, size_t slot) {
+            constexpr size_t BATCH = 64;
+            idInt labels[BATCH];
+            const void* vectors[BATCH];
+            float sims[BATCH];
+            size_t batch_size = 0;
+
+            auto view = make_view();
+            TopSimilar& top = tops[slot];
+            auto flush = [&]() {
+                sim_batch_func(query_data, vectors, batch_size, dist_func_param, sims);
+                for(size_t i = 0; i < batch_size; i++) {
+                    top.push(sims[i], labels[i]);
+                }
+                batch_size = 0;
+            };
+
+            // Seek to the first id of the block, then stream the rest of it
+            idInt first;
+            ids.select(static_cast<idInt>(block * block_size), &first);
+            auto it = ids.begin();
+            it.move_equalorlarger(first);
+            for(size_t i = 0; i < block_size && it != ids.end(); i++, ++it) {
+                const uint8_t* vec = view.get(*it);
+                if(!vec) {
+                    continue;
+                }
+                labels[batch_size] = *it;
+                vectors[batch_size] = vec;
+                if(++batch_size == BATCH) {
+                    flush();
+                }
+            }
+            if(batch_size) {
+                flush();
+            }
+        });
+
+        for(size_t i = 1; i < tops.size(); i++) {
+            tops[0].merge(tops[i]);
+        }
+        return tops[0].sorted();
     }
 
 }  // namespace hnswlib
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Parameters handed to every distance kernel. Kept apart from hnswlib.h so the quantization
+// kernels can be compiled without the rest of the index
+namespace hnswlib {
+    typedef uint8_t SpaceType;
+    static const SpaceType L2_SPACE = 0;
+    static const SpaceType IP_SPACE = 1;
+    static const SpaceType COSINE_SPACE = 2;
+
+    struct DistParams {
+        size_t dim;
+        uint8_t quant_level;
+        SpaceType space_type{L2_SPACE};
+        // Trained state of levels that need one (PQ codebook, INT8S scales), nullptr otherwise
+        const void* codebook{nullptr};
+    };
+
+    inline SpaceType getSpaceType(const std::string& space_type_str) {
+        if(space_type_str == "l2") {
+            return L2_SPACE;
+        }
+        if(space_type_str == "ip") {
+            return IP_SPACE;
+        }
+        if(space_type_str == "cosine") {
+            return COSINE_SPACE;
+        }
+        throw std::runtime_error("Unknown space type: " + space_type_str);
+    }
+
+    inline std::string getSpaceTypeString(SpaceType space_type) {
+        switch(space_type) {
+            case L2_SPACE:
+                return "l2";
+            case IP_SPACE:
+                return "ip";
+            case COSINE_SPACE:
+                return "cosine";
+            default:
+                throw std::runtime_error("Unknown space type: " + std::to_string(space_type));
+        }
+    }
+}  // namespace hnswlib
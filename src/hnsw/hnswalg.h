@@ -13,12 +13,19 @@
 #include <list>
 #include <functional>
 #include <sstream>
+#include <fstream>
+#include <filesystem>
 #include <iostream>
 #include <thread>
 #include <set>
 #include <unordered_map>
 #include <shared_mutex>
 #include <memory>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace hnswlib {
 
@@ -33,6 +40,167 @@ namespace hnswlib {
         }
     };
 
+    // Writes count zero bytes, in place of base layer slots that hold nothing
+    static void writeZeros(std::ostream& out, size_t count) {
+        static const char zeros[64 * 1024] = {};
+        while(count > 0) {
+            size_t chunk = std::min(count, sizeof(zeros));
+            out.write(zeros, chunk);
+            count -= chunk;
+        }
+    }
+
+    // Delta file of an index file. It holds the regions changed since the index file was
+    // written, as one record per checkpoint, and is applied on top of it by loadIndex
+    inline std::string deltaPath(const std::string& location) { return location + ".delta"; }
+
+    constexpr uint64_t DELTA_MAGIC = 0x0DE17A0DE17A0DE1;
+    constexpr uint64_t DELTA_RECORD_MARKER = 0xC4EC4901C4EC4901;
+
+    // Reads one delta record, framed by markers and its size. Returns false at the end of the
+    // file and for a record cut short by a crash
+    static bool readDeltaRecord(std::istream& input, std::string& payload) {
+        uint64_t marker = 0;
+        uint64_t size = 0;
+        readBinaryPOD(input, marker);
+        readBinaryPOD(input, size);
+        if(!input || marker != DELTA_RECORD_MARKER) {
+            return false;
+        }
+        std::streampos start = input.tellg();
+        input.seekg(0, std::ios::end);
+        std::streampos end = input.tellg();
+        input.seekg(start);
+        if(size > static_cast<uint64_t>(end - start)) {
+            return false;
+        }
+        payload.resize(size);
+        input.read(payload.data(), size);
+        readBinaryPOD(input, marker);
+        return input && marker == DELTA_RECORD_MARKER;
+    }
+
+    // Counts the bytes written through it, so that a snapshot can be sized before it is copied
+    class CountingStreamBuf : public std::streambuf {
+    public:
+        size_t count() const { return count_; }
+
+    protected:
+        std::streamsize xsputn(const char*, std::streamsize size) override {
+            count_ += size;
+            return size;
+        }
+        int_type overflow(int_type ch) override {
+            if(!traits_type::eq_int_type(ch, traits_type::eof())) {
+                count_++;
+            }
+            return traits_type::not_eof(ch);
+        }
+
+    private:
+        size_t count_{0};
+    };
+
+    // Writes go straight into a fixed array, a write past its end fails the stream
+    class ArrayStreamBuf : public std::streambuf {
+    public:
+        ArrayStreamBuf(char* data, size_t size) { setp(data, data + size); }
+        size_t written() const { return pptr() - pbase(); }
+    };
+
+    // Bytes allocated once at their final size and left uninitialized until written
+    struct SnapshotBytes {
+        std::unique_ptr<char[]> bytes;
+        size_t length{0};
+
+        SnapshotBytes() = default;
+        explicit SnapshotBytes(size_t size) :
+            bytes(std::make_unique_for_overwrite<char[]>(size)), length(size) {}
+
+        char* data() { return bytes.get(); }
+        const char* data() const { return bytes.get(); }
+        size_t size() const { return length; }
+    };
+
+    // Bytes of an index file captured in memory, so that the file can be written while the
+    // index keeps changing. The unused base layer slots are not kept, they are written as
+    // zeros
+    struct IndexSnapshot {
+        // A delta only holds what changed since the index file with base_id was written. It
+        // goes to the delta file of that index file, which stays as it is
+        bool delta{false};
+        uint64_t base_id{0};
+        SnapshotBytes head;  // Header and used base layer slots
+        size_t zero_fill{0};
+        SnapshotBytes tail;  // Upper layers and the optional sections, or the delta record
+
+        void write(const std::string& location) const {
+            if(delta) {
+                appendDelta(location);
+                return;
+            }
+            std::ofstream output(location, std::ios::binary);
+            output.write(head.data(), head.size());
+            writeZeros(output, zero_fill);
+            output.write(tail.data(), tail.size());
+            output.close();
+            if(!output) {
+                throw std::runtime_error("Failed to write index file: " + location);
+            }
+        }
+
+    private:
+        // A delta file left by an older index file is started over, and a record cut short
+        // by a crash is dropped so that the new one stays readable
+        void appendDelta(const std::string& location) const {
+            std::string path = deltaPath(location);
+            std::streamoff valid_end = 0;
+            {
+                std::ifstream input(path, std::ios::binary);
+                uint64_t magic = 0;
+                uint64_t id = 0;
+                readBinaryPOD(input, magic);
+                readBinaryPOD(input, id);
+                if(input && magic == DELTA_MAGIC && id == base_id) {
+                    std::string record;
+                    valid_end = input.tellg();
+                    while(readDeltaRecord(input, record)) {
+                        valid_end = input.tellg();
+                    }
+                }
+            }
+
+            std::ofstream output;
+            if(valid_end == 0) {
+                output.open(path, std::ios::binary | std::ios::trunc);
+                writeBinaryPOD(output, DELTA_MAGIC);
+                writeBinaryPOD(output, base_id);
+            } else {
+                std::filesystem::resize_file(path, valid_end);
+                output.open(path, std::ios::binary | std::ios::app);
+            }
+            uint64_t size = tail.size();
+            writeBinaryPOD(output, DELTA_RECORD_MARKER);
+            writeBinaryPOD(output, size);
+            output.write(tail.data(), tail.size());
+            writeBinaryPOD(output, DELTA_RECORD_MARKER);
+            output.close();
+            if(!output) {
+                throw std::runtime_error("Failed to write index delta: " + path);
+            }
+        }
+    };
+
+    // Closes a file descriptor when it goes out of scope
+    struct FileDescriptor {
+        int fd{-1};
+        ~FileDescriptor() {
+            if(fd >= 0) {
+                close(fd);
+            }
+        }
+    };
+
     template <typename dist_t> class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         using distance_type = std::pair<dist_t, idhInt>;
         using max_heap_pq = std::priority_queue<distance_type,
@@ -42,6 +210,7 @@ namespace hnswlib {
                                                 std::vector<distance_type>,
                                                 CompareBySecond<distance_type>>;
         using VectorFetcher = std::function<bool(idInt, uint8_t*)>;
+        using VectorViewFactory = std::function<std::unique_ptr<VectorView>()>;
 
     public:
         // Constructors and destructor
@@ -50,7 +219,13 @@ namespace hnswlib {
         HierarchicalNSW(const std::string& location, size_t max_elements = 0) :
             linkListLocks_(settings::MAX_LINK_LIST_LOCKS) {
             // Initilaize label lookup vector. Values will be filled in loadIndex
-            loadIndex(location, max_elements);
+            try {
+                loadIndex(location, max_elements);
+            } catch(...) {
+                // The destructor does not run, the members must not free mapped memory
+                releaseMappings();
+                throw;
+            }
         }
         // Used for creating a new index
         HierarchicalNSW(
@@ -82,6 +257,11 @@ namespace hnswlib {
             data_size_ = space_->get_data_size();
             fstDistFunc_ = space_->get_dist_func();
             fstSimFunc_ = space_->get_sim_func();
+            fstSimBatchFunc_ = space_->get_sim_batch_func();
+            fstSimErrorBatchFunc_ = space_->get_sim_error_batch_func();
+            fstQuerySimFunc_ = space_->get_query_sim_func();
+            fstQuerySimBatchFunc_ = space_->get_query_sim_batch_func();
+            fstQuerySimBoundedBatchFunc_ = space_->get_query_sim_bounded_batch_func();
             dist_func_param_ = space_->get_dist_func_param();
             LOG_DEBUG("Space initialized with data size: "
                       << data_size_ << ", dimension: " << dimension_
@@ -89,7 +269,9 @@ namespace hnswlib {
 
             // Initialize upper layer space
             bool use_hybrid = true;
-            if(quant_level_ == ndd::quant::QuantizationLevel::BINARY) {
+            if(quant_level_ == ndd::quant::QuantizationLevel::BINARY
+               || quant_level_ == ndd::quant::QuantizationLevel::RABITQ
+               || ndd::quant::is_trained_level(quant_level_)) {
                 use_hybrid = false;
             }
 
@@ -105,6 +287,11 @@ namespace hnswlib {
 
             data_size_upper_ = space_upper_->get_data_size();
             fstSimFuncUpper_ = space_upper_->get_sim_func();
+            fstSimBatchFuncUpper_ = space_upper_->get_sim_batch_func();
+            fstSimErrorBatchFuncUpper_ = space_upper_->get_sim_error_batch_func();
+            fstQuerySimFuncUpper_ = space_upper_->get_query_sim_func();
+            fstQuerySimBatchFuncUpper_ = space_upper_->get_query_sim_batch_func();
+            fstQuerySimBoundedBatchFuncUpper_ = space_upper_->get_query_sim_bounded_batch_func();
             dist_func_param_upper_ = space_upper_->get_dist_func_param();
             LOG_DEBUG("Upper layer data size: " << data_size_upper_);
 
@@ -141,6 +328,7 @@ namespace hnswlib {
             }
 
             mult_ = 1 / log(1.0 * M_);
+            resetDirtyTracking();
 
             visited_list_pool_ =
                     std::unique_ptr<VisitedListPool>(new VisitedListPool(1, maxElements_));
@@ -148,9 +336,13 @@ namespace hnswlib {
 
         ~HierarchicalNSW() {
             LOG_DEBUG("HierarchicalNSW destructor called");
+            releaseMappings();
             if(dataBaseLayer_) {
                 free(dataBaseLayer_);
             }
+            if(dataVectors_) {
+                free(dataVectors_);
+            }
         }
         // Public getters and setters
         ndd::quant::QuantizationLevel getQuantLevel() const { return quant_level_; }
@@ -161,14 +353,42 @@ namespace hnswlib {
         SpaceInterface<dist_t>* getSpace() const { return space_.get(); }
         size_t getDataSize() const { return data_size_; }
         void setVectorFetcher(VectorFetcher fetcher) { vector_fetcher_ = fetcher; }
+        void setVectorViewFactory(VectorViewFactory factory) { vector_view_factory_ = factory; }
         size_t getDimension() const { return dimension_; }
         size_t getM() const { return M_; }
         size_t getEfConstruction() const { return efConstruction_; }
-        size_t getRemainingCapacity() const { return maxElements_ - curElementsCount_; }
+        size_t getRemainingCapacity() const {
+            return maxElements_ - curElementsCount_ + freeCount_;
+        }
         size_t getMaxElements() const { return maxElements_; }
         // Get active elements count
-        size_t getElementsCount() const { return curElementsCount_ - deletedElementsCount_; }
+        size_t getElementsCount() const {
+            return curElementsCount_ - deletedElementsCount_ - freeCount_;
+        }
+        // Deleted elements still linked into the graph, until vacuum() reclaims them
         size_t getDeletedCount() const { return deletedElementsCount_; }
+        // Slots reclaimed by vacuum() and not yet taken by a new element
+        size_t getFreeSlotCount() const { return freeCount_; }
+        // Share of the used slots held by deleted elements
+        double getDeletedRatio() const {
+            size_t used = curElementsCount_ - freeCount_;
+            return used ? static_cast<double>(deletedElementsCount_) / used : 0.0;
+        }
+        bool hasVectorArena() const { return dataVectors_ != nullptr; }
+        // Leading internal ids laid out in graph order by the last reorderGraph()
+        size_t getReorderedCount() const { return reorderedCount_; }
+
+        // Trained state of PQ and INT8S indexes, shared by the base and upper layer spaces. It
+        // is set once, searches running concurrently check hasCodebook() before touching it.
+        // Its type is the one the kernels of the level cast DistParams::codebook back to
+        bool hasCodebook() const { return has_codebook_.load(std::memory_order_acquire); }
+        std::shared_ptr<const void> getCodebook() const { return codebook_; }
+        void setCodebook(std::shared_ptr<const void> codebook) {
+            codebook_ = std::move(codebook);
+            static_cast<DistParams*>(dist_func_param_)->codebook = codebook_.get();
+            static_cast<DistParams*>(dist_func_param_upper_)->codebook = codebook_.get();
+            has_codebook_.store(codebook_ != nullptr, std::memory_order_release);
+        }
         std::string getElementStats() const {
             std::stringstream ss;
             ss << "Elements: " << curElementsCount_ << ", MaxLevel: " << maxLevel_
@@ -188,6 +408,11 @@ namespace hnswlib {
             size += upper_layer_estimate
                     * (data_size_upper_ + sizeof(levelInt) + sizeLinksUpperLayers_);
 
+            // Level 0 vector arena, if enabled
+            if(dataVectors_) {
+                size += maxElements_ * sizeVectorSlot_;
+            }
+
             return size / GB;  // GB
         }
 
@@ -216,6 +441,7 @@ namespace hnswlib {
             int x = 0;
             LOG_DEBUG("Inside searchKnn, element count: " << curElementsCount_);
             std::vector<std::pair<dist_t, idInt>> result;
+            std::shared_lock<std::shared_mutex> lock(layout_lock_);
             if(curElementsCount_ == 0) {
                 return result;
             }
@@ -223,20 +449,18 @@ namespace hnswlib {
             idhInt currObj = entryPoint_;
             dist_t curSim;
 
-            // Prepare query data for upper layers
-            std::vector<uint8_t> query_data_upper;
+            // The query comes prepared by quantize_query. Levels with INT8 upper layers prepare
+            // float queries, which the asymmetric INT8 kernels score as well, other levels keep
+            // their own space upstairs
+            const void* query_upper = query_data;
             if(maxLevel_ > 0) {
-                query_data_upper =
-                        const_cast<HierarchicalNSW*>(this)->getUpperLayerRepresentation(query_data);
-
                 // Use direct pointer for upper layers
                 const uint8_t* ep_data = getUpperLayerDataPtr(currObj);
                 if(!ep_data) {
                     return result;
                 }
 
-                curSim = fstSimFuncUpper_(
-                        query_data_upper.data(), ep_data, dist_func_param_upper_);
+                curSim = fstQuerySimFuncUpper_(query_upper, ep_data, dist_func_param_upper_);
             }
 
             dist_t s;
@@ -265,8 +489,8 @@ namespace hnswlib {
                         if(!candidate_data) {
                             continue;
                         }
-                        s = fstSimFuncUpper_(
-                                query_data_upper.data(), candidate_data, dist_func_param_upper_);
+                        s = fstQuerySimFuncUpper_(
+                                query_upper, candidate_data, dist_func_param_upper_);
 
                         if(s > curSim) {
                             curSim = s;
@@ -279,12 +503,22 @@ namespace hnswlib {
 
             std::vector<std::pair<dist_t, idhInt>> top_candidates;
             LOG_DEBUG("Starting search in level 0..current object " << currObj);
+            // Pin one read view for the whole level 0 search
+            std::unique_ptr<VectorView> view = openVectorView();
             if(deletedElementsCount_) {
-                top_candidates = searchBaseLayer<false, true>(
-                        currObj, query_data, 0, std::max(ef, k));  // Level 0 for final search
+                top_candidates = searchBaseLayer<false, true>(currObj,
+                                                              query_data,
+                                                              0,
+                                                              std::max(ef, k),
+                                                              view.get(),
+                                                              isIdAllowed);  // Level 0
             } else {
-                top_candidates = searchBaseLayer<false, false>(
-                        currObj, query_data, 0, std::max(ef, k));  // Level 0 for final search
+                top_candidates = searchBaseLayer<false, false>(currObj,
+                                                               query_data,
+                                                               0,
+                                                               std::max(ef, k),
+                                                               view.get(),
+                                                               isIdAllowed);  // Level 0
             }
             LOG_DEBUG("Search in level 0 completed. Found " << top_candidates.size()
                                                             << " candidates");
@@ -301,7 +535,98 @@ namespace hnswlib {
             // Lock the index so that addPoint and markDelete are not called
             std::unique_lock<std::shared_mutex> lock(index_lock_);
 
+            beginFullCheckpoint();
             std::ofstream output(location, std::ios::binary);
+            writeHead(output);
+            writeZeros(output, (maxElements_ - curElementsCount_) * sizeDataAtBaseLayer_);
+            writeTail(output, output.tellp());
+            output.close();
+            if(!output) {
+                fullCheckpointNeeded_ = true;
+                throw std::runtime_error("Failed to write index file: " + location);
+            }
+        }
+
+        // Copies what saveIndex writes, so that writing it out blocks nothing. The sizes are
+        // counted first and each part is copied into one buffer of exactly that size. The
+        // caller keeps inserts and deletes out while it runs, as for saveIndex.
+        // With allow_delta, only the regions changed since the last snapshot or save are
+        // copied, unless a full copy is due: the deltas outgrew CHECKPOINT_DELTA_RATIO of the
+        // index, or a change moved more than links and labels around
+        std::unique_ptr<IndexSnapshot> snapshot(bool allow_delta = false) {
+            std::unique_lock<std::shared_mutex> lock(index_lock_);
+            auto snap = std::make_unique<IndexSnapshot>();
+            if(allow_delta && !fullCheckpointDue()) {
+                // Writing the delta consumes the dirty regions, so it cannot be sized first.
+                // It is small next to the index
+                std::ostringstream record;
+                writeDelta(record);
+                std::string bytes = std::move(record).str();
+                snap->delta = true;
+                snap->base_id = checkpointId_;
+                snap->tail = SnapshotBytes(bytes.size());
+                memcpy(snap->tail.data(), bytes.data(), bytes.size());
+                deltaBytes_ += snap->tail.size();
+                return snap;
+            }
+
+            beginFullCheckpoint();
+            snap->head = copyOut([this](std::ostream& output) { writeHead(output); });
+            snap->zero_fill = (maxElements_ - curElementsCount_) * sizeDataAtBaseLayer_;
+            size_t tail_offset = snap->head.size() + snap->zero_fill;
+            snap->tail = copyOut(
+                    [this, tail_offset](std::ostream& output) { writeTail(output, tail_offset); });
+            return snap;
+        }
+
+        // Makes the next snapshot a full one, after a delta or full snapshot failed to write
+        void requireFullCheckpoint() { fullCheckpointNeeded_ = true; }
+
+    private:
+        // Runs write twice: once to count its bytes and once into a buffer of that size
+        template <typename Write> static SnapshotBytes copyOut(Write write) {
+            CountingStreamBuf counter;
+            std::ostream counting(&counter);
+            write(counting);
+
+            SnapshotBytes bytes(counter.count());
+            ArrayStreamBuf buffer(bytes.data(), bytes.size());
+            std::ostream output(&buffer);
+            write(output);
+            if(!output || buffer.written() != bytes.size()) {
+                throw std::runtime_error("Index snapshot changed size while being copied");
+            }
+            return bytes;
+        }
+
+        bool fullCheckpointDue() const {
+            size_t slot_bytes = sizeDataAtBaseLayer_ + (dataVectors_ ? sizeVectorSlot_ : 0);
+            size_t index_bytes = curElementsCount_ * slot_bytes;
+            return fullCheckpointNeeded_
+                   || deltaBytes_ > settings::CHECKPOINT_DELTA_RATIO * index_bytes;
+        }
+
+        // A full index file gets a new id, the deltas written after it carry it
+        void beginFullCheckpoint() {
+            std::random_device rd;
+            checkpointId_ = (static_cast<uint64_t>(rd()) << 32) | rd();
+            resetDirtyTracking();
+            deltaBytes_ = 0;
+            fullCheckpointNeeded_ = false;
+        }
+
+        void syncFreeSlotsFlag() {
+            if(freeSlots_.empty()) {
+                flags_ &= ~FLAG_FREE_SLOTS;
+            } else {
+                flags_ |= FLAG_FREE_SLOTS;
+            }
+        }
+
+        // Header and the used base layer slots of the index file
+        void writeHead(std::ostream& output) {
+            syncFreeSlotsFlag();
+            flags_ |= FLAG_CHECKPOINT_ID | FLAG_MAPPABLE;
 
             // Save version (first 2 bytes)
             writeBinaryPOD(output, settings::INDEX_VERSION);
@@ -325,35 +650,368 @@ namespace hnswlib {
             writeBinaryPOD(output, mult_);
             writeBinaryPOD(output, efConstruction_);
 
-            // Save level 0 data
-            output.write(dataBaseLayer_, maxElements_ * sizeDataAtBaseLayer_);
+            // Save level 0 data. The unused slots that follow are written as zeros
+            output.write(dataBaseLayer_, curElementsCount_ * sizeDataAtBaseLayer_);
+        }
+
+        // Everything after the base layer, which starts at offset in the file
+        void writeTail(std::ostream& output, size_t offset) const {
             // Marker to check alignment of data
             uint64_t upper_marker = 0xDEADBEEFDEADBEEF;
             writeBinaryPOD(output, upper_marker);
+            size_t position = offset + sizeof(upper_marker);
+
+            // File offsets of the upper layer blocks, so that a mapped load points at them
+            // without walking the stream below
+            if(flags_ & FLAG_MAPPABLE) {
+                std::vector<idhInt> ids;
+                for(size_t i = 0; i < dataUpperLayer_.size(); ++i) {
+                    if(dataUpperLayer_[i]) {
+                        ids.push_back(i);
+                    }
+                }
+                uint64_t block_count = ids.size();
+                position += 2 * sizeof(uint64_t);
+                position += block_count * (sizeof(idhInt) + sizeof(uint64_t));
+                std::vector<uint64_t> offsets;
+                offsets.reserve(block_count);
+                for(idhInt id : ids) {
+                    position += sizeof(idhInt);
+                    offsets.push_back(position);
+                    position += upperBlockSize(dataUpperLayer_[id].get());
+                }
+                // Past the sentinel
+                uint64_t stream_end = position + sizeof(idhInt);
+                writeBinaryPOD(output, block_count);
+                writeBinaryPOD(output, stream_end);
+                output.write(reinterpret_cast<const char*>(ids.data()),
+                             block_count * sizeof(idhInt));
+                output.write(reinterpret_cast<const char*>(offsets.data()),
+                             block_count * sizeof(uint64_t));
+                position = stream_end;
+            }
 
-            levelInt level;
-            size_t total_size;
             // Write upper layer data using sentinel-based stream
             for(size_t i = 0; i < dataUpperLayer_.size(); ++i) {
                 if(!dataUpperLayer_[i]) {
                     continue;
                 }
-
-                // Use data_size_upper_
-                level = *reinterpret_cast<levelInt*>(dataUpperLayer_[i].get() + data_size_upper_);
-                total_size = data_size_upper_ + sizeof(levelInt) + level * sizeLinksUpperLayers_;
-
                 writeBinaryPOD(output, static_cast<idhInt>(i));  // write ID
                 output.write(reinterpret_cast<char*>(dataUpperLayer_[i].get()),
-                             total_size);  // write blob
+                             upperBlockSize(dataUpperLayer_[i].get()));  // write blob
             }
 
             // Sentinel to mark end
             idhInt sentinel = INVALID_ID;
             writeBinaryPOD(output, sentinel);
-            output.close();
+
+            // Level 0 vector arena. Only the used slots are written, aligned in the file like
+            // in memory so that a mapped arena keeps its vectors on cache line boundaries
+            if(flags_ & FLAG_VECTOR_ARENA) {
+                uint64_t arena_marker = VECTOR_ARENA_MARKER;
+                writeBinaryPOD(output, arena_marker);
+                writeBinaryPOD(output, sizeVectorSlot_);
+                if(flags_ & FLAG_MAPPABLE) {
+                    position += sizeof(arena_marker) + sizeof(sizeVectorSlot_);
+                    writeZeros(output, arenaPadding(position));
+                }
+                output.write(dataVectors_, curElementsCount_ * sizeVectorSlot_);
+            }
+
+            // Internal ids are positions in the arrays above, so a reordered index is saved in
+            // graph order already. Only the length of the ordered prefix is recorded
+            if(flags_ & FLAG_REORDERED) {
+                uint64_t reorder_marker = REORDER_MARKER;
+                writeBinaryPOD(output, reorder_marker);
+                writeBinaryPOD(output, reorderedCount_);
+            }
+
+            // Slots reclaimed by vacuum(). They keep their old label, so the load has to know
+            // them before it rebuilds labelLookup_
+            if(flags_ & FLAG_FREE_SLOTS) {
+                uint64_t free_marker = FREE_SLOTS_MARKER;
+                writeBinaryPOD(output, free_marker);
+                size_t free_count = freeSlots_.size();
+                writeBinaryPOD(output, free_count);
+                output.write(reinterpret_cast<const char*>(freeSlots_.data()),
+                             free_count * sizeof(idhInt));
+            }
+
+            if(flags_ & FLAG_CHECKPOINT_ID) {
+                uint64_t checkpoint_marker = CHECKPOINT_ID_MARKER;
+                writeBinaryPOD(output, checkpoint_marker);
+                writeBinaryPOD(output, checkpointId_);
+            }
+
+            // Label lookup table, a mapped load would otherwise read every base layer slot to
+            // rebuild it
+            if(flags_ & FLAG_MAPPABLE) {
+                uint64_t label_marker = LABEL_LOOKUP_MARKER;
+                writeBinaryPOD(output, label_marker);
+                size_t label_count = labelLookup_.size();
+                writeBinaryPOD(output, label_count);
+                output.write(reinterpret_cast<const char*>(labelLookup_.data()),
+                             label_count * sizeof(idhInt));
+            }
+        }
+
+        size_t upperBlockSize(const uint8_t* block) const {
+            levelInt level = *reinterpret_cast<const levelInt*>(block + data_size_upper_);
+            return data_size_upper_ + sizeof(levelInt) + level * sizeLinksUpperLayers_;
+        }
+
+        static size_t arenaPadding(size_t position) {
+            return (settings::VECTOR_ARENA_ALIGNMENT - position % settings::VECTOR_ARENA_ALIGNMENT)
+                   % settings::VECTOR_ARENA_ALIGNMENT;
+        }
+
+        // A delta record: the header fields that change with inserts and deletes, the dirty
+        // base layer and vector arena slots, the dirty upper layer blocks and the free slots.
+        // The dirty marks are cleared
+        void writeDelta(std::ostream& output) {
+            syncFreeSlotsFlag();
+            size_t count = curElementsCount_;
+            size_t deleted = deletedElementsCount_;
+            writeBinaryPOD(output, flags_);
+            writeBinaryPOD(output, count);
+            writeBinaryPOD(output, deleted);
+            writeBinaryPOD(output, maxLevel_);
+            writeBinaryPOD(output, entryPoint_);
+
+            writeDirtySlots(output, dirtyBase_, dataBaseLayer_, sizeDataAtBaseLayer_, count);
+            writeDirtySlots(output, dirtyArena_, dataVectors_, sizeVectorSlot_, count);
+
+            std::vector<size_t> upper;
+            for(size_t id : takeDirty(dirtyUpper_)) {
+                if(id < count && dataUpperLayer_[id]) {
+                    upper.push_back(id);
+                }
+            }
+            size_t upper_count = upper.size();
+            writeBinaryPOD(output, upper_count);
+            for(size_t id : upper) {
+                writeBinaryPOD(output, static_cast<idhInt>(id));
+                output.write(reinterpret_cast<char*>(dataUpperLayer_[id].get()),
+                             upperBlockSize(dataUpperLayer_[id].get()));
+            }
+
+            size_t free_count = freeSlots_.size();
+            writeBinaryPOD(output, free_count);
+            output.write(reinterpret_cast<const char*>(freeSlots_.data()),
+                         free_count * sizeof(idhInt));
         }
 
+        // Writes the dirty slots of a slot array as runs of consecutive slots
+        void writeDirtySlots(std::ostream& output,
+                             std::vector<std::atomic<uint64_t>>& dirty,
+                             const char* data,
+                             size_t stride,
+                             size_t count) {
+            std::vector<std::pair<uint64_t, uint64_t>> runs;
+            for(size_t id : takeDirty(dirty)) {
+                if(id >= count) {
+                    continue;
+                }
+                if(!runs.empty() && runs.back().first + runs.back().second == id) {
+                    runs.back().second++;
+                } else {
+                    runs.emplace_back(id, 1);
+                }
+            }
+            uint64_t run_count = runs.size();
+            writeBinaryPOD(output, run_count);
+            for(const auto& [first, length] : runs) {
+                writeBinaryPOD(output, first);
+                writeBinaryPOD(output, length);
+                output.write(data + first * stride, length * stride);
+            }
+        }
+
+        // Replays the delta file of an index file over it. A delta file left by an older index
+        // file is ignored, as is a record cut short by a crash and anything after it. Returns
+        // the base layer slots the deltas wrote
+        std::vector<idhInt> applyDeltas(const std::string& location) {
+            deltaBytes_ = 0;
+            std::vector<idhInt> slots;
+            std::ifstream input(deltaPath(location), std::ios::binary);
+            if(!input) {
+                return slots;
+            }
+            uint64_t magic = 0;
+            uint64_t id = 0;
+            readBinaryPOD(input, magic);
+            readBinaryPOD(input, id);
+            if(!input || magic != DELTA_MAGIC || id != checkpointId_) {
+                LOG_INFO("Ignoring index delta of an older index file: " << deltaPath(location));
+                return slots;
+            }
+
+            std::string record;
+            size_t applied = 0;
+            while(readDeltaRecord(input, record)) {
+                std::istringstream record_input(record);
+                applyDeltaRecord(record_input, slots);
+                deltaBytes_ += record.size();
+                applied++;
+            }
+            LOG_INFO("Applied " << applied << " index deltas, " << deltaBytes_ / KB << " KB");
+            return slots;
+        }
+
+        void applyDeltaRecord(std::istream& input, std::vector<idhInt>& slots) {
+            size_t count;
+            size_t deleted;
+            readBinaryPOD(input, flags_);
+            readBinaryPOD(input, count);
+            readBinaryPOD(input, deleted);
+            readBinaryPOD(input, maxLevel_);
+            readBinaryPOD(input, entryPoint_);
+            if(!input || count > maxElements_) {
+                throw std::runtime_error("Corrupt index delta: element count out of range");
+            }
+            curElementsCount_ = count;
+            deletedElementsCount_ = deleted;
+
+            readSlots(input, dataBaseLayer_, sizeDataAtBaseLayer_, &slots);
+            readSlots(input, dataVectors_, sizeVectorSlot_);
+
+            size_t upper_count;
+            readBinaryPOD(input, upper_count);
+            for(size_t i = 0; i < upper_count && input; i++) {
+                idhInt id;
+                readBinaryPOD(input, id);
+                if(id >= count) {
+                    throw std::runtime_error("Corrupt index delta: upper layer id out of range");
+                }
+                setUpperBlock(id, readUpperBlock(input));
+            }
+
+            size_t free_count;
+            readBinaryPOD(input, free_count);
+            if(!input || free_count > count) {
+                throw std::runtime_error("Corrupt index delta: free slots out of range");
+            }
+            freeSlots_.resize(free_count);
+            input.read(reinterpret_cast<char*>(freeSlots_.data()), free_count * sizeof(idhInt));
+            if(!input) {
+                throw std::runtime_error("Corrupt index delta: record truncated");
+            }
+            validateFreeSlots("Corrupt index delta");
+        }
+
+        // Free slots are distinct used slots, loading would index past the base layer or hand
+        // one slot to two elements otherwise
+        void validateFreeSlots(const std::string& error) const {
+            std::vector<bool> seen(curElementsCount_, false);
+            for(idhInt id : freeSlots_) {
+                if(id >= curElementsCount_ || seen[id]) {
+                    LOG_DEBUG(error << ": free slot " << id << " out of range or repeated");
+                    throw std::runtime_error(error + ": free slot " + std::to_string(id)
+                                             + " out of range or repeated");
+                }
+                seen[id] = true;
+            }
+        }
+
+        void readSlots(std::istream& input,
+                       char* data,
+                       size_t stride,
+                       std::vector<idhInt>* slots = nullptr) {
+            uint64_t run_count;
+            readBinaryPOD(input, run_count);
+            for(uint64_t i = 0; i < run_count && input; i++) {
+                uint64_t first;
+                uint64_t length;
+                readBinaryPOD(input, first);
+                readBinaryPOD(input, length);
+                // Only slots below the element count of the record are written
+                if(!data || first >= curElementsCount_ || length > curElementsCount_ - first) {
+                    throw std::runtime_error("Corrupt index delta: slots out of range");
+                }
+                input.read(data + first * stride, length * stride);
+                for(uint64_t id = first; slots && id < first + length; id++) {
+                    slots->push_back(id);
+                }
+            }
+        }
+
+        // Points the upper layer blocks at the block stream of the index file, through the
+        // offset table in front of it
+        void mapUpperBlocks(std::istream& input,
+                            int fd,
+                            uint64_t block_count,
+                            uint64_t stream_end) {
+            std::vector<idhInt> ids(block_count);
+            std::vector<uint64_t> offsets(block_count);
+            input.read(reinterpret_cast<char*>(ids.data()), block_count * sizeof(idhInt));
+            input.read(reinterpret_cast<char*>(offsets.data()), block_count * sizeof(uint64_t));
+            if(!input) {
+                throw std::runtime_error("Failed to read upper layer offsets");
+            }
+            uint64_t stream_start = input.tellg();
+            if(stream_end < stream_start) {
+                throw std::runtime_error("Corrupt index file: upper layer stream out of range");
+            }
+            char* stream = mapRegion(
+                    fd, stream_start, stream_end - stream_start, stream_end - stream_start);
+            for(uint64_t i = 0; i < block_count; i++) {
+                uint64_t offset = offsets[i];
+                if(ids[i] >= maxElements_ || offset < stream_start
+                   || offset + data_size_upper_ + sizeof(levelInt) > stream_end) {
+                    throw std::runtime_error("Corrupt index file: upper layer block out of range");
+                }
+                uint8_t* block = reinterpret_cast<uint8_t*>(stream + (offset - stream_start));
+                if(offset + upperBlockSize(block) > stream_end) {
+                    throw std::runtime_error("Corrupt index file: upper layer block out of range");
+                }
+                dataUpperLayer_[ids[i]].reset(block);
+            }
+            input.seekg(stream_end);
+        }
+
+        // An upper layer block as writeTail writes it: vector, level and link lists.
+        // legacy_int8 blocks come from a version 1 file and hold INT8 vectors without the
+        // squared norm, it is computed while the block is read
+        std::unique_ptr<uint8_t[]> readUpperBlock(std::istream& input,
+                                                  bool legacy_int8 = false) const {
+            size_t stored_data_size = data_size_upper_ - (legacy_int8 ? sizeof(float) : 0);
+            size_t header_size;
+            // Step 1: Read vector + level header
+            header_size = data_size_upper_ + sizeof(levelInt);
+
+            std::vector<uint8_t> header_buf(header_size);
+            input.read(reinterpret_cast<char*>(header_buf.data()),
+                       stored_data_size + sizeof(levelInt));
+            if(!input) {
+                throw std::runtime_error("Failed to read upper layer header");
+            }
+            if(legacy_int8) {
+                memmove(header_buf.data() + data_size_upper_,
+                        header_buf.data() + stored_data_size,
+                        sizeof(levelInt));
+                ndd::quant::int8d::store_squared_norm(header_buf.data(), dimension_);
+            }
+
+            levelInt level;
+            level = *reinterpret_cast<levelInt*>(header_buf.data() + data_size_upper_);
+
+            size_t total_size = header_size + level * sizeLinksUpperLayers_;
+
+            // Step 2: Allocate and copy header
+            auto mem = std::make_unique<uint8_t[]>(total_size);
+            memcpy(mem.get(), header_buf.data(), header_size);
+
+            // Step 3: Read linklists
+            input.read(reinterpret_cast<char*>(mem.get() + header_size),
+                       level * sizeLinksUpperLayers_);
+            if(!input) {
+                throw std::runtime_error("Failed to read upper layer linklists");
+            }
+            return mem;
+        }
+
+    public:
+
         void loadIndex(const std::string& location, size_t maxElements_i = 0) {
             std::ifstream input(location, std::ios::binary);
             if(!input.is_open()) {
@@ -363,7 +1021,8 @@ namespace hnswlib {
             // Read version
             uint16_t version;
             readBinaryPOD(input, version);
-            if(version != settings::INDEX_VERSION) {
+            // Version 1 files differ only in their INT8 vectors, which had no squared norm
+            if(version != settings::INDEX_VERSION && version != LEGACY_INT8_INDEX_VERSION) {
                 LOG_DEBUG("Index version mismatch. Expected: " << settings::INDEX_VERSION
                                                                << ", Found: " << version);
                 throw std::runtime_error("Index version mismatch");
@@ -390,6 +1049,7 @@ namespace hnswlib {
             readBinaryPOD(input, mult_);
             readBinaryPOD(input, efConstruction_);
 
+            size_t stored_max_elements = maxElements_;
             if(maxElements_i > 0) {
                 maxElements_ = maxElements_i;
             }
@@ -408,11 +1068,18 @@ namespace hnswlib {
             data_size_ = space_->get_data_size();
             fstDistFunc_ = space_->get_dist_func();
             fstSimFunc_ = space_->get_sim_func();
+            fstSimBatchFunc_ = space_->get_sim_batch_func();
+            fstSimErrorBatchFunc_ = space_->get_sim_error_batch_func();
+            fstQuerySimFunc_ = space_->get_query_sim_func();
+            fstQuerySimBatchFunc_ = space_->get_query_sim_batch_func();
+            fstQuerySimBoundedBatchFunc_ = space_->get_query_sim_bounded_batch_func();
             dist_func_param_ = space_->get_dist_func_param();
 
             // Initialize upper layer space
             bool use_hybrid = true;
-            if(quant_level_ == ndd::quant::QuantizationLevel::BINARY) {
+            if(quant_level_ == ndd::quant::QuantizationLevel::BINARY
+               || quant_level_ == ndd::quant::QuantizationLevel::RABITQ
+               || ndd::quant::is_trained_level(quant_level_)) {
                 use_hybrid = false;
             }
 
@@ -426,14 +1093,37 @@ namespace hnswlib {
 
             data_size_upper_ = space_upper_->get_data_size();
             fstSimFuncUpper_ = space_upper_->get_sim_func();
+            fstSimBatchFuncUpper_ = space_upper_->get_sim_batch_func();
+            fstSimErrorBatchFuncUpper_ = space_upper_->get_sim_error_batch_func();
+            fstQuerySimFuncUpper_ = space_upper_->get_query_sim_func();
+            fstQuerySimBatchFuncUpper_ = space_upper_->get_query_sim_batch_func();
+            fstQuerySimBoundedBatchFuncUpper_ = space_upper_->get_query_sim_bounded_batch_func();
             dist_func_param_upper_ = space_upper_->get_dist_func_param();
 
+            // Files with the mappable layout are mapped instead of read, see mapRegion()
+            bool mapped = settings::ENABLE_INDEX_MMAP && (flags_ & FLAG_MAPPABLE)
+                          && maxElements_ == stored_max_elements;
+            FileDescriptor file;
+            if(mapped) {
+                file.fd = open(location.c_str(), O_RDONLY);
+                if(file.fd < 0) {
+                    throw std::runtime_error("Cannot open file");
+                }
+            }
+
             // Allocate memory and load level 0 data
-            dataBaseLayer_ = (char*)malloc(maxElements_ * sizeDataAtBaseLayer_);
-            if(dataBaseLayer_ == nullptr) {
-                throw std::runtime_error("Not enough memory");
+            if(mapped) {
+                size_t offset = input.tellg();
+                size_t length = maxElements_ * sizeDataAtBaseLayer_;
+                dataBaseLayer_ = mapRegion(file.fd, offset, length, length);
+                input.seekg(offset + length);
+            } else {
+                dataBaseLayer_ = (char*)malloc(maxElements_ * sizeDataAtBaseLayer_);
+                if(dataBaseLayer_ == nullptr) {
+                    throw std::runtime_error("Not enough memory");
+                }
+                input.read(dataBaseLayer_, maxElements_ * sizeDataAtBaseLayer_);
             }
-            input.read(dataBaseLayer_, maxElements_ * sizeDataAtBaseLayer_);
 
             uint64_t upper_marker_check;
             readBinaryPOD(input, upper_marker_check);
@@ -442,62 +1132,179 @@ namespace hnswlib {
                 throw std::runtime_error(
                         "Corrupt index file: dataUpperLayer_ marker missing or mismatched");
             }
-            labelLookup_.resize(maxElements_, INVALID_ID);
-            for(size_t i = 0; i < curElementsCount_; i++) {
-                idInt label = getExternalLabel(i);
-                if(label >= maxElements_) {
-                    // Oops.. The index is corrupted
-                    LOG_DEBUG("Corrupt index: label "
-                              << label << " at i=" << i
-                              << " exceeds maxElements_ = " << maxElements_);
-                    throw std::runtime_error("Corrupt index: label " + std::to_string(label)
-                                             + " at i=" + std::to_string(i)
-                                             + " exceeds maxElements_ = "
-                                             + std::to_string(maxElements_));
+            dataUpperLayer_.resize(maxElements_);
+            if(flags_ & FLAG_MAPPABLE) {
+                uint64_t block_count;
+                uint64_t stream_end;
+                readBinaryPOD(input, block_count);
+                readBinaryPOD(input, stream_end);
+                if(mapped) {
+                    mapUpperBlocks(input, file.fd, block_count, stream_end);
+                } else {
+                    input.seekg(block_count * (sizeof(idhInt) + sizeof(uint64_t)), std::ios::cur);
                 }
-                labelLookup_[label] = i;
-                //labelLookup_[getExternalLabel(i)] = i;
             }
-
-            dataUpperLayer_.resize(maxElements_);
-            while(true) {
+            bool upper_int8 =
+                    use_hybrid || quant_level_ == ndd::quant::QuantizationLevel::INT8;
+            bool legacy_int8 = version == LEGACY_INT8_INDEX_VERSION && upper_int8;
+            while(!mapped) {
                 idhInt id;
                 readBinaryPOD(input, id);
                 if(id == INVALID_ID) {
                     break;
                 }
+                dataUpperLayer_[id] = readUpperBlock(input, legacy_int8);
+            }
 
-                size_t header_size;
-                // Step 1: Read vector + level header
-                header_size = data_size_upper_ + sizeof(levelInt);
-
-                std::vector<uint8_t> header_buf(header_size);
-                input.read(reinterpret_cast<char*>(header_buf.data()), header_size);
+            if(flags_ & FLAG_VECTOR_ARENA) {
+                uint64_t arena_marker_check;
+                readBinaryPOD(input, arena_marker_check);
+                if(arena_marker_check != VECTOR_ARENA_MARKER) {
+                    LOG_DEBUG("Corrupt index file: vector arena marker missing or mismatched");
+                    throw std::runtime_error(
+                            "Corrupt index file: vector arena marker missing or mismatched");
+                }
+                size_t stored_slot_size;
+                readBinaryPOD(input, stored_slot_size);
+                sizeVectorSlot_ = vectorSlotSize();
+                if(stored_slot_size != sizeVectorSlot_) {
+                    throw std::runtime_error("Corrupt index file: vector arena stride mismatch");
+                }
+                if(flags_ & FLAG_MAPPABLE) {
+                    input.seekg(arenaPadding(input.tellg()), std::ios::cur);
+                }
+                size_t length = curElementsCount_ * sizeVectorSlot_;
+                if(mapped) {
+                    size_t offset = input.tellg();
+                    dataVectors_ =
+                            mapRegion(file.fd, offset, length, maxElements_ * sizeVectorSlot_);
+                    input.seekg(offset + length);
+                } else {
+                    // Owned here until the read succeeds, the destructor does not run on throw
+                    std::unique_ptr<char, decltype(&free)> arena(
+                            allocateVectorArena(maxElements_), &free);
+                    input.read(arena.get(), length);
+                    if(!input) {
+                        throw std::runtime_error("Failed to read vector arena");
+                    }
+                    dataVectors_ = arena.release();
+                }
                 if(!input) {
-                    throw std::runtime_error("Failed to read upper layer header");
+                    throw std::runtime_error("Failed to read vector arena");
                 }
+            }
 
-                levelInt level;
-                level = *reinterpret_cast<levelInt*>(header_buf.data() + data_size_upper_);
-
-                size_t total_size = header_size + level * sizeLinksUpperLayers_;
-
-                // Step 2: Allocate and copy header
-                auto mem = std::make_unique<uint8_t[]>(total_size);
-                memcpy(mem.get(), header_buf.data(), header_size);
+            if(flags_ & FLAG_REORDERED) {
+                uint64_t reorder_marker_check;
+                readBinaryPOD(input, reorder_marker_check);
+                if(reorder_marker_check != REORDER_MARKER) {
+                    LOG_DEBUG("Corrupt index file: reorder marker missing or mismatched");
+                    throw std::runtime_error(
+                            "Corrupt index file: reorder marker missing or mismatched");
+                }
+                readBinaryPOD(input, reorderedCount_);
+            }
 
-                // Step 3: Read linklists
-                input.read(reinterpret_cast<char*>(mem.get() + header_size),
-                           level * sizeLinksUpperLayers_);
+            freeSlots_.clear();
+            if(flags_ & FLAG_FREE_SLOTS) {
+                uint64_t free_marker_check;
+                readBinaryPOD(input, free_marker_check);
+                if(free_marker_check != FREE_SLOTS_MARKER) {
+                    LOG_DEBUG("Corrupt index file: free slots marker missing or mismatched");
+                    throw std::runtime_error(
+                            "Corrupt index file: free slots marker missing or mismatched");
+                }
+                size_t free_count;
+                readBinaryPOD(input, free_count);
+                if(!input || free_count > curElementsCount_) {
+                    throw std::runtime_error("Corrupt index file: free slot count out of range");
+                }
+                freeSlots_.resize(free_count);
+                input.read(reinterpret_cast<char*>(freeSlots_.data()),
+                           free_count * sizeof(idhInt));
                 if(!input) {
-                    throw std::runtime_error("Failed to read upper layer linklists");
+                    throw std::runtime_error("Failed to read free slots");
                 }
+                validateFreeSlots("Corrupt index file");
+            }
 
-                dataUpperLayer_[id] = std::move(mem);
+            // Files written before checkpoint ids get a full checkpoint first
+            checkpointId_ = 0;
+            fullCheckpointNeeded_ = true;
+            if(flags_ & FLAG_CHECKPOINT_ID) {
+                uint64_t checkpoint_marker_check;
+                readBinaryPOD(input, checkpoint_marker_check);
+                if(checkpoint_marker_check != CHECKPOINT_ID_MARKER) {
+                    LOG_DEBUG("Corrupt index file: checkpoint id marker missing or mismatched");
+                    throw std::runtime_error(
+                            "Corrupt index file: checkpoint id marker missing or mismatched");
+                }
+                readBinaryPOD(input, checkpointId_);
+                fullCheckpointNeeded_ = false;
             }
 
+            bool labels_loaded = false;
+            if(flags_ & FLAG_MAPPABLE) {
+                uint64_t label_marker_check;
+                readBinaryPOD(input, label_marker_check);
+                if(label_marker_check != LABEL_LOOKUP_MARKER) {
+                    LOG_DEBUG("Corrupt index file: label lookup marker missing or mismatched");
+                    throw std::runtime_error(
+                            "Corrupt index file: label lookup marker missing or mismatched");
+                }
+                size_t label_count;
+                readBinaryPOD(input, label_count);
+                // Rebuilt below when the index was loaded with a new size
+                if(label_count == maxElements_) {
+                    labelLookup_.resize(label_count);
+                    input.read(reinterpret_cast<char*>(labelLookup_.data()),
+                               label_count * sizeof(idhInt));
+                    if(!input) {
+                        throw std::runtime_error("Failed to read label lookup");
+                    }
+                    labels_loaded = true;
+                }
+            }
             input.close();
 
+            std::vector<idhInt> delta_slots = applyDeltas(location);
+            resetDirtyTracking();
+            freeCount_ = freeSlots_.size();
+
+            // Free slots keep the label they had, which may belong to a live slot by now
+            std::vector<bool> free_slot(curElementsCount_, false);
+            for(idhInt id : freeSlots_) {
+                free_slot[id] = true;
+            }
+            labelLookup_.resize(maxElements_, INVALID_ID);
+            auto lookup_label = [&](size_t i) {
+                if(i >= curElementsCount_ || free_slot[i]) {
+                    return;
+                }
+                idInt label = getExternalLabel(i);
+                if(label >= maxElements_) {
+                    // Oops.. The index is corrupted
+                    LOG_DEBUG("Corrupt index: label "
+                              << label << " at i=" << i
+                              << " exceeds maxElements_ = " << maxElements_);
+                    throw std::runtime_error("Corrupt index: label " + std::to_string(label)
+                                             + " at i=" + std::to_string(i)
+                                             + " exceeds maxElements_ = "
+                                             + std::to_string(maxElements_));
+                }
+                labelLookup_[label] = i;
+            };
+            if(labels_loaded) {
+                // The table only misses the labels the deltas added
+                for(idhInt i : delta_slots) {
+                    lookup_label(i);
+                }
+            } else {
+                for(size_t i = 0; i < curElementsCount_; i++) {
+                    lookup_label(i);
+                }
+            }
+
             visited_list_pool_ =
                     std::unique_ptr<VisitedListPool>(new VisitedListPool(1, maxElements_));
             if(visited_list_pool_ == nullptr) {
@@ -521,23 +1328,16 @@ namespace hnswlib {
             std::vector<uint8_t> datapoint_upper = getUpperLayerRepresentation(datapoint);
 
             //std::shared_lock<std::shared_mutex> lock(index_lock_);
+            // Labels index labelLookup_, which only grows with the index when it is saved
+            if(label >= labelLookup_.size()) {
+                throw std::runtime_error("Label " + std::to_string(label)
+                                         + " exceeds the index capacity of "
+                                         + std::to_string(labelLookup_.size()));
+            }
             idhInt cur_c = 0;
             levelInt curLevel = 0;
-            if(is_new) {
-                // Adding a new point
-                // Using fetch_add (or post-increment) ensures unique IDs even under contention.
-                cur_c = curElementsCount_.fetch_add(1);
-
-                if(cur_c >= maxElements_) {
-                    // Restore count if we exceeded limit (optional, but good for correctness)
-                    curElementsCount_--;
-                    throw std::runtime_error("The number of elements exceeds the specified limit");
-                }
-
-                labelLookup_[label] = cur_c;
-                setExternalLabel(cur_c, label);
-                curLevel = getRandomLevel(mult_);
-            } else {
+            bool update = false;
+            if(!is_new) {
                 idhInt searchId = labelLookup_[label];
                 if(searchId != INVALID_ID) {
                     // If the element is deleted, mark is undeleted first before calling update
@@ -548,11 +1348,33 @@ namespace hnswlib {
                     curLevel = getElementLevel(searchId);
                     removeAllConnections(searchId, curLevel);
                     cur_c = searchId;
+                    update = true;
                 } else {
-                    LOG_DEBUG("Label not found, can't update the point" << label);
-                    return;
+                    // vacuum() reclaimed the slot of the label, add the point back as new
+                    LOG_DEBUG("Label not found, adding the point as new " << label);
                 }
             }
+            bool reused_slot = false;
+            if(!update) {
+                // Adding a new point, in a slot reclaimed by vacuum() if there is one
+                reused_slot = takeFreeSlot(cur_c);
+                if(!reused_slot) {
+                    // Using fetch_add (or post-increment) ensures unique IDs even under
+                    // contention.
+                    cur_c = curElementsCount_.fetch_add(1);
+
+                    if(cur_c >= maxElements_) {
+                        // Restore count if we exceeded limit (optional, but good for correctness)
+                        curElementsCount_--;
+                        throw std::runtime_error(
+                                "The number of elements exceeds the specified limit");
+                    }
+                }
+
+                labelLookup_[label] = cur_c;
+                setExternalLabel(cur_c, label);
+                curLevel = getRandomLevel(mult_);
+            }
             // TODO - Check this ..is it thread safe to comment this
             // std::unique_lock <std::shared_mutex> lock_el(getLinkListMutex(cur_c));
 
@@ -567,6 +1389,16 @@ namespace hnswlib {
                 char* linklist = get_linklist0(cur_c);
                 memset(linklist, 0, sizeLinksBaseLayer_);
             }
+            markBaseDirty(cur_c);
+
+            // Keep the level 0 vector arena in sync before the point becomes reachable
+            if(dataVectors_) {
+                char* slot = dataVectors_ + cur_c * sizeVectorSlot_;
+                memcpy(slot, datapoint, data_size_);
+                // Zero the padding so that saved files do not depend on what the slot held
+                memset(slot + data_size_, 0, sizeVectorSlot_ - data_size_);
+                markDirty(dirtyArena_, cur_c);
+            }
 
             // Create data in upper levels
             size_t total_size;
@@ -584,10 +1416,11 @@ namespace hnswlib {
                        0,
                        curLevel * sizeLinksUpperLayers_);
 
-                dataUpperLayer_[cur_c] = std::move(mem);
+                setUpperBlock(cur_c, std::move(mem));
+                markDirty(dirtyUpper_, cur_c);
             }
 
-            if(cur_c != 0) {
+            if(cur_c != 0 || reused_slot) {
 
                 levelInt maxlevelcopy = maxLevel_;
 
@@ -597,7 +1430,7 @@ namespace hnswlib {
 
                 // Traverse to find closest neighbors at each level
                 // Greedy search till the current level
-                for(int level = maxlevelcopy; level > curLevel; level--) {
+                for(levelInt level = maxlevelcopy; level > curLevel; level--) {
                     bool changed = true;
                     while(changed) {
                         changed = false;
@@ -638,6 +1471,9 @@ namespace hnswlib {
                     }
                 }
 
+                // Level 0 vectors are read through one pinned view for the whole insert
+                std::unique_ptr<VectorView> view = openVectorView();
+
                 // Add connections from curLevel down to 0
                 for(int level = std::min(curLevel, maxlevelcopy); level >= 0; level--) {
                     std::vector<std::pair<dist_t, idhInt>> sorted_candidates;
@@ -646,13 +1482,13 @@ namespace hnswlib {
                     
                     if(deletedElementsCount_) {
                         sorted_candidates = searchBaseLayer<true, true>(
-                                currObj, level_datapoint, level, efConstruction_);
+                                currObj, level_datapoint, level, efConstruction_, view.get());
                     } else {  // No deleted elements
                         sorted_candidates = searchBaseLayer<true, false>(
-                                currObj, level_datapoint, level, efConstruction_);
+                                currObj, level_datapoint, level, efConstruction_, view.get());
                     }
                     currObj = mutuallyConnectNewElement(
-                            level_datapoint, cur_c, sorted_candidates, level);
+                            level_datapoint, cur_c, sorted_candidates, level, view.get());
                 }
 
                 if (has_higher_level) {
@@ -687,15 +1523,32 @@ namespace hnswlib {
             // Reset and reallocate visited list pool with new size
             visited_list_pool_.reset(new VisitedListPool(1, new_max_elements));
 
-            // Reallocate base layer (dataBaseLayer_)
-            char* dataBaseLayer_new =
-                    (char*)realloc(dataBaseLayer_, new_max_elements * sizeDataAtBaseLayer_);
+            // Reallocate base layer (dataBaseLayer_). A mapped one is copied to the heap
+            char* dataBaseLayer_new = nullptr;
+            if(isMapped(dataBaseLayer_)) {
+                dataBaseLayer_new = (char*)malloc(new_max_elements * sizeDataAtBaseLayer_);
+                if(dataBaseLayer_new) {
+                    memcpy(dataBaseLayer_new, dataBaseLayer_, maxElements_ * sizeDataAtBaseLayer_);
+                    releaseRegion(dataBaseLayer_);
+                }
+            } else {
+                dataBaseLayer_new =
+                        (char*)realloc(dataBaseLayer_, new_max_elements * sizeDataAtBaseLayer_);
+            }
             if(dataBaseLayer_new == nullptr) {
                 throw std::runtime_error(
                         "Not enough memory: resizeIndex failed to allocate base layer");
             }
             dataBaseLayer_ = dataBaseLayer_new;
 
+            // Reallocate level 0 vector arena. aligned_alloc has no realloc counterpart
+            if(dataVectors_) {
+                char* dataVectors_new = allocateVectorArena(new_max_elements);
+                memcpy(dataVectors_new, dataVectors_, curElementsCount_ * sizeVectorSlot_);
+                releaseRegion(dataVectors_);
+                dataVectors_ = dataVectors_new;
+            }
+
             // Reallocate upper layer (dataUpperLayer_)
             dataUpperLayer_.resize(new_max_elements);
 
@@ -704,12 +1557,234 @@ namespace hnswlib {
 
             // Update maxElements_ count
             maxElements_ = new_max_elements;
+            // The index file changes size, deltas cannot extend it
+            resetDirtyTracking();
+            fullCheckpointNeeded_ = true;
+        }
+
+        // Build the in-memory level 0 vector arena from the vector fetcher.
+        // Once enabled, the arena is persisted with the index and level 0 distance
+        // computations no longer go through the fetcher.
+        void enableVectorArena() {
+            std::unique_lock<std::shared_mutex> lock(index_lock_);
+            if(dataVectors_) {
+                return;
+            }
+            if(!vector_fetcher_) {
+                throw std::runtime_error("Vector fetcher must be set before enabling vector arena");
+            }
+
+            char* arena = allocateVectorArena(maxElements_);
+            for(size_t i = 0; i < curElementsCount_; i++) {
+                uint8_t* slot = reinterpret_cast<uint8_t*>(arena + i * sizeVectorSlot_);
+                memset(slot, 0, sizeVectorSlot_);
+                // Deleted points may not be in the vector store anymore
+                if(!vector_fetcher_(getExternalLabel(i), slot)) {
+                    memset(slot, 0, sizeVectorSlot_);
+                }
+            }
+            dataVectors_ = arena;
+            flags_ |= FLAG_VECTOR_ARENA;
+            resetDirtyTracking();
+            fullCheckpointNeeded_ = true;
+            LOG_INFO("Vector arena enabled: " << curElementsCount_ << " vectors, "
+                                              << (maxElements_ * sizeVectorSlot_) / MB << " MB");
+        }
+
+        // Renumbers internal ids breadth first from the entry point over level 0, so that
+        // neighbors sit close together in the base layer, the vector arena and the upper
+        // layer table and a search touches fewer cache lines and pages. Elements the walk does
+        // not reach keep their relative order after it. Points added later are appended as
+        // usual, calling it again folds them in. Returns the number of reordered elements
+        size_t reorderGraph() {
+            std::unique_lock<std::shared_mutex> lock(index_lock_);
+            std::unique_lock<std::shared_mutex> layout_lock(layout_lock_);
+            size_t count = curElementsCount_;
+            if(count < 2) {
+                return count;
+            }
+
+            // order[new id] = old id
+            std::vector<idhInt> order;
+            order.reserve(count);
+            std::vector<idhInt> new_ids(count, INVALID_ID);
+            auto visit = [&](idhInt old_id) {
+                new_ids[old_id] = static_cast<idhInt>(order.size());
+                order.push_back(old_id);
+            };
+            visit(entryPoint_);
+            size_t next_root = 0;
+            for(size_t head = 0; order.size() < count; head++) {
+                if(head == order.size()) {
+                    while(new_ids[next_root] != INVALID_ID) {
+                        next_root++;
+                    }
+                    visit(static_cast<idhInt>(next_root));
+                }
+                idhInt* ll = (idhInt*)get_linklist0(order[head]);
+                idhInt size = getListCount(ll);
+                for(idhInt i = 1; i <= size; i++) {
+                    if(ll[i] < count && new_ids[ll[i]] == INVALID_ID) {
+                        visit(ll[i]);
+                    }
+                }
+            }
+
+            // Zeroed like a fresh allocation, addPoint relies on the flags of unused slots
+            char* base_new = (char*)calloc(maxElements_, sizeDataAtBaseLayer_);
+            if(!base_new) {
+                throw std::runtime_error("Not enough memory: reorderGraph failed to allocate "
+                                         "base layer");
+            }
+            char* vectors_new = dataVectors_ ? allocateVectorArena(maxElements_) : nullptr;
+            for(size_t n = 0; n < count; n++) {
+                char* block = base_new + n * sizeDataAtBaseLayer_;
+                memcpy(block, get_linklist0(order[n]), sizeDataAtBaseLayer_);
+                remapLinks((idhInt*)block, new_ids);
+                if(vectors_new) {
+                    memcpy(vectors_new + n * sizeVectorSlot_,
+                           dataVectors_ + order[n] * sizeVectorSlot_,
+                           sizeVectorSlot_);
+                }
+            }
+            releaseRegion(dataBaseLayer_);
+            dataBaseLayer_ = base_new;
+            if(vectors_new) {
+                releaseRegion(dataVectors_);
+                dataVectors_ = vectors_new;
+            }
+
+            std::vector<std::unique_ptr<uint8_t[]>> upper_new(dataUpperLayer_.size());
+            for(size_t n = 0; n < count; n++) {
+                upper_new[n] = std::move(dataUpperLayer_[order[n]]);
+            }
+            dataUpperLayer_ = std::move(upper_new);
+            for(size_t n = 0; n < count; n++) {
+                levelInt level = getElementLevel(n);
+                for(levelInt l = 1; l <= level; l++) {
+                    remapLinks((idhInt*)get_linklist(n, l), new_ids);
+                }
+            }
+
+            // Free slots are never reached, they stay behind the graph with their old labels
+            std::vector<bool> free_slot(count, false);
+            for(idhInt& id : freeSlots_) {
+                id = new_ids[id];
+                free_slot[id] = true;
+            }
+            for(size_t n = 0; n < count; n++) {
+                if(!free_slot[n]) {
+                    labelLookup_[getExternalLabel(n)] = n;
+                }
+            }
+
+            entryPoint_ = new_ids[entryPoint_];
+            reorderedCount_ = count;
+            flags_ |= FLAG_REORDERED;
+            fullCheckpointNeeded_ = true;
+            LOG_INFO("Reordered " << count << " elements in graph order");
+            return count;
+        }
+
+        // Unlinks deleted elements and hands their slots to addPoint. Every live element that
+        // links to one is given new neighbors by the insert heuristic, picked among its other
+        // neighbors and the live elements reachable through its deleted ones. Searches keep
+        // running while links are repaired and are held off only while the slots are freed.
+        // Inserts and deletes must not run concurrently. Returns the number of freed slots
+        size_t vacuum() {
+            std::unique_lock<std::shared_mutex> lock(index_lock_);
+            size_t count = curElementsCount_;
+            if(deletedElementsCount_ == 0) {
+                return 0;
+            }
+
+            std::vector<bool> free_slot(count, false);
+            {
+                std::lock_guard<std::mutex> free_lock(freeSlotsLock_);
+                for(idhInt id : freeSlots_) {
+                    free_slot[id] = true;
+                }
+            }
+            std::vector<idhInt> tombstones;
+            std::vector<bool> dead(count, false);
+            idhInt new_entry = INVALID_ID;
+            levelInt new_max_level = 0;
+            for(size_t id = 0; id < count; id++) {
+                if(free_slot[id]) {
+                    continue;
+                }
+                if(isMarkedDeleted(id)) {
+                    tombstones.push_back(id);
+                    dead[id] = true;
+                } else if(new_entry == INVALID_ID || getElementLevel(id) > new_max_level) {
+                    new_entry = id;
+                    new_max_level = getElementLevel(id);
+                }
+            }
+            if(new_entry == INVALID_ID) {
+                // Nothing left to link the graph through
+                return 0;
+            }
+
+            std::unique_ptr<VectorView> view = openVectorView();
+            std::vector<uint8_t> self_buf(data_size_);
+            std::vector<uint8_t> cand_buf(data_size_);
+            for(size_t id = 0; id < count; id++) {
+                if(free_slot[id] || dead[id]) {
+                    continue;
+                }
+                levelInt elem_level = getElementLevel(id);
+                for(levelInt level = 0; level <= elem_level; level++) {
+                    repairLinks(id, level, dead, view.get(), self_buf.data(), cand_buf.data());
+                }
+            }
+
+            // No live element links to a tombstone anymore. Searches that already hold one
+            // finish before the slots change hands
+            std::unique_lock<std::shared_mutex> layout_lock(layout_lock_);
+            std::lock_guard<std::mutex> free_lock(freeSlotsLock_);
+            for(idhInt id : tombstones) {
+                levelInt elem_level = getElementLevel(id);
+                for(levelInt level = 0; level <= elem_level; level++) {
+                    setListCount((idhInt*)get_linklist(id, level), 0);
+                }
+                setUpperBlock(id, nullptr);
+                idInt label = getExternalLabel(id);
+                if(labelLookup_[label] == id) {
+                    labelLookup_[label] = INVALID_ID;
+                }
+                // The delete mark stays until the slot is reused
+                freeSlots_.push_back(id);
+            }
+            freeCount_ += tombstones.size();
+            deletedElementsCount_ -= tombstones.size();
+            entryPoint_ = new_entry;
+            maxLevel_ = new_max_level;
+            // Deltas cannot drop the upper layer blocks of the freed slots
+            fullCheckpointNeeded_ = true;
+            LOG_INFO("Vacuum freed " << tombstones.size() << " slots");
+            return tombstones.size();
         }
 
     private:
         // Invalid id for the label
         static constexpr idhInt INVALID_ID = static_cast<idhInt>(-1);
         static const unsigned char DELETE_MARK = 0x01;
+        // Bits of flags_ (persisted in the index header)
+        static constexpr uint64_t FLAG_VECTOR_ARENA = 0x01;
+        static constexpr uint64_t FLAG_REORDERED = 0x02;
+        static constexpr uint64_t FLAG_FREE_SLOTS = 0x04;
+        static constexpr uint64_t FLAG_CHECKPOINT_ID = 0x08;
+        // Upper layer block offsets, an aligned vector arena and the label lookup table, so
+        // that the file can be mapped
+        static constexpr uint64_t FLAG_MAPPABLE = 0x10;
+        static constexpr uint64_t VECTOR_ARENA_MARKER = 0xFEEDFACEFEEDFACE;
+        static constexpr uint64_t REORDER_MARKER = 0x0DDBA11C0DDBA11C;
+        static constexpr uint64_t FREE_SLOTS_MARKER = 0xF4EE5107F4EE5107;
+        static constexpr uint64_t CHECKPOINT_ID_MARKER = 0xC4EC4D01C4EC4D01;
+        static constexpr uint64_t LABEL_LOOKUP_MARKER = 0x1ABE110C1ABE110C;
+        // Last index version whose INT8 vectors were stored without their squared norm
+        static constexpr uint16_t LEGACY_INT8_INDEX_VERSION = 1;
         // TODO - We need to pass indexId in the constructor.
         // This may be helpful for logs
         std::string indexId_;
@@ -730,7 +1805,10 @@ namespace hnswlib {
         size_t dimension_;
 
         VectorFetcher vector_fetcher_;
+        VectorViewFactory vector_view_factory_;
         mutable std::shared_mutex index_lock_;
+        // Held by searches, and exclusively by reorderGraph() while it moves every element
+        mutable std::shared_mutex layout_lock_;
 
         size_t maxElements_{0};
         mutable std::atomic<size_t> curElementsCount_{0};
@@ -759,21 +1837,59 @@ namespace hnswlib {
         // is not fixed. So we use a vector of unique_ptrs to store the list
         // Structure: vector_data + level (unint32_t) + [idInt + linklist]
         std::vector<std::unique_ptr<uint8_t[]>> dataUpperLayer_;
+        // Optional level 0 vectors addressed by internal id. Each slot holds data_size_
+        // bytes and is padded to sizeVectorSlot_ so that every vector is cache line aligned
+        char* dataVectors_{nullptr};
+        size_t sizeVectorSlot_{0};
+        // Regions of the index file mapped by loadIndex, as address and length
+        std::vector<std::pair<char*, size_t>> mappings_;
+        size_t reorderedCount_{0};
 
         // This will vary based on fp16 or fp32
         size_t data_size_{0};
         DISTFUNC<dist_t> fstDistFunc_;
         SIMFUNC<dist_t> fstSimFunc_;
+        SIMBATCHFUNC<dist_t> fstSimBatchFunc_;
+        SIMBATCHFUNC<dist_t> fstSimErrorBatchFunc_{nullptr};
+        SIMFUNC<dist_t> fstQuerySimFunc_{nullptr};
+        SIMBATCHFUNC<dist_t> fstQuerySimBatchFunc_{nullptr};
+        SIMBOUNDEDBATCHFUNC<dist_t> fstQuerySimBoundedBatchFunc_{nullptr};
         void* dist_func_param_{nullptr};
 
         // Unified upper layer data parameters
         size_t data_size_upper_{0};
         SIMFUNC<dist_t> fstSimFuncUpper_;
+        SIMBATCHFUNC<dist_t> fstSimBatchFuncUpper_;
+        SIMBATCHFUNC<dist_t> fstSimErrorBatchFuncUpper_{nullptr};
+        SIMFUNC<dist_t> fstQuerySimFuncUpper_{nullptr};
+        SIMBATCHFUNC<dist_t> fstQuerySimBatchFuncUpper_{nullptr};
+        SIMBOUNDEDBATCHFUNC<dist_t> fstQuerySimBoundedBatchFuncUpper_{nullptr};
         void* dist_func_param_upper_{nullptr};
 
+        // Referenced by both DistParams, nullptr until a trained level index is trained
+        std::shared_ptr<const void> codebook_;
+        std::atomic<bool> has_codebook_{false};
+
         // Maps external label to internal id
         std::vector<idhInt> labelLookup_;
 
+        // Slots of deleted elements unlinked by vacuum(), reused by addPoint
+        std::vector<idhInt> freeSlots_;
+        std::mutex freeSlotsLock_;
+        std::atomic<size_t> freeCount_{0};
+
+        // Elements changed since the last snapshot or save, one bit per internal id for the
+        // base layer slot, the vector arena slot and the upper layer block
+        std::vector<std::atomic<uint64_t>> dirtyBase_;
+        std::vector<std::atomic<uint64_t>> dirtyArena_;
+        std::vector<std::atomic<uint64_t>> dirtyUpper_;
+        // Id of the last full index file, the deltas written after it carry it
+        uint64_t checkpointId_{0};
+        // Size of the deltas written since the last full index file
+        size_t deltaBytes_{0};
+        // Set by changes that deltas do not cover, until the next full snapshot or save
+        std::atomic<bool> fullCheckpointNeeded_{true};
+
         std::default_random_engine level_generator_;
         std::default_random_engine update_probability_generator_;
 
@@ -789,6 +1905,7 @@ namespace hnswlib {
                     reinterpret_cast<flagInt*>(get_linklist0(internal_id) + sizeLinksBaseLayer_);
             *flags |= DELETE_MARK;
             deletedElementsCount_++;
+            markBaseDirty(internal_id);
         }
 
         void unmarkDeletedInternal(idhInt internal_id) {
@@ -796,6 +1913,7 @@ namespace hnswlib {
                     reinterpret_cast<flagInt*>(get_linklist0(internal_id) + sizeLinksBaseLayer_);
             *flags &= ~DELETE_MARK;
             deletedElementsCount_--;
+            markBaseDirty(internal_id);
         }
 
         // Generate level for a new point
@@ -812,9 +1930,85 @@ namespace hnswlib {
             return dataUpperLayer_[internal_id].get();
         }
 
+        size_t vectorSlotSize() const {
+            return (data_size_ + settings::VECTOR_ARENA_ALIGNMENT - 1)
+                   & ~(settings::VECTOR_ARENA_ALIGNMENT - 1);
+        }
+
+        char* allocateVectorArena(size_t max_elements) {
+            sizeVectorSlot_ = vectorSlotSize();
+            // aligned_alloc needs the size to be a multiple of the alignment
+            char* arena = (char*)aligned_alloc(settings::VECTOR_ARENA_ALIGNMENT,
+                                               std::max<size_t>(max_elements, 1) * sizeVectorSlot_);
+            if(!arena) {
+                throw std::runtime_error("Unable to allocate vector arena of "
+                                         + std::to_string((max_elements * sizeVectorSlot_) / KB)
+                                         + " KB");
+            }
+            return arena;
+        }
+
+        // Opens a zero-copy view for level 0 access. Not needed when the vector arena is
+        // enabled or no view factory is set, in which case nullptr is returned.
+        std::unique_ptr<VectorView> openVectorView() const {
+            if(dataVectors_ || !vector_view_factory_) {
+                return nullptr;
+            }
+            return vector_view_factory_();
+        }
+
+        // Returns the level 0 vector of an element. Points into the vector arena when it is
+        // enabled, then into the pinned view if one is given, otherwise the vector is fetched
+        // into buffer. Returns nullptr on failure.
+        inline const uint8_t* getBaseLayerDataPtr(idhInt internal_id,
+                                                  uint8_t* buffer,
+                                                  const VectorView* view = nullptr) const {
+            if(dataVectors_) {
+                return reinterpret_cast<const uint8_t*>(dataVectors_
+                                                        + internal_id * sizeVectorSlot_);
+            }
+            if(view) {
+                return view->getVector(getExternalLabel(internal_id));
+            }
+            if(vector_fetcher_ && vector_fetcher_(getExternalLabel(internal_id), buffer)) {
+                return buffer;
+            }
+            return nullptr;
+        }
+
+        // Hints the cache lines searchBaseLayer touches for an element: its level 0 link
+        // list and flags, or its upper layer block, and the leading lines of its vector
+        inline void prefetchElement(idhInt internal_id, levelInt layer) const {
+            const char* vector_data = nullptr;
+            size_t vector_size = 0;
+            if(layer == 0) {
+                const char* linklist = get_linklist0(internal_id);
+                __builtin_prefetch(linklist);
+                __builtin_prefetch(linklist + sizeLinksBaseLayer_);
+                if(dataVectors_) {
+                    vector_data = dataVectors_ + internal_id * sizeVectorSlot_;
+                    vector_size = data_size_;
+                }
+            } else {
+                vector_data = reinterpret_cast<const char*>(dataUpperLayer_[internal_id].get());
+                vector_size = data_size_upper_;
+            }
+            if(!vector_data) {
+                return;
+            }
+            size_t lines = std::min(settings::PREFETCH_VECTOR_LINES, (vector_size + 63) / 64);
+            for(size_t i = 0; i < lines; i++) {
+                __builtin_prefetch(vector_data + i * 64);
+            }
+        }
+
         // Modified function returning bool and filling buffer
         bool getDataByInternalId(idhInt internal_id, levelInt layer, uint8_t* buffer) const {
             if(layer == 0) {
+                if(dataVectors_) {
+                    memcpy(buffer, dataVectors_ + internal_id * sizeVectorSlot_, data_size_);
+                    return true;
+                }
                 idInt external_label = getExternalLabel(internal_id);
                 if(vector_fetcher_) {
                     // Directly fetch to buffer
@@ -850,8 +2044,238 @@ namespace hnswlib {
         }
         inline idhInt getListCount(idhInt* ptr) const { return *ptr; }
 
+        // Pops a slot freed by vacuum(). Its delete mark is cleared here, it was never counted
+        // in deletedElementsCount_ while free
+        bool takeFreeSlot(idhInt& slot) {
+            std::lock_guard<std::mutex> lock(freeSlotsLock_);
+            if(freeSlots_.empty()) {
+                return false;
+            }
+            slot = freeSlots_.back();
+            freeSlots_.pop_back();
+            freeCount_--;
+            flagInt* flags = reinterpret_cast<flagInt*>(get_linklist0(slot) + sizeLinksBaseLayer_);
+            *flags = 0;
+            return true;
+        }
+
+        // Replaces the links of a live element to deleted ones at a level. The live elements
+        // reachable through the deleted ones join its remaining neighbors as candidates and
+        // the insert heuristic keeps the best of them
+        void repairLinks(idhInt id,
+                         levelInt level,
+                         const std::vector<bool>& dead,
+                         const VectorView* view,
+                         uint8_t* self_buf,
+                         uint8_t* cand_buf) {
+            idhInt* ll = (idhInt*)get_linklist(id, level);
+            idhInt size = getListCount(ll);
+            bool touches_dead = false;
+            for(idhInt i = 1; i <= size; i++) {
+                touches_dead |= ll[i] < dead.size() && dead[ll[i]];
+            }
+            if(!touches_dead) {
+                return;
+            }
+
+            // Live candidates, walking chains of deleted elements up to efConstruction_ of them
+            std::vector<idhInt> candidates;
+            std::vector<idhInt> pending;
+            std::unordered_set<idhInt> seen{id};
+            auto consider = [&](idhInt other) {
+                if(other >= dead.size() || !seen.insert(other).second) {
+                    return;
+                }
+                if(dead[other]) {
+                    pending.push_back(other);
+                } else {
+                    candidates.push_back(other);
+                }
+            };
+            for(idhInt i = 1; i <= size; i++) {
+                consider(ll[i]);
+            }
+            while(!pending.empty() && candidates.size() < efConstruction_) {
+                idhInt other = pending.back();
+                pending.pop_back();
+                if(level > getElementLevel(other)) {
+                    continue;
+                }
+                idhInt* ll_other = (idhInt*)get_linklist(other, level);
+                idhInt other_size = getListCount(ll_other);
+                for(idhInt i = 1; i <= other_size; i++) {
+                    consider(ll_other[i]);
+                }
+            }
+
+            auto curSimFunc = (level == 0) ? fstSimFunc_ : fstSimFuncUpper_;
+            auto curDistParam = (level == 0) ? dist_func_param_ : dist_func_param_upper_;
+            const void* self_vec = level == 0 ? getBaseLayerDataPtr(id, self_buf, view)
+                                              : getUpperLayerDataPtr(id);
+            std::vector<std::pair<dist_t, idhInt>> scored;
+            scored.reserve(candidates.size());
+            if(self_vec) {
+                for(idhInt other : candidates) {
+                    if(level > getElementLevel(other)) {
+                        continue;
+                    }
+                    const void* other_vec = level == 0
+                                                    ? getBaseLayerDataPtr(other, cand_buf, view)
+                                                    : getUpperLayerDataPtr(other);
+                    if(other_vec) {
+                        scored.emplace_back(curSimFunc(self_vec, other_vec, curDistParam),
+                                            other);
+                    }
+                }
+            }
+            std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) {
+                return a.first > b.first;
+            });
+            auto selected = getNeighborsByHeuristic2(scored, level ? M_ : M0_, level, view);
+
+            std::unique_lock<std::shared_mutex> list_lock(getLinkListMutex(id));
+            for(size_t i = 0; i < selected.size(); i++) {
+                ll[i + 1] = selected[i].second;
+            }
+            setListCount(ll, selected.size());
+            markLinksDirty(id, level);
+        }
+
+        // Rewrites the ids of a link list through an old id to new id table
+        void remapLinks(idhInt* ll, const std::vector<idhInt>& new_ids) const {
+            idhInt size = getListCount(ll);
+            for(idhInt i = 1; i <= size; i++) {
+                if(ll[i] < new_ids.size()) {
+                    ll[i] = new_ids[ll[i]];
+                }
+            }
+        }
+
         inline void setListCount(idhInt* ptr, idhInt size) const { *ptr = size; }
 
+        // Maps length bytes of the index file at offset, followed by zeroed memory up to
+        // capacity bytes. The mapping is private: pages are read from the file when first
+        // touched, or all up front with MMAP_POPULATE, and changes stay in memory. Index files
+        // are replaced by a rename and never rewritten in place, so the mapped file stays as it is
+        char* mapRegion(int fd, size_t offset, size_t length, size_t capacity) {
+            size_t lead = offset % sysconf(_SC_PAGESIZE);
+            size_t total = lead + std::max<size_t>(std::max(length, capacity), 1);
+            char* address = (char*)mmap(
+                    nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(address == MAP_FAILED) {
+                throw std::runtime_error("Unable to map " + std::to_string(total / KB)
+                                         + " KB: " + std::strerror(errno));
+            }
+            if(length > 0) {
+                int flags = MAP_PRIVATE | MAP_FIXED;
+                if(settings::MMAP_POPULATE) {
+                    flags |= MAP_POPULATE;
+                }
+                if(mmap(address, lead + length, PROT_READ | PROT_WRITE, flags, fd, offset - lead)
+                   == MAP_FAILED) {
+                    std::string err = std::strerror(errno);
+                    munmap(address, total);
+                    throw std::runtime_error("Unable to map index file: " + err);
+                }
+            }
+            mappings_.emplace_back(address, total);
+            return address + lead;
+        }
+
+        bool isMapped(const void* address) const {
+            for(const auto& [start, length] : mappings_) {
+                if(address >= start && address < start + length) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Frees memory from malloc, or unmaps it if it came from mapRegion()
+        void releaseRegion(char* address) {
+            for(auto it = mappings_.begin(); it != mappings_.end(); ++it) {
+                if(address >= it->first && address < it->first + it->second) {
+                    munmap(it->first, it->second);
+                    mappings_.erase(it);
+                    return;
+                }
+            }
+            free(address);
+        }
+
+        // Drops every pointer into a mapped region and unmaps them
+        void releaseMappings() {
+            if(mappings_.empty()) {
+                return;
+            }
+            for(auto& block : dataUpperLayer_) {
+                if(isMapped(block.get())) {
+                    block.release();
+                }
+            }
+            if(isMapped(dataBaseLayer_)) {
+                dataBaseLayer_ = nullptr;
+            }
+            if(isMapped(dataVectors_)) {
+                dataVectors_ = nullptr;
+            }
+            for(const auto& [address, length] : mappings_) {
+                munmap(address, length);
+            }
+            mappings_.clear();
+        }
+
+        // Replaces the upper layer block of an element. A block in a mapped region is not
+        // freed
+        void setUpperBlock(idhInt id, std::unique_ptr<uint8_t[]> block) {
+            if(isMapped(dataUpperLayer_[id].get())) {
+                dataUpperLayer_[id].release();
+            }
+            dataUpperLayer_[id] = std::move(block);
+        }
+
+        // Sizes the dirty bitmaps to maxElements_ with nothing marked
+        void resetDirtyTracking() {
+            size_t words = (maxElements_ + 63) / 64;
+            dirtyBase_ = std::vector<std::atomic<uint64_t>>(words);
+            dirtyArena_ = std::vector<std::atomic<uint64_t>>(dataVectors_ ? words : 0);
+            dirtyUpper_ = std::vector<std::atomic<uint64_t>>(words);
+        }
+
+        // Returns the marked bits and clears them
+        static std::vector<size_t> takeDirty(std::vector<std::atomic<uint64_t>>& dirty) {
+            std::vector<size_t> marked;
+            for(size_t w = 0; w < dirty.size(); w++) {
+                uint64_t bits = dirty[w].exchange(0, std::memory_order_relaxed);
+                while(bits) {
+                    marked.push_back(w * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                }
+            }
+            return marked;
+        }
+
+        // Inserts from many threads mark the same words, the load skips the atomic write
+        // when the bit is set already
+        static void markDirty(std::vector<std::atomic<uint64_t>>& dirty, size_t bit) {
+            std::atomic<uint64_t>& word = dirty[bit / 64];
+            uint64_t mask = uint64_t(1) << (bit % 64);
+            if(!(word.load(std::memory_order_relaxed) & mask)) {
+                word.fetch_or(mask, std::memory_order_relaxed);
+            }
+        }
+
+        // Level 0 links, flags and label of an element
+        void markBaseDirty(idhInt id) { markDirty(dirtyBase_, id); }
+
+        void markLinksDirty(idhInt id, levelInt level) {
+            if(level == 0) {
+                markBaseDirty(id);
+            } else {
+                markDirty(dirtyUpper_, id);
+            }
+        }
+
         idInt getExternalLabel(idhInt internal_id) const {
             idInt return_label;
             memcpy(&return_label,
@@ -879,7 +2303,8 @@ namespace hnswlib {
         std::vector<std::pair<dist_t, idhInt>>
         getNeighborsByHeuristic2(const std::vector<std::pair<dist_t, idhInt>>& candidates_sorted,
                                  size_t M,
-                                 levelInt level) {
+                                 levelInt level,
+                                 const VectorView* view = nullptr) {
             if(candidates_sorted.size() <= M) {
                 return candidates_sorted;
             }
@@ -902,9 +2327,7 @@ namespace hnswlib {
 
                 const void* cand_vec = nullptr;
                 if(level == 0) {
-                    if(getDataByInternalId(candidate.second, level, cand_buf.data())) {
-                        cand_vec = cand_buf.data();
-                    }
+                    cand_vec = getBaseLayerDataPtr(candidate.second, cand_buf.data(), view);
                 } else {
                     cand_vec = getUpperLayerDataPtr(candidate.second);
                 }
@@ -918,9 +2341,9 @@ namespace hnswlib {
                 for(const auto& selected : result) {
                     const void* selected_vec_ptr = nullptr;
                     if(level == 0) {
-                        if(getDataByInternalId(selected.second, level, selected_buf.data())) {
-                            selected_vec_ptr = selected_buf.data();
-                        }
+                        selected_vec_ptr = getBaseLayerDataPtr(selected.second,
+                                                               selected_buf.data(),
+                                                               view);
                     } else {
                         selected_vec_ptr = getUpperLayerDataPtr(selected.second);
                     }
@@ -951,7 +2374,8 @@ namespace hnswlib {
         mutuallyConnectNewElement(const void* data_point,
                                   idhInt cur_c,
                                   const std::vector<std::pair<dist_t, idhInt>>& sorted_candidates,
-                                  levelInt level) {
+                                  levelInt level,
+                                  const VectorView* view = nullptr) {
             LOG_TIME("mutuallyConnectNewElement");
 
             size_t curMaxM = level ? maxM_ : maxM0_;
@@ -962,7 +2386,7 @@ namespace hnswlib {
             auto curDistParam = (level == 0) ? dist_func_param_ : dist_func_param_upper_;
             size_t curDataSize = (level == 0) ? data_size_ : data_size_upper_;
 
-            auto selected = getNeighborsByHeuristic2(sorted_candidates, curM, level);
+            auto selected = getNeighborsByHeuristic2(sorted_candidates, curM, level, view);
             if(selected.empty()) {  // the graph is empty or disconnected
                 return 0;           // Or better handling
             }
@@ -979,6 +2403,7 @@ namespace hnswlib {
                     for(size_t idx = 0; idx < selected.size(); idx++) {
                         data[idx] = selected[idx].second;
                     }
+                    markLinksDirty(cur_c, level);
                 }
             }
 
@@ -998,6 +2423,7 @@ namespace hnswlib {
                 if(!ll_other) {
                     continue;
                 }
+                markLinksDirty(neighbor, level);
 
                 idhInt sz = getListCount(ll_other);
                 idhInt* data = (ll_other + 1);
@@ -1008,9 +2434,7 @@ namespace hnswlib {
                 } else {
                     const void* neighbor_data = nullptr;
                     if(level == 0) {
-                        if(getDataByInternalId(neighbor, level, neighbor_buf.data())) {
-                            neighbor_data = neighbor_buf.data();
-                        }
+                        neighbor_data = getBaseLayerDataPtr(neighbor, neighbor_buf.data(), view);
                     } else {
                         neighbor_data = getUpperLayerDataPtr(neighbor);
                     }
@@ -1029,9 +2453,8 @@ namespace hnswlib {
                         dist_t sim;
                         const void* other_neighbor_data = nullptr;
                         if(level == 0) {
-                            if(getDataByInternalId(data[j], level, data_buf.data())) {
-                                other_neighbor_data = data_buf.data();
-                            }
+                            other_neighbor_data =
+                                    getBaseLayerDataPtr(data[j], data_buf.data(), view);
                         } else {
                             other_neighbor_data = getUpperLayerDataPtr(data[j]);
                         }
@@ -1047,7 +2470,7 @@ namespace hnswlib {
                               all_candidates.end(),
                               [](const auto& a, const auto& b) { return a.first > b.first; });
 
-                    auto pruned = getNeighborsByHeuristic2(all_candidates, curM, level);
+                    auto pruned = getNeighborsByHeuristic2(all_candidates, curM, level, view);
                     for(size_t j = 0; j < pruned.size(); j++) {
                         data[j] = pruned[j].second;
                     }
@@ -1059,10 +2482,16 @@ namespace hnswlib {
         }
 
         // Search function for the base layer
-        // Returns a vector of top candidates sorted by similarity (1-distance) in reverse order
+        // Returns a vector of top candidates sorted by similarity (1-distance) in reverse order.
+        // With isIdAllowed set (layer 0 only) just the admitted labels are scored and returned.
         template <bool is_insert, bool has_deletions>
         std::vector<std::pair<dist_t, idhInt>>
-        searchBaseLayer(idhInt ep_id, const void* data_point, idhInt layer, size_t ef) const {
+        searchBaseLayer(idhInt ep_id,
+                        const void* data_point,
+                        idhInt layer,
+                        size_t ef,
+                        const VectorView* view = nullptr,
+                        BaseFilterFunctor* isIdAllowed = nullptr) const {
             LOG_TIME("searchBaseLayer");
             VisitedList* vl = visited_list_pool_->getFreeVisitedList();
             vl_type* visited_array = vl->mass;
@@ -1072,22 +2501,44 @@ namespace hnswlib {
             min_heap_pq top_candidates;
 
             // Generic awareness
-            auto curSimFunc = (layer == 0) ? fstSimFunc_ : fstSimFuncUpper_;
+            // Searches score a prepared query, inserts score a stored vector
+            auto curSimFunc = is_insert ? ((layer == 0) ? fstSimFunc_ : fstSimFuncUpper_)
+                                        : ((layer == 0) ? fstQuerySimFunc_ : fstQuerySimFuncUpper_);
+            auto curSimBatchFunc =
+                    is_insert ? ((layer == 0) ? fstSimBatchFunc_ : fstSimBatchFuncUpper_)
+                              : ((layer == 0) ? fstQuerySimBatchFunc_ : fstQuerySimBatchFuncUpper_);
+            auto curSimErrorBatchFunc =
+                    (layer == 0) ? fstSimErrorBatchFunc_ : fstSimErrorBatchFuncUpper_;
+            SIMBOUNDEDBATCHFUNC<dist_t> curSimBoundedBatchFunc = nullptr;
+            if(!is_insert) {
+                curSimBoundedBatchFunc = (layer == 0) ? fstQuerySimBoundedBatchFunc_
+                                                      : fstQuerySimBoundedBatchFuncUpper_;
+            }
             auto curDistParam = (layer == 0) ? dist_func_param_ : dist_func_param_upper_;
             size_t curDataSize = (layer == 0) ? data_size_ : data_size_upper_;
+
+            // Per expansion batch of unvisited neighbors. Fetched vectors need a buffer each
+            // because the whole batch is scored at once.
+            size_t maxBatch = std::max(maxM0_, maxM_);
+            std::vector<idhInt> batch_ids(maxBatch);
+            std::vector<const void*> batch_vectors(maxBatch);
+            std::vector<dist_t> batch_sims(maxBatch);
+            std::vector<dist_t> batch_errors(curSimErrorBatchFunc ? maxBatch : 0);
             std::vector<uint8_t> buffer;
-            if(layer == 0) {
-                buffer.resize(curDataSize);
+            if(layer == 0 && !dataVectors_ && !view) {
+                buffer.resize(maxBatch * curDataSize);
             }
 
+            auto isAllowed = [&](idhInt id) {
+                return !isIdAllowed || (*isIdAllowed)(getExternalLabel(id));
+            };
+
             dist_t lowerBound;
-            if(!has_deletions || !isMarkedDeleted(ep_id)) {
+            if((!has_deletions || !isMarkedDeleted(ep_id)) && isAllowed(ep_id)) {
 
                 const void* vec_data = nullptr;
                 if(layer == 0) {
-                    if(getDataByInternalId(ep_id, layer, buffer.data())) {
-                        vec_data = buffer.data();
-                    }
+                    vec_data = getBaseLayerDataPtr(ep_id, buffer.data(), view);
                 } else {
                     vec_data = getUpperLayerDataPtr(ep_id);
                 }
@@ -1103,7 +2554,7 @@ namespace hnswlib {
                     candidate_set.emplace(lowerBound, ep_id);
                 }
             } else {
-                // If entry point is deleted, lower bound will be minimum
+                // If entry point is deleted or filtered out, lower bound will be minimum
                 lowerBound = std::numeric_limits<dist_t>::lowest();
                 candidate_set.emplace(lowerBound, ep_id);
             }
@@ -1113,6 +2564,93 @@ namespace hnswlib {
             int max_below_threshold = is_insert ? settings::EARLY_EXIT_BUFFER_INSERT
                                                 : settings::EARLY_EXIT_BUFFER_QUERY;
 
+            // Scores the collected neighbors and moves the ones that qualify into the heaps
+            size_t batch_size = 0;
+            auto scoreBatch = [&]() {
+                size_t batch_count = 0;
+                for(size_t j = 0; j < batch_size; j++) {
+                    idhInt candidate_id = batch_ids[j];
+                    if(has_deletions && isMarkedDeleted(candidate_id)) {
+                        continue;
+                    }
+
+                    const void* neighbor_data = nullptr;
+                    if(layer == 0) {
+                        neighbor_data = getBaseLayerDataPtr(
+                                candidate_id, buffer.data() + batch_count * curDataSize, view);
+                    } else {
+                        neighbor_data = getUpperLayerDataPtr(candidate_id);
+                    }
+
+                    if(!neighbor_data) {
+                        continue;
+                    }
+                    batch_ids[batch_count] = candidate_id;
+                    batch_vectors[batch_count] = neighbor_data;
+                    batch_count++;
+                }
+                batch_size = 0;
+
+                if(batch_count == 0) {
+                    return;
+                }
+                // Once the results are full, neighbors that cannot beat lowerBound are dropped
+                // below, so the bounded kernels may stop scoring them early
+                if(curSimBoundedBatchFunc && top_candidates.size() >= ef) {
+                    curSimBoundedBatchFunc(data_point,
+                                           batch_vectors.data(),
+                                           batch_count,
+                                           curDistParam,
+                                           lowerBound,
+                                           batch_sims.data());
+                } else {
+                    curSimBatchFunc(data_point,
+                                    batch_vectors.data(),
+                                    batch_count,
+                                    curDistParam,
+                                    batch_sims.data());
+                }
+                if(curSimErrorBatchFunc) {
+                    curSimErrorBatchFunc(data_point,
+                                         batch_vectors.data(),
+                                         batch_count,
+                                         curDistParam,
+                                         batch_errors.data());
+                }
+
+                for(size_t j = 0; j < batch_count; j++) {
+                    idhInt candidate_id = batch_ids[j];
+                    dist_t sim = batch_sims[j];
+
+                    // Estimated similarities are only pruned when even their upper bound
+                    // cannot make the results, but the estimate is what gets ranked there
+                    dist_t upper = curSimErrorBatchFunc ? sim + batch_errors[j] : sim;
+                    if(top_candidates.size() < ef || upper > lowerBound) {
+                        candidate_set.emplace(upper, candidate_id);
+
+                        if((!has_deletions || !isMarkedDeleted(candidate_id))
+                           && (top_candidates.size() < ef || sim > lowerBound)) {
+                            top_candidates.emplace(sim, candidate_id);
+                            if(top_candidates.size() > ef) {
+                                top_candidates.pop();
+                            }
+                            if(!top_candidates.empty()) {
+                                lowerBound = top_candidates.top().first;
+                            }
+                        }
+                    }
+                }
+            };
+            // Two-hop expansion can collect more neighbors than a batch holds, a full batch is
+            // scored before collecting goes on
+            auto addToBatch = [&](idhInt id) {
+                if(batch_size == maxBatch) {
+                    scoreBatch();
+                }
+                prefetchElement(id, layer);
+                batch_ids[batch_size++] = id;
+            };
+
             while(!candidate_set.empty()) {
                 auto current_pair = candidate_set.top();
                 idhInt current_id = current_pair.second;
@@ -1138,46 +2676,36 @@ namespace hnswlib {
                 idhInt size = getListCount((idhInt*)data);
                 idhInt* datal = (idhInt*)(data + 1);
 
+                // Collect unvisited neighbors and start pulling in their link lists and
+                // vectors so that the loads overlap instead of stalling one at a time
                 for(idhInt j = 0; j < size; j++) {
                     idhInt candidate_id = *(datal + j);
+                    if(j + 1 < size) {
+                        __builtin_prefetch(visited_array + *(datal + j + 1));
+                    }
                     if(visited_array[candidate_id] == visited_array_tag) {
                         continue;
                     }
                     visited_array[candidate_id] = visited_array_tag;
-                    if(has_deletions && isMarkedDeleted(candidate_id)) {
-                        continue;
-                    }
-
-                    dist_t sim;
-                    const void* neighbor_data = nullptr;
-                    if(layer == 0) {
-                        if(getDataByInternalId(candidate_id, layer, buffer.data())) {
-                            neighbor_data = buffer.data();
-                        }
-                    } else {
-                        neighbor_data = getUpperLayerDataPtr(candidate_id);
-                    }
-
-                    if(!neighbor_data) {
-                        continue;
-                    }
-
-                    sim = curSimFunc(data_point, neighbor_data, curDistParam);
-
-                    if(top_candidates.size() < ef || sim > lowerBound) {
-                        candidate_set.emplace(sim, candidate_id);
-
-                        if(!has_deletions || !isMarkedDeleted(candidate_id)) {
-                            top_candidates.emplace(sim, candidate_id);
-                            if(top_candidates.size() > ef) {
-                                top_candidates.pop();
-                            }
-                            if(!top_candidates.empty()) {
-                                lowerBound = top_candidates.top().first;
+                    if(!isAllowed(candidate_id)) {
+                        // ACORN-style two-hop expansion: walk through the filtered-out node to
+                        // its admitted neighbors so sparse matches stay reachable
+                        idhInt* hop = (idhInt*)get_linklist0(candidate_id);
+                        idhInt hop_size = getListCount(hop);
+                        idhInt* hopl = (idhInt*)(hop + 1);
+                        for(idhInt h = 0; h < hop_size; h++) {
+                            idhInt hop_id = *(hopl + h);
+                            if(visited_array[hop_id] == visited_array_tag || !isAllowed(hop_id)) {
+                                continue;
                             }
+                            visited_array[hop_id] = visited_array_tag;
+                            addToBatch(hop_id);
                         }
+                        continue;
                     }
+                    addToBatch(candidate_id);
                 }
+                scoreBatch();
             }
 
             visited_list_pool_->releaseVisitedList(vl);
@@ -1192,7 +2720,7 @@ namespace hnswlib {
         }
         void removeAllConnections(idhInt internal_id, levelInt elem_level) {
 
-            for(int level = 0; level <= elem_level; ++level) {
+            for(levelInt level = 0; level <= elem_level; ++level) {
                 idhInt* ll_self = (idhInt*)get_linklist(internal_id, level);
                 idhInt size = getListCount(ll_self);
                 idhInt* neighbors = (idhInt*)(ll_self + 1);
@@ -1218,11 +2746,13 @@ namespace hnswlib {
                             }
                         }
                         setListCount(ll_other, new_size);
+                        markLinksDirty(neighbor_id, level);
                     }
                 }
                 // Now clear own links (make neighbor count 0)
                 std::unique_lock<std::shared_mutex> lock_self(getLinkListMutex(internal_id));
                 setListCount(ll_self, 0);
+                markLinksDirty(internal_id, level);
             }
         }
     };
@@ -123,44 +123,9 @@ static bool AVX512Capable() {
 #include <string.h>
 #include "../quant/common.hpp"
 #include "../core/types.hpp"
+#include "dist_params.h"
 
 namespace hnswlib {
-    typedef uint8_t SpaceType;
-    static const SpaceType L2_SPACE = 0;
-    static const SpaceType IP_SPACE = 1;
-    static const SpaceType COSINE_SPACE = 2;
-
-    struct DistParams {
-        size_t dim;
-        uint8_t quant_level;
-    };
-
-    inline SpaceType getSpaceType(const std::string& space_type_str) {
-        if(space_type_str == "l2") {
-            return L2_SPACE;
-        }
-        if(space_type_str == "ip") {
-            return IP_SPACE;
-        }
-        if(space_type_str == "cosine") {
-            return COSINE_SPACE;
-        }
-        throw std::runtime_error("Unknown space type: " + space_type_str);
-    }
-
-    inline std::string getSpaceTypeString(SpaceType space_type) {
-        switch(space_type) {
-            case L2_SPACE:
-                return "l2";
-            case IP_SPACE:
-                return "ip";
-            case COSINE_SPACE:
-                return "cosine";
-            default:
-                throw std::runtime_error("Unknown space type: " + std::to_string(space_type));
-        }
-    }
-
     // Type alias for labels
     using idInt = ndd::idInt;
     // Type alias for storing internal IDs
@@ -176,6 +141,24 @@ namespace hnswlib {
         virtual ~BaseFilterFunctor() {};
     };
 
+    // Admits the labels set in a filter bitmap (e.g. from Filter::computeFilterBitmap)
+    class BitmapFilterFunctor : public BaseFilterFunctor {
+    public:
+        explicit BitmapFilterFunctor(const ndd::RoaringBitmap& bitmap) : bitmap_(bitmap) {}
+        bool operator()(idInt id) override { return bitmap_.contains(id); }
+
+    private:
+        const ndd::RoaringBitmap& bitmap_;
+    };
+
+    // Zero-copy access to stored level 0 vectors. Returned pointers stay valid for the
+    // lifetime of the view (e.g. a pinned read transaction). Returns nullptr if not found.
+    class VectorView {
+    public:
+        virtual const uint8_t* getVector(idInt label) const = 0;
+        virtual ~VectorView() {}
+    };
+
     template <typename dist_t> class BaseSearchStopCondition {
     public:
         virtual void add_point_to_result(idInt label, const void* datapoint, dist_t dist) = 0;
@@ -211,6 +194,16 @@ namespace hnswlib {
 
     template <typename MTYPE> using SIMFUNC = MTYPE (*)(const void*, const void*, const void*);
 
+    // Scores one query against count vectors: (query, vectors, count, params, out)
+    template <typename MTYPE>
+    using SIMBATCHFUNC = void (*)(const void*, const void* const*, size_t, const void*, MTYPE*);
+
+    // Like SIMBATCHFUNC with a bound before out: a vector whose similarity cannot exceed the
+    // bound may be scored only partly, its output is then an upper bound no greater than it
+    template <typename MTYPE>
+    using SIMBOUNDEDBATCHFUNC =
+            void (*)(const void*, const void* const*, size_t, const void*, MTYPE, MTYPE*);
+
     template <typename MTYPE> class SpaceInterface {
     public:
         virtual size_t get_data_size() = 0;
@@ -219,6 +212,20 @@ namespace hnswlib {
 
         virtual SIMFUNC<MTYPE> get_sim_func() = 0;
 
+        virtual SIMBATCHFUNC<MTYPE> get_sim_batch_func() = 0;
+
+        // Scoring of search queries against stored vectors, when it differs from scoring two
+        // stored vectors (queries prepared at a higher precision)
+        virtual SIMFUNC<MTYPE> get_query_sim_func() { return get_sim_func(); }
+
+        virtual SIMBATCHFUNC<MTYPE> get_query_sim_batch_func() { return get_sim_batch_func(); }
+
+        // Early-abandoning query batch scoring, nullptr when the space has none
+        virtual SIMBOUNDEDBATCHFUNC<MTYPE> get_query_sim_bounded_batch_func() { return nullptr; }
+
+        // Error bounds of the batch similarities, nullptr when they are exact
+        virtual SIMBATCHFUNC<MTYPE> get_sim_error_batch_func() { return nullptr; }
+
         virtual void* get_dist_func_param() = 0;
 
         virtual ~SpaceInterface() {}
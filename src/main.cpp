@@ -122,6 +122,19 @@ bool is_cpu_compatible() {
     return ret;
 }
 
+/**
+ * Runtime dispatch builds carry AVX512 quantization kernels next to the AVX2 baseline.
+ * Points the registry at the best copy the CPU can run, before any index is loaded
+ */
+void select_simd_kernels() {
+#if defined(NDD_RUNTIME_DISPATCH)
+    ndd::quant::SimdLevel simd = is_avx512_compatible() ? ndd::quant::SimdLevel::AVX512
+                                                        : ndd::quant::SimdLevel::AVX2;
+    ndd::quant::QuantizationRegistry::instance().setSimdLevel(simd);
+    LOG_INFO("Quantization kernels: " << ndd::quant::simdLevelToString(simd));
+#endif
+}
+
 // Read file contents
 std::string read_file(const std::string& path) {
     std::ifstream file(path, std::ios::binary);
@@ -185,6 +198,7 @@ int main(int argc, char** argv) {
         printf("CPU is not compatible. Can't run Endee\n");
         return 0;
     }
+    select_simd_kernels();
     LOG_DEBUG("SERVER_ID: " << settings::SERVER_ID);
     LOG_DEBUG("SERVER_PORT: " << settings::SERVER_PORT);
     LOG_DEBUG("DATA_DIR: " << settings::DATA_DIR);
@@ -373,6 +387,29 @@ int main(int argc, char** argv) {
 
                 size_t sparse_dim = body.has("sparse_dim") ? (size_t)body["sparse_dim"].i() : 0;
 
+                // Optional higher precision copy used to rerank the graph candidates
+                ndd::quant::QuantizationLevel rerank_quant_level =
+                        ndd::quant::QuantizationLevel::UNKNOWN;
+                if(body.has("rerank_precision")) {
+                    rerank_quant_level = stringToQuantLevel(body["rerank_precision"].s());
+                    if(rerank_quant_level == ndd::quant::QuantizationLevel::UNKNOWN
+                       || rerank_quant_level == ndd::quant::QuantizationLevel::BINARY
+                       || rerank_quant_level == ndd::quant::QuantizationLevel::RABITQ
+                       || ndd::quant::is_trained_level(rerank_quant_level)) {
+                        return json_error(400, "Invalid rerank_precision");
+                    }
+                }
+
+                // Optional Matryoshka prefix the graph is built on. Candidates are reranked at
+                // full dimension, in FP32 unless another rerank precision is given
+                size_t prefix_dim = body.has("prefix_dim") ? (size_t)body["prefix_dim"].i() : 0;
+                if(body.has("prefix_dim") && (prefix_dim == 0 || prefix_dim >= dim)) {
+                    return json_error(400, "prefix_dim must be between 1 and dim - 1");
+                }
+                if(prefix_dim && rerank_quant_level == ndd::quant::QuantizationLevel::UNKNOWN) {
+                    rerank_quant_level = ndd::quant::QuantizationLevel::FP32;
+                }
+
                 IndexConfig config{dim,
                                    sparse_dim,
                                    settings::MAX_ELEMENTS,  // max elements
@@ -380,7 +417,9 @@ int main(int argc, char** argv) {
                                    m,
                                    ef_con,
                                    quant_level,
-                                   checksum};
+                                   checksum,
+                                   rerank_quant_level,
+                                   prefix_dim};
 
                 try {
                     // Pass the full index_id to index_manager with Admin user type (no limits)
@@ -420,6 +459,45 @@ int main(int argc, char** argv) {
                 }
             });
 
+    // Reorder the graph of an index for locality
+    CROW_ROUTE(app, "/api/v1/index/<string>/reorder")
+            .CROW_MIDDLEWARES(app, AuthMiddleware)
+            .methods("POST"_method)([&index_manager, &app](const crow::request& req,
+                                                           const std::string& index_name) {
+                auto& ctx = app.get_context<AuthMiddleware>(req);
+                std::string index_id = ctx.username + "/" + index_name;
+
+                try {
+                    size_t reordered = index_manager.reorderIndex(index_id);
+                    crow::json::wvalue response(
+                            {{"reordered", static_cast<int64_t>(reordered)}});
+                    return crow::response(200, response.dump());
+                } catch(const std::runtime_error& e) {
+                    return json_error(404, std::string("Error: ") + e.what());
+                } catch(const std::exception& e) {
+                    return json_error_500(ctx.username, req.url, std::string("Error: ") + e.what());
+                }
+            });
+
+    // Reclaim the slots of deleted vectors
+    CROW_ROUTE(app, "/api/v1/index/<string>/vacuum")
+            .CROW_MIDDLEWARES(app, AuthMiddleware)
+            .methods("POST"_method)([&index_manager, &app](const crow::request& req,
+                                                           const std::string& index_name) {
+                auto& ctx = app.get_context<AuthMiddleware>(req);
+                std::string index_id = ctx.username + "/" + index_name;
+
+                try {
+                    size_t freed = index_manager.vacuumIndex(index_id);
+                    crow::json::wvalue response({{"freed", static_cast<int64_t>(freed)}});
+                    return crow::response(200, response.dump());
+                } catch(const std::runtime_error& e) {
+                    return json_error(404, std::string("Error: ") + e.what());
+                } catch(const std::exception& e) {
+                    return json_error_500(ctx.username, req.url, std::string("Error: ") + e.what());
+                }
+            });
+
     // List Backups
     CROW_ROUTE(app, "/api/v1/backups")
             .CROW_MIDDLEWARES(app, AuthMiddleware)
@@ -606,6 +684,9 @@ int main(int argc, char** argv) {
                              {"sparse_dim", static_cast<int64_t>(metadata.sparse_dim)},
                              {"space_type", metadata.space_type_str},
                              {"precision", quantLevelToString(metadata.quant_level)},
+                             {"rerank_precision",
+                              quantLevelToString(metadata.rerank_quant_level)},
+                             {"prefix_dim", static_cast<int64_t>(metadata.prefix_dim)},
                              {"total_elements", static_cast<int64_t>(metadata.total_elements)},
                              {"checksum", metadata.checksum},
                              {"M", static_cast<int64_t>(metadata.M)},
@@ -690,6 +771,14 @@ int main(int argc, char** argv) {
                                               + " and " + std::to_string(settings::MAX_K));
                 }
                 size_t ef = body.has("ef") ? (size_t)body["ef"].i() : 0;
+                // 0 uses the default factor on indexes with a rerank copy
+                size_t rerank_factor =
+                        body.has("rerank_factor") ? (size_t)body["rerank_factor"].i() : 0;
+                if(rerank_factor > settings::MAX_RERANK_FACTOR) {
+                    return json_error(400,
+                                      "rerank_factor must be at most "
+                                              + std::to_string(settings::MAX_RERANK_FACTOR));
+                }
                 bool include_vectors =
                         body.has("include_vectors") ? body["include_vectors"].b() : false;
                 nlohmann::json filter_array = nlohmann::json::array();  // default: empty filter
@@ -710,6 +799,7 @@ int main(int argc, char** argv) {
                 }
                 LOG_DEBUG("Filter: " << filter_array.dump());
                 try {
+                    ndd::SearchPlan plan;
                     auto search_response = index_manager.searchKNN(index_id,
                                                                    query,
                                                                    sparse_indices,
@@ -717,7 +807,9 @@ int main(int argc, char** argv) {
                                                                    k,
                                                                    filter_array,
                                                                    include_vectors,
-                                                                   ef);
+                                                                   ef,
+                                                                   rerank_factor,
+                                                                   &plan);
                     if(!search_response) {
                         return json_error(404, "Index not found or search failed");
                     }
@@ -727,6 +819,8 @@ int main(int argc, char** argv) {
                     msgpack::pack(sbuf, search_response.value());
                     crow::response resp(200, std::string(sbuf.data(), sbuf.size()));
                     resp.add_header("Content-Type", "application/msgpack");
+                    // How a filtered search was executed, for tuning the planner
+                    resp.add_header("X-Search-Plan", plan.describe());
                     return resp;
                 } catch(const std::runtime_error& e) {
                     return json_error(400, e.what());
@@ -993,6 +1087,10 @@ int main(int argc, char** argv) {
                              {"sparse_dim", static_cast<int64_t>(info->sparse_dim)},
                              {"space_type", info->space_type_str},
                              {"precision", quantLevelToString(info->quant_level)},
+                             {"rerank_precision", quantLevelToString(info->rerank_quant_level)},
+                             {"prefix_dim", static_cast<int64_t>(info->prefix_dim)},
+                             {"deleted_elements", static_cast<int64_t>(info->deleted_elements)},
+                             {"deleted_ratio", info->deleted_ratio},
                              {"checksum", info->checksum},
                              {"M", static_cast<int64_t>(info->M)},
                              {"ef_con", static_cast<int64_t>(info->ef_con)},
@@ -0,0 +1,313 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include "../hnsw/dist_params.h"
+#include "kernels.hpp"
+#include "int8d.hpp"
+
+namespace ndd {
+    namespace quant {
+        namespace bfloat16::inline NDD_SIMD_NAMESPACE {
+
+            // BF16 keeps the FP32 exponent and the top 7 mantissa bits, so conversions are
+            // shifts plus rounding: no overflow or subnormal range of its own to handle.
+            constexpr size_t get_storage_size(size_t dimension) {
+                return dimension * sizeof(uint16_t);
+            }
+
+            inline float extract_scale(const uint8_t*, size_t) { return 1.0f; }
+
+            inline float bf16_to_fp32(uint16_t h) {
+                uint32_t bits = static_cast<uint32_t>(h) << 16;
+                float f;
+                std::memcpy(&f, &bits, sizeof(f));
+                return f;
+            }
+
+            // Round to nearest even, NaN stays a quiet NaN
+            inline uint16_t fp32_to_bf16(float f) {
+                uint32_t bits;
+                std::memcpy(&bits, &f, sizeof(bits));
+                if((bits & 0x7FFFFFFF) > 0x7F800000) {
+                    return static_cast<uint16_t>((bits >> 16) | 0x40);
+                }
+                bits += 0x7FFF + ((bits >> 16) & 1);
+                return static_cast<uint16_t>(bits >> 16);
+            }
+
+#if defined(USE_AVX512)
+            inline __m512 load_bf16_as_ps_avx512(const uint16_t* ptr) {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+                return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16));
+            }
+#elif defined(USE_AVX2)
+            inline __m256 load_bf16_as_ps_avx2(const uint16_t* ptr) {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+                return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+            }
+#elif defined(USE_NEON)
+            inline float32x4_t load_bf16_as_f32_neon(const uint16_t* ptr) {
+                return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(ptr), 16));
+            }
+#endif
+
+            inline std::vector<uint8_t> quantize(const std::vector<float>& input) {
+                size_t dimension = input.size();
+                std::vector<uint8_t> buffer(get_storage_size(dimension));
+                uint16_t* out = reinterpret_cast<uint16_t*>(buffer.data());
+                size_t i = 0;
+#if defined(USE_AVX512)
+                // vcvtneps2bf16 rounds to nearest even like the scalar path
+                for(; i + 16 <= dimension; i += 16) {
+                    __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(input.data() + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), (__m256i)h);
+                }
+#endif
+                for(; i < dimension; i++) {
+                    out[i] = fp32_to_bf16(input[i]);
+                }
+                return buffer;
+            }
+
+            inline std::vector<float> dequantize(const uint8_t* in, size_t dim) {
+                const uint16_t* h = reinterpret_cast<const uint16_t*>(in);
+                std::vector<float> output(dim);
+                for(size_t i = 0; i < dim; i++) {
+                    output[i] = bf16_to_fp32(h[i]);
+                }
+                return output;
+            }
+
+            // Inner product of two stored vectors. vdpbf16ps multiplies 32 pairs per
+            // instruction and accumulates exactly into FP32 lanes; the masked tail loads
+            // zeros that add nothing.
+            inline float Dot(const uint16_t* a, const uint16_t* b, size_t qty) {
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 64 <= qty; i += 64) {
+                    acc0 = _mm512_dpbf16_ps(acc0,
+                                            (__m512bh)_mm512_loadu_si512(a + i),
+                                            (__m512bh)_mm512_loadu_si512(b + i));
+                    acc1 = _mm512_dpbf16_ps(acc1,
+                                            (__m512bh)_mm512_loadu_si512(a + i + 32),
+                                            (__m512bh)_mm512_loadu_si512(b + i + 32));
+                }
+                for(; i < qty; i += 32) {
+                    __mmask32 mask = qty - i >= 32 ? 0xFFFFFFFF : (1U << (qty - i)) - 1;
+                    acc0 = _mm512_dpbf16_ps(acc0,
+                                            (__m512bh)_mm512_maskz_loadu_epi16(mask, a + i),
+                                            (__m512bh)_mm512_maskz_loadu_epi16(mask, b + i));
+                }
+                res = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    acc0 = _mm256_fmadd_ps(
+                            load_bf16_as_ps_avx2(a + i), load_bf16_as_ps_avx2(b + i), acc0);
+                    acc1 = _mm256_fmadd_ps(load_bf16_as_ps_avx2(a + i + 8),
+                                           load_bf16_as_ps_avx2(b + i + 8),
+                                           acc1);
+                }
+                res = ndd::quant::math::hsum_ps_avx2(_mm256_add_ps(acc0, acc1));
+#elif defined(USE_NEON)
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    acc0 = vfmaq_f32(
+                            acc0, load_bf16_as_f32_neon(a + i), load_bf16_as_f32_neon(b + i));
+                    acc1 = vfmaq_f32(acc1,
+                                     load_bf16_as_f32_neon(a + i + 4),
+                                     load_bf16_as_f32_neon(b + i + 4));
+                }
+                res = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                for(; i < qty; i++) {
+                    res += bf16_to_fp32(a[i]) * bf16_to_fp32(b[i]);
+                }
+                return res;
+            }
+
+            // Squared differences against FP32 values: q is either a float query or, through
+            // Load, another stored vector
+            template <bool query_is_float>
+            inline float L2Sum(const void* q, const uint16_t* v, size_t qty) {
+                const float* qf = static_cast<const float*>(q);
+                const uint16_t* qh = static_cast<const uint16_t*>(q);
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc = _mm512_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    __m512 a = query_is_float ? _mm512_loadu_ps(qf + i)
+                                              : load_bf16_as_ps_avx512(qh + i);
+                    __m512 diff = _mm512_sub_ps(a, load_bf16_as_ps_avx512(v + i));
+                    acc = _mm512_fmadd_ps(diff, diff, acc);
+                }
+                res = _mm512_reduce_add_ps(acc);
+#elif defined(USE_AVX2)
+                __m256 acc = _mm256_setzero_ps();
+                for(; i + 8 <= qty; i += 8) {
+                    __m256 a = query_is_float ? _mm256_loadu_ps(qf + i)
+                                              : load_bf16_as_ps_avx2(qh + i);
+                    __m256 diff = _mm256_sub_ps(a, load_bf16_as_ps_avx2(v + i));
+                    acc = _mm256_fmadd_ps(diff, diff, acc);
+                }
+                res = ndd::quant::math::hsum_ps_avx2(acc);
+#elif defined(USE_NEON)
+                float32x4_t acc = vdupq_n_f32(0.0f);
+                for(; i + 4 <= qty; i += 4) {
+                    float32x4_t a = query_is_float ? vld1q_f32(qf + i)
+                                                   : load_bf16_as_f32_neon(qh + i);
+                    float32x4_t diff = vsubq_f32(a, load_bf16_as_f32_neon(v + i));
+                    acc = vfmaq_f32(acc, diff, diff);
+                }
+                res = vaddvq_f32(acc);
+#endif
+                for(; i < qty; i++) {
+                    float a = query_is_float ? qf[i] : bf16_to_fp32(qh[i]);
+                    float diff = a - bf16_to_fp32(v[i]);
+                    res += diff * diff;
+                }
+                return res;
+            }
+
+            // Float query against stored halves, only the stored side is widened
+            inline float QueryDot(const float* q, const uint16_t* v, size_t qty) {
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    acc0 = _mm512_fmadd_ps(
+                            _mm512_loadu_ps(q + i), load_bf16_as_ps_avx512(v + i), acc0);
+                    acc1 = _mm512_fmadd_ps(
+                            _mm512_loadu_ps(q + i + 16), load_bf16_as_ps_avx512(v + i + 16), acc1);
+                }
+                res = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    acc0 = _mm256_fmadd_ps(
+                            _mm256_loadu_ps(q + i), load_bf16_as_ps_avx2(v + i), acc0);
+                    acc1 = _mm256_fmadd_ps(
+                            _mm256_loadu_ps(q + i + 8), load_bf16_as_ps_avx2(v + i + 8), acc1);
+                }
+                res = ndd::quant::math::hsum_ps_avx2(_mm256_add_ps(acc0, acc1));
+#elif defined(USE_NEON)
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    acc0 = vfmaq_f32(acc0, vld1q_f32(q + i), load_bf16_as_f32_neon(v + i));
+                    acc1 = vfmaq_f32(acc1, vld1q_f32(q + i + 4), load_bf16_as_f32_neon(v + i + 4));
+                }
+                res = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                for(; i < qty; i++) {
+                    res += q[i] * bf16_to_fp32(v[i]);
+                }
+                return res;
+            }
+
+            static float
+            InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                return Dot((const uint16_t*)pVect1v, (const uint16_t*)pVect2v, qty);
+            }
+
+            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                return -L2Sum<false>(pVect1v, (const uint16_t*)pVect2v, qty);
+            }
+
+            static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -L2SqrSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float
+            InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float
+            QueryInnerProductSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                return QueryDot((const float*)query, (const uint16_t*)vec, qty);
+            }
+
+            static float QueryL2SqrSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                return -L2Sum<true>(query, (const uint16_t*)vec, qty);
+            }
+
+            static float QueryCosineSim(const void* query, const void* vec, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return QueryInnerProductSim(query, vec, qty_ptr);
+            }
+
+            static std::vector<uint8_t> quantize_to_int8(const void* in, size_t dim) {
+                return int8d::quantize_vector_fp32_to_int8_buffer_auto(
+                        dequantize(static_cast<const uint8_t*>(in), dim));
+            }
+
+        }  // namespace bfloat16::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
+
+        class BFloat16Quantizer : public Quantizer {
+        public:
+            std::string name() const override { return "bfloat16"; }
+            QuantizationLevel level() const override { return QuantizationLevel::BF16; }
+
+            QuantizerDispatch getDispatch() const override {
+                QuantizerDispatch d;
+                d.dist_l2 = &bfloat16::L2Sqr;
+                d.dist_ip = &bfloat16::InnerProduct;
+                d.dist_cosine = &bfloat16::Cosine;
+                d.sim_l2 = &bfloat16::L2SqrSim;
+                d.sim_ip = &bfloat16::InnerProductSim;
+                d.sim_cosine = &bfloat16::CosineSim;
+                d.sim_l2_batch = &sim_batch_pairwise<&bfloat16::L2SqrSim>;
+                d.sim_ip_batch = &sim_batch_pairwise<&bfloat16::InnerProductSim>;
+                d.sim_cosine_batch = &sim_batch_pairwise<&bfloat16::CosineSim>;
+                d.quantize = &bfloat16::quantize;
+                d.dequantize = &bfloat16::dequantize;
+                d.quantize_to_int8 = &bfloat16::quantize_to_int8;
+                d.get_storage_size = &bfloat16::get_storage_size;
+                d.extract_scale = &bfloat16::extract_scale;
+                d.prepare_query = &prepare_float_query;
+                d.query_sim_l2 = &bfloat16::QueryL2SqrSim;
+                d.query_sim_ip = &bfloat16::QueryInnerProductSim;
+                d.query_sim_cosine = &bfloat16::QueryCosineSim;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&bfloat16::QueryL2SqrSim>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&bfloat16::QueryInnerProductSim>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&bfloat16::QueryCosineSim>;
+                return d;
+            }
+        };
+
+        // Register BF16
+        static RegisterQuantizer reg_bf16(QuantizationLevel::BF16,
+                                          "bfloat16",
+                                          std::make_shared<BFloat16Quantizer>());
+
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
+}  // namespace ndd
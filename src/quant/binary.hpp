@@ -3,7 +3,8 @@
 #include <cstdint>
 #include <cmath>
 #include <cstring>
-#include "common.hpp"
+#include "kernels.hpp"
+#include "../hnsw/dist_params.h"
 
 #if defined(USE_NEON)
 #    include <arm_neon.h>
@@ -19,7 +20,7 @@
 
 namespace ndd {
     namespace quant {
-        namespace binary {
+        namespace binary::inline NDD_SIMD_NAMESPACE {
 
             // Calculate storage size in bytes (padded to multiple of 64 bits / 8 bytes)
             inline size_t get_storage_size(size_t dimension) {
@@ -643,11 +644,311 @@ namespace ndd {
                 return HammingSim(v1, v2, params);
             }
 
+            // One query against many vectors. Four vectors are processed per pass so each
+            // query word is loaded once and xor-ed against all four.
+
+            static void Hamming4Scalar(const uint64_t* query,
+                                       const uint64_t* const* vectors,
+                                       size_t begin,
+                                       size_t num_uint64,
+                                       uint64_t* out) {
+                for(size_t k = 0; k < 4; k++) {
+                    const uint64_t* vec = vectors[k];
+                    uint64_t dist = 0;
+                    for(size_t i = begin; i < num_uint64; ++i) {
+                        dist += __builtin_popcountll(query[i] ^ vec[i]);
+                    }
+                    out[k] += dist;
+                }
+            }
+
+#if defined(USE_AVX512)
+            static void Hamming4AVX512(const uint64_t* query,
+                                       const uint64_t* const* vectors,
+                                       size_t num_uint64,
+                                       uint64_t* out) {
+                __m512i acc0 = _mm512_setzero_si512();
+                __m512i acc1 = _mm512_setzero_si512();
+                __m512i acc2 = _mm512_setzero_si512();
+                __m512i acc3 = _mm512_setzero_si512();
+
+                size_t i = 0;
+                for(; i + 8 <= num_uint64; i += 8) {
+                    __m512i q = _mm512_loadu_si512((const __m512i*)&query[i]);
+                    __m512i x0 = _mm512_xor_si512(
+                            q, _mm512_loadu_si512((const __m512i*)&vectors[0][i]));
+                    __m512i x1 = _mm512_xor_si512(
+                            q, _mm512_loadu_si512((const __m512i*)&vectors[1][i]));
+                    __m512i x2 = _mm512_xor_si512(
+                            q, _mm512_loadu_si512((const __m512i*)&vectors[2][i]));
+                    __m512i x3 = _mm512_xor_si512(
+                            q, _mm512_loadu_si512((const __m512i*)&vectors[3][i]));
+                    acc0 = _mm512_add_epi64(acc0, _mm512_popcnt_epi64(x0));
+                    acc1 = _mm512_add_epi64(acc1, _mm512_popcnt_epi64(x1));
+                    acc2 = _mm512_add_epi64(acc2, _mm512_popcnt_epi64(x2));
+                    acc3 = _mm512_add_epi64(acc3, _mm512_popcnt_epi64(x3));
+                }
+
+                // Handle remaining elements (1..7) using masking
+                if(i < num_uint64) {
+                    __mmask8 mask = (__mmask8)((1 << (num_uint64 - i)) - 1);
+                    __m512i q = _mm512_maskz_loadu_epi64(mask, &query[i]);
+                    __m512i x0 =
+                            _mm512_xor_si512(q, _mm512_maskz_loadu_epi64(mask, &vectors[0][i]));
+                    __m512i x1 =
+                            _mm512_xor_si512(q, _mm512_maskz_loadu_epi64(mask, &vectors[1][i]));
+                    __m512i x2 =
+                            _mm512_xor_si512(q, _mm512_maskz_loadu_epi64(mask, &vectors[2][i]));
+                    __m512i x3 =
+                            _mm512_xor_si512(q, _mm512_maskz_loadu_epi64(mask, &vectors[3][i]));
+                    acc0 = _mm512_add_epi64(acc0, _mm512_popcnt_epi64(x0));
+                    acc1 = _mm512_add_epi64(acc1, _mm512_popcnt_epi64(x1));
+                    acc2 = _mm512_add_epi64(acc2, _mm512_popcnt_epi64(x2));
+                    acc3 = _mm512_add_epi64(acc3, _mm512_popcnt_epi64(x3));
+                }
+
+                out[0] = _mm512_reduce_add_epi64(acc0);
+                out[1] = _mm512_reduce_add_epi64(acc1);
+                out[2] = _mm512_reduce_add_epi64(acc2);
+                out[3] = _mm512_reduce_add_epi64(acc3);
+            }
+#elif defined(USE_AVX2)
+            // Per-byte popcount via PSHUFB nibble lookup, summed into 64-bit lanes
+            inline __m256i popcnt_epi64_avx2(__m256i x) {
+                const __m256i mask_low = _mm256_set1_epi8(0x0F);
+                const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                                        1, 2, 2, 3, 2, 3, 3, 4,
+                                                        0, 1, 1, 2, 1, 2, 2, 3,
+                                                        1, 2, 2, 3, 2, 3, 3, 4);
+                __m256i low = _mm256_and_si256(x, mask_low);
+                __m256i high = _mm256_and_si256(_mm256_srli_epi16(x, 4), mask_low);
+                __m256i pop = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                              _mm256_shuffle_epi8(lookup, high));
+                return _mm256_sad_epu8(pop, _mm256_setzero_si256());
+            }
+
+            inline uint64_t reduce_add_epi64_avx2(__m256i v) {
+                __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v),
+                                            _mm256_extracti128_si256(v, 1));
+                sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+                return static_cast<uint64_t>(_mm_cvtsi128_si64(sum));
+            }
+
+            static void Hamming4AVX2(const uint64_t* query,
+                                     const uint64_t* const* vectors,
+                                     size_t num_uint64,
+                                     uint64_t* out) {
+                __m256i acc0 = _mm256_setzero_si256();
+                __m256i acc1 = _mm256_setzero_si256();
+                __m256i acc2 = _mm256_setzero_si256();
+                __m256i acc3 = _mm256_setzero_si256();
+
+                size_t i = 0;
+                for(; i + 4 <= num_uint64; i += 4) {
+                    __m256i q = _mm256_loadu_si256((const __m256i*)&query[i]);
+                    __m256i x0 = _mm256_xor_si256(
+                            q, _mm256_loadu_si256((const __m256i*)&vectors[0][i]));
+                    __m256i x1 = _mm256_xor_si256(
+                            q, _mm256_loadu_si256((const __m256i*)&vectors[1][i]));
+                    __m256i x2 = _mm256_xor_si256(
+                            q, _mm256_loadu_si256((const __m256i*)&vectors[2][i]));
+                    __m256i x3 = _mm256_xor_si256(
+                            q, _mm256_loadu_si256((const __m256i*)&vectors[3][i]));
+                    acc0 = _mm256_add_epi64(acc0, popcnt_epi64_avx2(x0));
+                    acc1 = _mm256_add_epi64(acc1, popcnt_epi64_avx2(x1));
+                    acc2 = _mm256_add_epi64(acc2, popcnt_epi64_avx2(x2));
+                    acc3 = _mm256_add_epi64(acc3, popcnt_epi64_avx2(x3));
+                }
+
+                out[0] = reduce_add_epi64_avx2(acc0);
+                out[1] = reduce_add_epi64_avx2(acc1);
+                out[2] = reduce_add_epi64_avx2(acc2);
+                out[3] = reduce_add_epi64_avx2(acc3);
+                Hamming4Scalar(query, vectors, i, num_uint64, out);
+            }
+#elif defined(USE_SVE2)
+            static void Hamming4SVE(const uint64_t* query,
+                                    const uint64_t* const* vectors,
+                                    size_t num_uint64,
+                                    uint64_t* out) {
+                svuint64_t acc0 = svdup_u64(0);
+                svuint64_t acc1 = svdup_u64(0);
+                svuint64_t acc2 = svdup_u64(0);
+                svuint64_t acc3 = svdup_u64(0);
+
+                // Inactive lanes load as zero, so their xor and popcount are zero as well
+                size_t i = 0;
+                svbool_t pg = svwhilelt_b64(i, num_uint64);
+                while(svptest_any(svptrue_b64(), pg)) {
+                    svuint64_t q = svld1_u64(pg, &query[i]);
+                    svuint64_t x0 = sveor_u64_z(pg, q, svld1_u64(pg, &vectors[0][i]));
+                    svuint64_t x1 = sveor_u64_z(pg, q, svld1_u64(pg, &vectors[1][i]));
+                    svuint64_t x2 = sveor_u64_z(pg, q, svld1_u64(pg, &vectors[2][i]));
+                    svuint64_t x3 = sveor_u64_z(pg, q, svld1_u64(pg, &vectors[3][i]));
+                    acc0 = svadd_u64_m(pg, acc0, svcnt_u64_x(pg, x0));
+                    acc1 = svadd_u64_m(pg, acc1, svcnt_u64_x(pg, x1));
+                    acc2 = svadd_u64_m(pg, acc2, svcnt_u64_x(pg, x2));
+                    acc3 = svadd_u64_m(pg, acc3, svcnt_u64_x(pg, x3));
+
+                    i += svcntd();
+                    pg = svwhilelt_b64(i, num_uint64);
+                }
+
+                out[0] = svaddv_u64(svptrue_b64(), acc0);
+                out[1] = svaddv_u64(svptrue_b64(), acc1);
+                out[2] = svaddv_u64(svptrue_b64(), acc2);
+                out[3] = svaddv_u64(svptrue_b64(), acc3);
+            }
+#elif defined(USE_NEON)
+            static void Hamming4NEON(const uint64_t* query,
+                                     const uint64_t* const* vectors,
+                                     size_t num_uint64,
+                                     uint64_t* out) {
+                // Each pass adds at most 16 per 16-bit lane, so the accumulators are safe up to
+                // 8192 words per vector, far above MAX_DIMENSION
+                uint16x8_t acc0 = vdupq_n_u16(0);
+                uint16x8_t acc1 = vdupq_n_u16(0);
+                uint16x8_t acc2 = vdupq_n_u16(0);
+                uint16x8_t acc3 = vdupq_n_u16(0);
+
+                size_t i = 0;
+                for(; i + 1 < num_uint64; i += 2) {
+                    uint8x16_t q = vld1q_u8((const uint8_t*)&query[i]);
+                    uint8x16_t x0 = veorq_u8(q, vld1q_u8((const uint8_t*)&vectors[0][i]));
+                    uint8x16_t x1 = veorq_u8(q, vld1q_u8((const uint8_t*)&vectors[1][i]));
+                    uint8x16_t x2 = veorq_u8(q, vld1q_u8((const uint8_t*)&vectors[2][i]));
+                    uint8x16_t x3 = veorq_u8(q, vld1q_u8((const uint8_t*)&vectors[3][i]));
+                    acc0 = vpadalq_u8(acc0, vcntq_u8(x0));
+                    acc1 = vpadalq_u8(acc1, vcntq_u8(x1));
+                    acc2 = vpadalq_u8(acc2, vcntq_u8(x2));
+                    acc3 = vpadalq_u8(acc3, vcntq_u8(x3));
+                }
+
+                out[0] = vaddlvq_u16(acc0);
+                out[1] = vaddlvq_u16(acc1);
+                out[2] = vaddlvq_u16(acc2);
+                out[3] = vaddlvq_u16(acc3);
+                Hamming4Scalar(query, vectors, i, num_uint64, out);
+            }
+#endif
+
+            static void Hamming4(const uint64_t* query,
+                                 const uint64_t* const* vectors,
+                                 size_t num_uint64,
+                                 uint64_t* out) {
+#if defined(USE_AVX512)
+                Hamming4AVX512(query, vectors, num_uint64, out);
+#elif defined(USE_AVX2)
+                Hamming4AVX2(query, vectors, num_uint64, out);
+#elif defined(USE_SVE2)
+                Hamming4SVE(query, vectors, num_uint64, out);
+#elif defined(USE_NEON)
+                Hamming4NEON(query, vectors, num_uint64, out);
+#else
+                out[0] = out[1] = out[2] = out[3] = 0;
+                Hamming4Scalar(query, vectors, 0, num_uint64, out);
+#endif
+            }
+
+            // All metrics reduce to dim - hamming for binary vectors
+            static void HammingSimBatch(const void* query,
+                                        const void* const* vectors,
+                                        size_t count,
+                                        const void* params,
+                                        float* out) {
+                const size_t dim = *static_cast<const size_t*>(params);
+                const uint64_t* q = static_cast<const uint64_t*>(query);
+                size_t num_uint64 = (dim + 63) / 64;
+
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const uint64_t* group[4] = {static_cast<const uint64_t*>(vectors[i]),
+                                                static_cast<const uint64_t*>(vectors[i + 1]),
+                                                static_cast<const uint64_t*>(vectors[i + 2]),
+                                                static_cast<const uint64_t*>(vectors[i + 3])};
+                    uint64_t dists[4];
+                    Hamming4(q, group, num_uint64, dists);
+                    for(size_t k = 0; k < 4; k++) {
+                        out[i + k] = dim - static_cast<float>(dists[k]);
+                    }
+                }
+                for(; i < count; i++) {
+                    out[i] = HammingSim(query, vectors[i], params);
+                }
+            }
+
+            // Float query against stored signs: the sum of the query values at the set bits,
+            // selected by masks built straight from the bits
+            inline float QuerySetSum(const float* query, const uint8_t* bits, size_t dim) {
+                float sum = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 32 <= dim; i += 32) {
+                    uint32_t m;
+                    std::memcpy(&m, bits + i / 8, sizeof(m));
+                    acc0 = _mm512_mask_add_ps(
+                            acc0, (__mmask16)(m & 0xFFFF), acc0, _mm512_loadu_ps(query + i));
+                    acc1 = _mm512_mask_add_ps(
+                            acc1, (__mmask16)(m >> 16), acc1, _mm512_loadu_ps(query + i + 16));
+                }
+                sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+                __m256 acc = _mm256_setzero_ps();
+                for(; i + 8 <= dim; i += 8) {
+                    __m256i b = _mm256_and_si256(_mm256_set1_epi32(bits[i / 8]), lanes);
+                    __m256 mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(b, lanes));
+                    acc = _mm256_add_ps(acc, _mm256_and_ps(mask, _mm256_loadu_ps(query + i)));
+                }
+                __m128 sum_128 =
+                        _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum = _mm_cvtss_f32(sum_128);
+#elif defined(USE_NEON)
+                const uint32x4_t lanes_lo = {1, 2, 4, 8};
+                const uint32x4_t lanes_hi = {16, 32, 64, 128};
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= dim; i += 8) {
+                    uint32x4_t b = vdupq_n_u32(bits[i / 8]);
+                    uint32x4_t m0 = vtstq_u32(b, lanes_lo);
+                    uint32x4_t m1 = vtstq_u32(b, lanes_hi);
+                    acc0 = vaddq_f32(acc0,
+                                     vreinterpretq_f32_u32(vandq_u32(
+                                             m0, vreinterpretq_u32_f32(vld1q_f32(query + i)))));
+                    acc1 = vaddq_f32(acc1,
+                                     vreinterpretq_f32_u32(vandq_u32(
+                                             m1, vreinterpretq_u32_f32(vld1q_f32(query + i + 4)))));
+                }
+                sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                for(; i < dim; i++) {
+                    if((bits[i / 8] >> (i % 8)) & 1) {
+                        sum += query[i];
+                    }
+                }
+                return sum;
+            }
+
+            // <query, signs> with signs of +1 at set bits and -1 elsewhere. Stored vectors carry
+            // no magnitude, so every metric ranks by it like the Hamming similarity does.
+            inline float QuerySignSim(const void* query, const void* vec, const void* params) {
+                const size_t dim = *static_cast<const size_t*>(params);
+                float set_sum = QuerySetSum((const float*)query, (const uint8_t*)vec, dim);
+                return 2.0f * set_sum - float_query_sum(query, dim);
+            }
+
             static std::vector<uint8_t> quantize_to_int8(const void* in, size_t dim) {
                 throw std::runtime_error("Binary to Int8 direct quantization not implemented");
             }
 
-        }  // namespace binary
+        }  // namespace binary::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
 
         class BinaryQuantizer : public Quantizer {
         public:
@@ -662,11 +963,21 @@ namespace ndd {
                 d.sim_l2 = &binary::L2SqrSim;
                 d.sim_ip = &binary::InnerProductSim;
                 d.sim_cosine = &binary::CosineSim;
+                d.sim_l2_batch = &binary::HammingSimBatch;
+                d.sim_ip_batch = &binary::HammingSimBatch;
+                d.sim_cosine_batch = &binary::HammingSimBatch;
                 d.quantize = &binary::quantize;
                 d.dequantize = &binary::dequantize;
                 d.quantize_to_int8 = &binary::quantize_to_int8;
                 d.get_storage_size = &binary::get_storage_size;
                 d.extract_scale = &binary::extract_scale;
+                d.prepare_query = &prepare_float_query;
+                d.query_sim_l2 = &binary::QuerySignSim;
+                d.query_sim_ip = &binary::QuerySignSim;
+                d.query_sim_cosine = &binary::QuerySignSim;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&binary::QuerySignSim>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&binary::QuerySignSim>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&binary::QuerySignSim>;
                 return d;
             }
         };
@@ -676,5 +987,5 @@ namespace ndd {
                                             "binary",
                                             std::make_shared<BinaryQuantizer>());
 
-    }  // namespace quant
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
 }  // namespace ndd
@@ -7,22 +7,62 @@
 
 // Include all quantizer implementations to ensure they are registered
 #include "float16.hpp"
+#include "bfloat16.hpp"
+#include "float8.hpp"
 #include "float32.hpp"
 #include "int8d.hpp"
+#include "int8s.hpp"
 #include "int16d.hpp"
+#include "int4d.hpp"
 #include "binary.hpp"
+#include "pq.hpp"
+#include "rabitq.hpp"
 
 namespace ndd {
     namespace quant {
 
-        // The "One Function" to get the behavior
-        inline QuantizerDispatch get_quantizer_dispatch(QuantizationLevel level) {
+        inline std::shared_ptr<Quantizer> get_registered_quantizer(QuantizationLevel level) {
             auto quantizer = QuantizationRegistry::instance().getQuantizer(level);
             if(!quantizer) {
                 throw std::runtime_error("Quantization level not registered: "
                                          + quantLevelToString(level));
             }
-            return quantizer->getDispatch();
+            return quantizer;
+        }
+
+        // The "One Function" to get the behavior
+        inline QuantizerDispatch get_quantizer_dispatch(QuantizationLevel level) {
+            return get_registered_quantizer(level)->getDispatch();
+        }
+
+        // Behavior for an index of dim dimensions, with dimension-specialized kernels when the
+        // level has them for dim
+        inline QuantizerDispatch get_quantizer_dispatch(QuantizationLevel level, size_t dim) {
+            return get_registered_quantizer(level)->getDispatchForDim(dim);
+        }
+
+        // Stored representation of a vector. params are the DistParams of the index space
+        inline std::vector<uint8_t> quantize_vector(const QuantizerDispatch& dispatch,
+                                                    const std::vector<float>& in,
+                                                    const void* params) {
+            return dispatch.encode ? dispatch.encode(in, params) : dispatch.quantize(in);
+        }
+
+        // Representation a query is scored from, the stored one for most levels
+        inline std::vector<uint8_t> quantize_query(const QuantizerDispatch& dispatch,
+                                                   const std::vector<float>& in,
+                                                   const void* params) {
+            if(dispatch.prepare_query) {
+                return dispatch.prepare_query(in, params);
+            }
+            return quantize_vector(dispatch, in, params);
+        }
+
+        inline std::vector<float> dequantize_vector(const QuantizerDispatch& dispatch,
+                                                    const uint8_t* in,
+                                                    size_t dim,
+                                                    const void* params) {
+            return dispatch.decode ? dispatch.decode(in, params) : dispatch.dequantize(in, dim);
         }
 
     }  // namespace quant
@@ -4,13 +4,13 @@
 #include <cmath>
 #include <cstring>
 #include <limits>
-#include "../hnsw/hnswlib.h"
-#include "common.hpp"
+#include "../hnsw/dist_params.h"
+#include "kernels.hpp"
 #include "int8d.hpp"
 
 namespace ndd {
     namespace quant {
-        namespace float16 {
+        namespace float16::inline NDD_SIMD_NAMESPACE {
 
             constexpr size_t get_storage_size(size_t dimension) {
                 return dimension * sizeof(uint16_t);
@@ -399,11 +399,12 @@ namespace ndd {
                 return convert_vector_f16_f32(fp16_data);
             }
 
+            template <size_t DIM = 0>
             static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
                 const uint16_t* pVect1 = (const uint16_t*)pVect1v;
                 const uint16_t* pVect2 = (const uint16_t*)pVect2v;
                 const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
-                size_t qty = params->dim;
+                size_t qty = kernel_dim<DIM>(params->dim);
 
                 float res = 0;
                 size_t i = 0;
@@ -584,25 +585,29 @@ namespace ndd {
                 res = svaddv_f32(svptrue_b32(), sum);
 #endif
 
-                for(; i < qty; i++) {
-                    float v1 = fp16_to_fp32(pVect1[i]);
-                    float v2 = fp16_to_fp32(pVect2[i]);
-                    float diff = v1 - v2;
-                    res += diff * diff;
+                if constexpr(kernel_scalar_tail<DIM>) {
+                    for(; i < qty; i++) {
+                        float v1 = fp16_to_fp32(pVect1[i]);
+                        float v2 = fp16_to_fp32(pVect2[i]);
+                        float diff = v1 - v2;
+                        res += diff * diff;
+                    }
                 }
                 return res;
             }
 
+            template <size_t DIM = 0>
             static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-                return -L2Sqr(pVect1v, pVect2v, qty_ptr);
+                return -L2Sqr<DIM>(pVect1v, pVect2v, qty_ptr);
             }
 
+            template <size_t DIM = 0>
             static float
             InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
                 const uint16_t* pVect1 = (const uint16_t*)pVect1v;
                 const uint16_t* pVect2 = (const uint16_t*)pVect2v;
                 const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
-                size_t qty = params->dim;
+                size_t qty = kernel_dim<DIM>(params->dim);
 
                 float res = 0;
                 size_t i = 0;
@@ -767,33 +772,444 @@ namespace ndd {
                 res = svaddv_f32(svptrue_b32(), sum);
 #endif
 
-                for(; i < qty; i++) {
-                    float v1 = fp16_to_fp32(pVect1[i]);
-                    float v2 = fp16_to_fp32(pVect2[i]);
-                    res += v1 * v2;
+                if constexpr(kernel_scalar_tail<DIM>) {
+                    for(; i < qty; i++) {
+                        float v1 = fp16_to_fp32(pVect1[i]);
+                        float v2 = fp16_to_fp32(pVect2[i]);
+                        res += v1 * v2;
+                    }
                 }
                 return res;
             }
 
+            template <size_t DIM = 0>
             static float
             InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-                return 1.0f - InnerProductSim(pVect1v, pVect2v, qty_ptr);
+                return 1.0f - InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
             }
 
+            template <size_t DIM = 0>
             static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
                 // Vectors are guaranteed normalized => cosine similarity == inner product.
                 // This reuses the same SIMD paths (NEON/AVX512/AVX2) as InnerProductSim.
-                return InnerProductSim(pVect1v, pVect2v, qty_ptr);
+                return InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
             }
 
+            template <size_t DIM = 0>
             static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-                return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
+                return 1.0f - CosineSim<DIM>(pVect1v, pVect2v, qty_ptr);
+            }
+
+            // =============================================================================
+            // BATCH IMPLEMENTATIONS (one query against many vectors)
+            // =============================================================================
+
+            // The *4 kernels score one query against four vectors. Each query chunk is
+            // loaded and widened once and shared by four accumulators, and the four
+            // horizontal sums are reduced together. With l2 set they accumulate squared
+            // differences, otherwise products.
+
+            template <bool l2, size_t DIM = 0>
+            static void Sum4Scalar(const uint16_t* query,
+                                   const uint16_t* const* vectors,
+                                   size_t begin,
+                                   size_t dim,
+                                   float* out) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                for(size_t k = 0; k < 4; k++) {
+                    const uint16_t* vec = vectors[k];
+                    float res = 0;
+                    for(size_t i = begin; i < qty; i++) {
+                        float v1 = fp16_to_fp32(query[i]);
+                        float v2 = fp16_to_fp32(vec[i]);
+                        if constexpr(l2) {
+                            float diff = v1 - v2;
+                            res += diff * diff;
+                        } else {
+                            res += v1 * v2;
+                        }
+                    }
+                    out[k] += res;
+                }
+            }
+
+#if defined(USE_NEON)
+            template <bool l2>
+            inline float32x4_t accumulate_f16_neon(float32x4_t sum, float16x8_t q, float16x8_t v) {
+                if constexpr(l2) {
+                    float16x8_t diff = vsubq_f16(q, v);
+                    sum = vfmlalq_low_f16(sum, diff, diff);
+                    return vfmlalq_high_f16(sum, diff, diff);
+                } else {
+                    sum = vfmlalq_low_f16(sum, q, v);
+                    return vfmlalq_high_f16(sum, q, v);
+                }
+            }
+
+            template <bool l2, size_t DIM = 0>
+            static void Sum4NEON(const uint16_t* query,
+                                 const uint16_t* const* vectors,
+                                 size_t dim,
+                                 float* out) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                const __fp16* v0 = reinterpret_cast<const __fp16*>(vectors[0]);
+                const __fp16* v1 = reinterpret_cast<const __fp16*>(vectors[1]);
+                const __fp16* v2 = reinterpret_cast<const __fp16*>(vectors[2]);
+                const __fp16* v3 = reinterpret_cast<const __fp16*>(vectors[3]);
+                const __fp16* q_ptr = reinterpret_cast<const __fp16*>(query);
+
+                float32x4_t sum0 = vdupq_n_f32(0.0f);
+                float32x4_t sum1 = vdupq_n_f32(0.0f);
+                float32x4_t sum2 = vdupq_n_f32(0.0f);
+                float32x4_t sum3 = vdupq_n_f32(0.0f);
+
+                size_t i = 0;
+                for(; i + 8 <= qty; i += 8) {
+                    float16x8_t q = vld1q_f16(q_ptr + i);
+                    sum0 = accumulate_f16_neon<l2>(sum0, q, vld1q_f16(v0 + i));
+                    sum1 = accumulate_f16_neon<l2>(sum1, q, vld1q_f16(v1 + i));
+                    sum2 = accumulate_f16_neon<l2>(sum2, q, vld1q_f16(v2 + i));
+                    sum3 = accumulate_f16_neon<l2>(sum3, q, vld1q_f16(v3 + i));
+                }
+
+                vst1q_f32(out, ndd::quant::math::hsum4_f32_neon(sum0, sum1, sum2, sum3));
+                if constexpr(kernel_tail<DIM>) {
+                    Sum4Scalar<l2, DIM>(query, vectors, i, qty, out);
+                }
+            }
+#elif defined(USE_AVX512)
+            template <bool l2> inline __m512 accumulate_ps_avx512(__m512 sum, __m512 q, __m512 v) {
+                if constexpr(l2) {
+                    __m512 diff = _mm512_sub_ps(q, v);
+                    return _mm512_fmadd_ps(diff, diff, sum);
+                } else {
+                    return _mm512_fmadd_ps(q, v, sum);
+                }
+            }
+
+            inline __m512 load_f16_as_ps_avx512(const uint16_t* ptr) {
+                return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)));
+            }
+
+            template <bool l2, size_t DIM = 0>
+            static void Sum4AVX512(const uint16_t* query,
+                                   const uint16_t* const* vectors,
+                                   size_t dim,
+                                   float* out) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                __m512 sum0 = _mm512_setzero_ps();
+                __m512 sum1 = _mm512_setzero_ps();
+                __m512 sum2 = _mm512_setzero_ps();
+                __m512 sum3 = _mm512_setzero_ps();
+
+                size_t i = 0;
+                for(; i + 16 <= qty; i += 16) {
+                    __m512 q = load_f16_as_ps_avx512(query + i);
+                    sum0 = accumulate_ps_avx512<l2>(sum0, q, load_f16_as_ps_avx512(vectors[0] + i));
+                    sum1 = accumulate_ps_avx512<l2>(sum1, q, load_f16_as_ps_avx512(vectors[1] + i));
+                    sum2 = accumulate_ps_avx512<l2>(sum2, q, load_f16_as_ps_avx512(vectors[2] + i));
+                    sum3 = accumulate_ps_avx512<l2>(sum3, q, load_f16_as_ps_avx512(vectors[3] + i));
+                }
+
+                _mm_storeu_ps(out, ndd::quant::math::hsum4_ps_avx512(sum0, sum1, sum2, sum3));
+                if constexpr(kernel_tail<DIM>) {
+                    Sum4Scalar<l2, DIM>(query, vectors, i, qty, out);
+                }
+            }
+#elif defined(USE_AVX2)
+            template <bool l2> inline __m256 accumulate_ps_avx2(__m256 sum, __m256 q, __m256 v) {
+                if constexpr(l2) {
+                    __m256 diff = _mm256_sub_ps(q, v);
+                    return _mm256_fmadd_ps(diff, diff, sum);
+                } else {
+                    return _mm256_fmadd_ps(q, v, sum);
+                }
+            }
+
+            inline __m256 load_f16_as_ps_avx2(const uint16_t* ptr) {
+                return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)));
+            }
+
+            template <bool l2, size_t DIM = 0>
+            static void Sum4AVX2(const uint16_t* query,
+                                 const uint16_t* const* vectors,
+                                 size_t dim,
+                                 float* out) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                __m256 sum0 = _mm256_setzero_ps();
+                __m256 sum1 = _mm256_setzero_ps();
+                __m256 sum2 = _mm256_setzero_ps();
+                __m256 sum3 = _mm256_setzero_ps();
+
+                size_t i = 0;
+                for(; i + 8 <= qty; i += 8) {
+                    __m256 q = load_f16_as_ps_avx2(query + i);
+                    sum0 = accumulate_ps_avx2<l2>(sum0, q, load_f16_as_ps_avx2(vectors[0] + i));
+                    sum1 = accumulate_ps_avx2<l2>(sum1, q, load_f16_as_ps_avx2(vectors[1] + i));
+                    sum2 = accumulate_ps_avx2<l2>(sum2, q, load_f16_as_ps_avx2(vectors[2] + i));
+                    sum3 = accumulate_ps_avx2<l2>(sum3, q, load_f16_as_ps_avx2(vectors[3] + i));
+                }
+
+                _mm_storeu_ps(out, ndd::quant::math::hsum4_ps_avx2(sum0, sum1, sum2, sum3));
+                if constexpr(kernel_tail<DIM>) {
+                    Sum4Scalar<l2, DIM>(query, vectors, i, qty, out);
+                }
+            }
+#elif defined(USE_SVE2)
+            template <bool l2>
+            inline svfloat32_t
+            accumulate_f16_sve(svbool_t pg, svfloat32_t sum, svfloat16_t q, svfloat16_t v) {
+                if constexpr(l2) {
+                    svfloat16_t diff = svsub_f16_z(pg, q, v);
+                    sum = svmlalb_f32(sum, diff, diff);
+                    return svmlalt_f32(sum, diff, diff);
+                } else {
+                    sum = svmlalb_f32(sum, q, v);
+                    return svmlalt_f32(sum, q, v);
+                }
+            }
+
+            template <bool l2, size_t DIM = 0>
+            static void Sum4SVE(const uint16_t* query,
+                                const uint16_t* const* vectors,
+                                size_t dim,
+                                float* out) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                const __fp16* v0 = (const __fp16*)vectors[0];
+                const __fp16* v1 = (const __fp16*)vectors[1];
+                const __fp16* v2 = (const __fp16*)vectors[2];
+                const __fp16* v3 = (const __fp16*)vectors[3];
+                const __fp16* q_ptr = (const __fp16*)query;
+
+                svfloat32_t sum0 = svdup_f32(0.0f);
+                svfloat32_t sum1 = svdup_f32(0.0f);
+                svfloat32_t sum2 = svdup_f32(0.0f);
+                svfloat32_t sum3 = svdup_f32(0.0f);
+
+                // Inactive lanes load as zero and add nothing to the sums
+                size_t i = 0;
+                svbool_t pg = svwhilelt_b16(i, qty);
+                while(svptest_any(svptrue_b16(), pg)) {
+                    svfloat16_t q = svld1_f16(pg, q_ptr + i);
+                    sum0 = accumulate_f16_sve<l2>(pg, sum0, q, svld1_f16(pg, v0 + i));
+                    sum1 = accumulate_f16_sve<l2>(pg, sum1, q, svld1_f16(pg, v1 + i));
+                    sum2 = accumulate_f16_sve<l2>(pg, sum2, q, svld1_f16(pg, v2 + i));
+                    sum3 = accumulate_f16_sve<l2>(pg, sum3, q, svld1_f16(pg, v3 + i));
+
+                    i += svcnth();
+                    pg = svwhilelt_b16(i, qty);
+                }
+
+                out[0] = svaddv_f32(svptrue_b32(), sum0);
+                out[1] = svaddv_f32(svptrue_b32(), sum1);
+                out[2] = svaddv_f32(svptrue_b32(), sum2);
+                out[3] = svaddv_f32(svptrue_b32(), sum3);
+            }
+#endif
+
+            template <bool l2, size_t DIM = 0>
+            static void Sum4(const uint16_t* query,
+                             const uint16_t* const* vectors,
+                             size_t dim,
+                             float* out) {
+                const size_t qty = kernel_dim<DIM>(dim);
+#if defined(USE_NEON)
+                Sum4NEON<l2, DIM>(query, vectors, qty, out);
+#elif defined(USE_AVX512)
+                Sum4AVX512<l2, DIM>(query, vectors, qty, out);
+#elif defined(USE_AVX2)
+                Sum4AVX2<l2, DIM>(query, vectors, qty, out);
+#elif defined(USE_SVE2)
+                Sum4SVE<l2, DIM>(query, vectors, qty, out);
+#else
+                out[0] = out[1] = out[2] = out[3] = 0;
+                Sum4Scalar<l2, DIM>(query, vectors, 0, qty, out);
+#endif
+            }
+
+            template <size_t DIM = 0>
+            static void L2SqrSimBatch(const void* query,
+                                      const void* const* vectors,
+                                      size_t count,
+                                      const void* qty_ptr,
+                                      float* out) {
+                const uint16_t* q = (const uint16_t*)query;
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t qty = kernel_dim<DIM>(params->dim);
+
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const uint16_t* group[4] = {(const uint16_t*)vectors[i],
+                                                (const uint16_t*)vectors[i + 1],
+                                                (const uint16_t*)vectors[i + 2],
+                                                (const uint16_t*)vectors[i + 3]};
+                    Sum4<true, DIM>(q, group, qty, out + i);
+                    for(size_t k = 0; k < 4; k++) {
+                        out[i + k] = -out[i + k];
+                    }
+                }
+                for(; i < count; i++) {
+                    out[i] = L2SqrSim<DIM>(query, vectors[i], qty_ptr);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void InnerProductSimBatch(const void* query,
+                                             const void* const* vectors,
+                                             size_t count,
+                                             const void* qty_ptr,
+                                             float* out) {
+                const uint16_t* q = (const uint16_t*)query;
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t qty = kernel_dim<DIM>(params->dim);
+
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const uint16_t* group[4] = {(const uint16_t*)vectors[i],
+                                                (const uint16_t*)vectors[i + 1],
+                                                (const uint16_t*)vectors[i + 2],
+                                                (const uint16_t*)vectors[i + 3]};
+                    Sum4<false, DIM>(q, group, qty, out + i);
+                }
+                for(; i < count; i++) {
+                    out[i] = InnerProductSim<DIM>(query, vectors[i], qty_ptr);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void CosineSimBatch(const void* query,
+                                       const void* const* vectors,
+                                       size_t count,
+                                       const void* qty_ptr,
+                                       float* out) {
+                // Vectors are guaranteed normalized => cosine similarity == inner product.
+                InnerProductSimBatch<DIM>(query, vectors, count, qty_ptr, out);
+            }
+
+            // Float query against stored halves, only the stored side is converted. Squared
+            // differences for l2, otherwise products.
+            template <bool l2, size_t DIM = 0>
+            inline float QuerySum(const float* query, const uint16_t* vec, size_t dim) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_NEON)
+                const __fp16* v_ptr = reinterpret_cast<const __fp16*>(vec);
+                float32x4_t sum0 = vdupq_n_f32(0.0f);
+                float32x4_t sum1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    float16x8_t v = vld1q_f16(v_ptr + i);
+                    float32x4_t v0 = vcvt_f32_f16(vget_low_f16(v));
+                    float32x4_t v1 = vcvt_high_f32_f16(v);
+                    float32x4_t q0 = vld1q_f32(query + i);
+                    float32x4_t q1 = vld1q_f32(query + i + 4);
+                    if constexpr(l2) {
+                        float32x4_t d0 = vsubq_f32(q0, v0);
+                        float32x4_t d1 = vsubq_f32(q1, v1);
+                        sum0 = vfmaq_f32(sum0, d0, d0);
+                        sum1 = vfmaq_f32(sum1, d1, d1);
+                    } else {
+                        sum0 = vfmaq_f32(sum0, q0, v0);
+                        sum1 = vfmaq_f32(sum1, q1, v1);
+                    }
+                }
+                res = vaddvq_f32(vaddq_f32(sum0, sum1));
+#elif defined(USE_AVX512)
+                __m512 sum0 = _mm512_setzero_ps();
+                __m512 sum1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    sum0 = accumulate_ps_avx512<l2>(
+                            sum0, _mm512_loadu_ps(query + i), load_f16_as_ps_avx512(vec + i));
+                    sum1 = accumulate_ps_avx512<l2>(sum1,
+                                                    _mm512_loadu_ps(query + i + 16),
+                                                    load_f16_as_ps_avx512(vec + i + 16));
+                }
+                for(; i + 16 <= qty; i += 16) {
+                    sum0 = accumulate_ps_avx512<l2>(
+                            sum0, _mm512_loadu_ps(query + i), load_f16_as_ps_avx512(vec + i));
+                }
+                res = _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+#elif defined(USE_AVX2)
+                __m256 sum0 = _mm256_setzero_ps();
+                __m256 sum1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    sum0 = accumulate_ps_avx2<l2>(
+                            sum0, _mm256_loadu_ps(query + i), load_f16_as_ps_avx2(vec + i));
+                    sum1 = accumulate_ps_avx2<l2>(
+                            sum1, _mm256_loadu_ps(query + i + 8), load_f16_as_ps_avx2(vec + i + 8));
+                }
+                sum0 = _mm256_add_ps(sum0, sum1);
+                __m128 sum_128 = _mm_add_ps(_mm256_castps256_ps128(sum0),
+                                            _mm256_extractf128_ps(sum0, 1));
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                res = _mm_cvtss_f32(sum_128);
+#endif
+                if constexpr(kernel_scalar_tail<DIM>) {
+                    for(; i < qty; i++) {
+                        float v = fp16_to_fp32(vec[i]);
+                        if constexpr(l2) {
+                            float diff = query[i] - v;
+                            res += diff * diff;
+                        } else {
+                            res += query[i] * v;
+                        }
+                    }
+                }
+                return res;
+            }
+
+            template <size_t DIM = 0>
+            static float QueryL2SqrSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                return -QuerySum<true, DIM>((const float*)query, (const uint16_t*)vec, qty);
+            }
+
+            template <size_t DIM = 0>
+            static float
+            QueryInnerProductSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                return QuerySum<false, DIM>((const float*)query, (const uint16_t*)vec, qty);
+            }
+
+            template <size_t DIM = 0>
+            static float QueryCosineSim(const void* query, const void* vec, const void* qty_ptr) {
+                // Vectors are guaranteed normalized => cosine similarity == inner product.
+                return QueryInnerProductSim<DIM>(query, vec, qty_ptr);
+            }
+
+            // L2 query scoring that gives up on a vector once its partial squared distance
+            // already rules it out. Exact, since the partial sums only grow
+            static float
+            QueryL2SqrSimBounded(const float* query, const uint16_t* vec, size_t qty, float bound) {
+                float dist = 0.0f;
+                size_t i = 0;
+                for(; i + ABANDON_BLOCK <= qty; i += ABANDON_BLOCK) {
+                    dist += QuerySum<true, ABANDON_BLOCK>(query + i, vec + i, ABANDON_BLOCK);
+                    if(-dist <= bound) {
+                        return -dist;
+                    }
+                }
+                return -(dist + QuerySum<true>(query + i, vec + i, qty - i));
+            }
+
+            template <size_t DIM = 0>
+            static void QueryL2SqrSimBatchBounded(const void* query,
+                                                  const void* const* vectors,
+                                                  size_t count,
+                                                  const void* qty_ptr,
+                                                  float bound,
+                                                  float* out) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                for(size_t i = 0; i < count; i++) {
+                    out[i] = QueryL2SqrSimBounded(
+                            (const float*)query, (const uint16_t*)vectors[i], qty, bound);
+                }
             }
 
             static std::vector<uint8_t> quantize_to_int8(const void* in, size_t dim) {
                 const uint16_t* input = static_cast<const uint16_t*>(in);
-                // Calculate storage size: dim bytes for data + 4 bytes for scale
-                size_t buffer_size = dim * sizeof(int8_t) + sizeof(float);
+                size_t buffer_size = ndd::quant::int8d::get_storage_size(dim);
                 std::vector<uint8_t> buffer(buffer_size);
                 int8_t* data_ptr = reinterpret_cast<int8_t*>(buffer.data());
                 float scale;
@@ -1060,30 +1476,53 @@ namespace ndd {
 
                 float* scale_ptr = reinterpret_cast<float*>(buffer.data() + dim);
                 *scale_ptr = abs_max / 127.0f;
+                ndd::quant::int8d::store_squared_norm(buffer.data(), dim);
 
                 return buffer;
             }
 
-        }  // namespace float16
+        }  // namespace float16::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
 
         class Float16Quantizer : public Quantizer {
         public:
             std::string name() const override { return "float16"; }
             QuantizationLevel level() const override { return QuantizationLevel::FP16; }
 
-            QuantizerDispatch getDispatch() const override {
+            QuantizerDispatch getDispatch() const override { return makeDispatch<0>(); }
+
+            QuantizerDispatch getDispatchForDim(size_t dim) const override {
+                return dispatch_for_dim(dim, []<size_t DIM>() { return makeDispatch<DIM>(); });
+            }
+
+        private:
+            template <size_t DIM> static QuantizerDispatch makeDispatch() {
                 QuantizerDispatch d;
-                d.dist_l2 = &float16::L2Sqr;
-                d.dist_ip = &float16::InnerProduct;
-                d.dist_cosine = &float16::Cosine;
-                d.sim_l2 = &float16::L2SqrSim;
-                d.sim_ip = &float16::InnerProductSim;
-                d.sim_cosine = &float16::CosineSim;
+                d.dist_l2 = &float16::L2Sqr<DIM>;
+                d.dist_ip = &float16::InnerProduct<DIM>;
+                d.dist_cosine = &float16::Cosine<DIM>;
+                d.sim_l2 = &float16::L2SqrSim<DIM>;
+                d.sim_ip = &float16::InnerProductSim<DIM>;
+                d.sim_cosine = &float16::CosineSim<DIM>;
+                d.sim_l2_batch = &float16::L2SqrSimBatch<DIM>;
+                d.sim_ip_batch = &float16::InnerProductSimBatch<DIM>;
+                d.sim_cosine_batch = &float16::CosineSimBatch<DIM>;
                 d.quantize = &float16::quantize;
                 d.dequantize = &float16::dequantize;
                 d.quantize_to_int8 = &float16::quantize_to_int8;
                 d.get_storage_size = &float16::get_storage_size;
                 d.extract_scale = &float16::extract_scale;
+                d.prepare_query = &prepare_float_query;
+                d.query_sim_l2 = &float16::QueryL2SqrSim<DIM>;
+                d.query_sim_ip = &float16::QueryInnerProductSim<DIM>;
+                d.query_sim_cosine = &float16::QueryCosineSim<DIM>;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&float16::QueryL2SqrSim<DIM>>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&float16::QueryInnerProductSim<DIM>>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&float16::QueryCosineSim<DIM>>;
+                // Without stored norms only L2 can be bounded before the end
+                d.query_sim_l2_batch_bounded = &float16::QueryL2SqrSimBatchBounded<DIM>;
                 return d;
             }
         };
@@ -1092,5 +1531,5 @@ namespace ndd {
         static RegisterQuantizer
                 reg_fp16(QuantizationLevel::FP16, "float16", std::make_shared<Float16Quantizer>());
 
-    }  // namespace quant
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
 }  // namespace ndd
@@ -1,6 +1,6 @@
 #pragma once
-#include "../hnsw/hnswlib.h"
-#include "../quant/common.hpp"
+#include "../hnsw/dist_params.h"
+#include "kernels.hpp"
 #include "int8d.hpp"
 #include <vector>
 #include <cmath>
@@ -8,7 +8,7 @@
 
 namespace hnswlib {
     namespace quant {
-        namespace float32 {
+        namespace float32::inline NDD_SIMD_NAMESPACE {
 
             // =============================================================================
             // QUANTIZATION / DEQUANTIZATION
@@ -50,7 +50,9 @@ namespace hnswlib {
             // DISTANCE IMPLEMENTATIONS
             // =============================================================================
 
-            static float L2SqrScalar(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float L2SqrScalar(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
                 float res = 0;
@@ -61,7 +63,9 @@ namespace hnswlib {
                 return res;
             }
 
-            static float InnerProductScalar(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float InnerProductScalar(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
                 float res = 0;
@@ -72,7 +76,9 @@ namespace hnswlib {
             }
 
 #if defined(USE_NEON)
-            static float L2SqrNEON(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float L2SqrNEON(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -122,7 +128,9 @@ namespace hnswlib {
                 return res;
             }
 
-            static float InnerProductNEON(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float InnerProductNEON(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -169,7 +177,9 @@ namespace hnswlib {
 #endif
 
 #if defined(USE_AVX512)
-            static float L2SqrAVX512(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float L2SqrAVX512(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -198,7 +208,9 @@ namespace hnswlib {
                 return res;
             }
 
-            static float InnerProductAVX512(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float InnerProductAVX512(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -227,7 +239,9 @@ namespace hnswlib {
 #endif
 
 #if defined(USE_AVX2)
-            static float L2SqrAVX2(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float L2SqrAVX2(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -266,7 +280,9 @@ namespace hnswlib {
                 return res;
             }
 
-            static float InnerProductAVX2(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float InnerProductAVX2(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -305,7 +321,9 @@ namespace hnswlib {
 #endif
 
 #if defined(USE_SVE2)
-            static float L2SqrSVE(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float L2SqrSVE(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -363,7 +381,9 @@ namespace hnswlib {
                 return svaddv_f32(svptrue_b32(), sum);
             }
 
-            static float InnerProductSVE(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float InnerProductSVE(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
                 const float* vec1 = reinterpret_cast<const float*>(pVect1);
                 const float* vec2 = reinterpret_cast<const float*>(pVect2);
 
@@ -417,145 +437,574 @@ namespace hnswlib {
             }
 #endif
 
-            static float L2Sqr(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float L2Sqr(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
 #if defined(USE_AVX512)
-                return L2SqrAVX512(pVect1, pVect2, qty);
+                return L2SqrAVX512<DIM>(pVect1, pVect2, qty);
 #elif defined(USE_SVE2)
-                return L2SqrSVE(pVect1, pVect2, qty);
+                return L2SqrSVE<DIM>(pVect1, pVect2, qty);
 #elif defined(USE_AVX2)
-                return L2SqrAVX2(pVect1, pVect2, qty);
+                return L2SqrAVX2<DIM>(pVect1, pVect2, qty);
 #elif defined(USE_NEON)
-                return L2SqrNEON(pVect1, pVect2, qty);
+                return L2SqrNEON<DIM>(pVect1, pVect2, qty);
 #else
-                return L2SqrScalar(pVect1, pVect2, qty);
+                return L2SqrScalar<DIM>(pVect1, pVect2, qty);
 #endif
             }
 
-            static float InnerProduct(const void* pVect1, const void* pVect2, size_t qty) {
+            template <size_t DIM = 0>
+            static float InnerProduct(const void* pVect1, const void* pVect2, size_t dim) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
 #if defined(USE_AVX512)
-                return InnerProductAVX512(pVect1, pVect2, qty);
+                return InnerProductAVX512<DIM>(pVect1, pVect2, qty);
 #elif defined(USE_SVE2)
-                return InnerProductSVE(pVect1, pVect2, qty);
+                return InnerProductSVE<DIM>(pVect1, pVect2, qty);
 #elif defined(USE_AVX2)
-                return InnerProductAVX2(pVect1, pVect2, qty);
+                return InnerProductAVX2<DIM>(pVect1, pVect2, qty);
 #elif defined(USE_NEON)
-                return InnerProductNEON(pVect1, pVect2, qty);
+                return InnerProductNEON<DIM>(pVect1, pVect2, qty);
 #else
-                return InnerProductScalar(pVect1, pVect2, qty);
+                return InnerProductScalar<DIM>(pVect1, pVect2, qty);
 #endif
             }
 
+            // =============================================================================
+            // BATCH IMPLEMENTATIONS (one query against many vectors)
+            // =============================================================================
+
+            // The *4 kernels score one query against four vectors. Each query chunk is
+            // loaded once and shared by four accumulators, and the four horizontal sums are
+            // reduced together.
+
+            template <size_t DIM = 0>
+            static void InnerProduct4Scalar(const float* query,
+                                            const float* const* vectors,
+                                            size_t begin,
+                                            size_t dim,
+                                            float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                for(size_t k = 0; k < 4; k++) {
+                    const float* vec = vectors[k];
+                    float res = 0;
+                    for(size_t i = begin; i < qty; i++) {
+                        res += query[i] * vec[i];
+                    }
+                    out[k] += res;
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void L2Sqr4Scalar(const float* query,
+                                     const float* const* vectors,
+                                     size_t begin,
+                                     size_t dim,
+                                     float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                for(size_t k = 0; k < 4; k++) {
+                    const float* vec = vectors[k];
+                    float res = 0;
+                    for(size_t i = begin; i < qty; i++) {
+                        float diff = query[i] - vec[i];
+                        res += diff * diff;
+                    }
+                    out[k] += res;
+                }
+            }
+
+#if defined(USE_AVX512)
+            template <size_t DIM = 0>
+            static void InnerProduct4AVX512(const float* query,
+                                            const float* const* vectors,
+                                            size_t dim,
+                                            float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                __m512 sum0 = _mm512_setzero_ps();
+                __m512 sum1 = _mm512_setzero_ps();
+                __m512 sum2 = _mm512_setzero_ps();
+                __m512 sum3 = _mm512_setzero_ps();
+
+                size_t i = 0;
+                for(; i + 16 <= qty; i += 16) {
+                    __m512 q = _mm512_loadu_ps(query + i);
+                    sum0 = _mm512_fmadd_ps(q, _mm512_loadu_ps(v0 + i), sum0);
+                    sum1 = _mm512_fmadd_ps(q, _mm512_loadu_ps(v1 + i), sum1);
+                    sum2 = _mm512_fmadd_ps(q, _mm512_loadu_ps(v2 + i), sum2);
+                    sum3 = _mm512_fmadd_ps(q, _mm512_loadu_ps(v3 + i), sum3);
+                }
+
+                // Masked tail keeps the remainder in registers
+                if constexpr(ndd::quant::kernel_tail<DIM>) {
+                    if(i < qty) {
+                        __mmask16 mask = (__mmask16)((1u << (qty - i)) - 1);
+                        __m512 q = _mm512_maskz_loadu_ps(mask, query + i);
+                        sum0 = _mm512_fmadd_ps(q, _mm512_maskz_loadu_ps(mask, v0 + i), sum0);
+                        sum1 = _mm512_fmadd_ps(q, _mm512_maskz_loadu_ps(mask, v1 + i), sum1);
+                        sum2 = _mm512_fmadd_ps(q, _mm512_maskz_loadu_ps(mask, v2 + i), sum2);
+                        sum3 = _mm512_fmadd_ps(q, _mm512_maskz_loadu_ps(mask, v3 + i), sum3);
+                    }
+                }
+
+                _mm_storeu_ps(out, ndd::quant::math::hsum4_ps_avx512(sum0, sum1, sum2, sum3));
+            }
+
+            template <size_t DIM = 0>
+            static void
+            L2Sqr4AVX512(const float* query, const float* const* vectors, size_t dim, float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                __m512 sum0 = _mm512_setzero_ps();
+                __m512 sum1 = _mm512_setzero_ps();
+                __m512 sum2 = _mm512_setzero_ps();
+                __m512 sum3 = _mm512_setzero_ps();
+
+                size_t i = 0;
+                for(; i + 16 <= qty; i += 16) {
+                    __m512 q = _mm512_loadu_ps(query + i);
+                    __m512 d0 = _mm512_sub_ps(q, _mm512_loadu_ps(v0 + i));
+                    __m512 d1 = _mm512_sub_ps(q, _mm512_loadu_ps(v1 + i));
+                    __m512 d2 = _mm512_sub_ps(q, _mm512_loadu_ps(v2 + i));
+                    __m512 d3 = _mm512_sub_ps(q, _mm512_loadu_ps(v3 + i));
+                    sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+                    sum1 = _mm512_fmadd_ps(d1, d1, sum1);
+                    sum2 = _mm512_fmadd_ps(d2, d2, sum2);
+                    sum3 = _mm512_fmadd_ps(d3, d3, sum3);
+                }
+
+                if constexpr(ndd::quant::kernel_tail<DIM>) {
+                    if(i < qty) {
+                        __mmask16 mask = (__mmask16)((1u << (qty - i)) - 1);
+                        __m512 q = _mm512_maskz_loadu_ps(mask, query + i);
+                        __m512 d0 = _mm512_sub_ps(q, _mm512_maskz_loadu_ps(mask, v0 + i));
+                        __m512 d1 = _mm512_sub_ps(q, _mm512_maskz_loadu_ps(mask, v1 + i));
+                        __m512 d2 = _mm512_sub_ps(q, _mm512_maskz_loadu_ps(mask, v2 + i));
+                        __m512 d3 = _mm512_sub_ps(q, _mm512_maskz_loadu_ps(mask, v3 + i));
+                        sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+                        sum1 = _mm512_fmadd_ps(d1, d1, sum1);
+                        sum2 = _mm512_fmadd_ps(d2, d2, sum2);
+                        sum3 = _mm512_fmadd_ps(d3, d3, sum3);
+                    }
+                }
+
+                _mm_storeu_ps(out, ndd::quant::math::hsum4_ps_avx512(sum0, sum1, sum2, sum3));
+            }
+#endif
+
+#if defined(USE_AVX2)
+            template <size_t DIM = 0>
+            static void InnerProduct4AVX2(const float* query,
+                                          const float* const* vectors,
+                                          size_t dim,
+                                          float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                __m256 sum0 = _mm256_setzero_ps();
+                __m256 sum1 = _mm256_setzero_ps();
+                __m256 sum2 = _mm256_setzero_ps();
+                __m256 sum3 = _mm256_setzero_ps();
+
+                size_t i = 0;
+                for(; i + 8 <= qty; i += 8) {
+                    __m256 q = _mm256_loadu_ps(query + i);
+                    sum0 = _mm256_fmadd_ps(q, _mm256_loadu_ps(v0 + i), sum0);
+                    sum1 = _mm256_fmadd_ps(q, _mm256_loadu_ps(v1 + i), sum1);
+                    sum2 = _mm256_fmadd_ps(q, _mm256_loadu_ps(v2 + i), sum2);
+                    sum3 = _mm256_fmadd_ps(q, _mm256_loadu_ps(v3 + i), sum3);
+                }
+
+                _mm_storeu_ps(out, ndd::quant::math::hsum4_ps_avx2(sum0, sum1, sum2, sum3));
+                if constexpr(ndd::quant::kernel_tail<DIM>) {
+                    InnerProduct4Scalar<DIM>(query, vectors, i, qty, out);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void
+            L2Sqr4AVX2(const float* query, const float* const* vectors, size_t dim, float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                __m256 sum0 = _mm256_setzero_ps();
+                __m256 sum1 = _mm256_setzero_ps();
+                __m256 sum2 = _mm256_setzero_ps();
+                __m256 sum3 = _mm256_setzero_ps();
+
+                size_t i = 0;
+                for(; i + 8 <= qty; i += 8) {
+                    __m256 q = _mm256_loadu_ps(query + i);
+                    __m256 d0 = _mm256_sub_ps(q, _mm256_loadu_ps(v0 + i));
+                    __m256 d1 = _mm256_sub_ps(q, _mm256_loadu_ps(v1 + i));
+                    __m256 d2 = _mm256_sub_ps(q, _mm256_loadu_ps(v2 + i));
+                    __m256 d3 = _mm256_sub_ps(q, _mm256_loadu_ps(v3 + i));
+                    sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+                    sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+                    sum2 = _mm256_fmadd_ps(d2, d2, sum2);
+                    sum3 = _mm256_fmadd_ps(d3, d3, sum3);
+                }
+
+                _mm_storeu_ps(out, ndd::quant::math::hsum4_ps_avx2(sum0, sum1, sum2, sum3));
+                if constexpr(ndd::quant::kernel_tail<DIM>) {
+                    L2Sqr4Scalar<DIM>(query, vectors, i, qty, out);
+                }
+            }
+#endif
+
+#if defined(USE_SVE2)
+            template <size_t DIM = 0>
+            static void InnerProduct4SVE(const float* query,
+                                         const float* const* vectors,
+                                         size_t dim,
+                                         float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                svfloat32_t sum0 = svdup_f32(0.0f);
+                svfloat32_t sum1 = svdup_f32(0.0f);
+                svfloat32_t sum2 = svdup_f32(0.0f);
+                svfloat32_t sum3 = svdup_f32(0.0f);
+
+                // Inactive lanes load as zero, so the predicated loop also covers the tail
+                size_t i = 0;
+                svbool_t pg = svwhilelt_b32(i, qty);
+                while(svptest_any(svptrue_b32(), pg)) {
+                    svfloat32_t q = svld1_f32(pg, query + i);
+                    sum0 = svmla_f32_m(pg, sum0, q, svld1_f32(pg, v0 + i));
+                    sum1 = svmla_f32_m(pg, sum1, q, svld1_f32(pg, v1 + i));
+                    sum2 = svmla_f32_m(pg, sum2, q, svld1_f32(pg, v2 + i));
+                    sum3 = svmla_f32_m(pg, sum3, q, svld1_f32(pg, v3 + i));
+
+                    i += svcntw();
+                    pg = svwhilelt_b32(i, qty);
+                }
+
+                out[0] = svaddv_f32(svptrue_b32(), sum0);
+                out[1] = svaddv_f32(svptrue_b32(), sum1);
+                out[2] = svaddv_f32(svptrue_b32(), sum2);
+                out[3] = svaddv_f32(svptrue_b32(), sum3);
+            }
+
+            template <size_t DIM = 0>
+            static void
+            L2Sqr4SVE(const float* query, const float* const* vectors, size_t dim, float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                svfloat32_t sum0 = svdup_f32(0.0f);
+                svfloat32_t sum1 = svdup_f32(0.0f);
+                svfloat32_t sum2 = svdup_f32(0.0f);
+                svfloat32_t sum3 = svdup_f32(0.0f);
+
+                size_t i = 0;
+                svbool_t pg = svwhilelt_b32(i, qty);
+                while(svptest_any(svptrue_b32(), pg)) {
+                    svfloat32_t q = svld1_f32(pg, query + i);
+                    svfloat32_t d0 = svsub_f32_z(pg, q, svld1_f32(pg, v0 + i));
+                    svfloat32_t d1 = svsub_f32_z(pg, q, svld1_f32(pg, v1 + i));
+                    svfloat32_t d2 = svsub_f32_z(pg, q, svld1_f32(pg, v2 + i));
+                    svfloat32_t d3 = svsub_f32_z(pg, q, svld1_f32(pg, v3 + i));
+                    sum0 = svmla_f32_m(pg, sum0, d0, d0);
+                    sum1 = svmla_f32_m(pg, sum1, d1, d1);
+                    sum2 = svmla_f32_m(pg, sum2, d2, d2);
+                    sum3 = svmla_f32_m(pg, sum3, d3, d3);
+
+                    i += svcntw();
+                    pg = svwhilelt_b32(i, qty);
+                }
+
+                out[0] = svaddv_f32(svptrue_b32(), sum0);
+                out[1] = svaddv_f32(svptrue_b32(), sum1);
+                out[2] = svaddv_f32(svptrue_b32(), sum2);
+                out[3] = svaddv_f32(svptrue_b32(), sum3);
+            }
+#endif
+
+#if defined(USE_NEON)
+            template <size_t DIM = 0>
+            static void InnerProduct4NEON(const float* query,
+                                          const float* const* vectors,
+                                          size_t dim,
+                                          float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                float32x4_t sum0 = vdupq_n_f32(0);
+                float32x4_t sum1 = vdupq_n_f32(0);
+                float32x4_t sum2 = vdupq_n_f32(0);
+                float32x4_t sum3 = vdupq_n_f32(0);
+
+                size_t i = 0;
+                for(; i + 4 <= qty; i += 4) {
+                    float32x4_t q = vld1q_f32(query + i);
+                    sum0 = vfmaq_f32(sum0, q, vld1q_f32(v0 + i));
+                    sum1 = vfmaq_f32(sum1, q, vld1q_f32(v1 + i));
+                    sum2 = vfmaq_f32(sum2, q, vld1q_f32(v2 + i));
+                    sum3 = vfmaq_f32(sum3, q, vld1q_f32(v3 + i));
+                }
+
+                vst1q_f32(out, ndd::quant::math::hsum4_f32_neon(sum0, sum1, sum2, sum3));
+                if constexpr(ndd::quant::kernel_tail<DIM>) {
+                    InnerProduct4Scalar<DIM>(query, vectors, i, qty, out);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void
+            L2Sqr4NEON(const float* query, const float* const* vectors, size_t dim, float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+                const float* v0 = vectors[0];
+                const float* v1 = vectors[1];
+                const float* v2 = vectors[2];
+                const float* v3 = vectors[3];
+
+                float32x4_t sum0 = vdupq_n_f32(0);
+                float32x4_t sum1 = vdupq_n_f32(0);
+                float32x4_t sum2 = vdupq_n_f32(0);
+                float32x4_t sum3 = vdupq_n_f32(0);
+
+                size_t i = 0;
+                for(; i + 4 <= qty; i += 4) {
+                    float32x4_t q = vld1q_f32(query + i);
+                    float32x4_t d0 = vsubq_f32(q, vld1q_f32(v0 + i));
+                    float32x4_t d1 = vsubq_f32(q, vld1q_f32(v1 + i));
+                    float32x4_t d2 = vsubq_f32(q, vld1q_f32(v2 + i));
+                    float32x4_t d3 = vsubq_f32(q, vld1q_f32(v3 + i));
+                    sum0 = vfmaq_f32(sum0, d0, d0);
+                    sum1 = vfmaq_f32(sum1, d1, d1);
+                    sum2 = vfmaq_f32(sum2, d2, d2);
+                    sum3 = vfmaq_f32(sum3, d3, d3);
+                }
+
+                vst1q_f32(out, ndd::quant::math::hsum4_f32_neon(sum0, sum1, sum2, sum3));
+                if constexpr(ndd::quant::kernel_tail<DIM>) {
+                    L2Sqr4Scalar<DIM>(query, vectors, i, qty, out);
+                }
+            }
+#endif
+
+            template <size_t DIM = 0>
+            static void
+            InnerProduct4(const float* query, const float* const* vectors, size_t dim, float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+#if defined(USE_AVX512)
+                InnerProduct4AVX512<DIM>(query, vectors, qty, out);
+#elif defined(USE_SVE2)
+                InnerProduct4SVE<DIM>(query, vectors, qty, out);
+#elif defined(USE_AVX2)
+                InnerProduct4AVX2<DIM>(query, vectors, qty, out);
+#elif defined(USE_NEON)
+                InnerProduct4NEON<DIM>(query, vectors, qty, out);
+#else
+                out[0] = out[1] = out[2] = out[3] = 0;
+                InnerProduct4Scalar<DIM>(query, vectors, 0, qty, out);
+#endif
+            }
+
+            template <size_t DIM = 0>
+            static void
+            L2Sqr4(const float* query, const float* const* vectors, size_t dim, float* out) {
+                const size_t qty = ndd::quant::kernel_dim<DIM>(dim);
+#if defined(USE_AVX512)
+                L2Sqr4AVX512<DIM>(query, vectors, qty, out);
+#elif defined(USE_SVE2)
+                L2Sqr4SVE<DIM>(query, vectors, qty, out);
+#elif defined(USE_AVX2)
+                L2Sqr4AVX2<DIM>(query, vectors, qty, out);
+#elif defined(USE_NEON)
+                L2Sqr4NEON<DIM>(query, vectors, qty, out);
+#else
+                out[0] = out[1] = out[2] = out[3] = 0;
+                L2Sqr4Scalar<DIM>(query, vectors, 0, qty, out);
+#endif
+            }
+
+            template <size_t DIM = 0>
+            static void L2SqrSimBatch(const void* query,
+                                      const void* const* vectors,
+                                      size_t count,
+                                      const void* params_ptr,
+                                      float* out) {
+                const DistParams* params = reinterpret_cast<const DistParams*>(params_ptr);
+                const float* q = reinterpret_cast<const float*>(query);
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const float* group[4] = {reinterpret_cast<const float*>(vectors[i]),
+                                             reinterpret_cast<const float*>(vectors[i + 1]),
+                                             reinterpret_cast<const float*>(vectors[i + 2]),
+                                             reinterpret_cast<const float*>(vectors[i + 3])};
+                    L2Sqr4<DIM>(q, group, params->dim, out + i);
+                    for(size_t k = 0; k < 4; k++) {
+                        out[i + k] = -out[i + k];
+                    }
+                }
+                for(; i < count; i++) {
+                    out[i] = -L2Sqr<DIM>(query, vectors[i], params->dim);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void InnerProductSimBatch(const void* query,
+                                             const void* const* vectors,
+                                             size_t count,
+                                             const void* params_ptr,
+                                             float* out) {
+                const DistParams* params = reinterpret_cast<const DistParams*>(params_ptr);
+                const float* q = reinterpret_cast<const float*>(query);
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const float* group[4] = {reinterpret_cast<const float*>(vectors[i]),
+                                             reinterpret_cast<const float*>(vectors[i + 1]),
+                                             reinterpret_cast<const float*>(vectors[i + 2]),
+                                             reinterpret_cast<const float*>(vectors[i + 3])};
+                    InnerProduct4<DIM>(q, group, params->dim, out + i);
+                }
+                for(; i < count; i++) {
+                    out[i] = InnerProduct<DIM>(query, vectors[i], params->dim);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void CosineSimBatch(const void* query,
+                                       const void* const* vectors,
+                                       size_t count,
+                                       const void* params_ptr,
+                                       float* out) {
+                InnerProductSimBatch<DIM>(query, vectors, count, params_ptr, out);
+            }
+
+            template <size_t DIM = 0>
             static float
             L2SqrDistance(const void* pVect1, const void* pVect2, const void* params_ptr) {
                 const DistParams* params = reinterpret_cast<const DistParams*>(params_ptr);
-                return L2Sqr(pVect1, pVect2, params->dim);
+                return L2Sqr<DIM>(pVect1, pVect2, params->dim);
             }
 
+            template <size_t DIM = 0>
             static float L2SqrSim(const void* pVect1, const void* pVect2, const void* params_ptr) {
-                return -L2SqrDistance(pVect1, pVect2, params_ptr);
+                return -L2SqrDistance<DIM>(pVect1, pVect2, params_ptr);
             }
 
+            template <size_t DIM = 0>
             static float
             InnerProductSim(const void* pVect1, const void* pVect2, const void* params_ptr) {
                 const DistParams* params = reinterpret_cast<const DistParams*>(params_ptr);
-                return InnerProduct(pVect1, pVect2, params->dim);
+                return InnerProduct<DIM>(pVect1, pVect2, params->dim);
             }
 
+            template <size_t DIM = 0>
             static float CosineSim(const void* pVect1, const void* pVect2, const void* params_ptr) {
-                return InnerProductSim(pVect1, pVect2, params_ptr);
+                return InnerProductSim<DIM>(pVect1, pVect2, params_ptr);
             }
 
+            template <size_t DIM = 0>
             static float
             InnerProductDistance(const void* pVect1, const void* pVect2, const void* params_ptr) {
                 const DistParams* params = reinterpret_cast<const DistParams*>(params_ptr);
-                return 1.0f - InnerProduct(pVect1, pVect2, params->dim);
+                return 1.0f - InnerProduct<DIM>(pVect1, pVect2, params->dim);
             }
 
+            template <size_t DIM = 0>
             static float
             CosineDistance(const void* pVect1, const void* pVect2, const void* params_ptr) {
                 // For normalized vectors, Cosine distance is same as Inner Product distance
-                return InnerProductDistance(pVect1, pVect2, params_ptr);
+                return InnerProductDistance<DIM>(pVect1, pVect2, params_ptr);
             }
 
-        }  //namespace float32
-    }  // namespace quant
+            // L2 scoring that gives up on a vector once its partial squared distance already
+            // rules it out. Exact, since the partial sums only grow
+            static float
+            L2SqrSimBounded(const float* query, const float* vec, size_t qty, float bound) {
+                constexpr size_t block = ndd::quant::ABANDON_BLOCK;
+                float dist = 0.0f;
+                size_t i = 0;
+                for(; i + block <= qty; i += block) {
+                    dist += L2Sqr<block>(query + i, vec + i, block);
+                    if(-dist <= bound) {
+                        return -dist;
+                    }
+                }
+                return -(dist + L2Sqr(query + i, vec + i, qty - i));
+            }
 
-    class FP32Space : public SpaceInterface<float> {
-    private:
-        size_t dim_;
-        size_t data_size_;
-        DistParams dist_params_;
-        SpaceType space_type_;
-
-    public:
-        FP32Space(SpaceType space_type, size_t dim) :
-            dim_(dim),
-            space_type_(space_type) {
-            data_size_ = dim * sizeof(float);
-            dist_params_.dim = dim;
-            dist_params_.quant_level = static_cast<uint8_t>(ndd::quant::QuantizationLevel::FP32);
-        }
-
-        size_t get_data_size() override { return data_size_; }
-
-        DISTFUNC<float> get_dist_func() override {
-            switch(space_type_) {
-                case L2_SPACE:
-                    return quant::float32::L2SqrDistance;
-                case IP_SPACE:
-                    return quant::float32::InnerProductDistance;
-                case COSINE_SPACE:
-                    return quant::float32::CosineDistance;
-                default:
-                    throw std::runtime_error("Unknown space type");
-            }
-        }
-
-        SIMFUNC<float> get_sim_func() override {
-            switch(space_type_) {
-                case L2_SPACE:
-                    return [](const void* v1, const void* v2, const void* param) -> float {
-                        const DistParams* params = reinterpret_cast<const DistParams*>(param);
-                        return -quant::float32::L2Sqr(
-                                v1, v2, params->dim);  // Negative L2 for similarity
-                    };
-                case IP_SPACE:
-                case COSINE_SPACE:
-                    return [](const void* v1, const void* v2, const void* param) -> float {
-                        const DistParams* params = reinterpret_cast<const DistParams*>(param);
-                        return quant::float32::InnerProduct(v1, v2, params->dim);
-                    };
-                default:
-                    throw std::runtime_error("Unknown space type");
-            }
-        }
-
-        void* get_dist_func_param() override { return &dist_params_; }
-    };
+            template <size_t DIM = 0>
+            static void L2SqrSimBatchBounded(const void* query,
+                                             const void* const* vectors,
+                                             size_t count,
+                                             const void* params_ptr,
+                                             float bound,
+                                             float* out) {
+                const DistParams* params = reinterpret_cast<const DistParams*>(params_ptr);
+                size_t qty = ndd::quant::kernel_dim<DIM>(params->dim);
+                const float* q = reinterpret_cast<const float*>(query);
+                for(size_t i = 0; i < count; i++) {
+                    const float* vec = reinterpret_cast<const float*>(vectors[i]);
+                    out[i] = L2SqrSimBounded(q, vec, qty, bound);
+                }
+            }
 
+        }  // namespace float32::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
 }  // namespace hnswlib
 
 namespace ndd {
-    namespace quant {
+    namespace quant::inline NDD_SIMD_NAMESPACE {
 
         class Float32Quantizer : public Quantizer {
         public:
             std::string name() const override { return "float32"; }
             QuantizationLevel level() const override { return QuantizationLevel::FP32; }
 
-            QuantizerDispatch getDispatch() const override {
+            QuantizerDispatch getDispatch() const override { return makeDispatch<0>(); }
+
+            QuantizerDispatch getDispatchForDim(size_t dim) const override {
+                return dispatch_for_dim(dim, []<size_t DIM>() { return makeDispatch<DIM>(); });
+            }
+
+        private:
+            template <size_t DIM> static QuantizerDispatch makeDispatch() {
                 QuantizerDispatch d;
-                d.dist_l2 = &hnswlib::quant::float32::L2SqrDistance;
-                d.dist_ip = &hnswlib::quant::float32::InnerProductDistance;
-                d.dist_cosine = &hnswlib::quant::float32::CosineDistance;
-                d.sim_l2 = &hnswlib::quant::float32::L2SqrSim;
-                d.sim_ip = &hnswlib::quant::float32::InnerProductSim;
-                d.sim_cosine = &hnswlib::quant::float32::CosineSim;
+                d.dist_l2 = &hnswlib::quant::float32::L2SqrDistance<DIM>;
+                d.dist_ip = &hnswlib::quant::float32::InnerProductDistance<DIM>;
+                d.dist_cosine = &hnswlib::quant::float32::CosineDistance<DIM>;
+                d.sim_l2 = &hnswlib::quant::float32::L2SqrSim<DIM>;
+                d.sim_ip = &hnswlib::quant::float32::InnerProductSim<DIM>;
+                d.sim_cosine = &hnswlib::quant::float32::CosineSim<DIM>;
+                d.sim_l2_batch = &hnswlib::quant::float32::L2SqrSimBatch<DIM>;
+                d.sim_ip_batch = &hnswlib::quant::float32::InnerProductSimBatch<DIM>;
+                d.sim_cosine_batch = &hnswlib::quant::float32::CosineSimBatch<DIM>;
                 d.quantize = &hnswlib::quant::float32::quantize;
                 d.dequantize = &hnswlib::quant::float32::dequantize;
                 d.quantize_to_int8 = &hnswlib::quant::float32::quantize_to_int8;
                 d.get_storage_size = [](size_t dim) { return dim * sizeof(float); };
                 d.extract_scale = &hnswlib::quant::float32::extract_scale;
+                // Stored vectors are a prefix of the prepared query, the sim functions score both
+                d.prepare_query = &prepare_float_query;
+                // Without stored norms only L2 can be bounded before the end
+                d.query_sim_l2_batch_bounded = &hnswlib::quant::float32::L2SqrSimBatchBounded<DIM>;
                 return d;
             }
         };
@@ -564,5 +1013,5 @@ namespace ndd {
         static RegisterQuantizer
                 reg_fp32(QuantizationLevel::FP32, "float32", std::make_shared<Float32Quantizer>());
 
-    }  // namespace quant
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
 }  // namespace ndd
@@ -0,0 +1,437 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include "kernels.hpp"
+#include "int8d.hpp"
+#include "../hnsw/dist_params.h"
+
+namespace ndd {
+    namespace quant {
+        namespace float8::inline NDD_SIMD_NAMESPACE {
+
+            // E4M3 without infinities: 4 exponent bits (bias 7), 3 mantissa bits, 0x7F is NaN
+            // and 0x7E = 448 the largest finite value. Each vector is scaled so its largest
+            // magnitude lands on 448.
+            constexpr float FP8_MAX = 448.0f;
+            constexpr uint8_t FP8_MAX_CODE = 0x7E;
+
+            // Codes widen to FP16 bit patterns by shifting: the E4M3 exponent becomes the low
+            // four bits of the FP16 exponent (bias 15), which leaves every value 2^8 too
+            // small, subnormals included. Kernels fold the 2^8 into the vector scale.
+            constexpr float FP16_WIDEN_SCALE = 256.0f;
+
+            constexpr size_t get_storage_size(size_t dimension) {
+                return dimension + sizeof(float);
+            }
+
+            inline float extract_scale(const uint8_t* in, size_t dim) {
+                float scale;
+                std::memcpy(&scale, in + dim, sizeof(float));
+                return scale;
+            }
+
+            inline float decode_fp8(uint8_t code) {
+                int exponent = (code >> 3) & 0x0F;
+                int mantissa = code & 0x07;
+                float value = exponent == 0 ? std::ldexp(static_cast<float>(mantissa), -9)
+                                            : std::ldexp(static_cast<float>(8 + mantissa),
+                                                         exponent - 10);
+                return (code & 0x80) ? -value : value;
+            }
+
+            // Round to nearest even, saturating at 448
+            inline uint8_t encode_fp8(float value) {
+                uint8_t sign = std::signbit(value) ? 0x80 : 0x00;
+                float a = std::fabs(value);
+                if(!(a < FP8_MAX)) {
+                    return sign | FP8_MAX_CODE;
+                }
+                uint32_t code;
+                if(a < 0.015625f) {
+                    // Subnormal range, steps of 2^-9. Rounding up to 8 yields the smallest
+                    // normal code
+                    code = static_cast<uint32_t>(std::nearbyint(std::ldexp(a, 9)));
+                } else {
+                    int exponent;
+                    float fraction = std::frexp(a, &exponent);
+                    uint32_t mantissa =
+                            static_cast<uint32_t>(std::nearbyint((fraction * 2.0f - 1.0f) * 8.0f));
+                    // A mantissa rounded up to 8 carries into the exponent
+                    code = (static_cast<uint32_t>(exponent + 6) << 3) + mantissa;
+                }
+                return sign | static_cast<uint8_t>(std::min<uint32_t>(code, FP8_MAX_CODE));
+            }
+
+            inline const std::array<float, 256>& decode_table() {
+                static const std::array<float, 256> table = [] {
+                    std::array<float, 256> t{};
+                    for(size_t i = 0; i < t.size(); i++) {
+                        t[i] = decode_fp8(static_cast<uint8_t>(i));
+                    }
+                    return t;
+                }();
+                return table;
+            }
+
+#if defined(USE_AVX512)
+            inline __m512 load_fp8_as_ps_avx512(const uint8_t* ptr) {
+                __m256i w = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)ptr));
+                __m256i h = _mm256_or_si256(
+                        _mm256_slli_epi16(_mm256_and_si256(w, _mm256_set1_epi16(0x80)), 8),
+                        _mm256_slli_epi16(_mm256_and_si256(w, _mm256_set1_epi16(0x7F)), 7));
+                return _mm512_cvtph_ps(h);
+            }
+#elif defined(USE_AVX2)
+            inline __m256 load_fp8_as_ps_avx2(const uint8_t* ptr) {
+                __m128i w = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)ptr));
+                __m128i h = _mm_or_si128(
+                        _mm_slli_epi16(_mm_and_si128(w, _mm_set1_epi16(0x80)), 8),
+                        _mm_slli_epi16(_mm_and_si128(w, _mm_set1_epi16(0x7F)), 7));
+                return _mm256_cvtph_ps(h);
+            }
+#elif defined(USE_NEON)
+            inline float16x8_t load_fp8_as_f16_neon(const uint8_t* ptr) {
+                uint16x8_t w = vmovl_u8(vld1_u8(ptr));
+                uint16x8_t h = vorrq_u16(vshlq_n_u16(vandq_u16(w, vdupq_n_u16(0x80)), 8),
+                                         vshlq_n_u16(vandq_u16(w, vdupq_n_u16(0x7F)), 7));
+                return vreinterpretq_f16_u16(h);
+            }
+#endif
+
+            inline std::vector<uint8_t> quantize(const std::vector<float>& input) {
+                size_t dimension = input.size();
+                std::vector<uint8_t> buffer(get_storage_size(dimension));
+
+                float abs_max = 0.0f;
+                for(float v : input) {
+                    abs_max = std::max(abs_max, std::fabs(v));
+                }
+                float scale = abs_max / FP8_MAX;
+                float inv_scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+                for(size_t i = 0; i < dimension; i++) {
+                    buffer[i] = encode_fp8(input[i] * inv_scale);
+                }
+                std::memcpy(buffer.data() + dimension, &scale, sizeof(float));
+                return buffer;
+            }
+
+            inline std::vector<float> dequantize(const uint8_t* in, size_t dim) {
+                const std::array<float, 256>& table = decode_table();
+                float scale = extract_scale(in, dim);
+                std::vector<float> output(dim);
+                for(size_t i = 0; i < dim; i++) {
+                    output[i] = table[in[i]] * scale;
+                }
+                return output;
+            }
+
+            // Sum of products of the widened codes, still 2^16 too small per product
+            inline float Dot(const uint8_t* a, const uint8_t* b, size_t qty) {
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    acc0 = _mm512_fmadd_ps(
+                            load_fp8_as_ps_avx512(a + i), load_fp8_as_ps_avx512(b + i), acc0);
+                    acc1 = _mm512_fmadd_ps(load_fp8_as_ps_avx512(a + i + 16),
+                                           load_fp8_as_ps_avx512(b + i + 16),
+                                           acc1);
+                }
+                res = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    acc0 = _mm256_fmadd_ps(
+                            load_fp8_as_ps_avx2(a + i), load_fp8_as_ps_avx2(b + i), acc0);
+                    acc1 = _mm256_fmadd_ps(
+                            load_fp8_as_ps_avx2(a + i + 8), load_fp8_as_ps_avx2(b + i + 8), acc1);
+                }
+                res = ndd::quant::math::hsum_ps_avx2(_mm256_add_ps(acc0, acc1));
+#elif defined(USE_NEON)
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    float16x8_t ha = load_fp8_as_f16_neon(a + i);
+                    float16x8_t hb = load_fp8_as_f16_neon(b + i);
+                    acc0 = vfmaq_f32(acc0,
+                                     vcvt_f32_f16(vget_low_f16(ha)),
+                                     vcvt_f32_f16(vget_low_f16(hb)));
+                    acc1 = vfmaq_f32(acc1,
+                                     vcvt_f32_f16(vget_high_f16(ha)),
+                                     vcvt_f32_f16(vget_high_f16(hb)));
+                }
+                res = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                if(i < qty) {
+                    const std::array<float, 256>& table = decode_table();
+                    float tail = 0.0f;
+                    for(; i < qty; i++) {
+                        tail += table[a[i]] * table[b[i]];
+                    }
+                    res += tail / (FP16_WIDEN_SCALE * FP16_WIDEN_SCALE);
+                }
+                return res;
+            }
+
+            // Squared distance between a * scale_a and b * scale_b, with the scales already
+            // carrying the 2^8 widening factor
+            inline float L2Sum(const uint8_t* a, float scale_a, const uint8_t* b, float scale_b,
+                               size_t qty) {
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 va_scale = _mm512_set1_ps(scale_a);
+                __m512 vb_scale = _mm512_set1_ps(scale_b);
+                __m512 acc = _mm512_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    __m512 diff = _mm512_fmsub_ps(load_fp8_as_ps_avx512(a + i),
+                                                  va_scale,
+                                                  _mm512_mul_ps(load_fp8_as_ps_avx512(b + i),
+                                                                vb_scale));
+                    acc = _mm512_fmadd_ps(diff, diff, acc);
+                }
+                res = _mm512_reduce_add_ps(acc);
+#elif defined(USE_AVX2)
+                __m256 va_scale = _mm256_set1_ps(scale_a);
+                __m256 vb_scale = _mm256_set1_ps(scale_b);
+                __m256 acc = _mm256_setzero_ps();
+                for(; i + 8 <= qty; i += 8) {
+                    __m256 diff = _mm256_fmsub_ps(
+                            load_fp8_as_ps_avx2(a + i),
+                            va_scale,
+                            _mm256_mul_ps(load_fp8_as_ps_avx2(b + i), vb_scale));
+                    acc = _mm256_fmadd_ps(diff, diff, acc);
+                }
+                res = ndd::quant::math::hsum_ps_avx2(acc);
+#elif defined(USE_NEON)
+                float32x4_t acc = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    float16x8_t ha = load_fp8_as_f16_neon(a + i);
+                    float16x8_t hb = load_fp8_as_f16_neon(b + i);
+                    float32x4_t d0 =
+                            vsubq_f32(vmulq_n_f32(vcvt_f32_f16(vget_low_f16(ha)), scale_a),
+                                      vmulq_n_f32(vcvt_f32_f16(vget_low_f16(hb)), scale_b));
+                    float32x4_t d1 =
+                            vsubq_f32(vmulq_n_f32(vcvt_f32_f16(vget_high_f16(ha)), scale_a),
+                                      vmulq_n_f32(vcvt_f32_f16(vget_high_f16(hb)), scale_b));
+                    acc = vfmaq_f32(vfmaq_f32(acc, d0, d0), d1, d1);
+                }
+                res = vaddvq_f32(acc);
+#endif
+                if(i < qty) {
+                    const std::array<float, 256>& table = decode_table();
+                    float tail_a = scale_a / FP16_WIDEN_SCALE;
+                    float tail_b = scale_b / FP16_WIDEN_SCALE;
+                    for(; i < qty; i++) {
+                        float diff = table[a[i]] * tail_a - table[b[i]] * tail_b;
+                        res += diff * diff;
+                    }
+                }
+                return res;
+            }
+
+            // Float query against widened codes, in the same 2^-8 units as Dot
+            inline float QueryDot(const float* q, const uint8_t* v, size_t qty) {
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    acc0 = _mm512_fmadd_ps(
+                            _mm512_loadu_ps(q + i), load_fp8_as_ps_avx512(v + i), acc0);
+                    acc1 = _mm512_fmadd_ps(
+                            _mm512_loadu_ps(q + i + 16), load_fp8_as_ps_avx512(v + i + 16), acc1);
+                }
+                res = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    acc0 = _mm256_fmadd_ps(
+                            _mm256_loadu_ps(q + i), load_fp8_as_ps_avx2(v + i), acc0);
+                    acc1 = _mm256_fmadd_ps(
+                            _mm256_loadu_ps(q + i + 8), load_fp8_as_ps_avx2(v + i + 8), acc1);
+                }
+                res = ndd::quant::math::hsum_ps_avx2(_mm256_add_ps(acc0, acc1));
+#elif defined(USE_NEON)
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    float16x8_t h = load_fp8_as_f16_neon(v + i);
+                    acc0 = vfmaq_f32(acc0, vld1q_f32(q + i), vcvt_f32_f16(vget_low_f16(h)));
+                    acc1 = vfmaq_f32(acc1, vld1q_f32(q + i + 4), vcvt_f32_f16(vget_high_f16(h)));
+                }
+                res = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                if(i < qty) {
+                    const std::array<float, 256>& table = decode_table();
+                    float tail = 0.0f;
+                    for(; i < qty; i++) {
+                        tail += q[i] * table[v[i]];
+                    }
+                    res += tail / FP16_WIDEN_SCALE;
+                }
+                return res;
+            }
+
+            // Squared distance between a float query and v * scale, scale carrying the 2^8
+            inline float QueryL2Sum(const float* q, const uint8_t* v, float scale, size_t qty) {
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 vscale = _mm512_set1_ps(scale);
+                __m512 acc = _mm512_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    __m512 diff = _mm512_fnmadd_ps(
+                            load_fp8_as_ps_avx512(v + i), vscale, _mm512_loadu_ps(q + i));
+                    acc = _mm512_fmadd_ps(diff, diff, acc);
+                }
+                res = _mm512_reduce_add_ps(acc);
+#elif defined(USE_AVX2)
+                __m256 vscale = _mm256_set1_ps(scale);
+                __m256 acc = _mm256_setzero_ps();
+                for(; i + 8 <= qty; i += 8) {
+                    __m256 diff = _mm256_fnmadd_ps(
+                            load_fp8_as_ps_avx2(v + i), vscale, _mm256_loadu_ps(q + i));
+                    acc = _mm256_fmadd_ps(diff, diff, acc);
+                }
+                res = ndd::quant::math::hsum_ps_avx2(acc);
+#elif defined(USE_NEON)
+                float32x4_t acc = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    float16x8_t h = load_fp8_as_f16_neon(v + i);
+                    float32x4_t d0 = vfmsq_n_f32(
+                            vld1q_f32(q + i), vcvt_f32_f16(vget_low_f16(h)), scale);
+                    float32x4_t d1 = vfmsq_n_f32(
+                            vld1q_f32(q + i + 4), vcvt_f32_f16(vget_high_f16(h)), scale);
+                    acc = vfmaq_f32(vfmaq_f32(acc, d0, d0), d1, d1);
+                }
+                res = vaddvq_f32(acc);
+#endif
+                if(i < qty) {
+                    const std::array<float, 256>& table = decode_table();
+                    float tail_scale = scale / FP16_WIDEN_SCALE;
+                    for(; i < qty; i++) {
+                        float diff = q[i] - table[v[i]] * tail_scale;
+                        res += diff * diff;
+                    }
+                }
+                return res;
+            }
+
+            static float
+            InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                const uint8_t* a = static_cast<const uint8_t*>(pVect1v);
+                const uint8_t* b = static_cast<const uint8_t*>(pVect2v);
+                float scale = extract_scale(a, qty) * extract_scale(b, qty)
+                              * (FP16_WIDEN_SCALE * FP16_WIDEN_SCALE);
+                return Dot(a, b, qty) * scale;
+            }
+
+            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                const uint8_t* a = static_cast<const uint8_t*>(pVect1v);
+                const uint8_t* b = static_cast<const uint8_t*>(pVect2v);
+                return -L2Sum(a,
+                              extract_scale(a, qty) * FP16_WIDEN_SCALE,
+                              b,
+                              extract_scale(b, qty) * FP16_WIDEN_SCALE,
+                              qty);
+            }
+
+            static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -L2SqrSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float
+            InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float
+            QueryInnerProductSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                const uint8_t* v = static_cast<const uint8_t*>(vec);
+                return QueryDot((const float*)query, v, qty) * extract_scale(v, qty)
+                       * FP16_WIDEN_SCALE;
+            }
+
+            static float QueryL2SqrSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                const uint8_t* v = static_cast<const uint8_t*>(vec);
+                return -QueryL2Sum(
+                        (const float*)query, v, extract_scale(v, qty) * FP16_WIDEN_SCALE, qty);
+            }
+
+            static float QueryCosineSim(const void* query, const void* vec, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return QueryInnerProductSim(query, vec, qty_ptr);
+            }
+
+            static std::vector<uint8_t> quantize_to_int8(const void* in, size_t dim) {
+                return int8d::quantize_vector_fp32_to_int8_buffer_auto(
+                        dequantize(static_cast<const uint8_t*>(in), dim));
+            }
+
+        }  // namespace float8::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
+
+        class Float8Quantizer : public Quantizer {
+        public:
+            std::string name() const override { return "float8"; }
+            QuantizationLevel level() const override { return QuantizationLevel::FP8; }
+
+            QuantizerDispatch getDispatch() const override {
+                QuantizerDispatch d;
+                d.dist_l2 = &float8::L2Sqr;
+                d.dist_ip = &float8::InnerProduct;
+                d.dist_cosine = &float8::Cosine;
+                d.sim_l2 = &float8::L2SqrSim;
+                d.sim_ip = &float8::InnerProductSim;
+                d.sim_cosine = &float8::CosineSim;
+                d.sim_l2_batch = &sim_batch_pairwise<&float8::L2SqrSim>;
+                d.sim_ip_batch = &sim_batch_pairwise<&float8::InnerProductSim>;
+                d.sim_cosine_batch = &sim_batch_pairwise<&float8::CosineSim>;
+                d.quantize = &float8::quantize;
+                d.dequantize = &float8::dequantize;
+                d.quantize_to_int8 = &float8::quantize_to_int8;
+                d.get_storage_size = &float8::get_storage_size;
+                d.extract_scale = &float8::extract_scale;
+                d.prepare_query = &prepare_float_query;
+                d.query_sim_l2 = &float8::QueryL2SqrSim;
+                d.query_sim_ip = &float8::QueryInnerProductSim;
+                d.query_sim_cosine = &float8::QueryCosineSim;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&float8::QueryL2SqrSim>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&float8::QueryInnerProductSim>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&float8::QueryCosineSim>;
+                return d;
+            }
+        };
+
+        // Register FP8
+        static RegisterQuantizer
+                reg_fp8(QuantizationLevel::FP8, "float8", std::make_shared<Float8Quantizer>());
+
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
+}  // namespace ndd
@@ -3,12 +3,13 @@
 #include <cstdint>
 #include <cmath>
 #include <cstring>
-#include "common.hpp"
-#include "../hnsw/hnswlib.h"
+#include "kernels.hpp"
+#include "int8d.hpp"
+#include "../hnsw/dist_params.h"
 
 namespace ndd {
     namespace quant {
-        namespace int16d {
+        namespace int16d::inline NDD_SIMD_NAMESPACE {
 
             constexpr float INT16_SCALE =
                     32767.0f;  // Max value for 16-bit signed integer quantization
@@ -995,6 +996,481 @@ namespace ndd {
                 return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
             }
 
+            // One query against many vectors. Vectors are processed four at a time: each
+            // query chunk is loaded once and the four sums are reduced together. L2 uses the
+            // expansion |a*s1 - b*s2|^2 = a.a*s1^2 + b.b*s2^2 - 2*a.b*s1*s2 over exact 64-bit
+            // sums, combined in double so that the cancellation stays accurate.
+
+            template <bool with_norms>
+            static void Dot4Scalar(const int16_t* query,
+                                   const int16_t* const* vectors,
+                                   size_t begin,
+                                   size_t qty,
+                                   int64_t* dots,
+                                   int64_t* norms) {
+                for(size_t k = 0; k < 4; k++) {
+                    const int16_t* vec = vectors[k];
+                    int64_t dot = 0;
+                    int64_t norm = 0;
+                    for(size_t i = begin; i < qty; i++) {
+                        dot += static_cast<int64_t>(query[i]) * static_cast<int64_t>(vec[i]);
+                        if constexpr(with_norms) {
+                            norm += static_cast<int64_t>(vec[i]) * static_cast<int64_t>(vec[i]);
+                        }
+                    }
+                    dots[k] += dot;
+                    if constexpr(with_norms) {
+                        norms[k] += norm;
+                    }
+                }
+            }
+
+#if defined(USE_AVX512)
+            // madd_epi16 pairs fit in 32 bits for |x| <= 32767; widen before accumulating
+            inline __m512i madd_epi16_to_epi64_avx512(__m512i acc, __m512i a, __m512i b) {
+                __m512i prod = _mm512_madd_epi16(a, b);
+                acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(prod)));
+                return _mm512_add_epi64(
+                        acc, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(prod, 1)));
+            }
+
+            template <bool with_norms>
+            static void Dot4AVX512(const int16_t* query,
+                                   const int16_t* const* vectors,
+                                   size_t qty,
+                                   int64_t* dots,
+                                   int64_t* norms) {
+                __m512i dot0 = _mm512_setzero_si512();
+                __m512i dot1 = _mm512_setzero_si512();
+                __m512i dot2 = _mm512_setzero_si512();
+                __m512i dot3 = _mm512_setzero_si512();
+                __m512i norm0 = _mm512_setzero_si512();
+                __m512i norm1 = _mm512_setzero_si512();
+                __m512i norm2 = _mm512_setzero_si512();
+                __m512i norm3 = _mm512_setzero_si512();
+
+                size_t i = 0;
+                for(; i + 32 <= qty; i += 32) {
+                    __m512i q = _mm512_loadu_si512((const __m512i*)(query + i));
+                    __m512i v0 = _mm512_loadu_si512((const __m512i*)(vectors[0] + i));
+                    __m512i v1 = _mm512_loadu_si512((const __m512i*)(vectors[1] + i));
+                    __m512i v2 = _mm512_loadu_si512((const __m512i*)(vectors[2] + i));
+                    __m512i v3 = _mm512_loadu_si512((const __m512i*)(vectors[3] + i));
+
+                    dot0 = madd_epi16_to_epi64_avx512(dot0, q, v0);
+                    dot1 = madd_epi16_to_epi64_avx512(dot1, q, v1);
+                    dot2 = madd_epi16_to_epi64_avx512(dot2, q, v2);
+                    dot3 = madd_epi16_to_epi64_avx512(dot3, q, v3);
+                    if constexpr(with_norms) {
+                        norm0 = madd_epi16_to_epi64_avx512(norm0, v0, v0);
+                        norm1 = madd_epi16_to_epi64_avx512(norm1, v1, v1);
+                        norm2 = madd_epi16_to_epi64_avx512(norm2, v2, v2);
+                        norm3 = madd_epi16_to_epi64_avx512(norm3, v3, v3);
+                    }
+                }
+
+                dots[0] = _mm512_reduce_add_epi64(dot0);
+                dots[1] = _mm512_reduce_add_epi64(dot1);
+                dots[2] = _mm512_reduce_add_epi64(dot2);
+                dots[3] = _mm512_reduce_add_epi64(dot3);
+                if constexpr(with_norms) {
+                    norms[0] = _mm512_reduce_add_epi64(norm0);
+                    norms[1] = _mm512_reduce_add_epi64(norm1);
+                    norms[2] = _mm512_reduce_add_epi64(norm2);
+                    norms[3] = _mm512_reduce_add_epi64(norm3);
+                }
+                Dot4Scalar<with_norms>(query, vectors, i, qty, dots, norms);
+            }
+#endif
+
+#if defined(USE_AVX2)
+            inline __m256i madd_epi16_to_epi64_avx2(__m256i acc, __m256i a, __m256i b) {
+                __m256i prod = _mm256_madd_epi16(a, b);
+                acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(prod)));
+                return _mm256_add_epi64(
+                        acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(prod, 1)));
+            }
+
+            inline int64_t reduce_add_epi64_avx2(__m256i v) {
+                __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v),
+                                            _mm256_extracti128_si256(v, 1));
+                sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+                return _mm_cvtsi128_si64(sum);
+            }
+
+            template <bool with_norms>
+            static void Dot4AVX2(const int16_t* query,
+                                 const int16_t* const* vectors,
+                                 size_t qty,
+                                 int64_t* dots,
+                                 int64_t* norms) {
+                __m256i dot0 = _mm256_setzero_si256();
+                __m256i dot1 = _mm256_setzero_si256();
+                __m256i dot2 = _mm256_setzero_si256();
+                __m256i dot3 = _mm256_setzero_si256();
+                __m256i norm0 = _mm256_setzero_si256();
+                __m256i norm1 = _mm256_setzero_si256();
+                __m256i norm2 = _mm256_setzero_si256();
+                __m256i norm3 = _mm256_setzero_si256();
+
+                size_t i = 0;
+                for(; i + 16 <= qty; i += 16) {
+                    __m256i q = _mm256_loadu_si256((const __m256i*)(query + i));
+                    __m256i v0 = _mm256_loadu_si256((const __m256i*)(vectors[0] + i));
+                    __m256i v1 = _mm256_loadu_si256((const __m256i*)(vectors[1] + i));
+                    __m256i v2 = _mm256_loadu_si256((const __m256i*)(vectors[2] + i));
+                    __m256i v3 = _mm256_loadu_si256((const __m256i*)(vectors[3] + i));
+
+                    dot0 = madd_epi16_to_epi64_avx2(dot0, q, v0);
+                    dot1 = madd_epi16_to_epi64_avx2(dot1, q, v1);
+                    dot2 = madd_epi16_to_epi64_avx2(dot2, q, v2);
+                    dot3 = madd_epi16_to_epi64_avx2(dot3, q, v3);
+                    if constexpr(with_norms) {
+                        norm0 = madd_epi16_to_epi64_avx2(norm0, v0, v0);
+                        norm1 = madd_epi16_to_epi64_avx2(norm1, v1, v1);
+                        norm2 = madd_epi16_to_epi64_avx2(norm2, v2, v2);
+                        norm3 = madd_epi16_to_epi64_avx2(norm3, v3, v3);
+                    }
+                }
+
+                dots[0] = reduce_add_epi64_avx2(dot0);
+                dots[1] = reduce_add_epi64_avx2(dot1);
+                dots[2] = reduce_add_epi64_avx2(dot2);
+                dots[3] = reduce_add_epi64_avx2(dot3);
+                if constexpr(with_norms) {
+                    norms[0] = reduce_add_epi64_avx2(norm0);
+                    norms[1] = reduce_add_epi64_avx2(norm1);
+                    norms[2] = reduce_add_epi64_avx2(norm2);
+                    norms[3] = reduce_add_epi64_avx2(norm3);
+                }
+                Dot4Scalar<with_norms>(query, vectors, i, qty, dots, norms);
+            }
+#endif
+
+#if defined(USE_NEON)
+            inline int64x2_t mlal_s16_to_s64_neon(int64x2_t acc, int16x8_t a, int16x8_t b) {
+                acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(a), vget_low_s16(b)));
+                return vpadalq_s32(acc, vmull_s16(vget_high_s16(a), vget_high_s16(b)));
+            }
+
+            template <bool with_norms>
+            static void Dot4NEON(const int16_t* query,
+                                 const int16_t* const* vectors,
+                                 size_t qty,
+                                 int64_t* dots,
+                                 int64_t* norms) {
+                int64x2_t dot0 = vdupq_n_s64(0);
+                int64x2_t dot1 = vdupq_n_s64(0);
+                int64x2_t dot2 = vdupq_n_s64(0);
+                int64x2_t dot3 = vdupq_n_s64(0);
+                int64x2_t norm0 = vdupq_n_s64(0);
+                int64x2_t norm1 = vdupq_n_s64(0);
+                int64x2_t norm2 = vdupq_n_s64(0);
+                int64x2_t norm3 = vdupq_n_s64(0);
+
+                size_t i = 0;
+                for(; i + 8 <= qty; i += 8) {
+                    int16x8_t q = vld1q_s16(query + i);
+                    int16x8_t v0 = vld1q_s16(vectors[0] + i);
+                    int16x8_t v1 = vld1q_s16(vectors[1] + i);
+                    int16x8_t v2 = vld1q_s16(vectors[2] + i);
+                    int16x8_t v3 = vld1q_s16(vectors[3] + i);
+
+                    dot0 = mlal_s16_to_s64_neon(dot0, q, v0);
+                    dot1 = mlal_s16_to_s64_neon(dot1, q, v1);
+                    dot2 = mlal_s16_to_s64_neon(dot2, q, v2);
+                    dot3 = mlal_s16_to_s64_neon(dot3, q, v3);
+                    if constexpr(with_norms) {
+                        norm0 = mlal_s16_to_s64_neon(norm0, v0, v0);
+                        norm1 = mlal_s16_to_s64_neon(norm1, v1, v1);
+                        norm2 = mlal_s16_to_s64_neon(norm2, v2, v2);
+                        norm3 = mlal_s16_to_s64_neon(norm3, v3, v3);
+                    }
+                }
+
+                dots[0] = vaddvq_s64(dot0);
+                dots[1] = vaddvq_s64(dot1);
+                dots[2] = vaddvq_s64(dot2);
+                dots[3] = vaddvq_s64(dot3);
+                if constexpr(with_norms) {
+                    norms[0] = vaddvq_s64(norm0);
+                    norms[1] = vaddvq_s64(norm1);
+                    norms[2] = vaddvq_s64(norm2);
+                    norms[3] = vaddvq_s64(norm3);
+                }
+                Dot4Scalar<with_norms>(query, vectors, i, qty, dots, norms);
+            }
+#endif
+
+#if defined(USE_SVE2)
+            inline svint64_t mlal_s16_to_s64_sve(svint64_t acc, svint16_t a, svint16_t b) {
+                acc = svadalp_s64_x(svptrue_b64(), acc, svmullb_s32(a, b));
+                return svadalp_s64_x(svptrue_b64(), acc, svmullt_s32(a, b));
+            }
+
+            template <bool with_norms>
+            static void Dot4SVE(const int16_t* query,
+                                const int16_t* const* vectors,
+                                size_t qty,
+                                int64_t* dots,
+                                int64_t* norms) {
+                svint64_t dot0 = svdup_s64(0);
+                svint64_t dot1 = svdup_s64(0);
+                svint64_t dot2 = svdup_s64(0);
+                svint64_t dot3 = svdup_s64(0);
+                svint64_t norm0 = svdup_s64(0);
+                svint64_t norm1 = svdup_s64(0);
+                svint64_t norm2 = svdup_s64(0);
+                svint64_t norm3 = svdup_s64(0);
+
+                // Inactive lanes load as zero and add nothing to the sums
+                size_t i = 0;
+                svbool_t pg = svwhilelt_b16(i, qty);
+                while(svptest_any(svptrue_b16(), pg)) {
+                    svint16_t q = svld1_s16(pg, query + i);
+                    svint16_t v0 = svld1_s16(pg, vectors[0] + i);
+                    svint16_t v1 = svld1_s16(pg, vectors[1] + i);
+                    svint16_t v2 = svld1_s16(pg, vectors[2] + i);
+                    svint16_t v3 = svld1_s16(pg, vectors[3] + i);
+
+                    dot0 = mlal_s16_to_s64_sve(dot0, q, v0);
+                    dot1 = mlal_s16_to_s64_sve(dot1, q, v1);
+                    dot2 = mlal_s16_to_s64_sve(dot2, q, v2);
+                    dot3 = mlal_s16_to_s64_sve(dot3, q, v3);
+                    if constexpr(with_norms) {
+                        norm0 = mlal_s16_to_s64_sve(norm0, v0, v0);
+                        norm1 = mlal_s16_to_s64_sve(norm1, v1, v1);
+                        norm2 = mlal_s16_to_s64_sve(norm2, v2, v2);
+                        norm3 = mlal_s16_to_s64_sve(norm3, v3, v3);
+                    }
+
+                    i += svcnth();
+                    pg = svwhilelt_b16(i, qty);
+                }
+
+                dots[0] = svaddv_s64(svptrue_b64(), dot0);
+                dots[1] = svaddv_s64(svptrue_b64(), dot1);
+                dots[2] = svaddv_s64(svptrue_b64(), dot2);
+                dots[3] = svaddv_s64(svptrue_b64(), dot3);
+                if constexpr(with_norms) {
+                    norms[0] = svaddv_s64(svptrue_b64(), norm0);
+                    norms[1] = svaddv_s64(svptrue_b64(), norm1);
+                    norms[2] = svaddv_s64(svptrue_b64(), norm2);
+                    norms[3] = svaddv_s64(svptrue_b64(), norm3);
+                }
+            }
+#endif
+
+            template <bool with_norms>
+            static void Dot4(const int16_t* query,
+                             const int16_t* const* vectors,
+                             size_t qty,
+                             int64_t* dots,
+                             int64_t* norms) {
+#if defined(USE_AVX512)
+                Dot4AVX512<with_norms>(query, vectors, qty, dots, norms);
+#elif defined(USE_AVX2)
+                Dot4AVX2<with_norms>(query, vectors, qty, dots, norms);
+#elif defined(USE_NEON)
+                Dot4NEON<with_norms>(query, vectors, qty, dots, norms);
+#elif defined(USE_SVE2)
+                Dot4SVE<with_norms>(query, vectors, qty, dots, norms);
+#else
+                for(size_t k = 0; k < 4; k++) {
+                    dots[k] = 0;
+                    if constexpr(with_norms) {
+                        norms[k] = 0;
+                    }
+                }
+                Dot4Scalar<with_norms>(query, vectors, 0, qty, dots, norms);
+#endif
+            }
+
+            static void L2SqrSimBatch(const void* query,
+                                      const void* const* vectors,
+                                      size_t count,
+                                      const void* qty_ptr,
+                                      float* out) {
+                const int16_t* q = (const int16_t*)query;
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t qty = params->dim;
+
+                double scale1 = extract_scale((const uint8_t*)q, qty);
+                int64_t query_norm = 0;
+                for(size_t i = 0; i < qty; i++) {
+                    query_norm += static_cast<int64_t>(q[i]) * static_cast<int64_t>(q[i]);
+                }
+                double query_term = static_cast<double>(query_norm) * scale1 * scale1;
+
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const int16_t* group[4] = {(const int16_t*)vectors[i],
+                                               (const int16_t*)vectors[i + 1],
+                                               (const int16_t*)vectors[i + 2],
+                                               (const int16_t*)vectors[i + 3]};
+                    int64_t dots[4];
+                    int64_t norms[4];
+                    Dot4<true>(q, group, qty, dots, norms);
+                    for(size_t k = 0; k < 4; k++) {
+                        double scale2 = extract_scale((const uint8_t*)group[k], qty);
+                        double res = query_term + static_cast<double>(norms[k]) * scale2 * scale2
+                                     - 2.0 * static_cast<double>(dots[k]) * scale1 * scale2;
+                        out[i + k] = -static_cast<float>(std::max(res, 0.0));
+                    }
+                }
+                for(; i < count; i++) {
+                    out[i] = L2SqrSim(query, vectors[i], qty_ptr);
+                }
+            }
+
+            static void InnerProductSimBatch(const void* query,
+                                             const void* const* vectors,
+                                             size_t count,
+                                             const void* qty_ptr,
+                                             float* out) {
+                const int16_t* q = (const int16_t*)query;
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t qty = params->dim;
+
+                float scale1 = extract_scale((const uint8_t*)q, qty);
+
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const int16_t* group[4] = {(const int16_t*)vectors[i],
+                                               (const int16_t*)vectors[i + 1],
+                                               (const int16_t*)vectors[i + 2],
+                                               (const int16_t*)vectors[i + 3]};
+                    int64_t dots[4];
+                    Dot4<false>(q, group, qty, dots, nullptr);
+                    for(size_t k = 0; k < 4; k++) {
+                        float scale2 = extract_scale((const uint8_t*)group[k], qty);
+                        out[i + k] = (static_cast<float>(dots[k]) * scale1) * scale2;
+                    }
+                }
+                for(; i < count; i++) {
+                    out[i] = InnerProductSim(query, vectors[i], qty_ptr);
+                }
+            }
+
+            static void CosineSimBatch(const void* query,
+                                       const void* const* vectors,
+                                       size_t count,
+                                       const void* qty_ptr,
+                                       float* out) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                InnerProductSimBatch(query, vectors, count, qty_ptr, out);
+            }
+
+            // Float query against stored codes, the codes are widened to floats. For l2 the sum
+            // of squared differences to the dequantized codes, otherwise sum q_i * c_i that the
+            // caller scales.
+            template <bool l2>
+            inline float
+            QuerySum(const float* query, const int16_t* codes, size_t qty, float scale) {
+                float res = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 s = _mm512_set1_ps(scale);
+                __m512 sum0 = _mm512_setzero_ps();
+                __m512 sum1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    __m512i c = _mm512_loadu_si512((const void*)(codes + i));
+                    __m512 c0 = _mm512_cvtepi32_ps(
+                            _mm512_cvtepi16_epi32(_mm512_castsi512_si256(c)));
+                    __m512 c1 = _mm512_cvtepi32_ps(
+                            _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(c, 1)));
+                    __m512 q0 = _mm512_loadu_ps(query + i);
+                    __m512 q1 = _mm512_loadu_ps(query + i + 16);
+                    if constexpr(l2) {
+                        __m512 d0 = _mm512_fnmadd_ps(c0, s, q0);
+                        __m512 d1 = _mm512_fnmadd_ps(c1, s, q1);
+                        sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+                        sum1 = _mm512_fmadd_ps(d1, d1, sum1);
+                    } else {
+                        sum0 = _mm512_fmadd_ps(q0, c0, sum0);
+                        sum1 = _mm512_fmadd_ps(q1, c1, sum1);
+                    }
+                }
+                res = _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+#elif defined(USE_AVX2)
+                __m256 s = _mm256_set1_ps(scale);
+                __m256 sum0 = _mm256_setzero_ps();
+                __m256 sum1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    __m256i c = _mm256_loadu_si256((const __m256i*)(codes + i));
+                    __m256 c0 = _mm256_cvtepi32_ps(
+                            _mm256_cvtepi16_epi32(_mm256_castsi256_si128(c)));
+                    __m256 c1 = _mm256_cvtepi32_ps(
+                            _mm256_cvtepi16_epi32(_mm256_extracti128_si256(c, 1)));
+                    __m256 q0 = _mm256_loadu_ps(query + i);
+                    __m256 q1 = _mm256_loadu_ps(query + i + 8);
+                    if constexpr(l2) {
+                        __m256 d0 = _mm256_fnmadd_ps(c0, s, q0);
+                        __m256 d1 = _mm256_fnmadd_ps(c1, s, q1);
+                        sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+                        sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+                    } else {
+                        sum0 = _mm256_fmadd_ps(q0, c0, sum0);
+                        sum1 = _mm256_fmadd_ps(q1, c1, sum1);
+                    }
+                }
+                sum0 = _mm256_add_ps(sum0, sum1);
+                __m128 sum_128 = _mm_add_ps(_mm256_castps256_ps128(sum0),
+                                            _mm256_extractf128_ps(sum0, 1));
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                res = _mm_cvtss_f32(sum_128);
+#elif defined(USE_NEON)
+                float32x4_t sum0 = vdupq_n_f32(0.0f);
+                float32x4_t sum1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    int16x8_t c = vld1q_s16(codes + i);
+                    float32x4_t c0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(c)));
+                    float32x4_t c1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(c)));
+                    float32x4_t q0 = vld1q_f32(query + i);
+                    float32x4_t q1 = vld1q_f32(query + i + 4);
+                    if constexpr(l2) {
+                        float32x4_t d0 = vfmsq_n_f32(q0, c0, scale);
+                        float32x4_t d1 = vfmsq_n_f32(q1, c1, scale);
+                        sum0 = vfmaq_f32(sum0, d0, d0);
+                        sum1 = vfmaq_f32(sum1, d1, d1);
+                    } else {
+                        sum0 = vfmaq_f32(sum0, q0, c0);
+                        sum1 = vfmaq_f32(sum1, q1, c1);
+                    }
+                }
+                res = vaddvq_f32(vaddq_f32(sum0, sum1));
+#endif
+                for(; i < qty; i++) {
+                    if constexpr(l2) {
+                        float diff = query[i] - static_cast<float>(codes[i]) * scale;
+                        res += diff * diff;
+                    } else {
+                        res += query[i] * static_cast<float>(codes[i]);
+                    }
+                }
+                return res;
+            }
+
+            static float QueryL2SqrSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                float scale = extract_scale((const uint8_t*)vec, qty);
+                return -QuerySum<true>((const float*)query, (const int16_t*)vec, qty, scale);
+            }
+
+            static float
+            QueryInnerProductSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                float scale = extract_scale((const uint8_t*)vec, qty);
+                float dot = QuerySum<false>((const float*)query, (const int16_t*)vec, qty, scale);
+                return dot * scale;
+            }
+
+            static float QueryCosineSim(const void* query, const void* vec, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return QueryInnerProductSim(query, vec, qty_ptr);
+            }
+
             // Direct Int16 -> Int8 quantization
             static std::vector<uint8_t> quantize_to_int8(const void* in, size_t dim) {
                 const int16_t* in_data = static_cast<const int16_t*>(in);
@@ -1006,7 +1482,7 @@ namespace ndd {
                 // new_scale = scale * 256.0f
                 float new_scale = scale * 256.0f;
 
-                size_t out_size = dim * sizeof(int8_t) + sizeof(float);
+                size_t out_size = ndd::quant::int8d::get_storage_size(dim);
                 std::vector<uint8_t> out_vec(out_size);
                 int8_t* out_data = reinterpret_cast<int8_t*>(out_vec.data());
 
@@ -1048,10 +1524,14 @@ namespace ndd {
                     out_data[i] = static_cast<int8_t>(in_data[i] >> 8);
                 }
                 std::memcpy(out_data + dim, &new_scale, sizeof(float));
+                ndd::quant::int8d::store_squared_norm(out_vec.data(), dim);
                 return out_vec;
             }
 
-        }  // namespace int16d
+        }  // namespace int16d::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
 
         class Int16Quantizer : public Quantizer {
         public:
@@ -1066,11 +1546,21 @@ namespace ndd {
                 d.sim_l2 = &int16d::L2SqrSim;
                 d.sim_ip = &int16d::InnerProductSim;
                 d.sim_cosine = &int16d::CosineSim;
+                d.sim_l2_batch = &int16d::L2SqrSimBatch;
+                d.sim_ip_batch = &int16d::InnerProductSimBatch;
+                d.sim_cosine_batch = &int16d::CosineSimBatch;
                 d.quantize = &int16d::quantize;
                 d.dequantize = &int16d::dequantize;
                 d.quantize_to_int8 = &int16d::quantize_to_int8;
                 d.get_storage_size = &int16d::get_storage_size;
                 d.extract_scale = &int16d::extract_scale;
+                d.prepare_query = &prepare_float_query;
+                d.query_sim_l2 = &int16d::QueryL2SqrSim;
+                d.query_sim_ip = &int16d::QueryInnerProductSim;
+                d.query_sim_cosine = &int16d::QueryCosineSim;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&int16d::QueryL2SqrSim>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&int16d::QueryInnerProductSim>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&int16d::QueryCosineSim>;
                 return d;
             }
         };
@@ -1079,5 +1569,5 @@ namespace ndd {
         static RegisterQuantizer
                 reg_int16(QuantizationLevel::INT16, "int16d", std::make_shared<Int16Quantizer>());
 
-    }  // namespace quant
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
 }  // namespace ndd
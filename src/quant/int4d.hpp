@@ -0,0 +1,400 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include "kernels.hpp"
+#include "int8d.hpp"
+#include "../hnsw/dist_params.h"
+
+namespace ndd {
+    namespace quant {
+        namespace int4d::inline NDD_SIMD_NAMESPACE {
+
+            constexpr float INT4_SCALE = 7.0f;  // Codes are in [-7, 7]
+            constexpr uint8_t INT4_OFFSET = 8;  // Stored nibble = code + 8
+
+            // Layout: [packed nibbles, even dimensions in the low half][float scale]
+            // [float squared norm of the dequantized vector][int32 sum of the codes]. An odd
+            // dimension is padded with a zero code.
+            inline size_t get_packed_size(size_t dimension) { return (dimension + 1) / 2; }
+
+            inline size_t get_storage_size(size_t dimension) {
+                return get_packed_size(dimension) + 2 * sizeof(float) + sizeof(int32_t);
+            }
+
+            inline float extract_scale(const uint8_t* buffer, size_t dimension) {
+                float scale;
+                std::memcpy(&scale, buffer + get_packed_size(dimension), sizeof(float));
+                return scale;
+            }
+
+            inline float extract_squared_norm(const uint8_t* buffer, size_t dimension) {
+                float norm;
+                std::memcpy(
+                        &norm, buffer + get_packed_size(dimension) + sizeof(float), sizeof(float));
+                return norm;
+            }
+
+            inline int32_t extract_code_sum(const uint8_t* buffer, size_t dimension) {
+                int32_t sum;
+                std::memcpy(&sum,
+                            buffer + get_packed_size(dimension) + 2 * sizeof(float),
+                            sizeof(int32_t));
+                return sum;
+            }
+
+            inline int8_t code_at(const uint8_t* packed, size_t i) {
+                uint8_t nibble = (i % 2) ? (packed[i / 2] >> 4) : (packed[i / 2] & 0x0F);
+                return static_cast<int8_t>(nibble) - INT4_OFFSET;
+            }
+
+            inline std::vector<uint8_t> quantize(const std::vector<float>& input) {
+                if(input.empty()) {
+                    return std::vector<uint8_t>();
+                }
+
+                size_t dimension = input.size();
+                std::vector<uint8_t> buffer(get_storage_size(dimension), 0);
+
+                float abs_max = ndd::quant::math::find_abs_max(input.data(), dimension);
+                if(abs_max == 0.0f) {
+                    abs_max = 1.0f;  // Avoid division by zero
+                }
+                float scale = abs_max / INT4_SCALE;
+                float inv_scale = 1.0f / scale;
+
+                int32_t code_sum = 0;
+                int32_t code_norm = 0;
+                for(size_t i = 0; i < dimension; i += 2) {
+                    float next = i + 1 < dimension ? input[i + 1] : 0.0f;
+                    int32_t c0 = static_cast<int32_t>(std::round(input[i] * inv_scale));
+                    int32_t c1 = static_cast<int32_t>(std::round(next * inv_scale));
+                    c0 = std::clamp(c0, -7, 7);
+                    c1 = std::clamp(c1, -7, 7);
+                    code_sum += c0 + c1;
+                    code_norm += c0 * c0 + c1 * c1;
+                    buffer[i / 2] = static_cast<uint8_t>((c0 + INT4_OFFSET)
+                                                         | ((c1 + INT4_OFFSET) << 4));
+                }
+
+                float norm = (static_cast<float>(code_norm) * scale) * scale;
+                uint8_t* tail = buffer.data() + get_packed_size(dimension);
+                std::memcpy(tail, &scale, sizeof(float));
+                std::memcpy(tail + sizeof(float), &norm, sizeof(float));
+                std::memcpy(tail + 2 * sizeof(float), &code_sum, sizeof(int32_t));
+                return buffer;
+            }
+
+            inline std::vector<float> dequantize(const uint8_t* in, size_t dim) {
+                float scale = extract_scale(in, dim);
+                std::vector<float> output(dim);
+                for(size_t i = 0; i < dim; i++) {
+                    output[i] = static_cast<float>(code_at(in, i)) * scale;
+                }
+                return output;
+            }
+
+            // Sum of code products of two packed vectors. The nibbles are split in-register
+            // into low and high halves; pairing the halves of both sides keeps the sum exact
+            // without restoring the dimension order.
+            inline int32_t Dot(const uint8_t* p1, const uint8_t* p2, size_t dimension) {
+                size_t bytes = get_packed_size(dimension);
+                int32_t sum = 0;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                // VNNI multiplies unsigned by signed bytes: the nibbles of p1 stay offset by
+                // 8, which adds 8 * (code sum of p2), subtracted at the end. Zero bytes of the
+                // masked tail are nibble 0 on p1 and add nothing.
+                const __m512i low_mask = _mm512_set1_epi8(0x0F);
+                const __m512i offset = _mm512_set1_epi8(INT4_OFFSET);
+                __m512i acc = _mm512_setzero_si512();
+                for(; i < bytes; i += 64) {
+                    __mmask64 mask = bytes - i >= 64 ? ~0ULL : (1ULL << (bytes - i)) - 1;
+                    __m512i a = _mm512_maskz_loadu_epi8(mask, p1 + i);
+                    __m512i b = _mm512_maskz_loadu_epi8(mask, p2 + i);
+                    __m512i a_lo = _mm512_and_si512(a, low_mask);
+                    __m512i a_hi = _mm512_and_si512(_mm512_srli_epi16(a, 4), low_mask);
+                    __m512i b_lo = _mm512_sub_epi8(_mm512_and_si512(b, low_mask), offset);
+                    __m512i b_hi = _mm512_sub_epi8(
+                            _mm512_and_si512(_mm512_srli_epi16(b, 4), low_mask), offset);
+                    acc = _mm512_dpbusd_epi32(acc, a_lo, b_lo);
+                    acc = _mm512_dpbusd_epi32(acc, a_hi, b_hi);
+                }
+                return _mm512_reduce_add_epi32(acc)
+                       - INT4_OFFSET * extract_code_sum(p2, dimension);
+#elif defined(USE_AVX2)
+                // maddubs multiplies |a| by b with the sign of a moved onto b
+                const __m256i low_mask = _mm256_set1_epi8(0x0F);
+                const __m256i offset = _mm256_set1_epi8(INT4_OFFSET);
+                const __m256i ones = _mm256_set1_epi16(1);
+                __m256i acc = _mm256_setzero_si256();
+                for(; i + 32 <= bytes; i += 32) {
+                    __m256i a = _mm256_loadu_si256((const __m256i*)(p1 + i));
+                    __m256i b = _mm256_loadu_si256((const __m256i*)(p2 + i));
+                    __m256i a_lo = _mm256_sub_epi8(_mm256_and_si256(a, low_mask), offset);
+                    __m256i a_hi = _mm256_sub_epi8(
+                            _mm256_and_si256(_mm256_srli_epi16(a, 4), low_mask), offset);
+                    __m256i b_lo = _mm256_sub_epi8(_mm256_and_si256(b, low_mask), offset);
+                    __m256i b_hi = _mm256_sub_epi8(
+                            _mm256_and_si256(_mm256_srli_epi16(b, 4), low_mask), offset);
+                    __m256i prod_lo = _mm256_maddubs_epi16(_mm256_sign_epi8(a_lo, a_lo),
+                                                           _mm256_sign_epi8(b_lo, a_lo));
+                    __m256i prod_hi = _mm256_maddubs_epi16(_mm256_sign_epi8(a_hi, a_hi),
+                                                           _mm256_sign_epi8(b_hi, a_hi));
+                    acc = _mm256_add_epi32(
+                            acc, _mm256_madd_epi16(_mm256_add_epi16(prod_lo, prod_hi), ones));
+                }
+                __m128i sum_128 = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                                                _mm256_extracti128_si256(acc, 1));
+                sum_128 = _mm_hadd_epi32(sum_128, sum_128);
+                sum_128 = _mm_hadd_epi32(sum_128, sum_128);
+                sum = _mm_cvtsi128_si32(sum_128);
+#elif defined(USE_SVE2)
+                // Inactive lanes are zeroed after the offset so they add nothing
+                svint32_t acc = svdup_s32(0);
+                svbool_t pg = svwhilelt_b8(i, bytes);
+                while(svptest_any(svptrue_b8(), pg)) {
+                    svuint8_t a = svld1_u8(pg, p1 + i);
+                    svuint8_t b = svld1_u8(pg, p2 + i);
+                    svint8_t a_lo = svsub_n_s8_z(pg, svreinterpret_s8_u8(svand_n_u8_x(pg, a, 0x0F)),
+                                                 INT4_OFFSET);
+                    svint8_t a_hi = svsub_n_s8_z(pg, svreinterpret_s8_u8(svlsr_n_u8_x(pg, a, 4)),
+                                                 INT4_OFFSET);
+                    svint8_t b_lo = svsub_n_s8_z(pg, svreinterpret_s8_u8(svand_n_u8_x(pg, b, 0x0F)),
+                                                 INT4_OFFSET);
+                    svint8_t b_hi = svsub_n_s8_z(pg, svreinterpret_s8_u8(svlsr_n_u8_x(pg, b, 4)),
+                                                 INT4_OFFSET);
+                    acc = svdot_s32(acc, a_lo, b_lo);
+                    acc = svdot_s32(acc, a_hi, b_hi);
+
+                    i += svcntb();
+                    pg = svwhilelt_b8(i, bytes);
+                }
+                return svaddv_s32(svptrue_b32(), acc);
+#elif defined(USE_NEON)
+                const uint8x16_t low_mask = vdupq_n_u8(0x0F);
+                const int8x16_t offset = vdupq_n_s8(INT4_OFFSET);
+                int32x4_t acc0 = vdupq_n_s32(0);
+                int32x4_t acc1 = vdupq_n_s32(0);
+                for(; i + 16 <= bytes; i += 16) {
+                    uint8x16_t a = vld1q_u8(p1 + i);
+                    uint8x16_t b = vld1q_u8(p2 + i);
+                    int8x16_t a_lo = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(a, low_mask)), offset);
+                    int8x16_t a_hi = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(a, 4)), offset);
+                    int8x16_t b_lo = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(b, low_mask)), offset);
+                    int8x16_t b_hi = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(b, 4)), offset);
+                    acc0 = vdotq_s32(acc0, a_lo, b_lo);
+                    acc1 = vdotq_s32(acc1, a_hi, b_hi);
+                }
+                sum = vaddvq_s32(vaddq_s32(acc0, acc1));
+#endif
+                // Handle remaining bytes
+                for(; i < bytes; i++) {
+                    int32_t a_lo = static_cast<int32_t>(p1[i] & 0x0F) - INT4_OFFSET;
+                    int32_t a_hi = static_cast<int32_t>(p1[i] >> 4) - INT4_OFFSET;
+                    int32_t b_lo = static_cast<int32_t>(p2[i] & 0x0F) - INT4_OFFSET;
+                    int32_t b_hi = static_cast<int32_t>(p2[i] >> 4) - INT4_OFFSET;
+                    sum += a_lo * b_lo + a_hi * b_hi;
+                }
+                return sum;
+            }
+
+            static float
+            InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                const uint8_t* p1 = static_cast<const uint8_t*>(pVect1v);
+                const uint8_t* p2 = static_cast<const uint8_t*>(pVect2v);
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                float scale1 = extract_scale(p1, qty);
+                float scale2 = extract_scale(p2, qty);
+                return (static_cast<float>(Dot(p1, p2, qty)) * scale1) * scale2;
+            }
+
+            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+
+                // |a*s1 - b*s2|^2 = |a*s1|^2 + |b*s2|^2 - 2*(a.b)*s1*s2 with both norms stored
+                float norm1 = extract_squared_norm((const uint8_t*)pVect1v, qty);
+                float norm2 = extract_squared_norm((const uint8_t*)pVect2v, qty);
+                float res = norm1 + norm2 - 2.0f * InnerProductSim(pVect1v, pVect2v, qty_ptr);
+                return std::max(res, 0.0f);
+            }
+
+            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -L2Sqr(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float
+            InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            // Float query against stored codes: sum q_i * c_i, scaled by the caller. Nibbles
+            // are interleaved back into dimension order before widening to floats.
+            inline float QueryDot(const float* query, const uint8_t* packed, size_t qty) {
+                float sum = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                const __m128i low_mask = _mm_set1_epi8(0x0F);
+                const __m128i offset = _mm_set1_epi8(INT4_OFFSET);
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    __m128i b = _mm_loadu_si128((const __m128i*)(packed + i / 2));
+                    __m128i lo = _mm_and_si128(b, low_mask);
+                    __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), low_mask);
+                    __m128i c0 = _mm_sub_epi8(_mm_unpacklo_epi8(lo, hi), offset);
+                    __m128i c1 = _mm_sub_epi8(_mm_unpackhi_epi8(lo, hi), offset);
+                    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(query + i),
+                                           _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(c0)),
+                                           acc0);
+                    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(query + i + 16),
+                                           _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(c1)),
+                                           acc1);
+                }
+                sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                const __m128i low_mask = _mm_set1_epi8(0x0F);
+                const __m128i offset = _mm_set1_epi8(INT4_OFFSET);
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    __m128i b = _mm_loadl_epi64((const __m128i*)(packed + i / 2));
+                    __m128i lo = _mm_and_si128(b, low_mask);
+                    __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), low_mask);
+                    __m128i c = _mm_sub_epi8(_mm_unpacklo_epi8(lo, hi), offset);
+                    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i),
+                                           _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(c)),
+                                           acc0);
+                    acc1 = _mm256_fmadd_ps(
+                            _mm256_loadu_ps(query + i + 8),
+                            _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(c, 8))),
+                            acc1);
+                }
+                acc0 = _mm256_add_ps(acc0, acc1);
+                __m128 sum_128 = _mm_add_ps(_mm256_castps256_ps128(acc0),
+                                            _mm256_extractf128_ps(acc0, 1));
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum = _mm_cvtss_f32(sum_128);
+#elif defined(USE_NEON)
+                const uint8x8_t low_mask = vdup_n_u8(0x0F);
+                const int8x16_t offset = vdupq_n_s8(INT4_OFFSET);
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 16 <= qty; i += 16) {
+                    uint8x8_t b = vld1_u8(packed + i / 2);
+                    uint8x8x2_t zipped = vzip_u8(vand_u8(b, low_mask), vshr_n_u8(b, 4));
+                    int8x16_t c = vsubq_s8(
+                            vreinterpretq_s8_u8(vcombine_u8(zipped.val[0], zipped.val[1])),
+                            offset);
+                    int16x8_t c_lo = vmovl_s8(vget_low_s8(c));
+                    int16x8_t c_hi = vmovl_s8(vget_high_s8(c));
+                    acc0 = vfmaq_f32(acc0,
+                                     vld1q_f32(query + i),
+                                     vcvtq_f32_s32(vmovl_s16(vget_low_s16(c_lo))));
+                    acc1 = vfmaq_f32(acc1,
+                                     vld1q_f32(query + i + 4),
+                                     vcvtq_f32_s32(vmovl_s16(vget_high_s16(c_lo))));
+                    acc0 = vfmaq_f32(acc0,
+                                     vld1q_f32(query + i + 8),
+                                     vcvtq_f32_s32(vmovl_s16(vget_low_s16(c_hi))));
+                    acc1 = vfmaq_f32(acc1,
+                                     vld1q_f32(query + i + 12),
+                                     vcvtq_f32_s32(vmovl_s16(vget_high_s16(c_hi))));
+                }
+                sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                for(; i < qty; i++) {
+                    sum += query[i] * static_cast<float>(code_at(packed, i));
+                }
+                return sum;
+            }
+
+            static float
+            QueryInnerProductSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                float dot = QueryDot((const float*)query, (const uint8_t*)vec, qty);
+                return dot * extract_scale((const uint8_t*)vec, qty);
+            }
+
+            static float QueryL2SqrSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = static_cast<const hnswlib::DistParams*>(qty_ptr)->dim;
+                float ip = QueryInnerProductSim(query, vec, qty_ptr);
+                float norm = extract_squared_norm((const uint8_t*)vec, qty);
+                return -std::max(float_query_squared_norm(query, qty) + norm - 2.0f * ip, 0.0f);
+            }
+
+            static float QueryCosineSim(const void* query, const void* vec, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return QueryInnerProductSim(query, vec, qty_ptr);
+            }
+
+            // Direct Int4 -> Int8 for the hybrid upper layers: the codes widen as is and keep
+            // the scale
+            static std::vector<uint8_t> quantize_to_int8(const void* in, size_t dim) {
+                const uint8_t* packed = static_cast<const uint8_t*>(in);
+                std::vector<uint8_t> out(ndd::quant::int8d::get_storage_size(dim));
+                int8_t* codes = reinterpret_cast<int8_t*>(out.data());
+                for(size_t i = 0; i < dim; i++) {
+                    codes[i] = code_at(packed, i);
+                }
+                float scale = extract_scale(packed, dim);
+                std::memcpy(out.data() + dim, &scale, sizeof(float));
+                ndd::quant::int8d::store_squared_norm(out.data(), dim);
+                return out;
+            }
+
+        }  // namespace int4d::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
+
+        class Int4Quantizer : public Quantizer {
+        public:
+            std::string name() const override { return "int4d"; }
+            QuantizationLevel level() const override { return QuantizationLevel::INT4; }
+
+            QuantizerDispatch getDispatch() const override {
+                QuantizerDispatch d;
+                d.dist_l2 = &int4d::L2Sqr;
+                d.dist_ip = &int4d::InnerProduct;
+                d.dist_cosine = &int4d::Cosine;
+                d.sim_l2 = &int4d::L2SqrSim;
+                d.sim_ip = &int4d::InnerProductSim;
+                d.sim_cosine = &int4d::CosineSim;
+                d.sim_l2_batch = &sim_batch_pairwise<&int4d::L2SqrSim>;
+                d.sim_ip_batch = &sim_batch_pairwise<&int4d::InnerProductSim>;
+                d.sim_cosine_batch = &sim_batch_pairwise<&int4d::CosineSim>;
+                d.quantize = &int4d::quantize;
+                d.dequantize = &int4d::dequantize;
+                d.quantize_to_int8 = &int4d::quantize_to_int8;
+                d.get_storage_size = &int4d::get_storage_size;
+                d.extract_scale = &int4d::extract_scale;
+                d.prepare_query = &prepare_float_query;
+                d.query_sim_l2 = &int4d::QueryL2SqrSim;
+                d.query_sim_ip = &int4d::QueryInnerProductSim;
+                d.query_sim_cosine = &int4d::QueryCosineSim;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&int4d::QueryL2SqrSim>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&int4d::QueryInnerProductSim>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&int4d::QueryCosineSim>;
+                return d;
+            }
+        };
+
+        // Register INT4
+        static RegisterQuantizer
+                reg_int4(QuantizationLevel::INT4, "int4d", std::make_shared<Int4Quantizer>());
+
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
+}  // namespace ndd
@@ -1,25 +1,47 @@
 #pragma once
 #include <vector>
+#include <algorithm>
 #include <cstdint>
 #include <cmath>
 #include <cstring>
-#include "common.hpp"
-#include "../hnsw/hnswlib.h"
+#include "kernels.hpp"
+#include "../hnsw/dist_params.h"
 
 namespace ndd {
     namespace quant {
-        namespace int8d {
+        namespace int8d::inline NDD_SIMD_NAMESPACE {
 
             constexpr float INT8_SCALE = 127.0f;  // Max value for 8-bit signed integer quantization
 
+            // Layout: [int8 codes][float scale][float squared norm of the dequantized vector]
             constexpr size_t get_storage_size(size_t dimension) {
-                return dimension * sizeof(int8_t) + sizeof(float);
+                return dimension * sizeof(int8_t) + 2 * sizeof(float);
             }
 
             inline float extract_scale(const uint8_t* buffer, size_t dimension) {
                 return *reinterpret_cast<const float*>(buffer + dimension * sizeof(int8_t));
             }
 
+            inline float extract_squared_norm(const uint8_t* buffer, size_t dimension) {
+                return *reinterpret_cast<const float*>(buffer + dimension * sizeof(int8_t)
+                                                       + sizeof(float));
+            }
+
+            // Computes |x|^2 from the codes and scale already in the buffer and stores it, so L2
+            // reduces to |q|^2 + |x|^2 - 2*q.x and needs a single dot product per pair
+            inline void store_squared_norm(uint8_t* buffer, size_t dimension) {
+                const int8_t* data_ptr = reinterpret_cast<const int8_t*>(buffer);
+                int32_t sum = 0;
+                for(size_t i = 0; i < dimension; ++i) {
+                    sum += static_cast<int32_t>(data_ptr[i]) * static_cast<int32_t>(data_ptr[i]);
+                }
+                float scale = extract_scale(buffer, dimension);
+                float norm = (static_cast<float>(sum) * scale) * scale;
+                std::memcpy(buffer + dimension * sizeof(int8_t) + sizeof(float),
+                            &norm,
+                            sizeof(float));
+            }
+
             // Quantize FP32 vector to INT8 + scale, store in uint8_t buffer
             inline std::vector<uint8_t>
             quantize_vector_fp32_to_int8_buffer(const std::vector<float>& input) {
@@ -50,6 +72,7 @@ namespace ndd {
                 float* scale_ptr =
                         reinterpret_cast<float*>(buffer.data() + (dimension * sizeof(int8_t)));
                 *scale_ptr = scale;
+                store_squared_norm(buffer.data(), dimension);
 
                 return buffer;
             }
@@ -135,6 +158,7 @@ namespace ndd {
                 float* scale_ptr =
                         reinterpret_cast<float*>(buffer.data() + (dimension * sizeof(int8_t)));
                 *scale_ptr = scale;
+                store_squared_norm(buffer.data(), dimension);
 
                 return buffer;
             }
@@ -253,6 +277,7 @@ namespace ndd {
                 float* scale_ptr =
                         reinterpret_cast<float*>(buffer.data() + (dimension * sizeof(int8_t)));
                 *scale_ptr = scale;
+                store_squared_norm(buffer.data(), dimension);
 
                 return buffer;
             }
@@ -306,6 +331,7 @@ namespace ndd {
                 float* scale_ptr =
                         reinterpret_cast<float*>(buffer.data() + (dimension * sizeof(int8_t)));
                 *scale_ptr = scale;
+                store_squared_norm(buffer.data(), dimension);
 
                 return buffer;
             }
@@ -390,6 +416,7 @@ namespace ndd {
                 float* scale_ptr =
                         reinterpret_cast<float*>(buffer.data() + (dimension * sizeof(int8_t)));
                 *scale_ptr = scale;
+                store_squared_norm(buffer.data(), dimension);
 
                 return buffer;
             }
@@ -585,189 +612,13 @@ namespace ndd {
                 return dequantize_int8_buffer_to_fp32(in, dim);
             }
 
-            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-                const int8_t* pVect1 = (const int8_t*)pVect1v;
-                const int8_t* pVect2 = (const int8_t*)pVect2v;
-                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
-                size_t qty = params->dim;
-
-                float scale1 = extract_scale((const uint8_t*)pVect1, qty);
-                float scale2 = extract_scale((const uint8_t*)pVect2, qty);
-
-                float res = 0;
-                size_t i = 0;
-
-#if defined(USE_AVX512)
-                __m512 sum = _mm512_setzero_ps();
-                __m512 v_scale1 = _mm512_set1_ps(scale1);
-                __m512 v_scale2 = _mm512_set1_ps(scale2);
-
-                for(; i + 16 <= qty; i += 16) {
-                    __m128i v1_i8 = _mm_loadu_si128((const __m128i*)(pVect1 + i));
-                    __m128i v2_i8 = _mm_loadu_si128((const __m128i*)(pVect2 + i));
-
-                    __m512i v1_i32 = _mm512_cvtepi8_epi32(v1_i8);
-                    __m512i v2_i32 = _mm512_cvtepi8_epi32(v2_i8);
-
-                    __m512 v1_f = _mm512_cvtepi32_ps(v1_i32);
-                    __m512 v2_f = _mm512_cvtepi32_ps(v2_i32);
-
-                    v1_f = _mm512_mul_ps(v1_f, v_scale1);
-                    v2_f = _mm512_mul_ps(v2_f, v_scale2);
-
-                    __m512 diff = _mm512_sub_ps(v1_f, v2_f);
-                    sum = _mm512_fmadd_ps(diff, diff, sum);
-                }
-                res = _mm512_reduce_add_ps(sum);
-#elif defined(USE_AVX2)
-                __m256 sum = _mm256_setzero_ps();
-                __m256 v_scale1 = _mm256_set1_ps(scale1);
-                __m256 v_scale2 = _mm256_set1_ps(scale2);
-
-                for(; i + 8 <= qty; i += 8) {
-                    __m128i v1_i8 = _mm_loadl_epi64((const __m128i*)(pVect1 + i));
-                    __m128i v2_i8 = _mm_loadl_epi64((const __m128i*)(pVect2 + i));
-
-                    __m256i v1_i32 = _mm256_cvtepi8_epi32(v1_i8);
-                    __m256i v2_i32 = _mm256_cvtepi8_epi32(v2_i8);
-
-                    __m256 v1_f = _mm256_cvtepi32_ps(v1_i32);
-                    __m256 v2_f = _mm256_cvtepi32_ps(v2_i32);
-
-                    v1_f = _mm256_mul_ps(v1_f, v_scale1);
-                    v2_f = _mm256_mul_ps(v2_f, v_scale2);
-
-                    __m256 diff = _mm256_sub_ps(v1_f, v2_f);
-                    sum = _mm256_fmadd_ps(diff, diff, sum);
-                }
-                // Reduce AVX2 sum
-                __m128 sum_lo = _mm256_castps256_ps128(sum);
-                __m128 sum_hi = _mm256_extractf128_ps(sum, 1);
-                sum_lo = _mm_add_ps(sum_lo, sum_hi);
-                sum_lo = _mm_hadd_ps(sum_lo, sum_lo);
-                sum_lo = _mm_hadd_ps(sum_lo, sum_lo);
-                res = _mm_cvtss_f32(sum_lo);
-#elif defined(USE_SVE2)
-                svint32_t sum_sq1 = svdup_s32(0);
-                svint32_t sum_sq2 = svdup_s32(0);
-                svint32_t sum_prod = svdup_s32(0);
-
-                // Use svdot_s32 for efficient processing (3 streams)
-                uint64_t num_bytes = svcntb();
-                size_t unroll_stride = num_bytes * 2;
-                svbool_t pg_all = svptrue_b8();
-
-                for(; i + unroll_stride <= qty; i += unroll_stride) {
-                    svint8_t v1_0 = svld1_s8(pg_all, pVect1 + i);
-                    svint8_t v2_0 = svld1_s8(pg_all, pVect2 + i);
-                    sum_sq1 = svdot_s32(sum_sq1, v1_0, v1_0);
-                    sum_sq2 = svdot_s32(sum_sq2, v2_0, v2_0);
-                    sum_prod = svdot_s32(sum_prod, v1_0, v2_0);
-
-                    svint8_t v1_1 = svld1_s8(pg_all, pVect1 + i + num_bytes);
-                    svint8_t v2_1 = svld1_s8(pg_all, pVect2 + i + num_bytes);
-                    sum_sq1 = svdot_s32(sum_sq1, v1_1, v1_1);
-                    sum_sq2 = svdot_s32(sum_sq2, v2_1, v2_1);
-                    sum_prod = svdot_s32(sum_prod, v1_1, v2_1);
-                }
-
-                // Handle remaining elements (use svdot if possible, or fallback loop)
-                svbool_t pg8 = svwhilelt_b8(i, qty);
-                while(svptest_any(svptrue_b8(), pg8)) {
-                    svint8_t v1 = svld1_s8(pg8, pVect1 + i);
-                    svint8_t v2 = svld1_s8(pg8, pVect2 + i);
-                    sum_sq1 = svdot_s32(sum_sq1, v1, v1);
-                    sum_sq2 = svdot_s32(sum_sq2, v2, v2);
-                    sum_prod = svdot_s32(sum_prod, v1, v2);
-
-                    i += svcntb();
-                    pg8 = svwhilelt_b8(i, qty);
-                }
-
-                float dot1 = static_cast<float>(svaddv_s32(svptrue_b32(), sum_sq1));
-                float dot2 = static_cast<float>(svaddv_s32(svptrue_b32(), sum_sq2));
-                float dot_prod = static_cast<float>(svaddv_s32(svptrue_b32(), sum_prod));
-
-                res = (dot1 * scale1) * scale1 + (dot2 * scale2) * scale2 -
-                      2.0f * ((dot_prod * scale1) * scale2);
-
-#elif defined(USE_NEON)
-                // NEON implementation for L2Sqr
-                // Uses the expansion: (a*s1 - b*s2)^2 = a^2*s1^2 + b^2*s2^2 - 2ab*s1*s2
-                // This allows using integer dot products for the terms.
-
-
-                int32x4_t sum_sq1 = vdupq_n_s32(0);
-                int32x4_t sum_sq2 = vdupq_n_s32(0);
-                int32x4_t sum_prod = vdupq_n_s32(0);
-
-#    if defined(__ARM_FEATURE_DOTPROD)
-                size_t qty64 = qty / 64;
-                for(; i < qty64 * 64; i += 64) {
-                    int8x16_t v1_0 = vld1q_s8(pVect1 + i);
-                    int8x16_t v2_0 = vld1q_s8(pVect2 + i);
-                    int8x16_t v1_1 = vld1q_s8(pVect1 + i + 16);
-                    int8x16_t v2_1 = vld1q_s8(pVect2 + i + 16);
-                    int8x16_t v1_2 = vld1q_s8(pVect1 + i + 32);
-                    int8x16_t v2_2 = vld1q_s8(pVect2 + i + 32);
-                    int8x16_t v1_3 = vld1q_s8(pVect1 + i + 48);
-                    int8x16_t v2_3 = vld1q_s8(pVect2 + i + 48);
-
-                    sum_sq1 = vdotq_s32(sum_sq1, v1_0, v1_0);
-                    sum_sq2 = vdotq_s32(sum_sq2, v2_0, v2_0);
-                    sum_prod = vdotq_s32(sum_prod, v1_0, v2_0);
-
-                    sum_sq1 = vdotq_s32(sum_sq1, v1_1, v1_1);
-                    sum_sq2 = vdotq_s32(sum_sq2, v2_1, v2_1);
-                    sum_prod = vdotq_s32(sum_prod, v1_1, v2_1);
-
-                    sum_sq1 = vdotq_s32(sum_sq1, v1_2, v1_2);
-                    sum_sq2 = vdotq_s32(sum_sq2, v2_2, v2_2);
-                    sum_prod = vdotq_s32(sum_prod, v1_2, v2_2);
-
-                    sum_sq1 = vdotq_s32(sum_sq1, v1_3, v1_3);
-                    sum_sq2 = vdotq_s32(sum_sq2, v2_3, v2_3);
-                    sum_prod = vdotq_s32(sum_prod, v1_3, v2_3);
-                }
-
-                size_t qty16 = qty / 16;
-                for(; i < qty16 * 16; i += 16) {
-                    int8x16_t v1 = vld1q_s8(pVect1 + i);
-                    int8x16_t v2 = vld1q_s8(pVect2 + i);
-
-                    sum_sq1 = vdotq_s32(sum_sq1, v1, v1);
-                    sum_sq2 = vdotq_s32(sum_sq2, v2, v2);
-                    sum_prod = vdotq_s32(sum_prod, v1, v2);
-                }
-#    endif
-
-                float dot1 = static_cast<float>(vaddvq_s32(sum_sq1));
-                float dot2 = static_cast<float>(vaddvq_s32(sum_sq2));
-                float dot_prod = static_cast<float>(vaddvq_s32(sum_prod));
-
-                res = (dot1 * scale1) * scale1 + (dot2 * scale2) * scale2 -
-                      2.0f * ((dot_prod * scale1) * scale2);
-#endif
-
-                for(; i < qty; i++) {
-                    float v1 = static_cast<float>(pVect1[i]) * scale1;
-                    float v2 = static_cast<float>(pVect2[i]) * scale2;
-                    float diff = v1 - v2;
-                    res += diff * diff;
-                }
-                return res;
-            }
-
-            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-                return -L2Sqr(pVect1v, pVect2v, qty_ptr);
-            }
-
+            template <size_t DIM = 0>
             static float
             InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
                 const int8_t* pVect1 = (const int8_t*)pVect1v;
                 const int8_t* pVect2 = (const int8_t*)pVect2v;
                 const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
-                size_t qty = params->dim;
+                size_t qty = kernel_dim<DIM>(params->dim);
 
                 float scale1 = extract_scale((const uint8_t*)pVect1, qty);
                 float scale2 = extract_scale((const uint8_t*)pVect2, qty);
@@ -895,18 +746,387 @@ namespace ndd {
                 return (static_cast<float>(sum) * scale1) * scale2;
             }
 
+            template <size_t DIM = 0>
+            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t qty = kernel_dim<DIM>(params->dim);
+
+                // |a*s1 - b*s2|^2 = |a*s1|^2 + |b*s2|^2 - 2*(a.b)*s1*s2 with both norms stored
+                float norm1 = extract_squared_norm((const uint8_t*)pVect1v, qty);
+                float norm2 = extract_squared_norm((const uint8_t*)pVect2v, qty);
+                float res = norm1 + norm2 - 2.0f * InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
+                return std::max(res, 0.0f);
+            }
+
+            template <size_t DIM = 0>
+            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -L2Sqr<DIM>(pVect1v, pVect2v, qty_ptr);
+            }
+
+            template <size_t DIM = 0>
             static float
             InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-                return 1.0f - InnerProductSim(pVect1v, pVect2v, qty_ptr);
+                return 1.0f - InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
             }
 
+            template <size_t DIM = 0>
             static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
                 // Vectors are normalized, so CosineSim is just InnerProductSim
-                return InnerProductSim(pVect1v, pVect2v, qty_ptr);
+                return InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
             }
 
+            template <size_t DIM = 0>
             static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
-                return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
+                return 1.0f - CosineSim<DIM>(pVect1v, pVect2v, qty_ptr);
+            }
+
+            // One query against many vectors. Vectors are processed four at a time: each
+            // query chunk is loaded and widened once, and the four dot products are reduced
+            // together. L2 reuses the dot products with the stored squared norms.
+
+            template <size_t DIM = 0>
+            static void Dot4Scalar(const int8_t* query,
+                                   const int8_t* const* vectors,
+                                   size_t begin,
+                                   size_t dim,
+                                   int32_t* dots) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                for(size_t k = 0; k < 4; k++) {
+                    const int8_t* vec = vectors[k];
+                    int32_t dot = 0;
+                    for(size_t i = begin; i < qty; i++) {
+                        dot += static_cast<int32_t>(query[i]) * static_cast<int32_t>(vec[i]);
+                    }
+                    dots[k] += dot;
+                }
+            }
+
+#if defined(USE_AVX512)
+            template <size_t DIM = 0>
+            static void Dot4AVX512(const int8_t* query,
+                                   const int8_t* const* vectors,
+                                   size_t dim,
+                                   int32_t* dots) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                __m512i dot0 = _mm512_setzero_si512();
+                __m512i dot1 = _mm512_setzero_si512();
+                __m512i dot2 = _mm512_setzero_si512();
+                __m512i dot3 = _mm512_setzero_si512();
+
+                size_t i = 0;
+                for(; i + 32 <= qty; i += 32) {
+                    __m512i q = _mm512_cvtepi8_epi16(
+                            _mm256_loadu_si256((const __m256i*)(query + i)));
+                    __m512i v0 = _mm512_cvtepi8_epi16(
+                            _mm256_loadu_si256((const __m256i*)(vectors[0] + i)));
+                    __m512i v1 = _mm512_cvtepi8_epi16(
+                            _mm256_loadu_si256((const __m256i*)(vectors[1] + i)));
+                    __m512i v2 = _mm512_cvtepi8_epi16(
+                            _mm256_loadu_si256((const __m256i*)(vectors[2] + i)));
+                    __m512i v3 = _mm512_cvtepi8_epi16(
+                            _mm256_loadu_si256((const __m256i*)(vectors[3] + i)));
+
+                    dot0 = _mm512_add_epi32(dot0, _mm512_madd_epi16(q, v0));
+                    dot1 = _mm512_add_epi32(dot1, _mm512_madd_epi16(q, v1));
+                    dot2 = _mm512_add_epi32(dot2, _mm512_madd_epi16(q, v2));
+                    dot3 = _mm512_add_epi32(dot3, _mm512_madd_epi16(q, v3));
+                }
+
+                _mm_storeu_si128((__m128i*)dots,
+                                 ndd::quant::math::hsum4_epi32_avx512(dot0, dot1, dot2, dot3));
+                if constexpr(kernel_tail<DIM>) {
+                    Dot4Scalar<DIM>(query, vectors, i, qty, dots);
+                }
+            }
+#endif
+
+#if defined(USE_AVX2)
+            template <size_t DIM = 0>
+            static void Dot4AVX2(const int8_t* query,
+                                 const int8_t* const* vectors,
+                                 size_t dim,
+                                 int32_t* dots) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                __m256i dot0 = _mm256_setzero_si256();
+                __m256i dot1 = _mm256_setzero_si256();
+                __m256i dot2 = _mm256_setzero_si256();
+                __m256i dot3 = _mm256_setzero_si256();
+
+                size_t i = 0;
+                for(; i + 16 <= qty; i += 16) {
+                    __m256i q =
+                            _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(query + i)));
+                    __m256i v0 = _mm256_cvtepi8_epi16(
+                            _mm_loadu_si128((const __m128i*)(vectors[0] + i)));
+                    __m256i v1 = _mm256_cvtepi8_epi16(
+                            _mm_loadu_si128((const __m128i*)(vectors[1] + i)));
+                    __m256i v2 = _mm256_cvtepi8_epi16(
+                            _mm_loadu_si128((const __m128i*)(vectors[2] + i)));
+                    __m256i v3 = _mm256_cvtepi8_epi16(
+                            _mm_loadu_si128((const __m128i*)(vectors[3] + i)));
+
+                    dot0 = _mm256_add_epi32(dot0, _mm256_madd_epi16(q, v0));
+                    dot1 = _mm256_add_epi32(dot1, _mm256_madd_epi16(q, v1));
+                    dot2 = _mm256_add_epi32(dot2, _mm256_madd_epi16(q, v2));
+                    dot3 = _mm256_add_epi32(dot3, _mm256_madd_epi16(q, v3));
+                }
+
+                _mm_storeu_si128((__m128i*)dots,
+                                 ndd::quant::math::hsum4_epi32_avx2(dot0, dot1, dot2, dot3));
+                if constexpr(kernel_tail<DIM>) {
+                    Dot4Scalar<DIM>(query, vectors, i, qty, dots);
+                }
+            }
+#endif
+
+#if defined(USE_SVE2)
+            template <size_t DIM = 0>
+            static void Dot4SVE(const int8_t* query,
+                                const int8_t* const* vectors,
+                                size_t dim,
+                                int32_t* dots) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                svint32_t dot0 = svdup_s32(0);
+                svint32_t dot1 = svdup_s32(0);
+                svint32_t dot2 = svdup_s32(0);
+                svint32_t dot3 = svdup_s32(0);
+
+                // Inactive lanes load as zero and add nothing to the dot products
+                size_t i = 0;
+                svbool_t pg8 = svwhilelt_b8(i, qty);
+                while(svptest_any(svptrue_b8(), pg8)) {
+                    svint8_t q = svld1_s8(pg8, query + i);
+                    svint8_t v0 = svld1_s8(pg8, vectors[0] + i);
+                    svint8_t v1 = svld1_s8(pg8, vectors[1] + i);
+                    svint8_t v2 = svld1_s8(pg8, vectors[2] + i);
+                    svint8_t v3 = svld1_s8(pg8, vectors[3] + i);
+
+                    dot0 = svdot_s32(dot0, q, v0);
+                    dot1 = svdot_s32(dot1, q, v1);
+                    dot2 = svdot_s32(dot2, q, v2);
+                    dot3 = svdot_s32(dot3, q, v3);
+
+                    i += svcntb();
+                    pg8 = svwhilelt_b8(i, qty);
+                }
+
+                dots[0] = svaddv_s32(svptrue_b32(), dot0);
+                dots[1] = svaddv_s32(svptrue_b32(), dot1);
+                dots[2] = svaddv_s32(svptrue_b32(), dot2);
+                dots[3] = svaddv_s32(svptrue_b32(), dot3);
+            }
+#endif
+
+#if defined(USE_NEON)
+            template <size_t DIM = 0>
+            static void Dot4NEON(const int8_t* query,
+                                 const int8_t* const* vectors,
+                                 size_t dim,
+                                 int32_t* dots) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                int32x4_t dot0 = vdupq_n_s32(0);
+                int32x4_t dot1 = vdupq_n_s32(0);
+                int32x4_t dot2 = vdupq_n_s32(0);
+                int32x4_t dot3 = vdupq_n_s32(0);
+
+                size_t i = 0;
+                for(; i + 16 <= qty; i += 16) {
+                    int8x16_t q = vld1q_s8(query + i);
+                    int8x16_t v0 = vld1q_s8(vectors[0] + i);
+                    int8x16_t v1 = vld1q_s8(vectors[1] + i);
+                    int8x16_t v2 = vld1q_s8(vectors[2] + i);
+                    int8x16_t v3 = vld1q_s8(vectors[3] + i);
+
+                    dot0 = vdotq_s32(dot0, q, v0);
+                    dot1 = vdotq_s32(dot1, q, v1);
+                    dot2 = vdotq_s32(dot2, q, v2);
+                    dot3 = vdotq_s32(dot3, q, v3);
+                }
+
+                vst1q_s32(dots, ndd::quant::math::hsum4_s32_neon(dot0, dot1, dot2, dot3));
+                if constexpr(kernel_tail<DIM>) {
+                    Dot4Scalar<DIM>(query, vectors, i, qty, dots);
+                }
+            }
+#endif
+
+            template <size_t DIM = 0>
+            static void Dot4(const int8_t* query,
+                             const int8_t* const* vectors,
+                             size_t dim,
+                             int32_t* dots) {
+                const size_t qty = kernel_dim<DIM>(dim);
+#if defined(USE_AVX512)
+                Dot4AVX512<DIM>(query, vectors, qty, dots);
+#elif defined(USE_AVX2)
+                Dot4AVX2<DIM>(query, vectors, qty, dots);
+#elif defined(USE_SVE2)
+                Dot4SVE<DIM>(query, vectors, qty, dots);
+#elif defined(USE_NEON)
+                Dot4NEON<DIM>(query, vectors, qty, dots);
+#else
+                for(size_t k = 0; k < 4; k++) {
+                    dots[k] = 0;
+                }
+                Dot4Scalar<DIM>(query, vectors, 0, qty, dots);
+#endif
+            }
+
+            template <size_t DIM = 0>
+            static void L2SqrSimBatch(const void* query,
+                                      const void* const* vectors,
+                                      size_t count,
+                                      const void* qty_ptr,
+                                      float* out) {
+                const int8_t* q = (const int8_t*)query;
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t qty = kernel_dim<DIM>(params->dim);
+
+                float scale1 = extract_scale((const uint8_t*)q, qty);
+                float query_norm = extract_squared_norm((const uint8_t*)q, qty);
+
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const int8_t* group[4] = {(const int8_t*)vectors[i],
+                                              (const int8_t*)vectors[i + 1],
+                                              (const int8_t*)vectors[i + 2],
+                                              (const int8_t*)vectors[i + 3]};
+                    int32_t dots[4];
+                    Dot4<DIM>(q, group, qty, dots);
+                    for(size_t k = 0; k < 4; k++) {
+                        float scale2 = extract_scale((const uint8_t*)group[k], qty);
+                        float norm2 = extract_squared_norm((const uint8_t*)group[k], qty);
+                        float ip = (static_cast<float>(dots[k]) * scale1) * scale2;
+                        out[i + k] = -std::max(query_norm + norm2 - 2.0f * ip, 0.0f);
+                    }
+                }
+                for(; i < count; i++) {
+                    out[i] = L2SqrSim<DIM>(query, vectors[i], qty_ptr);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void InnerProductSimBatch(const void* query,
+                                             const void* const* vectors,
+                                             size_t count,
+                                             const void* qty_ptr,
+                                             float* out) {
+                const int8_t* q = (const int8_t*)query;
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t qty = kernel_dim<DIM>(params->dim);
+
+                float scale1 = extract_scale((const uint8_t*)q, qty);
+
+                size_t i = 0;
+                for(; i + 4 <= count; i += 4) {
+                    const int8_t* group[4] = {(const int8_t*)vectors[i],
+                                              (const int8_t*)vectors[i + 1],
+                                              (const int8_t*)vectors[i + 2],
+                                              (const int8_t*)vectors[i + 3]};
+                    int32_t dots[4];
+                    Dot4<DIM>(q, group, qty, dots);
+                    for(size_t k = 0; k < 4; k++) {
+                        float scale2 = extract_scale((const uint8_t*)group[k], qty);
+                        out[i + k] = (static_cast<float>(dots[k]) * scale1) * scale2;
+                    }
+                }
+                for(; i < count; i++) {
+                    out[i] = InnerProductSim<DIM>(query, vectors[i], qty_ptr);
+                }
+            }
+
+            template <size_t DIM = 0>
+            static void CosineSimBatch(const void* query,
+                                       const void* const* vectors,
+                                       size_t count,
+                                       const void* qty_ptr,
+                                       float* out) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                InnerProductSimBatch<DIM>(query, vectors, count, qty_ptr, out);
+            }
+
+            // Float query against stored codes: the codes are widened to floats and
+            // accumulated with FMA, so the query keeps its full precision. Returns sum q_i * c_i,
+            // the caller applies the scale of the stored vector.
+            template <size_t DIM = 0>
+            inline float QueryDot(const float* query, const int8_t* codes, size_t dim) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                float sum = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    __m512 c0 = _mm512_cvtepi32_ps(
+                            _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(codes + i))));
+                    __m512 c1 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(
+                            _mm_loadu_si128((const __m128i*)(codes + i + 16))));
+                    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(query + i), c0, acc0);
+                    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(query + i + 16), c1, acc1);
+                }
+                for(; i + 16 <= qty; i += 16) {
+                    __m512 c0 = _mm512_cvtepi32_ps(
+                            _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(codes + i))));
+                    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(query + i), c0, acc0);
+                }
+                sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    __m256 c0 = _mm256_cvtepi32_ps(
+                            _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(codes + i))));
+                    __m256 c1 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+                            _mm_loadl_epi64((const __m128i*)(codes + i + 8))));
+                    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i), c0, acc0);
+                    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i + 8), c1, acc1);
+                }
+                acc0 = _mm256_add_ps(acc0, acc1);
+                __m128 sum_128 = _mm_add_ps(_mm256_castps256_ps128(acc0),
+                                            _mm256_extractf128_ps(acc0, 1));
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum_128 = _mm_hadd_ps(sum_128, sum_128);
+                sum = _mm_cvtss_f32(sum_128);
+#elif defined(USE_NEON)
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    int16x8_t c = vmovl_s8(vld1_s8(codes + i));
+                    float32x4_t c0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(c)));
+                    float32x4_t c1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(c)));
+                    acc0 = vfmaq_f32(acc0, vld1q_f32(query + i), c0);
+                    acc1 = vfmaq_f32(acc1, vld1q_f32(query + i + 4), c1);
+                }
+                sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                if constexpr(kernel_scalar_tail<DIM>) {
+                    for(; i < qty; i++) {
+                        sum += query[i] * static_cast<float>(codes[i]);
+                    }
+                }
+                return sum;
+            }
+
+            template <size_t DIM = 0>
+            static float
+            QueryInnerProductSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                float dot = QueryDot<DIM>((const float*)query, (const int8_t*)vec, qty);
+                return dot * extract_scale((const uint8_t*)vec, qty);
+            }
+
+            template <size_t DIM = 0>
+            static float QueryL2SqrSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                float ip = QueryInnerProductSim<DIM>(query, vec, qty_ptr);
+                float norm = extract_squared_norm((const uint8_t*)vec, qty);
+                return -std::max(float_query_squared_norm(query, qty) + norm - 2.0f * ip, 0.0f);
+            }
+
+            template <size_t DIM = 0>
+            static float QueryCosineSim(const void* query, const void* vec, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return QueryInnerProductSim<DIM>(query, vec, qty_ptr);
             }
 
             // Direct quantization to INT8 - identity function for INT8 input
@@ -916,7 +1136,10 @@ namespace ndd {
                 return std::vector<uint8_t>(ptr, ptr + size);
             }
 
-        }  // namespace int8d
+        }  // namespace int8d::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
 
         class Int8Quantizer : public ndd::quant::Quantizer {
         public:
@@ -925,19 +1148,36 @@ namespace ndd {
                 return ndd::quant::QuantizationLevel::INT8;
             }
 
-            ndd::quant::QuantizerDispatch getDispatch() const override {
+            ndd::quant::QuantizerDispatch getDispatch() const override { return makeDispatch<0>(); }
+
+            ndd::quant::QuantizerDispatch getDispatchForDim(size_t dim) const override {
+                return dispatch_for_dim(dim, []<size_t DIM>() { return makeDispatch<DIM>(); });
+            }
+
+        private:
+            template <size_t DIM> static ndd::quant::QuantizerDispatch makeDispatch() {
                 ndd::quant::QuantizerDispatch d;
-                d.dist_l2 = &int8d::L2Sqr;
-                d.dist_ip = &int8d::InnerProduct;
-                d.dist_cosine = &int8d::Cosine;
-                d.sim_l2 = &int8d::L2SqrSim;
-                d.sim_ip = &int8d::InnerProductSim;
-                d.sim_cosine = &int8d::CosineSim;
+                d.dist_l2 = &int8d::L2Sqr<DIM>;
+                d.dist_ip = &int8d::InnerProduct<DIM>;
+                d.dist_cosine = &int8d::Cosine<DIM>;
+                d.sim_l2 = &int8d::L2SqrSim<DIM>;
+                d.sim_ip = &int8d::InnerProductSim<DIM>;
+                d.sim_cosine = &int8d::CosineSim<DIM>;
+                d.sim_l2_batch = &int8d::L2SqrSimBatch<DIM>;
+                d.sim_ip_batch = &int8d::InnerProductSimBatch<DIM>;
+                d.sim_cosine_batch = &int8d::CosineSimBatch<DIM>;
                 d.quantize = &int8d::quantize;
                 d.dequantize = &int8d::dequantize;
                 d.quantize_to_int8 = &int8d::quantize_to_int8_identity;
                 d.get_storage_size = &int8d::get_storage_size;
                 d.extract_scale = &int8d::extract_scale;
+                d.prepare_query = &prepare_float_query;
+                d.query_sim_l2 = &int8d::QueryL2SqrSim<DIM>;
+                d.query_sim_ip = &int8d::QueryInnerProductSim<DIM>;
+                d.query_sim_cosine = &int8d::QueryCosineSim<DIM>;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&int8d::QueryL2SqrSim<DIM>>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&int8d::QueryInnerProductSim<DIM>>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&int8d::QueryCosineSim<DIM>>;
                 return d;
             }
         };
@@ -947,5 +1187,5 @@ namespace ndd {
                                                       "int8d",
                                                       std::make_shared<Int8Quantizer>());
 
-    }  // namespace quant
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
 }  // namespace ndd
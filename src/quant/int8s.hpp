@@ -0,0 +1,295 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "kernels.hpp"
+#include "int8d.hpp"
+#include "int8s_scales.hpp"
+#include "../hnsw/dist_params.h"
+
+namespace ndd {
+    namespace quant {
+        namespace int8s::inline NDD_SIMD_NAMESPACE {
+
+            // Layout: [int8 codes][float squared norm][float offsets . (scales * codes)], both
+            // of the decoded vector. The offsets and scales are per index (DimScales)
+            constexpr size_t get_storage_size(size_t dimension) {
+                return dimension * sizeof(int8_t) + 2 * sizeof(float);
+            }
+
+            // No per-vector scale, the index holds one per dimension
+            inline float extract_scale(const uint8_t*, size_t) { return 1.0f; }
+
+            inline float extract_squared_norm(const uint8_t* buffer, size_t dimension) {
+                float norm;
+                std::memcpy(&norm, buffer + dimension, sizeof(float));
+                return norm;
+            }
+
+            inline float extract_offset_dot(const uint8_t* buffer, size_t dimension) {
+                float dot;
+                std::memcpy(&dot, buffer + dimension + sizeof(float), sizeof(float));
+                return dot;
+            }
+
+            inline const DimScales& scales_of(const void* params) {
+                const auto* dist_params = static_cast<const hnswlib::DistParams*>(params);
+                if(!dist_params || !dist_params->codebook) {
+                    throw std::runtime_error("INT8S scales are not trained");
+                }
+                return *static_cast<const DimScales*>(dist_params->codebook);
+            }
+
+            // sum w_i * a_i * b_i over two stored code vectors. The code products fit int16 and
+            // are widened to floats only for the weights
+            template <size_t DIM = 0>
+            inline float
+            WeightedDot(const int8_t* a, const int8_t* b, const float* weights, size_t dim) {
+                const size_t qty = kernel_dim<DIM>(dim);
+                float sum = 0.0f;
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                for(; i + 32 <= qty; i += 32) {
+                    __m512i prod = _mm512_mullo_epi16(
+                            _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(a + i))),
+                            _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(b + i))));
+                    __m512 p0 = _mm512_cvtepi32_ps(
+                            _mm512_cvtepi16_epi32(_mm512_castsi512_si256(prod)));
+                    __m512 p1 = _mm512_cvtepi32_ps(
+                            _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(prod, 1)));
+                    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(weights + i), p0, acc0);
+                    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(weights + i + 16), p1, acc1);
+                }
+                sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(USE_AVX2)
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                for(; i + 16 <= qty; i += 16) {
+                    __m256i prod = _mm256_mullo_epi16(
+                            _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a + i))),
+                            _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + i))));
+                    __m256 p0 = _mm256_cvtepi32_ps(
+                            _mm256_cvtepi16_epi32(_mm256_castsi256_si128(prod)));
+                    __m256 p1 = _mm256_cvtepi32_ps(
+                            _mm256_cvtepi16_epi32(_mm256_extracti128_si256(prod, 1)));
+                    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + i), p0, acc0);
+                    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(weights + i + 8), p1, acc1);
+                }
+                sum = ndd::quant::math::hsum_ps_avx2(_mm256_add_ps(acc0, acc1));
+#elif defined(USE_NEON)
+                float32x4_t acc0 = vdupq_n_f32(0.0f);
+                float32x4_t acc1 = vdupq_n_f32(0.0f);
+                for(; i + 8 <= qty; i += 8) {
+                    int16x8_t prod = vmull_s8(vld1_s8(a + i), vld1_s8(b + i));
+                    float32x4_t p0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(prod)));
+                    float32x4_t p1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(prod)));
+                    acc0 = vfmaq_f32(acc0, vld1q_f32(weights + i), p0);
+                    acc1 = vfmaq_f32(acc1, vld1q_f32(weights + i + 4), p1);
+                }
+                sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+                if constexpr(kernel_scalar_tail<DIM>) {
+                    for(; i < qty; i++) {
+                        sum += weights[i] * static_cast<float>(a[i]) * static_cast<float>(b[i]);
+                    }
+                }
+                return sum;
+            }
+
+            // Stored against stored: (o + s * a) . (o + s * b) expands to |o|^2, the two stored
+            // offset dots and the code products weighted by s^2
+            template <size_t DIM = 0>
+            static float
+            InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                const DimScales& scales = scales_of(qty_ptr);
+                const uint8_t* a = static_cast<const uint8_t*>(pVect1v);
+                const uint8_t* b = static_cast<const uint8_t*>(pVect2v);
+                float dot = WeightedDot<DIM>(
+                        (const int8_t*)a, (const int8_t*)b, scales.weights(), qty);
+                return scales.offsetNorm() + extract_offset_dot(a, qty)
+                       + extract_offset_dot(b, qty) + dot;
+            }
+
+            template <size_t DIM = 0>
+            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                float ip = InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
+                float norm1 = extract_squared_norm((const uint8_t*)pVect1v, qty);
+                float norm2 = extract_squared_norm((const uint8_t*)pVect2v, qty);
+                return -std::max(norm1 + norm2 - 2.0f * ip, 0.0f);
+            }
+
+            template <size_t DIM = 0>
+            static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
+            }
+
+            template <size_t DIM = 0>
+            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -L2SqrSim<DIM>(pVect1v, pVect2v, qty_ptr);
+            }
+
+            template <size_t DIM = 0>
+            static float
+            InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - InnerProductSim<DIM>(pVect1v, pVect2v, qty_ptr);
+            }
+
+            template <size_t DIM = 0>
+            static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - CosineSim<DIM>(pVect1v, pVect2v, qty_ptr);
+            }
+
+            // Prepared query: the float query layout (see prepare_float_query) with every value
+            // multiplied by the scale of its dimension and q . offsets in place of the sum, so
+            // q . x = q . o + sum (q_i * s_i) * c_i is a plain float by int8 dot product
+            inline std::vector<uint8_t> prepare_query(const std::vector<float>& input,
+                                                      const void* params) {
+                const DimScales& scales = scales_of(params);
+                size_t dim = scales.dimension();
+                if(input.size() != dim) {
+                    throw std::runtime_error("Query dimension does not match the INT8S scales");
+                }
+                std::vector<float> scaled(dim);
+                float norm = 0.0f;
+                float offset_dot = 0.0f;
+                for(size_t i = 0; i < dim; i++) {
+                    scaled[i] = input[i] * scales.scales()[i];
+                    norm += input[i] * input[i];
+                    offset_dot += input[i] * scales.offsets()[i];
+                }
+                std::vector<uint8_t> buffer(get_float_query_size(dim));
+                std::memcpy(buffer.data(), scaled.data(), dim * sizeof(float));
+                std::memcpy(buffer.data() + dim * sizeof(float), &norm, sizeof(float));
+                std::memcpy(buffer.data() + (dim + 1) * sizeof(float), &offset_dot, sizeof(float));
+                return buffer;
+            }
+
+            template <size_t DIM = 0>
+            static float
+            QueryInnerProductSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                float dot = int8d::QueryDot<DIM>((const float*)query, (const int8_t*)vec, qty);
+                return static_cast<const float*>(query)[qty + 1] + dot;
+            }
+
+            template <size_t DIM = 0>
+            static float QueryL2SqrSim(const void* query, const void* vec, const void* qty_ptr) {
+                size_t qty = kernel_dim<DIM>(static_cast<const hnswlib::DistParams*>(qty_ptr)->dim);
+                float ip = QueryInnerProductSim<DIM>(query, vec, qty_ptr);
+                float norm = extract_squared_norm((const uint8_t*)vec, qty);
+                return -std::max(float_query_squared_norm(query, qty) + norm - 2.0f * ip, 0.0f);
+            }
+
+            template <size_t DIM = 0>
+            static float QueryCosineSim(const void* query, const void* vec, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return QueryInnerProductSim<DIM>(query, vec, qty_ptr);
+            }
+
+            inline std::vector<uint8_t> encode(const std::vector<float>& input,
+                                               const void* params) {
+                const DimScales& scales = scales_of(params);
+                size_t dim = scales.dimension();
+                if(input.size() != dim) {
+                    throw std::runtime_error("Vector dimension does not match the INT8S scales");
+                }
+                std::vector<uint8_t> buffer(get_storage_size(dim));
+                int8_t* codes = reinterpret_cast<int8_t*>(buffer.data());
+                scales.encode(input.data(), codes);
+
+                float norm = 0.0f;
+                float offset_dot = 0.0f;
+                for(size_t i = 0; i < dim; i++) {
+                    float scaled = scales.scales()[i] * static_cast<float>(codes[i]);
+                    float value = scales.offsets()[i] + scaled;
+                    norm += value * value;
+                    offset_dot += scales.offsets()[i] * scaled;
+                }
+                std::memcpy(buffer.data() + dim, &norm, sizeof(float));
+                std::memcpy(buffer.data() + dim + sizeof(float), &offset_dot, sizeof(float));
+                return buffer;
+            }
+
+            inline std::vector<float> decode(const uint8_t* in, const void* params) {
+                const DimScales& scales = scales_of(params);
+                std::vector<float> output(scales.dimension());
+                scales.decode(reinterpret_cast<const int8_t*>(in), output.data());
+                return output;
+            }
+
+            // Codes mean nothing without the scales of their index, which only reach the
+            // params based entry points above
+            inline std::vector<uint8_t> quantize(const std::vector<float>&) {
+                throw std::runtime_error(
+                        "INT8S vectors are encoded with the scales of their index");
+            }
+
+            inline std::vector<float> dequantize(const uint8_t*, size_t) {
+                throw std::runtime_error(
+                        "INT8S vectors are decoded with the scales of their index");
+            }
+
+            inline std::vector<uint8_t> quantize_to_int8(const void*, size_t) {
+                throw std::runtime_error("INT8S vectors have no INT8 upper layer representation");
+            }
+
+        }  // namespace int8s::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
+
+        class Int8SQuantizer : public Quantizer {
+        public:
+            std::string name() const override { return "int8s"; }
+            QuantizationLevel level() const override { return QuantizationLevel::INT8S; }
+
+            QuantizerDispatch getDispatch() const override { return makeDispatch<0>(); }
+
+            QuantizerDispatch getDispatchForDim(size_t dim) const override {
+                return dispatch_for_dim(dim, []<size_t DIM>() { return makeDispatch<DIM>(); });
+            }
+
+        private:
+            template <size_t DIM> static QuantizerDispatch makeDispatch() {
+                QuantizerDispatch d;
+                d.dist_l2 = &int8s::L2Sqr<DIM>;
+                d.dist_ip = &int8s::InnerProduct<DIM>;
+                d.dist_cosine = &int8s::Cosine<DIM>;
+                d.sim_l2 = &int8s::L2SqrSim<DIM>;
+                d.sim_ip = &int8s::InnerProductSim<DIM>;
+                d.sim_cosine = &int8s::CosineSim<DIM>;
+                d.sim_l2_batch = &sim_batch_pairwise<&int8s::L2SqrSim<DIM>>;
+                d.sim_ip_batch = &sim_batch_pairwise<&int8s::InnerProductSim<DIM>>;
+                d.sim_cosine_batch = &sim_batch_pairwise<&int8s::CosineSim<DIM>>;
+                d.quantize = &int8s::quantize;
+                d.dequantize = &int8s::dequantize;
+                d.quantize_to_int8 = &int8s::quantize_to_int8;
+                d.get_storage_size = &int8s::get_storage_size;
+                d.extract_scale = &int8s::extract_scale;
+                d.encode = &int8s::encode;
+                d.decode = &int8s::decode;
+                d.prepare_query = &int8s::prepare_query;
+                d.query_sim_l2 = &int8s::QueryL2SqrSim<DIM>;
+                d.query_sim_ip = &int8s::QueryInnerProductSim<DIM>;
+                d.query_sim_cosine = &int8s::QueryCosineSim<DIM>;
+                d.query_sim_l2_batch = &sim_batch_pairwise<&int8s::QueryL2SqrSim<DIM>>;
+                d.query_sim_ip_batch = &sim_batch_pairwise<&int8s::QueryInnerProductSim<DIM>>;
+                d.query_sim_cosine_batch = &sim_batch_pairwise<&int8s::QueryCosineSim<DIM>>;
+                return d;
+            }
+        };
+
+        // Register INT8S
+        static RegisterQuantizer
+                reg_int8s(QuantizationLevel::INT8S, "int8s", std::make_shared<Int8SQuantizer>());
+
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
+}  // namespace ndd
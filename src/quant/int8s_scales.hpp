@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Trained INT8S state. Shared by every instruction set's copy of the INT8S kernels
+// (int8s.hpp), so it stays outside the kernel namespaces
+namespace ndd {
+    namespace quant {
+        namespace int8s {
+
+            constexpr float INT8S_MAX = 127.0f;
+
+            constexpr uint32_t SCALES_MAGIC = 0x5338444e;  // "NDS8"
+            constexpr uint32_t SCALES_VERSION = 1;
+
+            // Offset and scale of every dimension: value = offset + scale * code. Immutable
+            // once trained, so searches and inserts share it without locking.
+            class DimScales {
+            public:
+                DimScales(size_t dimension, std::vector<float> offsets, std::vector<float> scales) :
+                    dimension_(dimension),
+                    offsets_(std::move(offsets)),
+                    scales_(std::move(scales)) {
+                    if(offsets_.size() != dimension_ || scales_.size() != dimension_) {
+                        throw std::runtime_error("INT8S scales do not match dimension");
+                    }
+                    weights_.resize(dimension_);
+                    offset_norm_ = 0.0f;
+                    for(size_t d = 0; d < dimension_; d++) {
+                        weights_[d] = scales_[d] * scales_[d];
+                        offset_norm_ += offsets_[d] * offsets_[d];
+                    }
+                }
+
+                // Range of every dimension over n row-major vectors. Each dimension gets its
+                // own, so a few wide dimensions do not cost the others their resolution
+                static std::shared_ptr<DimScales>
+                train(const float* data, size_t n, size_t dimension) {
+                    if(n == 0) {
+                        throw std::runtime_error("INT8S training needs at least one vector");
+                    }
+
+                    std::vector<float> lo(data, data + dimension);
+                    std::vector<float> hi(data, data + dimension);
+                    for(size_t i = 1; i < n; i++) {
+                        const float* row = data + i * dimension;
+                        for(size_t d = 0; d < dimension; d++) {
+                            lo[d] = std::min(lo[d], row[d]);
+                            hi[d] = std::max(hi[d], row[d]);
+                        }
+                    }
+
+                    std::vector<float> offsets(dimension);
+                    std::vector<float> scales(dimension);
+                    for(size_t d = 0; d < dimension; d++) {
+                        offsets[d] = (lo[d] + hi[d]) * 0.5f;
+                        scales[d] = (hi[d] - lo[d]) / (2.0f * INT8S_MAX);
+                    }
+
+                    return std::make_shared<DimScales>(
+                            dimension, std::move(offsets), std::move(scales));
+                }
+
+                size_t dimension() const { return dimension_; }
+                const float* offsets() const { return offsets_.data(); }
+                const float* scales() const { return scales_.data(); }
+                // Squared scales, the weights of code products between two stored vectors
+                const float* weights() const { return weights_.data(); }
+                // Squared norm of the offsets
+                float offsetNorm() const { return offset_norm_; }
+
+                // Values outside the trained range are clamped to it
+                void encode(const float* in, int8_t* codes) const {
+                    for(size_t d = 0; d < dimension_; d++) {
+                        float code = 0.0f;
+                        if(scales_[d] > 0.0f) {
+                            code = std::nearbyint((in[d] - offsets_[d]) / scales_[d]);
+                        }
+                        codes[d] = static_cast<int8_t>(std::clamp(code, -INT8S_MAX, INT8S_MAX));
+                    }
+                }
+
+                void decode(const int8_t* codes, float* out) const {
+                    for(size_t d = 0; d < dimension_; d++) {
+                        out[d] = offsets_[d] + scales_[d] * static_cast<float>(codes[d]);
+                    }
+                }
+
+                void save(const std::string& path) const {
+                    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                    if(!out) {
+                        throw std::runtime_error("Cannot write INT8S scales: " + path);
+                    }
+                    uint64_t dimension = dimension_;
+                    out.write(reinterpret_cast<const char*>(&SCALES_MAGIC), sizeof(uint32_t));
+                    out.write(reinterpret_cast<const char*>(&SCALES_VERSION), sizeof(uint32_t));
+                    out.write(reinterpret_cast<const char*>(&dimension), sizeof(uint64_t));
+                    out.write(reinterpret_cast<const char*>(offsets_.data()),
+                              dimension_ * sizeof(float));
+                    out.write(reinterpret_cast<const char*>(scales_.data()),
+                              dimension_ * sizeof(float));
+                    out.flush();
+                    if(!out) {
+                        throw std::runtime_error("Cannot write INT8S scales: " + path);
+                    }
+                }
+
+                static std::shared_ptr<DimScales> load(const std::string& path) {
+                    std::ifstream in(path, std::ios::binary);
+                    if(!in) {
+                        throw std::runtime_error("Cannot open INT8S scales: " + path);
+                    }
+                    uint32_t magic = 0;
+                    uint32_t version = 0;
+                    uint64_t dimension = 0;
+                    in.read(reinterpret_cast<char*>(&magic), sizeof(uint32_t));
+                    in.read(reinterpret_cast<char*>(&version), sizeof(uint32_t));
+                    in.read(reinterpret_cast<char*>(&dimension), sizeof(uint64_t));
+                    if(!in || magic != SCALES_MAGIC || version != SCALES_VERSION) {
+                        throw std::runtime_error("Invalid INT8S scales: " + path);
+                    }
+                    std::vector<float> offsets(dimension);
+                    std::vector<float> scales(dimension);
+                    in.read(reinterpret_cast<char*>(offsets.data()), dimension * sizeof(float));
+                    in.read(reinterpret_cast<char*>(scales.data()), dimension * sizeof(float));
+                    if(!in) {
+                        throw std::runtime_error("Truncated INT8S scales: " + path);
+                    }
+                    return std::make_shared<DimScales>(
+                            dimension, std::move(offsets), std::move(scales));
+                }
+
+            private:
+                size_t dimension_;
+                std::vector<float> offsets_;
+                std::vector<float> scales_;
+                std::vector<float> weights_;
+                float offset_norm_;
+            };
+
+        }  // namespace int8s
+    }  // namespace quant
+}  // namespace ndd
@@ -0,0 +1,57 @@
+// AVX512 copy of the quantization kernels, built into USE_RUNTIME_DISPATCH binaries next to
+// the AVX2 baseline the rest of the binary is compiled for. main() switches the registry to
+// these kernels when the CPU passes is_avx512_compatible().
+//
+// Everything shared with the rest of the binary is included first, so it is compiled for the
+// baseline. The kernel headers after it get AVX512 target attributes on every function and
+// land in the simd_avx512 inline namespaces, so the linker never mixes them up with the AVX2
+// copies.
+#if !defined(USE_AVX512)
+#    error "kernels_avx512.cpp must be compiled with USE_AVX512"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <immintrin.h>
+#include "common.hpp"
+#include "pq_codebook.hpp"
+#include "int8s_scales.hpp"
+#include "../hnsw/dist_params.h"
+
+#if defined(__clang__)
+#    pragma clang attribute push(                                                              \
+            __attribute__((target("avx512f,avx512bw,avx512dq,avx512vnni,avx512fp16,"            \
+                                  "avx512vpopcntdq,avx512bf16"))),                               \
+            apply_to = function)
+#else
+#    pragma GCC push_options
+#    pragma GCC target("avx512f,avx512bw,avx512dq,avx512vnni,avx512fp16,avx512vpopcntdq," \
+                       "avx512bf16")
+#endif
+
+// Same levels as dispatch.hpp
+#include "float16.hpp"
+#include "bfloat16.hpp"
+#include "float8.hpp"
+#include "float32.hpp"
+#include "int8d.hpp"
+#include "int8s.hpp"
+#include "int16d.hpp"
+#include "int4d.hpp"
+#include "binary.hpp"
+#include "pq.hpp"
+#include "rabitq.hpp"
+
+#if defined(__clang__)
+#    pragma clang attribute pop
+#else
+#    pragma GCC pop_options
+#endif
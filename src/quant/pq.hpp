@@ -0,0 +1,404 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "kernels.hpp"
+#include "pq_codebook.hpp"
+#include "../hnsw/dist_params.h"
+
+#if defined(USE_AVX512) || defined(USE_AVX2)
+#    include <immintrin.h>
+#endif
+
+#if defined(USE_NEON)
+#    include <arm_neon.h>
+#endif
+
+namespace ndd {
+    namespace quant {
+        namespace pq::inline NDD_SIMD_NAMESPACE {
+
+            // First byte of a buffer, tells stored codes apart from a prepared query table
+            constexpr uint8_t FORMAT_CODES = 0;
+            constexpr uint8_t FORMAT_TABLE = 1;
+
+            // Prepared query: format byte, padding, float scale and bias, then one row of
+            // NUM_CENTROIDS uint8 entries per subspace
+            constexpr size_t TABLE_HEADER_SIZE = 12;
+
+            inline size_t get_storage_size(size_t dimension) { return 1 + code_bytes(dimension); }
+
+            // Table rows are padded to two per code byte, the padding rows are zero
+            inline size_t get_table_size(size_t dimension) {
+                return TABLE_HEADER_SIZE + code_bytes(dimension) * 2 * NUM_CENTROIDS;
+            }
+
+            // No scale for PQ codes
+            inline float extract_scale(const uint8_t*, size_t) { return 1.0f; }
+
+            inline const Codebook& codebook_of(const void* params) {
+                const auto* dist_params = static_cast<const hnswlib::DistParams*>(params);
+                if(!dist_params || !dist_params->codebook) {
+                    throw std::runtime_error("PQ codebook is not trained");
+                }
+                return *static_cast<const Codebook*>(dist_params->codebook);
+            }
+
+            // Quantizes a float table to uint8 rows. Every row is shifted by its minimum and
+            // all rows share one scale, so a sum of entries maps back with scale * sum + bias.
+            inline void quantize_table(const float* table, size_t dimension, uint8_t* out) {
+                size_t subspaces = num_subspaces(dimension);
+                std::memset(out, 0, get_table_size(dimension));
+                out[0] = FORMAT_TABLE;
+
+                float bias = 0.0f;
+                float max_range = 0.0f;
+                for(size_t m = 0; m < subspaces; m++) {
+                    const float* row = table + m * NUM_CENTROIDS;
+                    auto [min_it, max_it] = std::minmax_element(row, row + NUM_CENTROIDS);
+                    bias += *min_it;
+                    max_range = std::max(max_range, *max_it - *min_it);
+                }
+                float scale = max_range > 0.0f ? max_range / 255.0f : 1.0f;
+
+                uint8_t* rows = out + TABLE_HEADER_SIZE;
+                for(size_t m = 0; m < subspaces; m++) {
+                    const float* row = table + m * NUM_CENTROIDS;
+                    float row_min = *std::min_element(row, row + NUM_CENTROIDS);
+                    for(size_t c = 0; c < NUM_CENTROIDS; c++) {
+                        float q = std::nearbyint((row[c] - row_min) / scale);
+                        rows[m * NUM_CENTROIDS + c] = static_cast<uint8_t>(std::min(q, 255.0f));
+                    }
+                }
+                std::memcpy(out + 4, &scale, sizeof(float));
+                std::memcpy(out + 8, &bias, sizeof(float));
+            }
+
+            inline uint32_t scan_codes(const uint8_t* rows, const uint8_t* codes, size_t bytes) {
+                uint32_t sum = 0;
+                for(size_t j = 0; j < bytes; j++) {
+                    const uint8_t* pair = rows + j * 2 * NUM_CENTROIDS;
+                    sum += pair[codes[j] & 0x0F];
+                    sum += pair[NUM_CENTROIDS + (codes[j] >> 4)];
+                }
+                return sum;
+            }
+
+            // Scores count stored vectors against a prepared query table
+            inline void scan_table(const uint8_t* table,
+                                   const void* const* vectors,
+                                   size_t count,
+                                   size_t dimension,
+                                   float* out) {
+                const size_t bytes = code_bytes(dimension);
+                const uint8_t* rows = table + TABLE_HEADER_SIZE;
+                float scale;
+                float bias;
+                std::memcpy(&scale, table + 4, sizeof(float));
+                std::memcpy(&bias, table + 8, sizeof(float));
+
+                size_t i = 0;
+#if defined(USE_AVX512) || defined(USE_AVX2)
+                // Fast scan over 32 vectors: their code bytes at one position are gathered
+                // into a register and both nibbles are looked up with one shuffle each
+                const __m256i low_mask = _mm256_set1_epi8(0x0F);
+                const __m256i zero = _mm256_setzero_si256();
+                alignas(32) uint8_t column[32];
+                alignas(32) uint16_t partial[32];
+                for(; i + 32 <= count; i += 32) {
+                    const uint8_t* codes[32];
+                    for(size_t v = 0; v < 32; v++) {
+                        codes[v] = static_cast<const uint8_t*>(vectors[i + v]) + 1;
+                    }
+
+                    uint32_t totals[32] = {};
+                    size_t j = 0;
+                    while(j < bytes) {
+                        // 128 positions of at most 2 * 255 each fit the uint16 lanes
+                        size_t block_end = std::min(bytes, j + 128);
+                        __m256i acc_lo = zero;
+                        __m256i acc_hi = zero;
+                        for(; j < block_end; j++) {
+                            for(size_t v = 0; v < 32; v++) {
+                                column[v] = codes[v][j];
+                            }
+                            __m256i c = _mm256_load_si256((const __m256i*)column);
+                            __m256i lo = _mm256_and_si256(c, low_mask);
+                            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(c, 4), low_mask);
+
+                            const uint8_t* pair = rows + j * 2 * NUM_CENTROIDS;
+                            __m256i row_lo = _mm256_broadcastsi128_si256(
+                                    _mm_loadu_si128((const __m128i*)pair));
+                            __m256i row_hi = _mm256_broadcastsi128_si256(
+                                    _mm_loadu_si128((const __m128i*)(pair + NUM_CENTROIDS)));
+                            __m256i val_lo = _mm256_shuffle_epi8(row_lo, lo);
+                            __m256i val_hi = _mm256_shuffle_epi8(row_hi, hi);
+
+                            acc_lo = _mm256_add_epi16(acc_lo, _mm256_unpacklo_epi8(val_lo, zero));
+                            acc_lo = _mm256_add_epi16(acc_lo, _mm256_unpacklo_epi8(val_hi, zero));
+                            acc_hi = _mm256_add_epi16(acc_hi, _mm256_unpackhi_epi8(val_lo, zero));
+                            acc_hi = _mm256_add_epi16(acc_hi, _mm256_unpackhi_epi8(val_hi, zero));
+                        }
+
+                        // unpacklo holds vectors 0-7 and 16-23, unpackhi 8-15 and 24-31
+                        _mm256_store_si256((__m256i*)partial, acc_lo);
+                        _mm256_store_si256((__m256i*)(partial + 16), acc_hi);
+                        for(size_t w = 0; w < 8; w++) {
+                            totals[w] += partial[w];
+                            totals[16 + w] += partial[8 + w];
+                            totals[8 + w] += partial[16 + w];
+                            totals[24 + w] += partial[24 + w];
+                        }
+                    }
+
+                    for(size_t v = 0; v < 32; v++) {
+                        out[i + v] = scale * static_cast<float>(totals[v]) + bias;
+                    }
+                }
+#elif defined(USE_NEON)
+                // Fast scan over 16 vectors with one table lookup per nibble
+                const uint8x16_t low_mask = vdupq_n_u8(0x0F);
+                uint8_t column[16];
+                uint16_t partial[16];
+                for(; i + 16 <= count; i += 16) {
+                    const uint8_t* codes[16];
+                    for(size_t v = 0; v < 16; v++) {
+                        codes[v] = static_cast<const uint8_t*>(vectors[i + v]) + 1;
+                    }
+
+                    uint32_t totals[16] = {};
+                    size_t j = 0;
+                    while(j < bytes) {
+                        // 128 positions of at most 2 * 255 each fit the uint16 lanes
+                        size_t block_end = std::min(bytes, j + 128);
+                        uint16x8_t acc_lo = vdupq_n_u16(0);
+                        uint16x8_t acc_hi = vdupq_n_u16(0);
+                        for(; j < block_end; j++) {
+                            for(size_t v = 0; v < 16; v++) {
+                                column[v] = codes[v][j];
+                            }
+                            uint8x16_t c = vld1q_u8(column);
+                            uint8x16_t lo = vandq_u8(c, low_mask);
+                            uint8x16_t hi = vshrq_n_u8(c, 4);
+
+                            const uint8_t* pair = rows + j * 2 * NUM_CENTROIDS;
+                            uint8x16_t val_lo = vqtbl1q_u8(vld1q_u8(pair), lo);
+                            uint8x16_t val_hi = vqtbl1q_u8(vld1q_u8(pair + NUM_CENTROIDS), hi);
+
+                            acc_lo = vaddw_u8(acc_lo, vget_low_u8(val_lo));
+                            acc_lo = vaddw_u8(acc_lo, vget_low_u8(val_hi));
+                            acc_hi = vaddw_u8(acc_hi, vget_high_u8(val_lo));
+                            acc_hi = vaddw_u8(acc_hi, vget_high_u8(val_hi));
+                        }
+
+                        vst1q_u16(partial, acc_lo);
+                        vst1q_u16(partial + 8, acc_hi);
+                        for(size_t v = 0; v < 16; v++) {
+                            totals[v] += partial[v];
+                        }
+                    }
+
+                    for(size_t v = 0; v < 16; v++) {
+                        out[i + v] = scale * static_cast<float>(totals[v]) + bias;
+                    }
+                }
+#endif
+                for(; i < count; i++) {
+                    const uint8_t* codes = static_cast<const uint8_t*>(vectors[i]) + 1;
+                    out[i] = scale * static_cast<float>(scan_codes(rows, codes, bytes)) + bias;
+                }
+            }
+
+            // Summed table entries of a query against one stored vector: table lookups for a
+            // prepared query, centroid to centroid distances for stored codes
+            inline float score(const void* query,
+                               const void* vec,
+                               const void* params,
+                               hnswlib::SpaceType space) {
+                const uint8_t* q = static_cast<const uint8_t*>(query);
+                const uint8_t* codes = static_cast<const uint8_t*>(vec) + 1;
+                size_t dimension = static_cast<const hnswlib::DistParams*>(params)->dim;
+
+                if(q[0] == FORMAT_TABLE) {
+                    float scale;
+                    float bias;
+                    std::memcpy(&scale, q + 4, sizeof(float));
+                    std::memcpy(&bias, q + 8, sizeof(float));
+                    uint32_t sum = scan_codes(q + TABLE_HEADER_SIZE, codes, code_bytes(dimension));
+                    return scale * static_cast<float>(sum) + bias;
+                }
+
+                const float* table = codebook_of(params).symmetricTable(space);
+                float sum = 0.0f;
+                for(size_t m = 0; m < num_subspaces(dimension); m++) {
+                    sum += table[(m * NUM_CENTROIDS + get_code(q + 1, m)) * NUM_CENTROIDS
+                                 + get_code(codes, m)];
+                }
+                return sum;
+            }
+
+            inline void score_batch(const void* query,
+                                    const void* const* vectors,
+                                    size_t count,
+                                    const void* params,
+                                    hnswlib::SpaceType space,
+                                    float* out) {
+                const uint8_t* q = static_cast<const uint8_t*>(query);
+                if(q[0] == FORMAT_TABLE) {
+                    size_t dimension = static_cast<const hnswlib::DistParams*>(params)->dim;
+                    scan_table(q, vectors, count, dimension, out);
+                    return;
+                }
+                for(size_t i = 0; i < count; i++) {
+                    out[i] = score(query, vectors[i], params, space);
+                }
+            }
+
+            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -score(pVect1v, pVect2v, qty_ptr, hnswlib::L2_SPACE);
+            }
+
+            static float
+            InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return score(pVect1v, pVect2v, qty_ptr, hnswlib::IP_SPACE);
+            }
+
+            static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -L2SqrSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float
+            InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static void L2SqrSimBatch(const void* query,
+                                      const void* const* vectors,
+                                      size_t count,
+                                      const void* qty_ptr,
+                                      float* out) {
+                score_batch(query, vectors, count, qty_ptr, hnswlib::L2_SPACE, out);
+                for(size_t i = 0; i < count; i++) {
+                    out[i] = -out[i];
+                }
+            }
+
+            static void InnerProductSimBatch(const void* query,
+                                             const void* const* vectors,
+                                             size_t count,
+                                             const void* qty_ptr,
+                                             float* out) {
+                score_batch(query, vectors, count, qty_ptr, hnswlib::IP_SPACE, out);
+            }
+
+            static void CosineSimBatch(const void* query,
+                                       const void* const* vectors,
+                                       size_t count,
+                                       const void* qty_ptr,
+                                       float* out) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                InnerProductSimBatch(query, vectors, count, qty_ptr, out);
+            }
+
+            inline std::vector<uint8_t> encode(const std::vector<float>& input,
+                                               const void* params) {
+                const Codebook& codebook = codebook_of(params);
+                if(input.size() != codebook.dimension()) {
+                    throw std::runtime_error("Vector dimension does not match the PQ codebook");
+                }
+                std::vector<uint8_t> buffer(get_storage_size(codebook.dimension()));
+                buffer[0] = FORMAT_CODES;
+                codebook.encode(input.data(), buffer.data() + 1);
+                return buffer;
+            }
+
+            inline std::vector<float> decode(const uint8_t* in, const void* params) {
+                const Codebook& codebook = codebook_of(params);
+                std::vector<float> output(codebook.dimension());
+                codebook.decode(in + 1, output.data());
+                return output;
+            }
+
+            // Asymmetric distance table of a float query, built once per search
+            inline std::vector<uint8_t> prepare_query(const std::vector<float>& input,
+                                                      const void* params) {
+                const Codebook& codebook = codebook_of(params);
+                if(input.size() != codebook.dimension()) {
+                    throw std::runtime_error("Query dimension does not match the PQ codebook");
+                }
+                auto space = static_cast<const hnswlib::DistParams*>(params)->space_type;
+                std::vector<float> table(codebook.subspaces() * NUM_CENTROIDS);
+                codebook.fillTable(input.data(), space, table.data());
+
+                std::vector<uint8_t> buffer(get_table_size(codebook.dimension()));
+                quantize_table(table.data(), codebook.dimension(), buffer.data());
+                return buffer;
+            }
+
+            // Codes mean nothing without the codebook of their index, which only reaches the
+            // params based entry points above
+            inline std::vector<uint8_t> quantize(const std::vector<float>&) {
+                throw std::runtime_error("PQ vectors are encoded with the codebook of their index");
+            }
+
+            inline std::vector<float> dequantize(const uint8_t*, size_t) {
+                throw std::runtime_error("PQ vectors are decoded with the codebook of their index");
+            }
+
+            inline std::vector<uint8_t> quantize_to_int8(const void*, size_t) {
+                throw std::runtime_error("PQ vectors have no INT8 upper layer representation");
+            }
+
+        }  // namespace pq::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
+
+        class PQQuantizer : public Quantizer {
+        public:
+            std::string name() const override { return "pq"; }
+            QuantizationLevel level() const override { return QuantizationLevel::PQ; }
+
+            QuantizerDispatch getDispatch() const override {
+                QuantizerDispatch d;
+                d.dist_l2 = &pq::L2Sqr;
+                d.dist_ip = &pq::InnerProduct;
+                d.dist_cosine = &pq::Cosine;
+                d.sim_l2 = &pq::L2SqrSim;
+                d.sim_ip = &pq::InnerProductSim;
+                d.sim_cosine = &pq::CosineSim;
+                d.sim_l2_batch = &pq::L2SqrSimBatch;
+                d.sim_ip_batch = &pq::InnerProductSimBatch;
+                d.sim_cosine_batch = &pq::CosineSimBatch;
+                d.quantize = &pq::quantize;
+                d.dequantize = &pq::dequantize;
+                d.quantize_to_int8 = &pq::quantize_to_int8;
+                d.get_storage_size = &pq::get_storage_size;
+                d.extract_scale = &pq::extract_scale;
+                d.encode = &pq::encode;
+                d.decode = &pq::decode;
+                d.prepare_query = &pq::prepare_query;
+                return d;
+            }
+        };
+
+        // Register PQ
+        static RegisterQuantizer
+                reg_pq(QuantizationLevel::PQ, "pq", std::make_shared<PQQuantizer>());
+
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
+}  // namespace ndd
@@ -0,0 +1,293 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include "../hnsw/dist_params.h"
+
+// Trained PQ state. Shared by every instruction set's copy of the PQ kernels (pq.hpp), so
+// it stays outside the kernel namespaces
+namespace ndd {
+    namespace quant {
+        namespace pq {
+
+            // Every sub-quantizer covers SUBSPACE_DIM dimensions with a 4-bit code, so one row
+            // of a query lookup table fits a 16 byte shuffle register
+            constexpr size_t SUBSPACE_DIM = 4;
+            constexpr size_t NUM_CENTROIDS = 16;
+
+            constexpr uint32_t CODEBOOK_MAGIC = 0x5150444e;  // "NDPQ"
+            constexpr uint32_t CODEBOOK_VERSION = 1;
+
+            inline size_t num_subspaces(size_t dimension) {
+                return (dimension + SUBSPACE_DIM - 1) / SUBSPACE_DIM;
+            }
+
+            // Two codes per byte, even subspaces in the low nibble
+            inline size_t code_bytes(size_t dimension) {
+                return (num_subspaces(dimension) + 1) / 2;
+            }
+
+            inline uint8_t get_code(const uint8_t* codes, size_t subspace) {
+                return (codes[subspace / 2] >> ((subspace & 1) * 4)) & 0x0F;
+            }
+
+            // Centroids of every subspace. Immutable once trained, so searches and inserts
+            // share it without locking.
+            class Codebook {
+            public:
+                Codebook(size_t dimension, std::vector<float> centroids) :
+                    dimension_(dimension),
+                    num_subspaces_(num_subspaces(dimension)),
+                    centroids_(std::move(centroids)) {
+                    if(centroids_.size() != num_subspaces_ * NUM_CENTROIDS * SUBSPACE_DIM) {
+                        throw std::runtime_error("PQ codebook size does not match dimension");
+                    }
+                    buildSymmetricTables();
+                }
+
+                // k-means with NUM_CENTROIDS centroids in every subspace of n row-major vectors
+                static std::shared_ptr<Codebook> train(const float* data,
+                                                       size_t n,
+                                                       size_t dimension,
+                                                       size_t iterations,
+                                                       uint64_t seed) {
+                    if(n < NUM_CENTROIDS) {
+                        throw std::runtime_error("PQ training needs at least "
+                                                 + std::to_string(NUM_CENTROIDS) + " vectors");
+                    }
+
+                    size_t subspaces = num_subspaces(dimension);
+                    std::vector<float> centroids(subspaces * NUM_CENTROIDS * SUBSPACE_DIM);
+                    std::vector<float> points(n * SUBSPACE_DIM);
+                    std::vector<uint8_t> assignment(n);
+                    std::vector<size_t> order(n);
+                    std::mt19937_64 rng(seed);
+
+                    for(size_t m = 0; m < subspaces; m++) {
+                        for(size_t i = 0; i < n; i++) {
+                            copySubvector(data + i * dimension,
+                                          dimension,
+                                          m,
+                                          &points[i * SUBSPACE_DIM]);
+                        }
+                        float* sub_centroids = &centroids[m * NUM_CENTROIDS * SUBSPACE_DIM];
+
+                        // Start from distinct random points
+                        std::iota(order.begin(), order.end(), 0);
+                        for(size_t c = 0; c < NUM_CENTROIDS; c++) {
+                            size_t pick = c + rng() % (n - c);
+                            std::swap(order[c], order[pick]);
+                            std::memcpy(&sub_centroids[c * SUBSPACE_DIM],
+                                        &points[order[c] * SUBSPACE_DIM],
+                                        SUBSPACE_DIM * sizeof(float));
+                        }
+
+                        for(size_t iter = 0; iter < iterations; iter++) {
+                            bool changed = false;
+                            for(size_t i = 0; i < n; i++) {
+                                uint8_t nearest =
+                                        nearestCentroid(sub_centroids, &points[i * SUBSPACE_DIM]);
+                                if(iter == 0 || nearest != assignment[i]) {
+                                    assignment[i] = nearest;
+                                    changed = true;
+                                }
+                            }
+                            if(!changed) {
+                                break;
+                            }
+
+                            float sums[NUM_CENTROIDS * SUBSPACE_DIM] = {};
+                            size_t counts[NUM_CENTROIDS] = {};
+                            for(size_t i = 0; i < n; i++) {
+                                counts[assignment[i]]++;
+                                for(size_t d = 0; d < SUBSPACE_DIM; d++) {
+                                    sums[assignment[i] * SUBSPACE_DIM + d] +=
+                                            points[i * SUBSPACE_DIM + d];
+                                }
+                            }
+                            for(size_t c = 0; c < NUM_CENTROIDS; c++) {
+                                // An empty cluster restarts from a random point
+                                if(counts[c] == 0) {
+                                    std::memcpy(&sub_centroids[c * SUBSPACE_DIM],
+                                                &points[(rng() % n) * SUBSPACE_DIM],
+                                                SUBSPACE_DIM * sizeof(float));
+                                    continue;
+                                }
+                                for(size_t d = 0; d < SUBSPACE_DIM; d++) {
+                                    sub_centroids[c * SUBSPACE_DIM + d] =
+                                            sums[c * SUBSPACE_DIM + d] / counts[c];
+                                }
+                            }
+                        }
+                    }
+
+                    return std::make_shared<Codebook>(dimension, std::move(centroids));
+                }
+
+                size_t dimension() const { return dimension_; }
+                size_t subspaces() const { return num_subspaces_; }
+
+                // Writes code_bytes(dimension) bytes of codes for one vector
+                void encode(const float* in, uint8_t* codes) const {
+                    std::memset(codes, 0, code_bytes(dimension_));
+                    float sub[SUBSPACE_DIM];
+                    for(size_t m = 0; m < num_subspaces_; m++) {
+                        copySubvector(in, dimension_, m, sub);
+                        uint8_t code = nearestCentroid(subCentroids(m), sub);
+                        codes[m / 2] |= code << ((m & 1) * 4);
+                    }
+                }
+
+                void decode(const uint8_t* codes, float* out) const {
+                    for(size_t m = 0; m < num_subspaces_; m++) {
+                        const float* centroid =
+                                subCentroids(m) + get_code(codes, m) * SUBSPACE_DIM;
+                        for(size_t d = 0; d < SUBSPACE_DIM && m * SUBSPACE_DIM + d < dimension_;
+                            d++) {
+                            out[m * SUBSPACE_DIM + d] = centroid[d];
+                        }
+                    }
+                }
+
+                // Query against every centroid, squared L2 distances for L2 spaces and inner
+                // products otherwise. num_subspaces * NUM_CENTROIDS floats
+                void fillTable(const float* query, hnswlib::SpaceType space, float* table) const {
+                    float sub[SUBSPACE_DIM];
+                    for(size_t m = 0; m < num_subspaces_; m++) {
+                        copySubvector(query, dimension_, m, sub);
+                        for(size_t c = 0; c < NUM_CENTROIDS; c++) {
+                            const float* centroid = subCentroids(m) + c * SUBSPACE_DIM;
+                            table[m * NUM_CENTROIDS + c] = space == hnswlib::L2_SPACE
+                                                                   ? l2(sub, centroid)
+                                                                   : dot(sub, centroid);
+                        }
+                    }
+                }
+
+                // Centroid against centroid per subspace, for scoring stored codes against
+                // each other during graph construction
+                const float* symmetricTable(hnswlib::SpaceType space) const {
+                    return space == hnswlib::L2_SPACE ? symmetric_l2_.data()
+                                                      : symmetric_ip_.data();
+                }
+
+                void save(const std::string& path) const {
+                    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                    if(!out) {
+                        throw std::runtime_error("Cannot write PQ codebook: " + path);
+                    }
+                    uint64_t dimension = dimension_;
+                    out.write(reinterpret_cast<const char*>(&CODEBOOK_MAGIC), sizeof(uint32_t));
+                    out.write(reinterpret_cast<const char*>(&CODEBOOK_VERSION), sizeof(uint32_t));
+                    out.write(reinterpret_cast<const char*>(&dimension), sizeof(uint64_t));
+                    out.write(reinterpret_cast<const char*>(centroids_.data()),
+                              centroids_.size() * sizeof(float));
+                    out.flush();
+                    if(!out) {
+                        throw std::runtime_error("Cannot write PQ codebook: " + path);
+                    }
+                }
+
+                static std::shared_ptr<Codebook> load(const std::string& path) {
+                    std::ifstream in(path, std::ios::binary);
+                    if(!in) {
+                        throw std::runtime_error("Cannot open PQ codebook: " + path);
+                    }
+                    uint32_t magic = 0;
+                    uint32_t version = 0;
+                    uint64_t dimension = 0;
+                    in.read(reinterpret_cast<char*>(&magic), sizeof(uint32_t));
+                    in.read(reinterpret_cast<char*>(&version), sizeof(uint32_t));
+                    in.read(reinterpret_cast<char*>(&dimension), sizeof(uint64_t));
+                    if(!in || magic != CODEBOOK_MAGIC || version != CODEBOOK_VERSION) {
+                        throw std::runtime_error("Invalid PQ codebook: " + path);
+                    }
+                    std::vector<float> centroids(num_subspaces(dimension) * NUM_CENTROIDS
+                                                 * SUBSPACE_DIM);
+                    in.read(reinterpret_cast<char*>(centroids.data()),
+                            centroids.size() * sizeof(float));
+                    if(!in) {
+                        throw std::runtime_error("Truncated PQ codebook: " + path);
+                    }
+                    return std::make_shared<Codebook>(dimension, std::move(centroids));
+                }
+
+            private:
+                size_t dimension_;
+                size_t num_subspaces_;
+                std::vector<float> centroids_;  // [subspace][centroid][SUBSPACE_DIM]
+                std::vector<float> symmetric_l2_;  // [subspace][centroid][centroid]
+                std::vector<float> symmetric_ip_;
+
+                const float* subCentroids(size_t m) const {
+                    return &centroids_[m * NUM_CENTROIDS * SUBSPACE_DIM];
+                }
+
+                // The last subspace is zero padded when the dimension is not a multiple
+                static void
+                copySubvector(const float* in, size_t dimension, size_t m, float* out) {
+                    for(size_t d = 0; d < SUBSPACE_DIM; d++) {
+                        size_t idx = m * SUBSPACE_DIM + d;
+                        out[d] = idx < dimension ? in[idx] : 0.0f;
+                    }
+                }
+
+                static float l2(const float* a, const float* b) {
+                    float sum = 0.0f;
+                    for(size_t d = 0; d < SUBSPACE_DIM; d++) {
+                        float diff = a[d] - b[d];
+                        sum += diff * diff;
+                    }
+                    return sum;
+                }
+
+                static float dot(const float* a, const float* b) {
+                    float sum = 0.0f;
+                    for(size_t d = 0; d < SUBSPACE_DIM; d++) {
+                        sum += a[d] * b[d];
+                    }
+                    return sum;
+                }
+
+                static uint8_t nearestCentroid(const float* centroids, const float* point) {
+                    uint8_t best = 0;
+                    float best_dist = std::numeric_limits<float>::max();
+                    for(size_t c = 0; c < NUM_CENTROIDS; c++) {
+                        float dist = l2(point, centroids + c * SUBSPACE_DIM);
+                        if(dist < best_dist) {
+                            best_dist = dist;
+                            best = static_cast<uint8_t>(c);
+                        }
+                    }
+                    return best;
+                }
+
+                void buildSymmetricTables() {
+                    symmetric_l2_.resize(num_subspaces_ * NUM_CENTROIDS * NUM_CENTROIDS);
+                    symmetric_ip_.resize(num_subspaces_ * NUM_CENTROIDS * NUM_CENTROIDS);
+                    for(size_t m = 0; m < num_subspaces_; m++) {
+                        for(size_t a = 0; a < NUM_CENTROIDS; a++) {
+                            for(size_t b = 0; b < NUM_CENTROIDS; b++) {
+                                const float* ca = subCentroids(m) + a * SUBSPACE_DIM;
+                                const float* cb = subCentroids(m) + b * SUBSPACE_DIM;
+                                size_t idx = (m * NUM_CENTROIDS + a) * NUM_CENTROIDS + b;
+                                symmetric_l2_[idx] = l2(ca, cb);
+                                symmetric_ip_[idx] = dot(ca, cb);
+                            }
+                        }
+                    }
+                }
+            };
+
+        }  // namespace pq
+    }  // namespace quant
+}  // namespace ndd
@@ -0,0 +1,495 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include "kernels.hpp"
+#include "binary.hpp"
+#include "../hnsw/dist_params.h"
+
+#if defined(USE_AVX512) || defined(USE_AVX2)
+#    include <immintrin.h>
+#endif
+
+#if defined(USE_NEON)
+#    include <arm_neon.h>
+#endif
+
+namespace ndd {
+    namespace quant {
+        namespace rabitq::inline NDD_SIMD_NAMESPACE {
+
+            // RaBitQ-style binary quantization. A vector is stored as the signs of its randomly
+            // rotated unit direction plus two correction factors, its norm and the inner
+            // product of the direction with its quantized form. Queries keep 4 bits per
+            // dimension, so scoring is popcounts over 4 bit planes and the estimate of the
+            // inner product is unbiased with a known error bound.
+
+            // Queries stay in 4 bits per dimension, one bit plane per bit
+            constexpr size_t QUERY_BITS = 4;
+            constexpr float QUERY_LEVELS = 15.0f;
+
+            // Confidence multiplier of the error bound, about three standard deviations
+            constexpr float ERROR_EPSILON = 1.9f;
+
+            // Rounds of sign flips and Hadamard transforms in the rotation
+            constexpr size_t ROTATION_ROUNDS = 4;
+            constexpr uint64_t ROTATION_SEED = 0x9e3779b97f4a7c15ULL;
+
+            // First byte of a buffer, tells stored codes apart from a prepared query
+            constexpr uint8_t FORMAT_CODES = 0;
+            constexpr uint8_t FORMAT_QUERY = 1;
+
+            // Stored: format, padding, float norm, float <quantized, direction>, uint32
+            // popcount, then padded_dim bits. Prepared query: format, padding, float norm,
+            // float low, float step, float sum of the quantized values, padding, then
+            // QUERY_BITS planes of padded_dim bits.
+            constexpr size_t CODES_HEADER_SIZE = 16;
+            constexpr size_t QUERY_HEADER_SIZE = 24;
+
+            // Bits are padded to whole 64-bit words, the rotation works in the padded space
+            inline size_t padded_dim(size_t dimension) { return (dimension + 63) / 64 * 64; }
+
+            inline size_t get_storage_size(size_t dimension) {
+                return CODES_HEADER_SIZE + padded_dim(dimension) / 8;
+            }
+
+            inline size_t get_query_size(size_t dimension) {
+                return QUERY_HEADER_SIZE + QUERY_BITS * padded_dim(dimension) / 8;
+            }
+
+            // No scale for RaBitQ codes
+            inline float extract_scale(const uint8_t*, size_t) { return 1.0f; }
+
+            inline float read_float(const uint8_t* buffer, size_t offset) {
+                float value;
+                std::memcpy(&value, buffer + offset, sizeof(float));
+                return value;
+            }
+
+            inline void write_float(uint8_t* buffer, size_t offset, float value) {
+                std::memcpy(buffer + offset, &value, sizeof(float));
+            }
+
+            inline bool flip_sign(size_t round, size_t i) {
+                // splitmix64 of the round and coordinate
+                uint64_t z = ROTATION_SEED + (round << 32) + i;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                return (z ^ (z >> 31)) & 1;
+            }
+
+            // Orthonormal Walsh-Hadamard transform of n (a power of two) values
+            inline void hadamard(float* x, size_t n) {
+                for(size_t h = 1; h < n; h *= 2) {
+                    for(size_t i = 0; i < n; i += 2 * h) {
+                        for(size_t j = i; j < i + h; j++) {
+                            float a = x[j];
+                            float b = x[j + h];
+                            x[j] = a + b;
+                            x[j + h] = a - b;
+                        }
+                    }
+                }
+                float norm = 1.0f / std::sqrt(static_cast<float>(n));
+                for(size_t i = 0; i < n; i++) {
+                    x[i] *= norm;
+                }
+            }
+
+            // Fixed random rotation of the padded space: every round flips seeded signs and
+            // applies Hadamard transforms over two overlapping power-of-two windows, which
+            // together cover every coordinate. Costs O(d log d), no per-index state.
+            inline void rotate(std::vector<float>& x) {
+                size_t n = x.size();
+                size_t window = 1;
+                while(window * 2 <= n) {
+                    window *= 2;
+                }
+                for(size_t round = 0; round < ROTATION_ROUNDS; round++) {
+                    for(size_t i = 0; i < n; i++) {
+                        if(flip_sign(round, i)) {
+                            x[i] = -x[i];
+                        }
+                    }
+                    hadamard(x.data(), window);
+                    if(window < n) {
+                        hadamard(x.data() + n - window, window);
+                    }
+                }
+            }
+
+            inline void unrotate(std::vector<float>& x) {
+                size_t n = x.size();
+                size_t window = 1;
+                while(window * 2 <= n) {
+                    window *= 2;
+                }
+                for(size_t round = ROTATION_ROUNDS; round-- > 0;) {
+                    if(window < n) {
+                        hadamard(x.data() + n - window, window);
+                    }
+                    hadamard(x.data(), window);
+                    for(size_t i = 0; i < n; i++) {
+                        if(flip_sign(round, i)) {
+                            x[i] = -x[i];
+                        }
+                    }
+                }
+            }
+
+            inline std::vector<float> rotated(const std::vector<float>& input) {
+                std::vector<float> x(padded_dim(input.size()), 0.0f);
+                std::copy(input.begin(), input.end(), x.begin());
+                rotate(x);
+                return x;
+            }
+
+            inline std::vector<uint8_t> quantize(const std::vector<float>& input) {
+                if(input.empty()) {
+                    return std::vector<uint8_t>();
+                }
+
+                std::vector<float> x = rotated(input);
+                size_t padded = x.size();
+                std::vector<uint8_t> buffer(get_storage_size(input.size()), 0);
+
+                float norm = 0.0f;
+                for(float v : x) {
+                    norm += v * v;
+                }
+                norm = std::sqrt(norm);
+
+                uint64_t* bits = reinterpret_cast<uint64_t*>(buffer.data() + CODES_HEADER_SIZE);
+                float abs_sum = 0.0f;
+                uint32_t popcount = 0;
+                for(size_t i = 0; i < padded; i++) {
+                    abs_sum += std::fabs(x[i]);
+                    if(x[i] > 0.0f) {
+                        bits[i / 64] |= 1ULL << (i % 64);
+                        popcount++;
+                    }
+                }
+
+                // <quantized, direction> = sum |o_i| / sqrt(d) for the unit direction o
+                float proj = norm > 0.0f ? abs_sum / (norm * std::sqrt(static_cast<float>(padded)))
+                                         : 1.0f;
+                buffer[0] = FORMAT_CODES;
+                write_float(buffer.data(), 4, norm);
+                write_float(buffer.data(), 8, std::max(proj, 1e-6f));
+                std::memcpy(buffer.data() + 12, &popcount, sizeof(uint32_t));
+                return buffer;
+            }
+
+            // Best guess of the vector: the quantized direction rotated back and scaled
+            inline std::vector<float> dequantize(const uint8_t* buffer, size_t dimension) {
+                size_t padded = padded_dim(dimension);
+                const uint64_t* bits =
+                        reinterpret_cast<const uint64_t*>(buffer + CODES_HEADER_SIZE);
+                float value = read_float(buffer, 4) / std::sqrt(static_cast<float>(padded));
+
+                std::vector<float> x(padded);
+                for(size_t i = 0; i < padded; i++) {
+                    x[i] = (bits[i / 64] >> (i % 64)) & 1 ? value : -value;
+                }
+                unrotate(x);
+                x.resize(dimension);
+                return x;
+            }
+
+            // Rotated query in QUERY_BITS unsigned levels between its minimum and maximum
+            inline std::vector<uint8_t> prepare_query(const std::vector<float>& input,
+                                                      const void*) {
+                std::vector<float> x = rotated(input);
+                size_t padded = x.size();
+                std::vector<uint8_t> buffer(get_query_size(input.size()), 0);
+
+                float norm = 0.0f;
+                for(float v : x) {
+                    norm += v * v;
+                }
+                auto [min_it, max_it] = std::minmax_element(x.begin(), x.end());
+                float low = *min_it;
+                float step = (*max_it - low) / QUERY_LEVELS;
+
+                uint64_t* planes = reinterpret_cast<uint64_t*>(buffer.data() + QUERY_HEADER_SIZE);
+                size_t words = padded / 64;
+                uint64_t level_sum = 0;
+                for(size_t i = 0; i < padded; i++) {
+                    uint32_t level =
+                            step > 0.0f ? static_cast<uint32_t>(std::nearbyint((x[i] - low) / step))
+                                        : 0;
+                    level = std::min(level, static_cast<uint32_t>(QUERY_LEVELS));
+                    level_sum += level;
+                    for(size_t b = 0; b < QUERY_BITS; b++) {
+                        if((level >> b) & 1) {
+                            planes[b * words + i / 64] |= 1ULL << (i % 64);
+                        }
+                    }
+                }
+
+                buffer[0] = FORMAT_QUERY;
+                write_float(buffer.data(), 4, std::sqrt(norm));
+                write_float(buffer.data(), 8, low);
+                write_float(buffer.data(), 12, step);
+                write_float(buffer.data(),
+                            16,
+                            low * static_cast<float>(padded)
+                                    + step * static_cast<float>(level_sum));
+                return buffer;
+            }
+
+            // Sum of the query levels at the set bits of a stored vector: popcounts of the
+            // vector bits against every query bit plane, weighted by the plane bit
+            inline uint64_t plane_dot(const uint64_t* planes, const uint64_t* bits, size_t words) {
+                uint64_t counts[QUERY_BITS] = {};
+                size_t i = 0;
+#if defined(USE_AVX512)
+                __m512i acc0 = _mm512_setzero_si512();
+                __m512i acc1 = _mm512_setzero_si512();
+                __m512i acc2 = _mm512_setzero_si512();
+                __m512i acc3 = _mm512_setzero_si512();
+                for(; i < words; i += 8) {
+                    __mmask8 mask = words - i >= 8 ? 0xFF : (__mmask8)((1 << (words - i)) - 1);
+                    __m512i b = _mm512_maskz_loadu_epi64(mask, &bits[i]);
+                    __m512i p0 = _mm512_maskz_loadu_epi64(mask, &planes[i]);
+                    __m512i p1 = _mm512_maskz_loadu_epi64(mask, &planes[words + i]);
+                    __m512i p2 = _mm512_maskz_loadu_epi64(mask, &planes[2 * words + i]);
+                    __m512i p3 = _mm512_maskz_loadu_epi64(mask, &planes[3 * words + i]);
+                    acc0 = _mm512_add_epi64(acc0, _mm512_popcnt_epi64(_mm512_and_si512(b, p0)));
+                    acc1 = _mm512_add_epi64(acc1, _mm512_popcnt_epi64(_mm512_and_si512(b, p1)));
+                    acc2 = _mm512_add_epi64(acc2, _mm512_popcnt_epi64(_mm512_and_si512(b, p2)));
+                    acc3 = _mm512_add_epi64(acc3, _mm512_popcnt_epi64(_mm512_and_si512(b, p3)));
+                }
+                counts[0] = _mm512_reduce_add_epi64(acc0);
+                counts[1] = _mm512_reduce_add_epi64(acc1);
+                counts[2] = _mm512_reduce_add_epi64(acc2);
+                counts[3] = _mm512_reduce_add_epi64(acc3);
+#elif defined(USE_AVX2)
+                __m256i acc0 = _mm256_setzero_si256();
+                __m256i acc1 = _mm256_setzero_si256();
+                __m256i acc2 = _mm256_setzero_si256();
+                __m256i acc3 = _mm256_setzero_si256();
+                for(; i + 4 <= words; i += 4) {
+                    __m256i b = _mm256_loadu_si256((const __m256i*)&bits[i]);
+                    __m256i p0 = _mm256_loadu_si256((const __m256i*)&planes[i]);
+                    __m256i p1 = _mm256_loadu_si256((const __m256i*)&planes[words + i]);
+                    __m256i p2 = _mm256_loadu_si256((const __m256i*)&planes[2 * words + i]);
+                    __m256i p3 = _mm256_loadu_si256((const __m256i*)&planes[3 * words + i]);
+                    acc0 = _mm256_add_epi64(acc0,
+                                            binary::popcnt_epi64_avx2(_mm256_and_si256(b, p0)));
+                    acc1 = _mm256_add_epi64(acc1,
+                                            binary::popcnt_epi64_avx2(_mm256_and_si256(b, p1)));
+                    acc2 = _mm256_add_epi64(acc2,
+                                            binary::popcnt_epi64_avx2(_mm256_and_si256(b, p2)));
+                    acc3 = _mm256_add_epi64(acc3,
+                                            binary::popcnt_epi64_avx2(_mm256_and_si256(b, p3)));
+                }
+                counts[0] = binary::reduce_add_epi64_avx2(acc0);
+                counts[1] = binary::reduce_add_epi64_avx2(acc1);
+                counts[2] = binary::reduce_add_epi64_avx2(acc2);
+                counts[3] = binary::reduce_add_epi64_avx2(acc3);
+#elif defined(USE_NEON)
+                // At most 16 per 16-bit lane and pass, safe far above MAX_DIMENSION
+                uint16x8_t acc[QUERY_BITS];
+                for(size_t p = 0; p < QUERY_BITS; p++) {
+                    acc[p] = vdupq_n_u16(0);
+                }
+                for(; i + 2 <= words; i += 2) {
+                    uint8x16_t b = vld1q_u8((const uint8_t*)&bits[i]);
+                    for(size_t p = 0; p < QUERY_BITS; p++) {
+                        uint8x16_t plane = vld1q_u8((const uint8_t*)&planes[p * words + i]);
+                        acc[p] = vpadalq_u8(acc[p], vcntq_u8(vandq_u8(b, plane)));
+                    }
+                }
+                for(size_t p = 0; p < QUERY_BITS; p++) {
+                    counts[p] = vaddlvq_u16(acc[p]);
+                }
+#endif
+                for(; i < words; i++) {
+                    for(size_t p = 0; p < QUERY_BITS; p++) {
+                        counts[p] += __builtin_popcountll(bits[i] & planes[p * words + i]);
+                    }
+                }
+                return counts[0] + 2 * counts[1] + 4 * counts[2] + 8 * counts[3];
+            }
+
+            // Estimated inner product of the query with a stored vector
+            inline float estimate_ip(const uint8_t* query, const uint8_t* vec, size_t dimension) {
+                size_t padded = padded_dim(dimension);
+                const uint64_t* bits = reinterpret_cast<const uint64_t*>(vec + CODES_HEADER_SIZE);
+                float norm = read_float(vec, 4);
+                float proj = read_float(vec, 8);
+                float inv_sqrt_d = 1.0f / std::sqrt(static_cast<float>(padded));
+
+                if(query[0] == FORMAT_QUERY) {
+                    const uint64_t* planes =
+                            reinterpret_cast<const uint64_t*>(query + QUERY_HEADER_SIZE);
+                    uint32_t popcount;
+                    std::memcpy(&popcount, vec + 12, sizeof(uint32_t));
+                    uint64_t levels = plane_dot(planes, bits, padded / 64);
+
+                    // <quantized, query> from the query values at set bits and their total
+                    float at_set_bits = read_float(query, 8) * static_cast<float>(popcount)
+                                        + read_float(query, 12) * static_cast<float>(levels);
+                    float ip_quantized = (2.0f * at_set_bits - read_float(query, 16)) * inv_sqrt_d;
+                    return norm * ip_quantized / proj;
+                }
+
+                // Two stored vectors, as during graph construction: both directions are known
+                // through their quantized forms only
+                const uint64_t* query_bits =
+                        reinterpret_cast<const uint64_t*>(query + CODES_HEADER_SIZE);
+                float hamming = binary::Hamming(query_bits, bits, &padded);
+                float ip_quantized = (static_cast<float>(padded) - 2.0f * hamming)
+                                     / static_cast<float>(padded);
+                float cosine = ip_quantized / (read_float(query, 8) * proj);
+                return read_float(query, 4) * norm * std::clamp(cosine, -1.0f, 1.0f);
+            }
+
+            inline float score(const void* query,
+                               const void* vec,
+                               const void* params,
+                               hnswlib::SpaceType space) {
+                const uint8_t* q = static_cast<const uint8_t*>(query);
+                const uint8_t* v = static_cast<const uint8_t*>(vec);
+                size_t dimension = static_cast<const hnswlib::DistParams*>(params)->dim;
+                float ip = estimate_ip(q, v, dimension);
+                if(space != hnswlib::L2_SPACE) {
+                    return ip;
+                }
+                float query_norm = read_float(q, 4);
+                float norm = read_float(v, 4);
+                return -(query_norm * query_norm + norm * norm - 2.0f * ip);
+            }
+
+            static float L2SqrSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return score(pVect1v, pVect2v, qty_ptr, hnswlib::L2_SPACE);
+            }
+
+            static float
+            InnerProductSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return score(pVect1v, pVect2v, qty_ptr, hnswlib::IP_SPACE);
+            }
+
+            static float CosineSim(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                return InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float L2Sqr(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return -L2SqrSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float
+            InnerProduct(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - InnerProductSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static float Cosine(const void* pVect1v, const void* pVect2v, const void* qty_ptr) {
+                return 1.0f - CosineSim(pVect1v, pVect2v, qty_ptr);
+            }
+
+            static void L2SqrSimBatch(const void* query,
+                                      const void* const* vectors,
+                                      size_t count,
+                                      const void* qty_ptr,
+                                      float* out) {
+                for(size_t i = 0; i < count; i++) {
+                    out[i] = L2SqrSim(query, vectors[i], qty_ptr);
+                }
+            }
+
+            static void InnerProductSimBatch(const void* query,
+                                             const void* const* vectors,
+                                             size_t count,
+                                             const void* qty_ptr,
+                                             float* out) {
+                for(size_t i = 0; i < count; i++) {
+                    out[i] = InnerProductSim(query, vectors[i], qty_ptr);
+                }
+            }
+
+            static void CosineSimBatch(const void* query,
+                                       const void* const* vectors,
+                                       size_t count,
+                                       const void* qty_ptr,
+                                       float* out) {
+                // Vectors are normalized, so CosineSim is just InnerProductSim
+                InnerProductSimBatch(query, vectors, count, qty_ptr, out);
+            }
+
+            // Half width of the confidence interval around each estimated similarity. The
+            // estimate of <direction, query> is off by at most
+            // sqrt(1 - proj^2) / proj * ERROR_EPSILON / sqrt(d - 1) per unit of query norm.
+            // Stored vectors scored against each other get no bound.
+            static void SimErrorBatch(const void* query,
+                                      const void* const* vectors,
+                                      size_t count,
+                                      const void* qty_ptr,
+                                      float* out) {
+                const uint8_t* q = static_cast<const uint8_t*>(query);
+                if(q[0] != FORMAT_QUERY) {
+                    std::fill(out, out + count, 0.0f);
+                    return;
+                }
+
+                const auto* params = static_cast<const hnswlib::DistParams*>(qty_ptr);
+                size_t padded = padded_dim(params->dim);
+                float scale = read_float(q, 4) * ERROR_EPSILON
+                              / std::sqrt(static_cast<float>(padded - 1));
+                if(params->space_type == hnswlib::L2_SPACE) {
+                    scale *= 2.0f;  // sim = -(|q|^2 + |v|^2 - 2 <q, v>)
+                }
+                for(size_t i = 0; i < count; i++) {
+                    const uint8_t* v = static_cast<const uint8_t*>(vectors[i]);
+                    float proj = read_float(v, 8);
+                    float spread = std::sqrt(std::max(0.0f, 1.0f - proj * proj));
+                    out[i] = scale * read_float(v, 4) * spread / proj;
+                }
+            }
+
+            static std::vector<uint8_t> quantize_to_int8(const void*, size_t) {
+                throw std::runtime_error("RaBitQ to Int8 direct quantization not implemented");
+            }
+
+        }  // namespace rabitq::inline NDD_SIMD_NAMESPACE
+    }  // namespace quant
+
+    namespace quant::inline NDD_SIMD_NAMESPACE {
+
+        class RaBitQQuantizer : public Quantizer {
+        public:
+            std::string name() const override { return "rabitq"; }
+            QuantizationLevel level() const override { return QuantizationLevel::RABITQ; }
+
+            QuantizerDispatch getDispatch() const override {
+                QuantizerDispatch d;
+                d.dist_l2 = &rabitq::L2Sqr;
+                d.dist_ip = &rabitq::InnerProduct;
+                d.dist_cosine = &rabitq::Cosine;
+                d.sim_l2 = &rabitq::L2SqrSim;
+                d.sim_ip = &rabitq::InnerProductSim;
+                d.sim_cosine = &rabitq::CosineSim;
+                d.sim_l2_batch = &rabitq::L2SqrSimBatch;
+                d.sim_ip_batch = &rabitq::InnerProductSimBatch;
+                d.sim_cosine_batch = &rabitq::CosineSimBatch;
+                d.quantize = &rabitq::quantize;
+                d.dequantize = &rabitq::dequantize;
+                d.quantize_to_int8 = &rabitq::quantize_to_int8;
+                d.get_storage_size = &rabitq::get_storage_size;
+                d.extract_scale = &rabitq::extract_scale;
+                d.prepare_query = &rabitq::prepare_query;
+                d.sim_error_batch = &rabitq::SimErrorBatch;
+                return d;
+            }
+        };
+
+        // Register RABITQ
+        static RegisterQuantizer reg_rabitq(QuantizationLevel::RABITQ,
+                                            "rabitq",
+                                            std::make_shared<RaBitQQuantizer>());
+
+    }  // namespace quant::inline NDD_SIMD_NAMESPACE
+}  // namespace ndd
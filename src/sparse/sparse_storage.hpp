@@ -11,6 +11,7 @@
 #include "bmw.hpp"
 #include "sparse_vector.hpp"
 #include "../utils/log.hpp"
+#include "../utils/settings.hpp"
 
 namespace ndd {
 
@@ -306,6 +307,12 @@ namespace ndd {
                 return false;
             }
 
+            rc = mdbx_env_set_maxreaders(env_, settings::MDBX_MAX_READERS);
+            if(rc != 0) {
+                LOG_ERROR("mdbx_env_set_maxreaders failed: " << rc);
+                return false;
+            }
+
             std::error_code ec;
             std::filesystem::create_directories(db_path_, ec);
             if(ec) {
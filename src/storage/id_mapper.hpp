@@ -14,6 +14,7 @@
 #include <set>
 #include "../core/types.hpp"
 #include "../utils/settings.hpp"
+#include "read_txn_pool.hpp"
 
 using ndd::idInt;
 class IDMapper {
@@ -30,6 +31,12 @@ public:
                                      + mdbx_strerror(rc));
         }
 
+        rc = mdbx_env_set_maxreaders(env_, settings::MDBX_MAX_READERS);
+        if(rc != MDBX_SUCCESS) {
+            throw std::runtime_error(std::string("Failed to set max readers: ")
+                                     + mdbx_strerror(rc));
+        }
+
         // Set geometry for auto-grow
         rc = mdbx_env_set_geometry(
                 env_,
@@ -69,12 +76,15 @@ public:
                                      + mdbx_strerror(rc));
         }
 
+        read_txns_ = std::make_unique<ndd::ReadTxnPool>(env_);
+
         if(is_new) {
             init_next_id();
         }
     }
 
     ~IDMapper() {
+        read_txns_.reset();
         mdbx_dbi_close(env_, dbi_);
         mdbx_env_close(env_);
     }
@@ -109,54 +119,42 @@ public:
         //Read-only LMDB check
         LOG_DEBUG("--- STEP 2: LMDB database check ---");
         {
-            MDBX_txn* txn;
-            int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-            if(rc != MDBX_SUCCESS) {
-                LOG_DEBUG("ERROR: Failed to begin read-only transaction: " << mdbx_strerror(rc));
-                throw std::runtime_error("Failed to begin read-only transaction: "
-                                         + std::string(mdbx_strerror(rc)));
-            }
+            auto read_txn = read_txns_->acquire();
+            MDBX_txn* txn = read_txn.txn();
             LOG_DEBUG("LMDB read-only transaction started successfully");
 
-            try {
-                int keys_checked = 0;
-                for(auto& tup : id_tuples) {
-                    if(std::get<1>(tup) == INVALID_LABEL) {
-                        const std::string& str_id = std::get<0>(tup);
-                        MDBX_val key{(void*)str_id.c_str(), str_id.size()};
-                        MDBX_val data;
-
-                        // Add debug logging
-                        LOG_DEBUG("LMDB: Checking key[" << keys_checked << "]: [" << str_id
-                                                        << "] size: " << str_id.size());
-                        keys_checked++;
-
-                        rc = mdbx_get(txn, dbi_, &key, &data);
-                        if(rc == MDBX_SUCCESS) {
-                            idInt existing_id = *(idInt*)data.iov_base;
-                            LOG_DEBUG("LMDB: ✓ FOUND existing ID: " << existing_id << " for key: ["
-                                                                    << str_id << "]");
-                            std::get<1>(tup) = existing_id;
-                            std::get<2>(tup) = false;  // ID already exists
-                        } else if(rc == MDBX_NOTFOUND) {
-                            LOG_DEBUG("LMDB: ✗ NOT FOUND: [" << str_id << "]");
-                            std::get<1>(tup) = 0;
-                        } else {
-                            LOG_DEBUG("LMDB: ERROR for key: [" << str_id
-                                                               << "] error: " << mdbx_strerror(rc));
-                            mdbx_txn_abort(txn);
-                            throw std::runtime_error("Database error checking ID: "
-                                                     + std::string(mdbx_strerror(rc)));
-                        }
+            int keys_checked = 0;
+            for(auto& tup : id_tuples) {
+                if(std::get<1>(tup) == INVALID_LABEL) {
+                    const std::string& str_id = std::get<0>(tup);
+                    MDBX_val key{(void*)str_id.c_str(), str_id.size()};
+                    MDBX_val data;
+
+                    // Add debug logging
+                    LOG_DEBUG("LMDB: Checking key[" << keys_checked << "]: [" << str_id
+                                                    << "] size: " << str_id.size());
+                    keys_checked++;
+
+                    int rc = mdbx_get(txn, dbi_, &key, &data);
+                    if(rc == MDBX_SUCCESS) {
+                        idInt existing_id = *(idInt*)data.iov_base;
+                        LOG_DEBUG("LMDB: ✓ FOUND existing ID: " << existing_id << " for key: ["
+                                                                << str_id << "]");
+                        std::get<1>(tup) = existing_id;
+                        std::get<2>(tup) = false;  // ID already exists
+                    } else if(rc == MDBX_NOTFOUND) {
+                        LOG_DEBUG("LMDB: ✗ NOT FOUND: [" << str_id << "]");
+                        std::get<1>(tup) = 0;
+                    } else {
+                        LOG_DEBUG("LMDB: ERROR for key: [" << str_id
+                                                           << "] error: " << mdbx_strerror(rc));
+                        throw std::runtime_error("Database error checking ID: "
+                                                 + std::string(mdbx_strerror(rc)));
                     }
                 }
-                LOG_DEBUG("LMDB: Checked " << keys_checked << " keys in database");
-                mdbx_txn_abort(txn);
-                LOG_DEBUG("LMDB check done");
-            } catch(...) {
-                mdbx_txn_abort(txn);
-                throw;
             }
+            LOG_DEBUG("LMDB: Checked " << keys_checked << " keys in database");
+            LOG_DEBUG("LMDB check done");
         }
 
         //Count and generate new IDs
@@ -332,22 +330,15 @@ public:
 
     // Get the number of key-value pairs in the database
     size_t get_count() const {
-        MDBX_txn* txn;
+        auto read_txn = read_txns_->acquire();
         MDBX_stat stat;
-        int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != MDBX_SUCCESS) {
-            throw std::runtime_error(std::string("Failed to begin transaction: ")
-                                     + mdbx_strerror(rc));
-        }
 
-        rc = mdbx_dbi_stat(txn, dbi_, &stat, sizeof(stat));
+        int rc = mdbx_dbi_stat(read_txn.txn(), dbi_, &stat, sizeof(stat));
         if(rc != MDBX_SUCCESS) {
-            mdbx_txn_abort(txn);
             throw std::runtime_error(std::string("Failed to get database statistics: ")
                                      + mdbx_strerror(rc));
         }
 
-        mdbx_txn_abort(txn);
         return stat.ms_entries - 1;  // Subtract 1 for NEXT_ID_KEY
     }
 
@@ -355,13 +346,8 @@ public:
     idInt get_id(const std::string& str_id) const {
         LOG_DEBUG("=== get_id START for: [" << str_id << "] size: " << str_id.size() << " ===");
 
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != MDBX_SUCCESS) {
-            LOG_DEBUG("get_id: ERROR - Failed to begin transaction: " << mdbx_strerror(rc));
-            throw std::runtime_error(std::string("Failed to begin transaction: ")
-                                     + mdbx_strerror(rc));
-        }
+        auto read_txn = read_txns_->acquire();
+        MDBX_txn* txn = read_txn.txn();
         LOG_DEBUG("get_id: LMDB read transaction started");
 
         MDBX_val key, data;
@@ -370,11 +356,10 @@ public:
 
         LOG_DEBUG("get_id: LMDB lookup for key: [" << str_id << "] size: " << str_id.size());
 
-        rc = mdbx_get(txn, dbi_, &key, &data);
+        int rc = mdbx_get(txn, dbi_, &key, &data);
         if(rc == MDBX_SUCCESS) {
             idInt id = *(idInt*)data.iov_base;
             LOG_DEBUG("get_id: ✓ FOUND ID: " << id << " for key: [" << str_id << "]");
-            mdbx_txn_abort(txn);
             LOG_DEBUG("=== get_id END - FOUND ===");
             return id;
         } else if(rc == MDBX_NOTFOUND) {
@@ -383,7 +368,6 @@ public:
             LOG_DEBUG("get_id: ERROR: [" << str_id << "] error: " << mdbx_strerror(rc));
         }
 
-        mdbx_txn_abort(txn);
         LOG_DEBUG("=== get_id END - NOT FOUND ===");
         return 0;  // Not found
     }
@@ -492,6 +476,7 @@ public:
 private:
     MDBX_env* env_;
     MDBX_dbi dbi_;
+    std::unique_ptr<ndd::ReadTxnPool> read_txns_;
     std::string path_;
     UserType user_type_;
     mutable std::mutex mutex_;  // Only used for next_id management
@@ -11,6 +11,7 @@
 #include "settings.hpp"
 #include "mdbx/mdbx.h"
 #include "quant/common.hpp"
+#include "read_txn_pool.hpp"
 
 struct IndexMetadata {
     std::string name;  // Just the index name, not the full path
@@ -19,6 +20,9 @@ struct IndexMetadata {
     std::string space_type_str;
     ndd::quant::QuantizationLevel quant_level =
             ndd::quant::QuantizationLevel::INT8;  // Quantization level (8, 15, 16, 32)
+    ndd::quant::QuantizationLevel rerank_quant_level =
+            ndd::quant::QuantizationLevel::UNKNOWN;  // Precision of the rerank copy, if any
+    size_t prefix_dim = 0;  // Leading dimensions the graph is built on, 0 for all of them
     int32_t checksum;
     size_t total_elements;
     size_t M;
@@ -31,6 +35,8 @@ struct IndexMetadata {
                 {"sparse_dim", sparse_dim},
                 {"space_type_str", space_type_str},
                 {"quant_level", static_cast<uint8_t>(quant_level)},
+                {"rerank_quant_level", static_cast<uint8_t>(rerank_quant_level)},
+                {"prefix_dim", prefix_dim},
                 {"checksum", checksum},
                 {"total_elements", total_elements},
                 {"M", M},
@@ -50,6 +56,9 @@ struct IndexMetadata {
         meta.space_type_str = j["space_type_str"].get<std::string>();
         meta.quant_level =
                 static_cast<ndd::quant::QuantizationLevel>(j["quant_level"].get<uint8_t>());
+        meta.rerank_quant_level = static_cast<ndd::quant::QuantizationLevel>(
+                j.value("rerank_quant_level", static_cast<uint8_t>(0)));
+        meta.prefix_dim = j.value("prefix_dim", static_cast<size_t>(0));
         meta.checksum = j["checksum"].get<int32_t>();
         meta.total_elements = j["total_elements"].get<size_t>();
         meta.M = j["M"].get<size_t>();
@@ -64,15 +73,18 @@ private:
     MDBX_env* metadata_env_;
     MDBX_dbi metadata_dbi_;
     std::string metadata_dir_;
+    std::unique_ptr<ndd::ReadTxnPool> read_txns_;
 
 public:
     MetadataManager(const std::string& base_dir) :
         metadata_dir_(base_dir + "/meta") {
         std::filesystem::create_directories(metadata_dir_);
         initEnvironment();
+        read_txns_ = std::make_unique<ndd::ReadTxnPool>(metadata_env_);
     }
 
     ~MetadataManager() {
+        read_txns_.reset();
         mdbx_dbi_close(metadata_env_, metadata_dbi_);
         mdbx_env_close(metadata_env_);
     }
@@ -129,20 +141,13 @@ public:
     std::optional<IndexMetadata> getMetadata(const std::string& index_id) {
         std::string key = index_id;
 
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(metadata_env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != 0) {
-            std::cerr << "Failed to begin transaction: " << mdbx_strerror(rc) << std::endl;
-            return std::nullopt;
-        }
-
         try {
+            auto read_txn = read_txns_->acquire();
             MDBX_val db_key{(void*)key.c_str(), key.size()};
             MDBX_val data;
 
-            rc = mdbx_get(txn, metadata_dbi_, &db_key, &data);
+            int rc = mdbx_get(read_txn.txn(), metadata_dbi_, &db_key, &data);
             if(rc != 0) {
-                mdbx_txn_abort(txn);
                 if(rc != MDBX_NOTFOUND) {
                     std::cerr << "Failed to retrieve metadata: " << mdbx_strerror(rc) << std::endl;
                 }
@@ -150,11 +155,8 @@ public:
             }
 
             std::string json_str(static_cast<char*>(data.iov_base), data.iov_len);
-            mdbx_txn_abort(txn);
-
             return IndexMetadata::from_json(nlohmann::json::parse(json_str));
         } catch(const std::exception& e) {
-            mdbx_txn_abort(txn);
             std::cerr << "Exception while retrieving metadata: " << e.what() << std::endl;
             return std::nullopt;
         }
@@ -198,17 +200,17 @@ public:
     std::vector<std::pair<std::string, IndexMetadata>> listAllMetadata() {
         std::vector<std::pair<std::string, IndexMetadata>> result;
 
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(metadata_env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != 0) {
-            std::cerr << "Failed to begin transaction: " << mdbx_strerror(rc) << std::endl;
+        std::optional<ndd::ReadTxnPool::Handle> read_txn;
+        try {
+            read_txn.emplace(read_txns_->acquire());
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << std::endl;
             return result;
         }
 
         MDBX_cursor* cursor;
-        rc = mdbx_cursor_open(txn, metadata_dbi_, &cursor);
+        int rc = mdbx_cursor_open(read_txn->txn(), metadata_dbi_, &cursor);
         if(rc != 0) {
-            mdbx_txn_abort(txn);
             std::cerr << "Failed to open cursor: " << mdbx_strerror(rc) << std::endl;
             return result;
         }
@@ -227,7 +229,6 @@ public:
         }
 
         mdbx_cursor_close(cursor);
-        mdbx_txn_abort(txn);
         return result;
     }
 
@@ -237,17 +238,17 @@ public:
         std::vector<std::pair<std::string, IndexMetadata>> indexes;
         std::string prefix = username + "/";
 
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(metadata_env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != 0) {
-            std::cerr << "Failed to begin transaction: " << mdbx_strerror(rc) << std::endl;
+        std::optional<ndd::ReadTxnPool::Handle> read_txn;
+        try {
+            read_txn.emplace(read_txns_->acquire());
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << std::endl;
             return indexes;
         }
 
         MDBX_cursor* cursor;
-        rc = mdbx_cursor_open(txn, metadata_dbi_, &cursor);
+        int rc = mdbx_cursor_open(read_txn->txn(), metadata_dbi_, &cursor);
         if(rc != 0) {
-            mdbx_txn_abort(txn);
             std::cerr << "Failed to open cursor: " << mdbx_strerror(rc) << std::endl;
             return indexes;
         }
@@ -278,24 +279,23 @@ public:
         }
 
         mdbx_cursor_close(cursor);
-        mdbx_txn_abort(txn);
         return indexes;
     }
 
     std::vector<std::pair<std::string, IndexMetadata>> listAllIndexes() {
         std::vector<std::pair<std::string, IndexMetadata>> result;
 
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(metadata_env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != 0) {
-            std::cerr << "Failed to begin transaction: " << mdbx_strerror(rc) << std::endl;
+        std::optional<ndd::ReadTxnPool::Handle> read_txn;
+        try {
+            read_txn.emplace(read_txns_->acquire());
+        } catch(const std::exception& e) {
+            std::cerr << e.what() << std::endl;
             return result;
         }
 
         MDBX_cursor* cursor;
-        rc = mdbx_cursor_open(txn, metadata_dbi_, &cursor);
+        int rc = mdbx_cursor_open(read_txn->txn(), metadata_dbi_, &cursor);
         if(rc != 0) {
-            mdbx_txn_abort(txn);
             std::cerr << "Failed to open cursor: " << mdbx_strerror(rc) << std::endl;
             return result;
         }
@@ -314,7 +314,6 @@ public:
         }
 
         mdbx_cursor_close(cursor);
-        mdbx_txn_abort(txn);
         return result;
     }
 
@@ -326,6 +325,12 @@ private:
                                      + mdbx_strerror(rc));
         }
 
+        rc = mdbx_env_set_maxreaders(metadata_env_, settings::MDBX_MAX_READERS);
+        if(rc != MDBX_SUCCESS) {
+            throw std::runtime_error(std::string("Failed to set max readers: ")
+                                     + mdbx_strerror(rc));
+        }
+
         // Set geometry for auto-grow
         rc = mdbx_env_set_geometry(
                 metadata_env_,
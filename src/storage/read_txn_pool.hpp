@@ -0,0 +1,187 @@
+#pragma once
+
+#include "mdbx/mdbx.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ndd {
+
+    // Renewable read-only transactions for one MDBX environment.
+    //
+    // Every thread keeps one parked transaction per pool. acquire() renews it with
+    // mdbx_txn_renew and releasing the last handle parks it again with mdbx_txn_reset,
+    // so lookups do not pay for mdbx_txn_begin/abort and reader slots are not churned.
+    //
+    // Handles acquired while the thread already holds one share the same transaction.
+    // Holding a handle for the duration of a query therefore pins one consistent
+    // snapshot for every lookup made through the same pool.
+    //
+    // All users of an environment must share one pool: MDBX allows a single read
+    // transaction per thread and environment. Handles must not be held across a write
+    // transaction on the same environment and thread.
+    //
+    // Parked transactions are aborted when their thread exits (MDBX releases the thread's
+    // reader slot right after) or when the pool is destroyed, whichever comes first.
+    class ReadTxnPool {
+    private:
+        struct Slot {
+            // Guards txn against the pool and the owning thread tearing it down together
+            std::mutex mutex;
+            MDBX_txn* txn{nullptr};
+            size_t depth{0};
+            bool closed{false};
+
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(txn) {
+                    mdbx_txn_abort(txn);
+                    txn = nullptr;
+                }
+                closed = true;
+            }
+        };
+
+        struct ThreadSlots {
+            std::unordered_map<uint64_t, std::shared_ptr<Slot>> slots;
+
+            ~ThreadSlots() {
+                current_thread_slots() = nullptr;
+                for(auto& [pool_id, slot] : slots) {
+                    slot->close();
+                }
+            }
+        };
+
+    public:
+        class Handle {
+        public:
+            Handle(Handle&& other) noexcept :
+                slot_(other.slot_) {
+                other.slot_ = nullptr;
+            }
+
+            // prevent copying
+            Handle(const Handle&) = delete;
+            Handle& operator=(const Handle&) = delete;
+            Handle& operator=(Handle&&) = delete;
+
+            ~Handle() {
+                if(slot_ && --slot_->depth == 0) {
+                    mdbx_txn_reset(slot_->txn);
+                }
+            }
+
+            MDBX_txn* txn() const { return slot_->txn; }
+
+        private:
+            friend class ReadTxnPool;
+            explicit Handle(Slot* slot) :
+                slot_(slot) {}
+
+            Slot* slot_;
+        };
+
+        explicit ReadTxnPool(MDBX_env* env) :
+            env_(env),
+            id_(next_pool_id().fetch_add(1)) {}
+
+        // prevent copying
+        ReadTxnPool(const ReadTxnPool&) = delete;
+        ReadTxnPool& operator=(const ReadTxnPool&) = delete;
+
+        // Must run before the environment is closed. Parked transactions have no owner
+        // thread, so they can be aborted from here.
+        ~ReadTxnPool() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(auto& slot : slots_) {
+                slot->close();
+            }
+        }
+
+        Handle acquire() {
+            Slot* slot = find_thread_slot();
+            if(!slot) {
+                return Handle(create_thread_slot());
+            }
+            if(slot->depth == 0) {
+                int rc = slot->txn ? mdbx_txn_renew(slot->txn)
+                                   : mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &slot->txn);
+                if(rc != MDBX_SUCCESS) {
+                    if(slot->txn) {
+                        mdbx_txn_abort(slot->txn);
+                        slot->txn = nullptr;
+                    }
+                    throw std::runtime_error("Failed to begin read transaction: "
+                                             + std::string(mdbx_strerror(rc)));
+                }
+            }
+            slot->depth++;
+            return Handle(slot);
+        }
+
+    private:
+        MDBX_env* env_;
+        // Unique for the process lifetime so that stale thread-local entries of a
+        // destroyed pool are never matched by a new one
+        uint64_t id_;
+        std::mutex mutex_;
+        std::vector<std::shared_ptr<Slot>> slots_;
+
+        static std::atomic<uint64_t>& next_pool_id() {
+            static std::atomic<uint64_t> next_id{0};
+            return next_id;
+        }
+
+        // Not owning, so reading it does not register a thread exit hook
+        static ThreadSlots*& current_thread_slots() {
+            thread_local ThreadSlots* thread_slots = nullptr;
+            return thread_slots;
+        }
+
+        Slot* find_thread_slot() {
+            ThreadSlots* thread_slots = current_thread_slots();
+            if(!thread_slots) {
+                return nullptr;
+            }
+            auto it = thread_slots->slots.find(id_);
+            return it != thread_slots->slots.end() ? it->second.get() : nullptr;
+        }
+
+        // Begins the transaction before the owning thread_local is first touched. MDBX
+        // registers its own thread exit hook on the first read transaction of a thread and
+        // these hooks run in reverse order, so ours aborts the parked transactions while
+        // the thread still holds its reader slot.
+        Slot* create_thread_slot() {
+            auto slot = std::make_shared<Slot>();
+            int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &slot->txn);
+            if(rc != MDBX_SUCCESS) {
+                throw std::runtime_error("Failed to begin read transaction: "
+                                         + std::string(mdbx_strerror(rc)));
+            }
+            slot->depth = 1;
+
+            thread_local ThreadSlots thread_slots;
+            current_thread_slots() = &thread_slots;
+
+            // Drop slots of pools that no longer exist
+            std::erase_if(thread_slots.slots, [](const auto& entry) {
+                std::lock_guard<std::mutex> lock(entry.second->mutex);
+                return entry.second->closed;
+            });
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                slots_.push_back(slot);
+            }
+            thread_slots.slots.emplace(id_, slot);
+            return slot.get();
+        }
+    };
+
+}  // namespace ndd
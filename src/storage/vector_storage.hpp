@@ -8,11 +8,13 @@
 #include "json/nlohmann_json.hpp"
 #include "msgpack_ndd.hpp"
 #include "quant_vector.hpp"
+#include "read_txn_pool.hpp"
 #include <string>
 #include <vector>
 #include <memory>
 #include <stdexcept>
 #include <filesystem>
+#include <utility>
 
 // Handles vector storage
 class VectorStore {
@@ -23,6 +25,7 @@ private:
     size_t vector_dim_;
     ndd::quant::QuantizationLevel quant_level_;
     size_t bytes_per_vector_;
+    std::unique_ptr<ndd::ReadTxnPool> read_txns_;
 
     void init_environment() {
         int rc = mdbx_env_create(&env_);
@@ -30,6 +33,11 @@ private:
             throw std::runtime_error("Failed to create LMDB env");
         }
 
+        rc = mdbx_env_set_maxreaders(env_, settings::MDBX_MAX_READERS);
+        if(rc != MDBX_SUCCESS) {
+            throw std::runtime_error("Failed to set max readers");
+        }
+
         // Set geometry for auto-grow: initial=8GB, growth=1GB, max=128GB
         rc = mdbx_env_set_geometry(env_,
                                    -1,  // lower size bound (use default)
@@ -67,6 +75,76 @@ private:
         }
     }
 
+    // INT8 vectors written before index version 2 have no squared norm after the scale.
+    // Appends it to each of them in one transaction, so a store is never half converted
+    void migrate_int8_norms() {
+        if(quant_level_ != ndd::quant::QuantizationLevel::INT8) {
+            return;
+        }
+        size_t legacy_bytes = bytes_per_vector_ - sizeof(float);
+
+        MDBX_txn* txn;
+        int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_READWRITE, &txn);
+        if(rc != MDBX_SUCCESS) {
+            throw std::runtime_error("Failed to begin transaction");
+        }
+        MDBX_cursor* cursor = nullptr;
+        try {
+            rc = mdbx_cursor_open(txn, dbi_, &cursor);
+            if(rc != MDBX_SUCCESS) {
+                throw std::runtime_error("LMDB cursor open failed");
+            }
+            MDBX_val key, data;
+            rc = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST);
+            if(rc != MDBX_SUCCESS || data.iov_len != legacy_bytes) {
+                mdbx_cursor_close(cursor);
+                mdbx_txn_abort(txn);
+                return;
+            }
+
+            // Values change size, so the ids are collected before any of them is rewritten
+            std::vector<ndd::idInt> ids;
+            for(; rc == MDBX_SUCCESS; rc = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
+                if(data.iov_len == legacy_bytes) {
+                    ids.push_back(*static_cast<const ndd::idInt*>(key.iov_base));
+                }
+            }
+            mdbx_cursor_close(cursor);
+            cursor = nullptr;
+
+            std::vector<uint8_t> buffer(bytes_per_vector_);
+            for(ndd::idInt id : ids) {
+                MDBX_val id_key{&id, sizeof(ndd::idInt)};
+                rc = mdbx_get(txn, dbi_, &id_key, &data);
+                if(rc != MDBX_SUCCESS) {
+                    throw std::runtime_error("Failed to read vector: "
+                                             + std::string(mdbx_strerror(rc)));
+                }
+                std::memcpy(buffer.data(), data.iov_base, legacy_bytes);
+                ndd::quant::int8d::store_squared_norm(buffer.data(), vector_dim_);
+                MDBX_val value{buffer.data(), buffer.size()};
+                rc = mdbx_put(txn, dbi_, &id_key, &value, MDBX_UPSERT);
+                if(rc != MDBX_SUCCESS) {
+                    throw std::runtime_error("Failed to convert vector: "
+                                             + std::string(mdbx_strerror(rc)));
+                }
+            }
+
+            rc = mdbx_txn_commit(txn);
+            if(rc != MDBX_SUCCESS) {
+                throw std::runtime_error("Failed to commit transaction: "
+                                         + std::string(mdbx_strerror(rc)));
+            }
+            LOG_INFO("Added squared norms to " << ids.size() << " INT8 vectors in " << path_);
+        } catch(...) {
+            if(cursor) {
+                mdbx_cursor_close(cursor);
+            }
+            mdbx_txn_abort(txn);
+            throw;
+        }
+    }
+
 public:
     VectorStore(const std::string& path,
                 size_t vector_dim,
@@ -78,24 +156,26 @@ public:
                 ndd::quant::get_quantizer_dispatch(quant_level_).get_storage_size(vector_dim);
         std::filesystem::create_directories(path);
         init_environment();
+        migrate_int8_norms();
+        read_txns_ = std::make_unique<ndd::ReadTxnPool>(env_);
     }
 
     ~VectorStore() {
+        read_txns_.reset();
         mdbx_dbi_close(env_, dbi_);
         mdbx_env_close(env_);
     }
     // Nested Cursor struct
 
     struct Cursor {
+        ndd::ReadTxnPool::Handle read_txn;
         MDBX_txn* txn = nullptr;
         MDBX_cursor* cursor = nullptr;
         bool done = false;
 
-        Cursor(MDBX_env* env, MDBX_dbi dbi) {
-            if(mdbx_txn_begin(env, nullptr, MDBX_TXN_RDONLY, &txn) != MDBX_SUCCESS) {
-                throw std::runtime_error("LMDB txn begin failed");
-            }
-
+        Cursor(ndd::ReadTxnPool& pool, MDBX_dbi dbi) :
+            read_txn(pool.acquire()),
+            txn(read_txn.txn()) {
             if(mdbx_cursor_open(txn, dbi, &cursor) != MDBX_SUCCESS) {
                 throw std::runtime_error("LMDB cursor open failed");
             }
@@ -131,65 +211,81 @@ public:
             if(cursor) {
                 mdbx_cursor_close(cursor);
             }
-            if(txn) {
-                mdbx_txn_abort(txn);
+        }
+    };
+
+    Cursor getCursor() { return Cursor(*read_txns_, dbi_); }
+
+    // Pinned read-only view over the vector table. Pointers returned by get() point
+    // directly into the memory map and stay valid until the view is destroyed.
+    class ReadView {
+    public:
+        ReadView(ndd::ReadTxnPool& pool, MDBX_dbi dbi, size_t bytes_per_vector) :
+            read_txn_(pool.acquire()),
+            dbi_(dbi),
+            bytes_per_vector_(bytes_per_vector) {}
+
+        ReadView(ReadView&& other) noexcept = default;
+
+        // prevent copying
+        ReadView(const ReadView&) = delete;
+        ReadView& operator=(const ReadView&) = delete;
+        ReadView& operator=(ReadView&&) = delete;
+
+        // Returns nullptr if the vector is missing or has an unexpected size
+        const uint8_t* get(ndd::idInt numeric_id) const {
+            MDBX_val key{&numeric_id, sizeof(ndd::idInt)};
+            MDBX_val data;
+            if(mdbx_get(read_txn_.txn(), dbi_, &key, &data) != MDBX_SUCCESS
+               || data.iov_len != bytes_per_vector_) {
+                return nullptr;
             }
+            return static_cast<const uint8_t*>(data.iov_base);
         }
+
+    private:
+        ndd::ReadTxnPool::Handle read_txn_;
+        MDBX_dbi dbi_;
+        size_t bytes_per_vector_;
     };
 
-    Cursor getCursor() { return Cursor(env_, dbi_); }
+    ReadView get_read_view() const { return ReadView(*read_txns_, dbi_, bytes_per_vector_); }
+
+    // Pins the current snapshot for this thread until the handle is released
+    ndd::ReadTxnPool::Handle pin_snapshot() const { return read_txns_->acquire(); }
 
     void store_vector_bytes(ndd::idInt id, const std::vector<uint8_t>& vec) {
         store_vectors_batch({{id, vec}});
     }
 
     std::vector<uint8_t> get_vector_bytes(ndd::idInt numeric_id) const {
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != MDBX_SUCCESS) {
-            throw std::runtime_error("Failed to begin transaction");
-        }
-
-        try {
-            MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
-            MDBX_val data;
-
-            rc = mdbx_get(txn, dbi_, &key, &data);
-            if(rc == MDBX_NOTFOUND) {
-                mdbx_txn_abort(txn);
-                return std::vector<uint8_t>();
-            }
+        auto read_txn = read_txns_->acquire();
 
-            std::vector<uint8_t> result(static_cast<uint8_t*>(data.iov_base),
-                                        static_cast<uint8_t*>(data.iov_base) + data.iov_len);
+        MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
+        MDBX_val data;
 
-            mdbx_txn_abort(txn);
-            return result;
-        } catch(...) {
-            mdbx_txn_abort(txn);
-            throw;
+        int rc = mdbx_get(read_txn.txn(), dbi_, &key, &data);
+        if(rc == MDBX_NOTFOUND) {
+            return std::vector<uint8_t>();
         }
+
+        return std::vector<uint8_t>(static_cast<uint8_t*>(data.iov_base),
+                                    static_cast<uint8_t*>(data.iov_base) + data.iov_len);
     }
 
     bool get_vector_bytes(ndd::idInt numeric_id, uint8_t* buffer) const {
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != MDBX_SUCCESS) {
-            return false;
-        }
-
         try {
+            auto read_txn = read_txns_->acquire();
+
             MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
             MDBX_val data;
 
-            rc = mdbx_get(txn, dbi_, &key, &data);
+            int rc = mdbx_get(read_txn.txn(), dbi_, &key, &data);
             if(rc == MDBX_NOTFOUND) {
-                mdbx_txn_abort(txn);
                 return false;
             }
 
             if(data.iov_len != bytes_per_vector_) {
-                mdbx_txn_abort(txn);
                 // Warning: data size mismatch.
                 // We could log this but for now just fail or copy what is there if smaller?
                 // Safer to fail or copy min to avoid overflow if buffer is assumed to be
@@ -198,11 +294,8 @@ public:
             }
 
             std::memcpy(buffer, data.iov_base, data.iov_len);
-
-            mdbx_txn_abort(txn);
             return true;
         } catch(...) {
-            mdbx_txn_abort(txn);
             return false;
         }
     }
@@ -261,34 +354,28 @@ public:
 
         result.reserve(numeric_ids.size());
 
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != MDBX_SUCCESS) {
-            throw std::runtime_error("Failed to begin transaction");
-        }
-
-        try {
-            for(const auto& numeric_id : numeric_ids) {
-                MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
-                MDBX_val data;
+        auto read_txn = read_txns_->acquire();
+        for(const auto& numeric_id : numeric_ids) {
+            MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
+            MDBX_val data;
 
-                rc = mdbx_get(txn, dbi_, &key, &data);
-                if(rc == MDBX_SUCCESS) {  // Found the vector
-                    std::vector<uint8_t> bytes(static_cast<uint8_t*>(data.iov_base),
-                                               static_cast<uint8_t*>(data.iov_base) + data.iov_len);
-                    result.emplace_back(numeric_id, std::move(bytes));
-                }
+            int rc = mdbx_get(read_txn.txn(), dbi_, &key, &data);
+            if(rc == MDBX_SUCCESS) {  // Found the vector
+                std::vector<uint8_t> bytes(static_cast<uint8_t*>(data.iov_base),
+                                           static_cast<uint8_t*>(data.iov_base) + data.iov_len);
+                result.emplace_back(numeric_id, std::move(bytes));
             }
-
-            mdbx_txn_abort(txn);
-            return result;
-        } catch(...) {
-            mdbx_txn_abort(txn);
-            throw;
         }
+        return result;
     }
 
-    void remove(ndd::idInt numeric_id) {
+    void remove(ndd::idInt numeric_id) { remove_batch({numeric_id}); }
+
+    void remove_batch(const std::vector<ndd::idInt>& numeric_ids) {
+        if(numeric_ids.empty()) {
+            return;
+        }
+
         MDBX_txn* txn;
         int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_READWRITE, &txn);
         if(rc != MDBX_SUCCESS) {
@@ -296,11 +383,13 @@ public:
         }
 
         try {
-            MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
+            for(const auto& numeric_id : numeric_ids) {
+                MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
 
-            rc = mdbx_del(txn, dbi_, &key, nullptr);
-            if(rc != MDBX_SUCCESS && rc != MDBX_NOTFOUND) {
-                throw std::runtime_error("Failed to delete vector data");
+                rc = mdbx_del(txn, dbi_, &key, nullptr);
+                if(rc != MDBX_SUCCESS && rc != MDBX_NOTFOUND) {
+                    throw std::runtime_error("Failed to delete vector data");
+                }
             }
 
             rc = mdbx_txn_commit(txn);
@@ -328,6 +417,7 @@ private:
     MDBX_env* env_;
     MDBX_dbi dbi_;
     std::string path_;
+    std::unique_ptr<ndd::ReadTxnPool> read_txns_;
 
     void init_environment() {
         int rc = mdbx_env_create(&env_);
@@ -335,6 +425,11 @@ private:
             throw std::runtime_error("Failed to create LMDB env");
         }
 
+        rc = mdbx_env_set_maxreaders(env_, settings::MDBX_MAX_READERS);
+        if(rc != MDBX_SUCCESS) {
+            throw std::runtime_error("Failed to set max readers");
+        }
+
         // Set geometry for auto-grow
         rc = mdbx_env_set_geometry(
                 env_,
@@ -380,9 +475,11 @@ public:
         path_(path) {
         std::filesystem::create_directories(path);
         init_environment();
+        read_txns_ = std::make_unique<ndd::ReadTxnPool>(env_);
     }
 
     ~MetaStore() {
+        read_txns_.reset();
         mdbx_dbi_close(env_, dbi_);
         mdbx_env_close(env_);
     }
@@ -433,31 +530,22 @@ public:
 
     void store_meta(ndd::idInt id, const ndd::VectorMeta& meta) { store_meta_batch({{id, meta}}); }
     ndd::VectorMeta get_meta(ndd::idInt numeric_id) const {
-        MDBX_txn* txn;
-        int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_RDONLY, &txn);
-        if(rc != MDBX_SUCCESS) {
-            throw std::runtime_error("Failed to begin transaction");
-        }
+        auto read_txn = read_txns_->acquire();
 
-        try {
-            MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
-            MDBX_val data;
+        MDBX_val key{const_cast<ndd::idInt*>(&numeric_id), sizeof(ndd::idInt)};
+        MDBX_val data;
 
-            rc = mdbx_get(txn, dbi_, &key, &data);
-            if(rc == MDBX_NOTFOUND) {
-                mdbx_txn_abort(txn);
-                throw std::runtime_error("Meta not found");
-            }
-            auto oh = msgpack::unpack(reinterpret_cast<const char*>(data.iov_base), data.iov_len);
-            auto meta = oh.get().as<ndd::VectorMeta>();
-            mdbx_txn_abort(txn);
-            return meta;
-        } catch(...) {
-            mdbx_txn_abort(txn);
-            throw;
+        int rc = mdbx_get(read_txn.txn(), dbi_, &key, &data);
+        if(rc == MDBX_NOTFOUND) {
+            throw std::runtime_error("Meta not found");
         }
+        auto oh = msgpack::unpack(reinterpret_cast<const char*>(data.iov_base), data.iov_len);
+        return oh.get().as<ndd::VectorMeta>();
     }
 
+    // Pins the current snapshot for this thread until the handle is released
+    ndd::ReadTxnPool::Handle pin_snapshot() const { return read_txns_->acquire(); }
+
     void remove(ndd::idInt numeric_id) {
         MDBX_txn* txn;
         int rc = mdbx_txn_begin(env_, nullptr, MDBX_TXN_READWRITE, &txn);
@@ -489,17 +577,28 @@ class VectorStorage {
 private:
     std::unique_ptr<VectorStore> vector_store_;
     std::unique_ptr<MetaStore> meta_store_;
+    // Higher precision copy of every vector, used to rerank the graph candidates
+    std::unique_ptr<VectorStore> rerank_store_;
 
 public:
     std::unique_ptr<Filter> filter_store_;
 
     VectorStorage(const std::string& base_path,
                   size_t vector_dim,
-                  ndd::quant::QuantizationLevel quant_level) {
+                  ndd::quant::QuantizationLevel quant_level,
+                  ndd::quant::QuantizationLevel rerank_quant_level =
+                          ndd::quant::QuantizationLevel::UNKNOWN,
+                  size_t rerank_dim = 0) {
         vector_store_ =
                 std::make_unique<VectorStore>(base_path + "/vectors", vector_dim, quant_level);
         meta_store_ = std::make_unique<MetaStore>(base_path + "/meta");
         filter_store_ = std::make_unique<Filter>(base_path + "/filters");
+        if(rerank_quant_level != ndd::quant::QuantizationLevel::UNKNOWN) {
+            // Indexes whose graph covers a prefix keep every dimension in the rerank copy
+            rerank_store_ = std::make_unique<VectorStore>(base_path + "/rerank",
+                                                          rerank_dim ? rerank_dim : vector_dim,
+                                                          rerank_quant_level);
+        }
     }
     VectorStore::Cursor getCursor() { return vector_store_->getCursor(); }
     // Get numeric ids of matching filters
@@ -634,6 +733,7 @@ public:
 
         // Prepare vector and meta batches
         std::vector<std::pair<ndd::idInt, std::vector<uint8_t>>> vector_batch;
+        std::vector<std::pair<ndd::idInt, std::vector<uint8_t>>> rerank_batch;
         std::vector<std::pair<ndd::idInt, ndd::VectorMeta>> meta_batch;
         std::vector<std::pair<ndd::idInt, std::string>> filter_batch;
 
@@ -654,6 +754,9 @@ public:
 
             vector_batch.emplace_back(numeric_id, std::move(vector_bytes));
             meta_batch.emplace_back(numeric_id, std::move(meta));
+            if(rerank_store_) {
+                rerank_batch.emplace_back(numeric_id, quant_obj.rerank_vector);
+            }
 
             // Collect filter data for batch processing
             if(!quant_obj.filter.empty()) {
@@ -664,6 +767,9 @@ public:
         // Store vectors and metadata in single transactions
         vector_store_->store_vectors_batch(vector_batch);
         meta_store_->store_meta_batch(meta_batch);
+        if(rerank_store_) {
+            rerank_store_->store_vectors_batch(rerank_batch);
+        }
 
         // Process filter data in batch if any
         if(!filter_batch.empty()) {
@@ -679,6 +785,36 @@ public:
         return vector_store_->get_vector_bytes(numeric_id, buffer);
     }
 
+    // Zero-copy access, see VectorStore::ReadView
+    VectorStore::ReadView get_read_view() const { return vector_store_->get_read_view(); }
+
+    bool has_rerank_store() const { return rerank_store_ != nullptr; }
+
+    // Zero-copy access to the rerank copies. Only valid if has_rerank_store()
+    VectorStore::ReadView get_rerank_view() const { return rerank_store_->get_read_view(); }
+
+    ndd::quant::QuantizationLevel getRerankQuantLevel() const {
+        return rerank_store_ ? rerank_store_->getQuantLevel()
+                             : ndd::quant::QuantizationLevel::UNKNOWN;
+    }
+
+    // 0 without a rerank copy
+    size_t getRerankDimension() const { return rerank_store_ ? rerank_store_->dimension() : 0; }
+
+    // One pinned snapshot per store. While it is alive, every lookup made on the calling
+    // thread through the vector, meta and filter stores reuses the same read transaction
+    struct ReadSnapshot {
+        ndd::ReadTxnPool::Handle vectors;
+        ndd::ReadTxnPool::Handle meta;
+        ndd::ReadTxnPool::Handle filters;
+    };
+
+    ReadSnapshot pin_snapshot() const {
+        return ReadSnapshot{vector_store_->pin_snapshot(),
+                            meta_store_->pin_snapshot(),
+                            filter_store_->pin_snapshot()};
+    }
+
     std::vector<std::pair<ndd::idInt, std::vector<uint8_t>>>
     get_vectors_batch(const std::vector<ndd::idInt>& numeric_ids) const {
         return vector_store_->get_vectors_batch(numeric_ids);
@@ -697,14 +833,24 @@ public:
             if(!meta.filter.empty()) {
                 filter_store_->remove_filters_from_json(numeric_id, meta.filter);
             }
-            // Try to remove both vector and meta data
+            // Try to remove vector, rerank copy and meta data
             vector_store_->remove(numeric_id);
+            if(rerank_store_) {
+                rerank_store_->remove(numeric_id);
+            }
             meta_store_->remove(numeric_id);
         } catch(const std::exception& e) {
             throw std::runtime_error(std::string("Failed to remove vector and metadata: ")
                                      + e.what());
         }
     }
+    // Deletes the rerank copies of deleted vectors, they are larger than the vectors themselves
+    void deleteRerankVectors(const std::vector<ndd::idInt>& numeric_ids) {
+        if(rerank_store_) {
+            rerank_store_->remove_batch(numeric_ids);
+        }
+    }
+
     // Deletes filter only.
     void deleteFilter(ndd::idInt numeric_id, std::string filter) {
         filter_store_->remove_filters_from_json(numeric_id, filter);
@@ -16,6 +16,8 @@ enum class WALOperationType : uint8_t { VECTOR_ADD = 1, VECTOR_DELETE = 2, VECTO
 class WriteAheadLog {
 private:
     std::string log_path_;
+    // Entries handed to a checkpoint that is still being written
+    std::string rotated_path_;
     std::ofstream log_file_;
     std::mutex file_mutex_;
     std::atomic<bool> enabled_{true};
@@ -30,6 +32,7 @@ public:
 
     WriteAheadLog(const std::string& index_dir) {
         log_path_ = index_dir + "/wal.bin";
+        rotated_path_ = index_dir + "/wal.prev.bin";
         // Open in append mode
         log_file_.open(log_path_, std::ios::binary | std::ios::app);
         if(!log_file_) {
@@ -43,7 +46,14 @@ public:
         // Check if WAL has existing entries (no need to count them)
         std::error_code ec;
         auto file_size = std::filesystem::file_size(log_path_, ec);
-        if(!ec && file_size > 0) {
+        if(ec) {
+            file_size = 0;
+        }
+        auto rotated_size = std::filesystem::file_size(rotated_path_, ec);
+        if(!ec) {
+            file_size += rotated_size;
+        }
+        if(file_size > 0) {
             // Set entry_count_ to 1 to indicate there are entries needing recovery
             // The exact count doesn't matter - we just need to know recovery is needed
             entry_count_ = 1;
@@ -81,11 +91,67 @@ public:
     // Convenience method for logging a single entry
     void log(const WALEntry& entry) { log(std::vector<WALEntry>{entry}); }
 
-    // Read all entries from the WAL file
+    // Read all entries from the WAL file, the ones of an unfinished checkpoint first
     std::vector<WALEntry> readEntries() {
+        std::vector<WALEntry> entries = readEntries(rotated_path_);
+        std::vector<WALEntry> current = readEntries(log_path_);
+        entries.insert(entries.end(), current.begin(), current.end());
+        return entries;
+    }
+
+    // Starts a checkpoint. The entries logged so far move aside until dropRotated() is called
+    // once the checkpoint is durable. If an earlier checkpoint failed, they are appended to
+    // the entries it left behind. On failure the entries stay where they were and logging
+    // goes on in the live file
+    void rotate() {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        bool append = std::filesystem::exists(rotated_path_);
+        if(append) {
+            // Built next to the rotated file while the live log stays open, then swapped in
+            std::string temp_path = rotated_path_ + ".tmp";
+            {
+                std::ofstream merged(temp_path, std::ios::binary | std::ios::trunc);
+                for(const std::string& path : {rotated_path_, log_path_}) {
+                    std::ifstream input(path, std::ios::binary);
+                    // Streaming an empty buffer sets failbit
+                    if(input && std::filesystem::file_size(path) > 0) {
+                        merged << input.rdbuf();
+                    }
+                }
+                merged.flush();
+                if(!merged) {
+                    std::filesystem::remove(temp_path);
+                    throw std::runtime_error("Failed to rotate WAL file: " + log_path_);
+                }
+            }
+            std::filesystem::rename(temp_path, rotated_path_);
+        }
+        log_file_.close();
+        try {
+            if(append) {
+                std::filesystem::remove(log_path_);
+            } else {
+                std::filesystem::rename(log_path_, rotated_path_);
+            }
+        } catch(...) {
+            log_file_.open(log_path_, std::ios::binary | std::ios::app);
+            throw;
+        }
+        log_file_.open(log_path_, std::ios::binary | std::ios::app);
+        entry_count_ = 0;
+    }
+
+    // Drops the entries moved aside by rotate()
+    void dropRotated() {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        std::filesystem::remove(rotated_path_);
+    }
+
+private:
+    std::vector<WALEntry> readEntries(const std::string& path) {
         std::vector<WALEntry> entries;
 
-        std::ifstream infile(log_path_, std::ios::binary);
+        std::ifstream infile(path, std::ios::binary);
         if(!infile) {
             return entries;  // Return empty if file can't be opened
         }
@@ -129,10 +195,14 @@ public:
 
         return entries;
     }
+
+public:
     // Clear the WAL file
     void clear() {
+        std::lock_guard<std::mutex> lock(file_mutex_);
         log_file_.close();
         std::filesystem::remove(log_path_);
+        std::filesystem::remove(rotated_path_);
         log_file_.open(log_path_, std::ios::binary | std::ios::app);
         entry_count_ = 0;
     }
@@ -10,6 +10,7 @@ static const uint32_t ECX_AVX_BIT = 28;
 static const uint32_t CPUID_FEATURES_LEAF = 1;
 static const uint32_t CPUID_EXT_FEATURES_LEAF = 7;
 static const uint32_t CPUID_SUBLEAF_0 = 0;
+static const uint32_t CPUID_SUBLEAF_1 = 1;
 
 static const uint32_t EBX_AVX2_BIT = 5;
 static const uint32_t EBX_AVX512F_BIT = 16;
@@ -17,6 +18,7 @@ static const uint32_t EBX_AVX512BW_BIT = 30;
 static const uint32_t ECX_AVX512VNNI_BIT = 11;
 static const uint32_t ECX_AVX512VPOPCNTDQ_BIT = 14;
 static const uint32_t EDX_AVX512FP16_BIT = 23;
+static const uint32_t EAX_AVX512BF16_BIT = 5;
 
 #if defined(__aarch64__)
 
@@ -54,6 +56,11 @@ int check_avx512_vpopcntdq_support(void) {
     return false;
 }
 
+int check_avx512_bf16_support(void) {
+    printf(ERROR_CALLING_FUNC, __func__);
+    return false;
+}
+
 #else  //X86
 #    include <cpuid.h>
 #    include <immintrin.h>
@@ -216,6 +223,16 @@ static int cpu_has_avx512vpopcntdq(void) {
     return (ecx >> ECX_AVX512VPOPCNTDQ_BIT) & 1;
 }
 
+/**
+ * True if CPU has AVX512 BF16 (vdpbf16ps, vcvtneps2bf16)
+ */
+static int cpu_has_avx512bf16(void) {
+    uint32_t eax, ebx, ecx, edx;
+    // AVX-512 BF16: CPUID.(EAX=7, ECX=1):EAX bit 5
+    cpuid_ex(CPUID_EXT_FEATURES_LEAF, CPUID_SUBLEAF_1, &eax, &ebx, &ecx, &edx);
+    return (eax >> EAX_AVX512BF16_BIT) & 1;
+}
+
 /**
  * //////////////////////////////////////////////////////////////////
  * One Instruction test
@@ -283,6 +300,14 @@ static void run_one_avx512vpopcntdq_instruction(void) {
     __m512i b = _mm512_popcnt_epi64(a);
     (void)b;
 }
+
+static void run_one_avx512bf16_instruction(void) {
+    // VDPBF16PS zmm,zmm,zmm  (requires AVX-512 BF16)
+    __m512 acc = _mm512_setzero_ps();
+    __m512bh a = _mm512_cvtne2ps_pbh(_mm512_set1_ps(1.0f), _mm512_set1_ps(2.0f));
+    __m512 b = _mm512_dpbf16_ps(acc, a, a);
+    (void)b;
+}
 #    endif
 /**
  * //////////////////////////////////////////////////////////////////
@@ -447,6 +472,33 @@ exit:
     return ret;
 }
 
+int check_avx512_bf16_support(void) {
+    int ret = false;
+
+    if(!cpu_has_avx512f()) {
+        printf("ERROR: AVX-512 BF16: not supported (missing AVX-512F).\n");
+        goto exit;
+    }
+
+    if(!cpu_has_avx512bf16()) {
+        printf("ERROR: AVX-512 BF16: not supported by CPU.\n");
+        goto exit;
+    }
+
+    if(!os_supports_avx512_state()) {
+        printf("ERROR: AVX-512 BF16: CPU supports it, but OS AVX-512 state not enabled (XCR0).\n");
+        goto exit;
+    }
+
+    // run_one_avx512bf16_instruction();
+
+    ret = true;
+    printf("LOG: AVX-512 BF16: supported and usable.\n");
+
+exit:
+    return ret;
+}
+
 #endif  //__aarch64__
 
 /**
@@ -461,12 +513,12 @@ bool is_avx2_compatible() {
 bool is_avx512_compatible() {
     return check_avx2_support() && check_avx512_support() && check_avx512_fp16_support()
            && check_avx512_vnni_support() && check_avx512_bw_support()
-           && check_avx512_vpopcntdq_support();
+           && check_avx512_vpopcntdq_support() && check_avx512_bf16_support();
 }
 
 /*
 int main(){
-        //gcc test_avx.c -mavx512f -mavx512fp16 -mavx512vnni -mavx512bw -mavx512vpopcntdq
+        //gcc test_avx.c -mavx512f -mavx512fp16 -mavx512vnni -mavx512bw -mavx512vpopcntdq -mavx512bf16
         if(is_avx512_compatible()){
                 printf("YES\n");
         }else{
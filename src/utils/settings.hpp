@@ -5,6 +5,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cstdint>
+#include <thread>
 
 constexpr uint64_t KB = (1024ULL);
 constexpr uint64_t MB = (1024ULL * KB);
@@ -17,7 +18,7 @@ namespace settings {
     // do not support constexpr for std::string
     inline const std::string NAME = "Endee";
     inline const std::string VERSION = "1.0.0-beta";
-    inline uint16_t INDEX_VERSION = 1;
+    inline uint16_t INDEX_VERSION = 2;  // 2: INT8 vectors store their squared norm
     inline const std::string DEFAULT_SPACE_TYPE = "cosine";
     constexpr size_t DEFAULT_STORAGE_BITS =
             16;  // 16 bits = 2 bytes per element. Only for dense vectors
@@ -32,12 +33,24 @@ namespace settings {
     constexpr size_t DEFAULT_EF_SEARCH = 128;
     constexpr size_t MIN_K = 1;
     constexpr size_t MAX_K = 4096;
+    // Graph candidates per requested result that are rescored on indexes with a rerank copy
+    constexpr size_t DEFAULT_RERANK_FACTOR = 4;
+    constexpr size_t MAX_RERANK_FACTOR = 64;
     constexpr size_t RANDOM_SEED = 100;
     constexpr size_t SAVE_EVERY_N_UPDATES = 10'000;
     constexpr size_t RECOVERY_BATCH_SIZE = 20'000;
     constexpr size_t SAVE_EVERY_N_MINUTES = 30;
+    // The autosave thread vacuums indexes whose deleted elements reach this share of the used
+    // slots, and at least VACUUM_MIN_DELETED of them
+    constexpr double VACUUM_DELETED_RATIO = 0.1;
+    constexpr size_t VACUUM_MIN_DELETED = 1'000;
+    // Checkpoints append the elements changed since the previous one to the delta file of the
+    // index file, and write the whole file again once the deltas reach this share of its size
+    constexpr double CHECKPOINT_DELTA_RATIO = 0.25;
     // Number of threads for http server - 0 means it will default to hardware concurrency
     constexpr size_t NUM_SERVER_THREADS = 0;
+    // MDBX reader slots for threads not counted in MDBX_MAX_READERS (autosave, checkpoints)
+    constexpr size_t MDBX_EXTRA_READERS = 16;
     // Number of save mutexes for parallel saves
     constexpr size_t NUM_INDEX_SAVE_MUTEXES = 16;
 
@@ -60,6 +73,12 @@ namespace settings {
 
     constexpr size_t MAX_LINK_LIST_LOCKS = 65536;
 
+    // Alignment (and stride granularity) of the in-memory level 0 vector arena
+    constexpr size_t VECTOR_ARENA_ALIGNMENT = 64;
+
+    // Cache lines of each neighbor vector prefetched ahead of batch scoring in HNSW search
+    constexpr size_t PREFETCH_VECTOR_LINES = 4;
+
     // Sparse Storage settings
     constexpr uint16_t MAX_BLOCK_SIZE = 128;    // Number of elements in a block
     constexpr uint32_t DEFAULT_VOCAB_SIZE = 0;  // 0 means dense vectors only
@@ -74,16 +93,45 @@ namespace settings {
     constexpr int EARLY_EXIT_BUFFER_INSERT = 16;
     constexpr int EARLY_EXIT_BUFFER_QUERY = 8;
 
-    // Pre-filter threshold - use pre-filter when cardinality is below this value
-    constexpr size_t PREFILTER_CARDINALITY_THRESHOLD = 1000;
-    // Use pre-filter if post-filter results are poor (less than this ratio of k)
-    constexpr float PREFILTER_RESULT_RATIO_THRESHOLD = 0.25f;  // k/4
+    // Filtered search planner. Costs are estimated in nanoseconds from the element count, the
+    // dimension and the values below. They are tunable defaults: only their ratios matter
+    // to the choice of plan.
+    // Visited nodes per unit of ef, relative to the base layer degree
+    constexpr double PLANNER_GRAPH_VISIT_RATIO = 0.75;
+    // Extra traversal work per rejected neighbor of a filtered graph search
+    constexpr double PLANNER_FILTER_PENALTY = 0.02;
+    // Scoring one stored vector against the query, per dimension
+    constexpr double PLANNER_NS_PER_DIMENSION = 0.5;
+    // Looking up a vector by id in the vector store, not paid with a vector arena
+    constexpr double PLANNER_VECTOR_FETCH_NS = 700.0;
+    // Materializing the filter bitmap, per matching id. Set for $range, $eq is far cheaper
+    constexpr double PLANNER_BITMAP_NS_PER_ID = 30.0;
+    // Loading and checking the metadata of one over-fetched candidate
+    constexpr double PLANNER_POSTFILTER_NS = 2500.0;
+    // Over-fetch asks for k / selectivity candidates times this margin
+    constexpr double PLANNER_OVERFETCH_MARGIN = 1.5;
+
+    // Ids scored per task of a parallel brute force search
+    constexpr size_t BRUTE_FORCE_BLOCK_SIZE = 4096;
+
+    // PQ codebooks are trained with k-means on the first batch inserted into an index
+    constexpr size_t PQ_MIN_TRAINING_VECTORS = 256;
+    constexpr size_t PQ_MAX_TRAINING_VECTORS = 4096;
+    constexpr size_t PQ_TRAINING_ITERATIONS = 25;
+
+    // INT8S dimension ranges are measured on the first batch inserted into an index
+    constexpr size_t INT8S_MIN_TRAINING_VECTORS = 64;
+    constexpr size_t INT8S_MAX_TRAINING_VECTORS = 16384;
 
     //DEFAULT VALUES
     constexpr size_t DEFAULT_NUM_PARALLEL_INSERTS = 4;
     constexpr size_t DEFAULT_NUM_RECOVERY_THREADS = 16;
+    constexpr size_t DEFAULT_NUM_SEARCH_THREADS = 0;  // 0 means hardware concurrency
     constexpr size_t DEFAULT_MAX_MEMORY_GB = 24;
     constexpr bool DEFAULT_ENABLE_DEBUG_LOG = true;
+    constexpr bool DEFAULT_ENABLE_VECTOR_ARENA = false;
+    constexpr bool DEFAULT_ENABLE_INDEX_MMAP = true;
+    constexpr bool DEFAULT_MMAP_POPULATE = false;
     const std::string DEFAULT_AUTH_TOKEN = "";
     inline static std::string DEFAULT_USERNAME = "endee";
     constexpr size_t DEFAULT_SERVER_PORT = 8080;
@@ -148,6 +196,28 @@ namespace settings {
         const char* env = std::getenv("NDD_NUM_RECOVERY_THREADS");
         return env ? std::stoull(env) : DEFAULT_NUM_RECOVERY_THREADS;
     }();
+    // Threads shared by the searches that scan many vectors exactly (filtered brute force)
+    inline static size_t NUM_SEARCH_THREADS = [] {
+        const char* env = std::getenv("NDD_NUM_SEARCH_THREADS");
+        size_t threads = env ? std::stoull(env) : DEFAULT_NUM_SEARCH_THREADS;
+        return threads ? threads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }();
+    // Reader slots of every MDBX environment. Each thread keeps its read transaction parked in
+    // a slot (see ReadTxnPool), so this covers the server threads, each with one async sparse
+    // search, the search, insert and recovery threads, and a few background threads. MDBX
+    // defaults to 61 and fails with MDBX_READERS_FULL past that.
+    inline static size_t MDBX_MAX_READERS = [] {
+        const char* env = std::getenv("NDD_MDBX_MAX_READERS");
+        if(env) {
+            return static_cast<size_t>(std::stoull(env));
+        }
+        size_t server_threads = NUM_SERVER_THREADS ? NUM_SERVER_THREADS
+                                                   : std::thread::hardware_concurrency();
+        size_t readers = 2 * std::max<size_t>(server_threads, 1) + NUM_SEARCH_THREADS
+                         + NUM_PARALLEL_INSERTS + NUM_RECOVERY_THREADS + MDBX_EXTRA_READERS;
+        // Never fewer than the MDBX default
+        return std::max<size_t>(readers, 61);
+    }();
     // TODO - Check if we can set this dynamically based on system memory
     // Max memory for HNSW index. It will evict the oldest index if it exceeds this limit
     inline static size_t MAX_MEMORY_GB = [] {
@@ -161,6 +231,30 @@ namespace settings {
                    : DEFAULT_ENABLE_DEBUG_LOG;
     }();
 
+    // Keep the quantized level 0 vectors in memory next to the HNSW graph instead of
+    // fetching them from the vector store for every distance computation
+    inline static bool ENABLE_VECTOR_ARENA = [] {
+        const char* env = std::getenv("NDD_VECTOR_ARENA");
+        return env ? (std::string(env) == "1" || std::string(env) == "true")
+                   : DEFAULT_ENABLE_VECTOR_ARENA;
+    }();
+
+    // Map HNSW index files on load instead of reading them. Pages are read on first access
+    // and stay in the page cache after the index is evicted
+    inline static bool ENABLE_INDEX_MMAP = [] {
+        const char* env = std::getenv("NDD_INDEX_MMAP");
+        return env ? (std::string(env) == "1" || std::string(env) == "true")
+                   : DEFAULT_ENABLE_INDEX_MMAP;
+    }();
+
+    // Read a mapped index file in whole on load, so that the first searches do not wait on
+    // page faults
+    inline static bool MMAP_POPULATE = [] {
+        const char* env = std::getenv("NDD_MMAP_POPULATE");
+        return env ? (std::string(env) == "1" || std::string(env) == "true")
+                   : DEFAULT_MMAP_POPULATE;
+    }();
+
     // Authentication settings for open-source mode
     // If NDD_AUTH_TOKEN is set, authentication is required
     // If NDD_AUTH_TOKEN is empty/not set, all APIs work without authentication
@@ -184,8 +278,13 @@ namespace settings {
         oss << "MAX_ELEMENTS_INCREMENT_TRIGGER: " << MAX_ELEMENTS_INCREMENT_TRIGGER << "\n";
         oss << "NUM_PARALLEL_INSERTS: " << NUM_PARALLEL_INSERTS << "\n";
         oss << "NUM_RECOVERY_THREADS: " << NUM_RECOVERY_THREADS << "\n";
+        oss << "NUM_SEARCH_THREADS: " << NUM_SEARCH_THREADS << "\n";
+        oss << "MDBX_MAX_READERS: " << MDBX_MAX_READERS << "\n";
         oss << "MAX_MEMORY_GB: " << MAX_MEMORY_GB << "\n";
         oss << "ENABLE_DEBUG_LOG: " << (ENABLE_DEBUG_LOG ? "true" : "false") << "\n";
+        oss << "ENABLE_VECTOR_ARENA: " << (ENABLE_VECTOR_ARENA ? "true" : "false") << "\n";
+        oss << "ENABLE_INDEX_MMAP: " << (ENABLE_INDEX_MMAP ? "true" : "false") << "\n";
+        oss << "MMAP_POPULATE: " << (MMAP_POPULATE ? "true" : "false") << "\n";
         oss << "AUTH_ENABLED: " << (AUTH_ENABLED ? "true" : "false") << "\n";
         oss << "DEFAULT_USERNAME: " << DEFAULT_USERNAME << "\n";
         oss << "\n=== End Settings ===\n";
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ndd {
+
+    // Long-lived threads that split one request into tasks.
+    //
+    // parallel_for() queues a job and the calling thread works on it together with the
+    // pool, so a job always makes progress even when every worker is busy with other jobs.
+    // Workers keep their thread-local state, such as parked read transactions, between jobs.
+    class WorkerPool {
+    public:
+        explicit WorkerPool(size_t num_workers) {
+            workers_.reserve(num_workers);
+            for(size_t i = 0; i < num_workers; i++) {
+                workers_.emplace_back([this, slot = i + 1]() { workerLoop(slot); });
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            for(auto& worker : workers_) {
+                worker.join();
+            }
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // Number of threads a job can run on, the caller included
+        size_t concurrency() const { return workers_.size() + 1; }
+
+        // Runs fn(task, slot) for every task in [0, num_tasks) and returns once all of them
+        // finished. slot < concurrency() identifies the executing thread within this job, so
+        // tasks can accumulate into per-slot state without locking. The first exception
+        // thrown by a task is rethrown here.
+        void parallel_for(size_t num_tasks, const std::function<void(size_t, size_t)>& fn) {
+            if(num_tasks == 0) {
+                return;
+            }
+
+            auto job = std::make_shared<Job>(fn, num_tasks);
+            if(num_tasks > 1 && !workers_.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    jobs_.push_back(job);
+                }
+                cv_.notify_all();
+            }
+
+            runTasks(*job, 0);
+
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->done_cv.wait(lock, [&]() { return job->done == job->num_tasks; });
+            if(job->error) {
+                std::rethrow_exception(job->error);
+            }
+        }
+
+    private:
+        struct Job {
+            Job(const std::function<void(size_t, size_t)>& f, size_t n) :
+                fn(f),
+                num_tasks(n) {}
+
+            const std::function<void(size_t, size_t)>& fn;
+            const size_t num_tasks;
+            std::atomic<size_t> next{0};
+
+            std::mutex mutex;  // Guards done and error
+            std::condition_variable done_cv;
+            size_t done{0};
+            std::exception_ptr error;
+        };
+
+        std::vector<std::thread> workers_;
+        std::deque<std::shared_ptr<Job>> jobs_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stop_{false};
+
+        static void runTasks(Job& job, size_t slot) {
+            size_t task;
+            while((task = job.next.fetch_add(1)) < job.num_tasks) {
+                std::exception_ptr error;
+                try {
+                    job.fn(task, slot);
+                } catch(...) {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if(error && !job.error) {
+                    job.error = error;
+                }
+                if(++job.done == job.num_tasks) {
+                    job.done_cv.notify_all();
+                }
+            }
+        }
+
+        void workerLoop(size_t slot) {
+            while(true) {
+                std::shared_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [&]() { return stop_ || !jobs_.empty(); });
+                    if(stop_) {
+                        return;
+                    }
+                    job = jobs_.front();
+                    // Every task is claimed, nothing left for other workers
+                    if(job->next.load() >= job->num_tasks) {
+                        jobs_.pop_front();
+                        continue;
+                    }
+                }
+                runTasks(*job, slot);
+            }
+        }
+    };
+
+}  // namespace ndd